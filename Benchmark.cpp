@@ -0,0 +1,424 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include <GL/glew.h>
+
+#include "GLStats.h"
+
+using namespace std;
+
+namespace
+{
+	typedef chrono::steady_clock Clock;
+
+	//number of timer queries in flight (results are read back this many frames late)
+	const int GPU_QUERY_COUNT = 4;
+
+	struct FrameSample
+	{
+		double cpuMs;		//begin of frame to right before the swap
+		double frameMs;		//whole loop iteration including the swap
+		double gpuMs;		//GL_TIME_ELAPSED for the frame (-1 if never available)
+		double latencyMs;	//input latched to frame finished after the swap (-1 if not measured)
+	};
+
+	vector<FrameSample> samples;
+	GLuint gpuQueries[GPU_QUERY_COUNT];
+	int queryFrame[GPU_QUERY_COUNT];	//which sample each query belongs to (-1 = free)
+	Clock::time_point frameStart;
+	bool started = false;
+	double workloadTriangles = 0.0;
+	double workloadPixels = 0.0;
+	double startupMs = -1.0;
+	double startupShaderMs = 0.0;
+	const char* startupShaderCache = "";
+
+	//read back the result of query slot i (blocks only when forced, used for the last frames)
+	void UCollectQuery(int i, bool wait)
+	{
+		if (queryFrame[i] < 0)
+			return;
+
+		GLint available = 0;
+		glGetQueryObjectiv(gpuQueries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available && !wait)
+			return;
+
+		GLuint64 elapsed = 0;
+		glGetQueryObjectui64v(gpuQueries[i], GL_QUERY_RESULT, &elapsed);
+		samples[queryFrame[i]].gpuMs = elapsed / 1.0e6;
+		queryFrame[i] = -1;
+	}
+
+	//nearest rank percentile of an already sorted list
+	double UPercentile(const vector<double>& sorted, double p)
+	{
+		if (sorted.empty())
+			return 0.0;
+		size_t rank = (size_t)(p / 100.0 * sorted.size() + 0.5);
+		rank = std::min(std::max(rank, (size_t)1), sorted.size());
+		return sorted[rank - 1];
+	}
+
+	void UWriteStats(ostream& out, const char* name, vector<double> values, bool last)
+	{
+		sort(values.begin(), values.end());
+		double mean = 0.0;
+		for (double v : values)
+			mean += v;
+		if (!values.empty())
+			mean /= values.size();
+
+		out << "    \"" << name << "\": { \"mean\": " << mean
+			<< ", \"p50\": " << UPercentile(values, 50.0)
+			<< ", \"p95\": " << UPercentile(values, 95.0)
+			<< ", \"p99\": " << UPercentile(values, 99.0)
+			<< ", \"max\": " << (values.empty() ? 0.0 : values.back())
+			<< " }" << (last ? "\n" : ",\n");
+	}
+
+	//escape a driver string or a path for json output
+	string UJsonString(const GLubyte* text)
+	{
+		string result;
+		for (const char* c = text ? (const char*)text : ""; *c; c++)
+		{
+			if ((unsigned char)*c < 0x20)
+			{
+				char escaped[8];
+				snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned char)*c);
+				result += escaped;
+				continue;
+			}
+			if (*c == '"' || *c == '\\')
+				result += '\\';
+			result += *c;
+		}
+		return result;
+	}
+
+	//catmull-rom interpolation between b and c
+	float UCatmullRom(float a, float b, float c, float d, float t)
+	{
+		float t2 = t * t;
+		float t3 = t2 * t;
+		return 0.5f * ((2.0f * b) + (c - a) * t + (2.0f * a - 5.0f * b + 4.0f * c - d) * t2 + (3.0f * b - a - 3.0f * c + d) * t3);
+	}
+}
+
+//COMMAND LINE =====================================================================================================================================
+
+bool UParseBenchmarkArgs(int argc, char* argv[], UBenchmarkConfig& config)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--benchmark") == 0)
+		{
+			config.enabled = true;
+			//optional path file
+			if (i + 1 < argc && argv[i + 1][0] != '-')
+				config.pathFile = argv[++i];
+		}
+		else if (strcmp(argv[i], "--bench-out") == 0 || strcmp(argv[i], "--bench-dt") == 0 || strcmp(argv[i], "--record") == 0)
+		{
+			if (i + 1 >= argc)
+			{
+				cerr << "ERROR: " << argv[i] << " needs a value" << endl;
+				return false;
+			}
+			if (strcmp(argv[i], "--bench-out") == 0)
+				config.outPrefix = argv[++i];
+			else if (strcmp(argv[i], "--bench-dt") == 0)
+				config.timestep = (float)atof(argv[++i]);
+			else
+				config.recordFile = argv[++i];
+		}
+	}
+
+	if (config.timestep <= 0.0f)
+	{
+		cerr << "ERROR: --bench-dt must be positive" << endl;
+		return false;
+	}
+	return true;
+}
+
+//CAMERA PATHS =====================================================================================================================================
+
+void UDefaultCameraPath(std::vector<UCameraKey>& keys)
+{
+	//slow orbit around the table at two heights, always looking back at the middle of the scene
+	keys.clear();
+	const int steps = 16;
+	const float duration = 20.0f;
+	for (int i = 0; i <= steps; i++)
+	{
+		float t = (float)i / steps;
+		float angle = glm::radians(90.0f + 360.0f * t);
+		float radius = 8.0f - 3.0f * sin(glm::radians(180.0f * t));
+		UCameraKey key;
+		key.time = duration * t;
+		key.position = glm::vec3(radius * cos(angle), 2.0f + 1.5f * sin(glm::radians(360.0f * t)), radius * sin(angle));
+		glm::vec3 toCenter = glm::normalize(glm::vec3(0.0f, 0.5f, 0.0f) - key.position);
+		key.yaw = glm::degrees(atan2(toCenter.z, toCenter.x));
+		key.pitch = glm::degrees(asin(toCenter.y));
+		//keep yaw continuous so the spline doesn't spin the long way round
+		if (!keys.empty())
+		{
+			while (key.yaw - keys.back().yaw > 180.0f) key.yaw -= 360.0f;
+			while (key.yaw - keys.back().yaw < -180.0f) key.yaw += 360.0f;
+		}
+		keys.push_back(key);
+	}
+}
+
+bool ULoadCameraPath(const std::string& file, std::vector<UCameraKey>& keys)
+{
+	ifstream in(file.c_str());
+	if (!in)
+	{
+		cerr << "ERROR: could not open camera path " << file << endl;
+		return false;
+	}
+
+	keys.clear();
+	string line;
+	while (getline(in, line))
+	{
+		size_t comment = line.find('#');
+		if (comment != string::npos)
+			line.erase(comment);
+
+		istringstream fields(line);
+		UCameraKey key;
+		if (fields >> key.time >> key.position.x >> key.position.y >> key.position.z >> key.yaw >> key.pitch)
+			keys.push_back(key);
+	}
+
+	if (keys.size() < 2)
+	{
+		cerr << "ERROR: camera path " << file << " needs at least two keys" << endl;
+		return false;
+	}
+
+	stable_sort(keys.begin(), keys.end(), [](const UCameraKey& a, const UCameraKey& b) { return a.time < b.time; });
+	return true;
+}
+
+bool USaveCameraPath(const std::string& file, const std::vector<UCameraKey>& keys)
+{
+	ofstream out(file.c_str());
+	if (!out)
+	{
+		cerr << "ERROR: could not write camera path " << file << endl;
+		return false;
+	}
+
+	out << "# time x y z yaw pitch\n";
+	for (const UCameraKey& key : keys)
+		out << key.time << ' ' << key.position.x << ' ' << key.position.y << ' ' << key.position.z << ' ' << key.yaw << ' ' << key.pitch << '\n';
+	return true;
+}
+
+void USampleCameraPath(const std::vector<UCameraKey>& keys, float time, glm::vec3& position, float& yaw, float& pitch)
+{
+	if (keys.empty())
+		return;
+
+	//clamp outside the keyed range
+	if (keys.size() == 1 || time <= keys.front().time)
+	{
+		position = keys.front().position;
+		yaw = keys.front().yaw;
+		pitch = keys.front().pitch;
+		return;
+	}
+	if (time >= keys.back().time)
+	{
+		position = keys.back().position;
+		yaw = keys.back().yaw;
+		pitch = keys.back().pitch;
+		return;
+	}
+
+	//find the segment [i, i+1] that contains time
+	size_t i = upper_bound(keys.begin(), keys.end(), time, [](float t, const UCameraKey& key) { return t < key.time; }) - keys.begin() - 1;
+	const UCameraKey& a = keys[i > 0 ? i - 1 : i];
+	const UCameraKey& b = keys[i];
+	const UCameraKey& c = keys[i + 1];
+	const UCameraKey& d = keys[i + 2 < keys.size() ? i + 2 : i + 1];
+
+	float span = c.time - b.time;
+	float t = span > 0.0f ? (time - b.time) / span : 0.0f;
+
+	for (int axis = 0; axis < 3; axis++)
+		position[axis] = UCatmullRom(a.position[axis], b.position[axis], c.position[axis], d.position[axis], t);
+	yaw = UCatmullRom(a.yaw, b.yaw, c.yaw, d.yaw, t);
+	pitch = glm::clamp(UCatmullRom(a.pitch, b.pitch, c.pitch, d.pitch, t), -89.0f, 89.0f);
+}
+
+//FRAME TIMING =====================================================================================================================================
+
+void UBenchmarkStart(const UBenchmarkConfig& config, const std::vector<UCameraKey>& path)
+{
+	//the warmup frames, then one per timestep until the path's last key (and one to spare for rounding)
+	float duration = path.empty() ? 0.0f : path.back().time;
+	size_t frames = (size_t)std::max(config.warmupFrames, 0) + (size_t)(duration / config.timestep) + 2;
+	samples.clear();
+	samples.reserve(frames);
+	glGenQueries(GPU_QUERY_COUNT, gpuQueries);
+	for (int i = 0; i < GPU_QUERY_COUNT; i++)
+		queryFrame[i] = -1;
+	started = true;
+}
+
+void UBenchmarkBeginFrame()
+{
+	if (!started)
+		return;
+
+	int frame = (int)samples.size();
+	int slot = frame % GPU_QUERY_COUNT;
+
+	//the slot was last used GPU_QUERY_COUNT frames ago, that result has to be read before reuse
+	UCollectQuery(slot, true);
+	for (int i = 0; i < GPU_QUERY_COUNT; i++)
+		UCollectQuery(i, false);
+
+	FrameSample sample = { 0.0, 0.0, -1.0, -1.0 };
+	samples.push_back(sample);
+	queryFrame[slot] = frame;
+	glBeginQuery(GL_TIME_ELAPSED, gpuQueries[slot]);
+	frameStart = Clock::now();
+}
+
+void UBenchmarkEndCpu()
+{
+	if (!started || samples.empty())
+		return;
+
+	glEndQuery(GL_TIME_ELAPSED);
+	samples.back().cpuMs = chrono::duration<double, milli>(Clock::now() - frameStart).count();
+}
+
+void UBenchmarkEndFrame()
+{
+	if (!started || samples.empty())
+		return;
+
+	samples.back().frameMs = chrono::duration<double, milli>(Clock::now() - frameStart).count();
+}
+
+int UBenchmarkCurrentFrame()
+{
+	return started ? (int)samples.size() - 1 : -1;
+}
+
+void UBenchmarkSetLatency(int frame, double latencyMs)
+{
+	if (frame >= 0 && frame < (int)samples.size())
+		samples[frame].latencyMs = latencyMs;
+}
+
+bool UBenchmarkFinish(const UBenchmarkConfig& config)
+{
+	if (!started)
+		return false;
+
+	//drain the queries still in flight
+	for (int i = 0; i < GPU_QUERY_COUNT; i++)
+		UCollectQuery(i, true);
+	glDeleteQueries(GPU_QUERY_COUNT, gpuQueries);
+	started = false;
+
+	size_t first = std::min((size_t)std::max(config.warmupFrames, 0), samples.size());
+	vector<double> cpu, frame, gpu, latency;
+	for (size_t i = first; i < samples.size(); i++)
+	{
+		cpu.push_back(samples[i].cpuMs);
+		frame.push_back(samples[i].frameMs);
+		if (samples[i].gpuMs >= 0.0)
+			gpu.push_back(samples[i].gpuMs);
+		if (samples[i].latencyMs >= 0.0)
+			latency.push_back(samples[i].latencyMs);
+	}
+
+	string csvName = config.outPrefix + ".csv";
+	ofstream csv(csvName.c_str());
+	if (!csv)
+	{
+		cerr << "ERROR: could not write " << csvName << endl;
+		return false;
+	}
+	csv << "frame,cpu_ms,gpu_ms,frame_ms,latency_ms\n";
+	for (size_t i = first; i < samples.size(); i++)
+		csv << (i - first) << ',' << samples[i].cpuMs << ',' << samples[i].gpuMs << ',' << samples[i].frameMs << ',' << samples[i].latencyMs << '\n';
+
+	string jsonName = config.outPrefix + ".json";
+	ofstream json(jsonName.c_str());
+	if (!json)
+	{
+		cerr << "ERROR: could not write " << jsonName << endl;
+		return false;
+	}
+	json << "{\n"
+		<< "  \"renderer\": \"" << UJsonString(glGetString(GL_RENDERER)) << "\",\n"
+		<< "  \"vendor\": \"" << UJsonString(glGetString(GL_VENDOR)) << "\",\n"
+		<< "  \"version\": \"" << UJsonString(glGetString(GL_VERSION)) << "\",\n"
+		<< "  \"path\": \"" << UJsonString((const GLubyte*)(config.pathFile.empty() ? "builtin" : config.pathFile.c_str())) << "\",\n"
+		<< "  \"timestep\": " << config.timestep << ",\n"
+		<< "  \"frames\": " << cpu.size() << ",\n";
+	if (workloadTriangles > 0.0 && !frame.empty())
+	{
+		double seconds = 0.0;
+		for (double ms : frame)
+			seconds += ms / 1000.0;
+		seconds /= frame.size();
+		json << "  \"triangles_per_frame\": " << workloadTriangles << ",\n"
+			<< "  \"pixels_per_frame\": " << workloadPixels << ",\n"
+			<< "  \"mtris_per_s\": " << workloadTriangles / seconds / 1.0e6 << ",\n"
+			<< "  \"mpix_per_s\": " << workloadPixels / seconds / 1.0e6 << ",\n";
+	}
+	if (startupMs >= 0.0)
+	{
+		json << "  \"startup_ms\": " << startupMs << ",\n"
+			<< "  \"startup_shader_ms\": " << startupShaderMs << ",\n"
+			<< "  \"shader_cache\": \"" << startupShaderCache << "\",\n";
+	}
+	json << "  \"stats\": {\n";
+	UWriteStats(json, "cpu_ms", cpu, false);
+	UWriteStats(json, "gpu_ms", gpu, false);
+	UWriteStats(json, "frame_ms", frame, latency.empty());
+	if (!latency.empty())
+		UWriteStats(json, "latency_ms", latency, true);
+	json << "  }\n}\n";
+
+	sort(cpu.begin(), cpu.end());
+	sort(gpu.begin(), gpu.end());
+	sort(latency.begin(), latency.end());
+	cout << "BENCHMARK: " << cpu.size() << " frames, cpu p50 " << UPercentile(cpu, 50.0) << " ms p99 " << UPercentile(cpu, 99.0)
+		<< " ms, gpu p50 " << UPercentile(gpu, 50.0) << " ms p99 " << UPercentile(gpu, 99.0) << " ms, latency p50 "
+		<< UPercentile(latency, 50.0) << " ms p99 " << UPercentile(latency, 99.0) << " ms -> " << csvName << ", " << jsonName << endl;
+	return true;
+}
+
+void UBenchmarkSetWorkload(double trianglesPerFrame, double pixelsPerFrame)
+{
+	workloadTriangles = trianglesPerFrame;
+	workloadPixels = pixelsPerFrame;
+}
+
+void UBenchmarkSetStartup(double startup, double shaderMs, const char* shaderCache)
+{
+	startupMs = startup;
+	startupShaderMs = shaderMs;
+	startupShaderCache = shaderCache;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+//BENCHMARK MODE ==================================================================================================================================
+//
+// --benchmark [path.txt]   replay a camera path (built in orbit if no file is given) with a fixed timestep and vsync off,
+//                          then write <prefix>.csv and <prefix>.json with per-frame cpu/gpu times, input latency and p50/p95/p99/max
+// --bench-out <prefix>     output file prefix (default "benchmark")
+// --bench-dt <seconds>     fixed simulation timestep used while replaying (default 1/60)
+// --record <path.txt>      record the live camera to a path file that --benchmark can replay later
+//
+// path files are plain text, one key per line: time x y z yaw pitch ('#' starts a comment)
+
+//camera keyframe (position/yaw/pitch keyed by time)
+struct UCameraKey
+{
+	float time;
+	glm::vec3 position;
+	float yaw;
+	float pitch;
+};
+
+struct UBenchmarkConfig
+{
+	bool enabled = false;				//replay a camera path instead of taking input
+	std::string pathFile;				//camera path to replay (empty = built in orbit)
+	std::string recordFile;				//when set the live camera is recorded here
+	std::string outPrefix = "benchmark";
+	float timestep = 1.0f / 60.0f;		//fixed simulation step per frame
+	int warmupFrames = 30;				//frames rendered before timing starts (not written out)
+};
+
+//parse the benchmark related command line options (returns false on a malformed command line)
+bool UParseBenchmarkArgs(int argc, char* argv[], UBenchmarkConfig& config);
+
+//camera paths
+void UDefaultCameraPath(std::vector<UCameraKey>& keys);
+bool ULoadCameraPath(const std::string& file, std::vector<UCameraKey>& keys);
+bool USaveCameraPath(const std::string& file, const std::vector<UCameraKey>& keys);
+void USampleCameraPath(const std::vector<UCameraKey>& keys, float time, glm::vec3& position, float& yaw, float& pitch);
+
+//frame timing (needs a current GL context; gpu time is read back a few frames late so the pipeline never stalls). the
+//samples of every frame the path takes are allocated here, so timing a frame never allocates
+void UBenchmarkStart(const UBenchmarkConfig& config, const std::vector<UCameraKey>& path);
+void UBenchmarkBeginFrame();
+void UBenchmarkEndCpu();		//call right before swapping buffers
+void UBenchmarkEndFrame();
+//sample index of the frame being timed (-1 when not benchmarking) and its input-to-present latency, which is only known
+//once the gpu has finished the frame (see FramePacing.h)
+int UBenchmarkCurrentFrame();
+void UBenchmarkSetLatency(int frame, double latencyMs);
+bool UBenchmarkFinish(const UBenchmarkConfig& config);
+//triangles submitted and pixels covered per frame, reported as Mtris/s and Mpix/s (to compare against --software-bench,
+//e.g. run once on the gpu and once with LIBGL_ALWAYS_SOFTWARE=1 for llvmpipe)
+void UBenchmarkSetWorkload(double trianglesPerFrame, double pixelsPerFrame);
+//launch-to-first-frame time and the part of it spent creating shader programs ("cold"/"warm"/"off" program cache)
+void UBenchmarkSetStartup(double startupMs, double shaderMs, const char* shaderCache);
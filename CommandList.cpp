@@ -0,0 +1,169 @@
+#include "CommandList.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "FrameArena.h"
+#include "JobSystem.h"
+#include "MultiView.h"
+#include "Trace.h"
+
+using namespace std;
+
+namespace
+{
+	//below this many draws per slice the job overhead costs more than the slice
+	const int MIN_SLICE = 64;
+
+	bool USphereVisible(const glm::vec4 planes[6], const glm::vec3& center, float radius)
+	{
+		for (int i = 0; i < 6; i++)
+		{
+			if (glm::dot(glm::vec3(planes[i]), center) + planes[i].w < -radius)
+				return false;
+		}
+		return true;
+	}
+
+	//one draw serves every view (MultiView.h), so it stays when any of them sees it
+	bool USphereVisibleInAny(const glm::vec4* planes, int views, const glm::vec3& center, float radius)
+	{
+		for (int v = 0; v < views; v++)
+		{
+			if (USphereVisible(planes + 6 * v, center, radius))
+				return true;
+		}
+		return false;
+	}
+
+	//what every slice job needs (one pointer, so the job's std::function doesn't allocate)
+	struct BuildContext
+	{
+		UCommandLists* lists;
+		const std::vector<UDrawItem>* items;
+		const USceneGraph* scene;
+		glm::vec4 planes[6 * UMULTIVIEW_MAX_VIEWS];
+		int views;
+		int grain;
+	};
+
+	void UBuildSlice(UCommandList& list, const std::vector<UDrawItem>& items, int begin, int end, const USceneGraph& scene, const glm::vec4* planes, int views, int worker)
+	{
+		UTRACE_SCOPE("build commands");
+		//room for every draw of the slice, culled ones just leave the end unused
+		list.packets = UFrameAllocArray<UDrawPacket>(end - begin, worker);
+		list.count = 0;
+		list.culled = 0;
+		for (int i = begin; i < end; i++)
+		{
+			const UDrawItem& item = items[i];
+			const glm::mat4& model = scene.world[item.node];
+
+			//bounding sphere into world space (radius grows with the largest axis scale)
+			glm::vec3 center = glm::vec3(model * glm::vec4(item.mesh->boundsCenter, 1.0f));
+			float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+			if (!USphereVisibleInAny(planes, views, center, item.mesh->boundsRadius * scale))
+			{
+				list.culled++;
+				continue;
+			}
+
+			UDrawPacket& packet = list.packets[list.count++];
+			packet.model = model;
+			packet.name = item.name;
+			packet.vao = item.mesh->vao;
+			packet.count = (GLsizei)item.mesh->nIndices;
+			packet.variant = item.variant;
+			packet.texture = item.texture;
+			packet.material = item.material;
+			packet.lightmap = item.lightmap;
+		}
+	}
+}
+
+//FRUSTUM ==========================================================================================================================================
+
+void UFrustumPlanes(const glm::mat4& m, glm::vec4 planes[6])
+{
+	glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+	glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+	glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+	glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+	planes[0] = row3 + row0;
+	planes[1] = row3 - row0;
+	planes[2] = row3 + row1;
+	planes[3] = row3 - row1;
+	planes[4] = row3 + row2;
+	planes[5] = row3 - row2;
+	for (int i = 0; i < 6; i++)
+		planes[i] = planes[i] * (1.0f / glm::length(glm::vec3(planes[i])));
+}
+
+//COMMAND LISTS ====================================================================================================================================
+
+bool UParseCommandListArgs(int argc, char* argv[], UCommandListConfig& config)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--draw-threads") == 0)
+		{
+			if (i + 1 >= argc || atoi(argv[i + 1]) < 0)
+			{
+				cerr << "ERROR: --draw-threads needs a thread count (0 = all hardware threads)" << endl;
+				return false;
+			}
+			config.threads = atoi(argv[++i]);
+		}
+	}
+	return true;
+}
+
+void UCommandListsInit(const UCommandListConfig& config)
+{
+	UJobsInit(config.threads);
+	cout << "INFO: draw commands built on " << UJobsThreadCount() << " threads" << endl;
+}
+
+void UCommandListsShutdown()
+{
+	UJobsShutdown();
+}
+
+int UCommandListsBuild(UCommandLists& lists, const std::vector<UDrawItem>& items, const USceneGraph& scene, const glm::vec4* planes, int views)
+{
+	BuildContext context;
+	context.lists = &lists;
+	context.items = &items;
+	context.scene = &scene;
+	context.views = std::min(std::max(views, 1), UMULTIVIEW_MAX_VIEWS);
+	std::copy(planes, planes + 6 * context.views, context.planes);
+
+	//a few slices per thread so stealing can even out slices with more culled draws
+	int count = (int)items.size();
+	context.grain = std::max(MIN_SLICE, (count + UJobsThreadCount() * 4 - 1) / (UJobsThreadCount() * 4));
+	int sliceCount = std::max(1, (count + context.grain - 1) / context.grain);
+	if ((int)lists.lists.size() != sliceCount)
+		lists.lists.resize(sliceCount);
+
+	if (count == 0)
+	{
+		lists.lists[0].count = 0;
+		lists.lists[0].culled = 0;
+	}
+	UParallelFor(count, context.grain, [&context](int begin, int end, int worker)
+	{
+		UBuildSlice(context.lists->lists[begin / context.grain], *context.items, begin, end, *context.scene, context.planes, context.views, worker);
+	});
+
+	int packets = 0;
+	lists.culled = 0;
+	for (const UCommandList& list : lists.lists)
+	{
+		packets += list.count;
+		lists.culled += list.culled;
+	}
+	return packets;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "Scene.h"
+
+//PARALLEL COMMAND LISTS ===========================================================================================================================
+//
+// --draw-threads <n>   threads building the draw commands (0 = one per hardware thread, default; 1 = build on the GL thread)
+//
+// each frame the draw list is cut into contiguous slices. job system workers take a slice each, cull it against the view
+// frusta (a draw stays when any view of MultiView.h sees it) and encode one compact packet per visible draw (model matrix, vao, index count, variant, texture, material, lightmap rect) into
+// the slice's own list, so building needs no locks and makes no GL calls. the packets come out of the worker's frame
+// arena (FrameArena.h) and are gone when the frame ends. the GL thread then replays the lists in slice
+// order: submission order and the redundant state filtering are the same as drawing the list directly, and the only work
+// left on the GL thread is the GL calls. small scenes fit in one slice and are built inline.
+
+struct UCommandListConfig
+{
+	int threads = 0;
+};
+
+//everything the GL thread needs for one draw
+struct UDrawPacket
+{
+	glm::mat4 model;
+	const char* name;		//object group (trace sections)
+	GLuint vao;
+	GLsizei count;			//GL_UNSIGNED_SHORT indices
+	int variant;			//shader variant
+	int texture;			//texture unit
+	int material;			//index into the material table (Materials.h)
+	glm::vec4 lightmap;		//atlas scale/offset (LIGHTMAP variants)
+};
+
+struct UCommandList
+{
+	UDrawPacket* packets = nullptr;		//in the frame arena of the worker that built it
+	int count = 0;
+	int culled = 0;
+};
+
+struct UCommandLists
+{
+	std::vector<UCommandList> lists;	//one per slice, replayed in order
+	int culled = 0;
+};
+
+//the six planes of the view frustum (xyz = inward unit normal, w = distance), straight from the rows of projection * view
+void UFrustumPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6]);
+
+bool UParseCommandListArgs(int argc, char* argv[], UCommandListConfig& config);
+
+//starts the job system for the GL path
+void UCommandListsInit(const UCommandListConfig& config);
+void UCommandListsShutdown();
+
+//culls and encodes this frame's draws against views sets of six frustum planes (UMultiViewFrustumPlanes), returns how many
+//packets were written
+int UCommandListsBuild(UCommandLists& lists, const std::vector<UDrawItem>& items, const USceneGraph& scene, const glm::vec4* planes, int views);
@@ -0,0 +1,303 @@
+#include "DynamicResolution.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "GLStats.h"
+#include "GpuResources.h"
+#include "Trace.h"
+
+using namespace std;
+
+namespace
+{
+	//timestamp pairs in flight (results are read back this many frames late)
+	const int QUERY_FRAMES = 4;
+	//the scale moves in steps of 1/64 of the full size so tiny corrections don't resize every frame
+	const float SCALE_STEP = 1.0f / 64.0f;
+	//scene textures stay bound to units 0..n, the upscale samples from a unit none of them uses
+	const int UPSCALE_TEXTURE_UNIT = 31;
+
+	const char* upscaleVertexShaderSource = "#version 440 core\n"
+		"out vec2 uv;\n"
+		"void main()\n"
+		"{\n"
+		//fullscreen triangle from the vertex id, no buffers
+		"	uv = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);\n"
+		"	gl_Position = vec4(uv * 2.0 - 1.0, 0.0, 1.0);\n"
+		"}\n\0";
+
+	const char* upscaleFragmentShaderSource = "#version 440 core\n"
+		"in vec2 uv;\n"
+		"out vec4 FragColor;\n"
+		"uniform sampler2D source;\n"
+		"uniform vec2 extent;\n"		//part of the texture that was rendered (0-1)
+		"uniform bool sharpen;\n"
+		"void main()\n"
+		"{\n"
+		"	vec2 texel = 1.0 / vec2(textureSize(source, 0));\n"
+		"	vec2 p = min(uv * extent, extent - 0.5 * texel);\n"
+		"	vec3 c = texture(source, p).rgb;\n"
+		"	if (sharpen)\n"
+		"	{\n"
+		//unsharp mask against the four neighbours (one source texel away), clamped to their range so edges don't ring
+		"		vec3 n = texture(source, min(p + vec2(0.0, texel.y), extent - 0.5 * texel)).rgb;\n"
+		"		vec3 s = texture(source, max(p - vec2(0.0, texel.y), 0.5 * texel)).rgb;\n"
+		"		vec3 e = texture(source, min(p + vec2(texel.x, 0.0), extent - 0.5 * texel)).rgb;\n"
+		"		vec3 w = texture(source, max(p - vec2(texel.x, 0.0), 0.5 * texel)).rgb;\n"
+		"		vec3 lo = min(c, min(min(n, s), min(e, w)));\n"
+		"		vec3 hi = max(c, max(max(n, s), max(e, w)));\n"
+		"		float amount = 0.5 * (1.0 - extent.x);\n"		//the more it is stretched the more it is sharpened
+		"		c = clamp(c + amount * (4.0 * c - n - s - e - w), lo, hi);\n"
+		"	}\n"
+		"	FragColor = vec4(c, 1.0);\n"
+		"}\n\0";
+
+	UDynamicResolutionConfig gConfig;
+	bool gActive = false;
+	int gWidth = 0;
+	int gHeight = 0;
+	float gScale = 1.0f;
+	double gSmoothedMs = 0.0;
+	UGpuProgram gUpscaleProgram;
+	UGpuVertexArray gEmptyVao;
+	GLint gExtentLoc = -1;
+	GLint gSharpenLoc = -1;
+	GLuint gQueries[QUERY_FRAMES * 2];
+	bool gQueryPending[QUERY_FRAMES];
+	int gFrame = 0;
+	//per frame scales for the exit report, as a histogram of 0.01 wide bins (fixed size, so a frame never allocates)
+	const int SCALE_BINS = 101;
+	long long gScaleBins[SCALE_BINS] = {};
+	long long gScaleCount = 0;
+	double gScaleSum = 0.0;
+	float gScaleMin = 1.0f;
+
+	bool UCompile(GLenum type, const char* source, GLuint& shaderId)
+	{
+		int success = 0;
+		char infoLog[512];
+		shaderId = glCreateShader(type);
+		glShaderSource(shaderId, 1, &source, NULL);
+		glCompileShader(shaderId);
+		glGetShaderiv(shaderId, GL_COMPILE_STATUS, &success);
+		if (!success)
+		{
+			glGetShaderInfoLog(shaderId, sizeof(infoLog), NULL, infoLog);
+			cout << "ERROR COMPILING UPSCALE SHADER\n" << infoLog << endl;
+			return false;
+		}
+		return true;
+	}
+
+	bool UCreateUpscaleProgram()
+	{
+		GLuint vertexShaderId = 0, fragmentShaderId = 0;
+		bool compiled = UCompile(GL_VERTEX_SHADER, upscaleVertexShaderSource, vertexShaderId)
+			&& UCompile(GL_FRAGMENT_SHADER, upscaleFragmentShaderSource, fragmentShaderId);
+		int success = 0;
+		if (compiled)
+		{
+			char infoLog[512];
+			gUpscaleProgram.Create("upscale");
+			glAttachShader(gUpscaleProgram, vertexShaderId);
+			glAttachShader(gUpscaleProgram, fragmentShaderId);
+			glLinkProgram(gUpscaleProgram);
+			glGetProgramiv(gUpscaleProgram, GL_LINK_STATUS, &success);
+			if (!success)
+			{
+				glGetProgramInfoLog(gUpscaleProgram, sizeof(infoLog), NULL, infoLog);
+				cout << "ERROR LINKING UPSCALE SHADER\n" << infoLog << endl;
+			}
+			glDetachShader(gUpscaleProgram, vertexShaderId);
+			glDetachShader(gUpscaleProgram, fragmentShaderId);
+		}
+		glDeleteShader(vertexShaderId);
+		glDeleteShader(fragmentShaderId);
+		if (!success)
+		{
+			gUpscaleProgram.Reset();
+			return false;
+		}
+
+		gExtentLoc = glGetUniformLocation(gUpscaleProgram, "extent");
+		gSharpenLoc = glGetUniformLocation(gUpscaleProgram, "sharpen");
+		glUseProgram(gUpscaleProgram);
+		glUniform1i(glGetUniformLocation(gUpscaleProgram, "source"), UPSCALE_TEXTURE_UNIT);
+		glUseProgram(0);
+		return true;
+	}
+
+	//feeds the scene time of a finished frame into the controller
+	void UUpdateScale(double sceneMs)
+	{
+		gSmoothedMs = gSmoothedMs <= 0.0 ? sceneMs : gSmoothedMs + 0.2 * (sceneMs - gSmoothedMs);
+		UTraceCounter("scene gpu ms", gSmoothedMs);
+
+		//cost ~ pixels ~ scale^2; down fast when over budget, up slowly and only below 85% of it
+		float ideal = gScale * (float)sqrt(gConfig.budgetMs / std::max(gSmoothedMs, 0.01));
+		float next = gScale;
+		if (gSmoothedMs > gConfig.budgetMs)
+			next = gScale + (ideal - gScale) * 0.5f;
+		else if (gSmoothedMs < gConfig.budgetMs * 0.85)
+			next = gScale + (ideal - gScale) * 0.1f;
+		next = std::min(std::max(floor(next / SCALE_STEP + 0.5f) * SCALE_STEP, gConfig.minScale), 1.0f);
+		gScale = next;
+	}
+}
+
+bool UParseDynamicResolutionArgs(int argc, char* argv[], UDynamicResolutionConfig& config)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--dynamic-resolution") == 0)
+		{
+			config.enabled = true;
+			if (i + 1 < argc && argv[i + 1][0] != '-')
+				config.budgetMs = atof(argv[++i]);
+			if (config.budgetMs <= 0.0)
+			{
+				cerr << "ERROR: --dynamic-resolution needs a gpu budget in ms above 0" << endl;
+				return false;
+			}
+		}
+		else if (strcmp(argv[i], "--min-scale") == 0)
+		{
+			if (i + 1 >= argc || atof(argv[i + 1]) <= 0.0 || atof(argv[i + 1]) > 1.0)
+			{
+				cerr << "ERROR: --min-scale needs a scale in (0, 1]" << endl;
+				return false;
+			}
+			config.minScale = (float)atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--upscale") == 0)
+		{
+			if (i + 1 >= argc || (strcmp(argv[i + 1], "bilinear") != 0 && strcmp(argv[i + 1], "sharpen") != 0))
+			{
+				cerr << "ERROR: --upscale needs bilinear or sharpen" << endl;
+				return false;
+			}
+			config.sharpen = strcmp(argv[++i], "sharpen") == 0;
+		}
+	}
+	return true;
+}
+
+bool UDynamicResolutionInit(const UDynamicResolutionConfig& config, int width, int height)
+{
+	if (!config.enabled)
+		return false;
+	gConfig = config;
+	gWidth = width;
+	gHeight = height;
+	gScale = 1.0f;
+	gSmoothedMs = 0.0;
+
+	if (!UCreateUpscaleProgram())
+		return false;
+	gEmptyVao.Create("upscale");
+
+	glGenQueries(QUERY_FRAMES * 2, gQueries);
+	for (int i = 0; i < QUERY_FRAMES; i++)
+		gQueryPending[i] = false;
+	gFrame = 0;
+	gActive = true;
+	cout << "INFO: dynamic resolution, " << config.budgetMs << " ms scene budget, scale " << config.minScale << "-1, "
+		<< (config.sharpen ? "sharpened" : "bilinear") << " upscale" << endl;
+	return true;
+}
+
+void UDynamicResolutionShutdown()
+{
+	if (!gActive)
+		return;
+	glDeleteQueries(QUERY_FRAMES * 2, gQueries);
+	gEmptyVao.Reset();
+	gUpscaleProgram.Reset();
+	gActive = false;
+
+	if (gScaleCount == 0)
+		return;
+	float median = 1.0f;
+	long long seen = 0;
+	for (int i = 0; i < SCALE_BINS; i++)
+	{
+		seen += gScaleBins[i];
+		if (seen > gScaleCount / 2)
+		{
+			median = i / (float)(SCALE_BINS - 1);
+			break;
+		}
+	}
+	cout << "INFO: dynamic resolution over " << gScaleCount << " frames: scale mean " << gScaleSum / gScaleCount << ", min " << gScaleMin
+		<< ", p50 " << median << ", smoothed scene time " << gSmoothedMs << " ms" << endl;
+}
+
+bool UDynamicResolutionEnabled()
+{
+	return gActive;
+}
+
+void UDynamicResolutionBeginScene()
+{
+	if (!gActive)
+		return;
+
+	//finished frames feed the controller (the slot about to be reused has to be read, the others only if ready)
+	int slot = gFrame % QUERY_FRAMES;
+	for (int i = 0; i < QUERY_FRAMES; i++)
+	{
+		int pendingSlot = (slot + i) % QUERY_FRAMES;
+		if (!gQueryPending[pendingSlot])
+			continue;
+		GLint available = 0;
+		glGetQueryObjectiv(gQueries[pendingSlot * 2 + 1], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available && pendingSlot != slot)
+			continue;
+		GLuint64 begin = 0, end = 0;
+		glGetQueryObjectui64v(gQueries[pendingSlot * 2], GL_QUERY_RESULT, &begin);
+		glGetQueryObjectui64v(gQueries[pendingSlot * 2 + 1], GL_QUERY_RESULT, &end);
+		gQueryPending[pendingSlot] = false;
+		UUpdateScale((end - begin) / 1.0e6);
+	}
+
+	gScaleBins[std::min(std::max((int)(gScale * (SCALE_BINS - 1) + 0.5f), 0), SCALE_BINS - 1)]++;
+	gScaleCount++;
+	gScaleSum += gScale;
+	gScaleMin = std::min(gScaleMin, gScale);
+	UTraceCounter("render scale", gScale);
+	glViewport(0, 0, std::max(1, (int)(gWidth * gScale)), std::max(1, (int)(gHeight * gScale)));
+	glQueryCounter(gQueries[slot * 2], GL_TIMESTAMP);
+}
+
+void UDynamicResolutionEndScene()
+{
+	if (!gActive)
+		return;
+	int slot = gFrame % QUERY_FRAMES;
+	glQueryCounter(gQueries[slot * 2 + 1], GL_TIMESTAMP);
+	gQueryPending[slot] = true;
+	gFrame++;
+}
+
+void UDynamicResolutionUpscale(GLuint sourceTexture)
+{
+	if (!gActive)
+		return;
+
+	//stretch the rendered corner over the target
+	glDisable(GL_DEPTH_TEST);
+	glUseProgram(gUpscaleProgram);
+	glUniform2f(gExtentLoc, std::max(1, (int)(gWidth * gScale)) / (float)gWidth, std::max(1, (int)(gHeight * gScale)) / (float)gHeight);
+	glUniform1i(gSharpenLoc, gConfig.sharpen ? 1 : 0);
+	glActiveTexture(GL_TEXTURE0 + UPSCALE_TEXTURE_UNIT);
+	glBindTexture(GL_TEXTURE_2D, sourceTexture);
+	glActiveTexture(GL_TEXTURE0);
+	glBindVertexArray(gEmptyVao);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glBindVertexArray(0);
+	glEnable(GL_DEPTH_TEST);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <GL/glew.h>
+
+//DYNAMIC RESOLUTION ===============================================================================================================================
+//
+// --dynamic-resolution [ms]    render the scene offscreen at a resolution that keeps its gpu time near ms (default 14)
+// --min-scale <s>              lowest render scale per axis (default 0.5)
+// --upscale <mode>             bilinear or sharpen (bilinear + a contrast clamped sharpen, default)
+//
+// the scene pass renders into a transient colour + depth target of the render graph the size of the window, drawing only
+// into its top left scale * size corner, so changing the scale never reallocates anything. the gpu time of the scene pass
+// is measured with timestamp queries read back a few frames late, smoothed, and the controller moves the scale towards
+// sqrt(budget / time) of the current one (shading cost goes with the pixel count, i.e. scale squared). it steps down
+// quickly when over budget and creeps back up only with some headroom, so it doesn't oscillate around the budget.
+// an upscale pass then stretches the corner over the window with a fullscreen triangle.
+
+struct UDynamicResolutionConfig
+{
+	bool enabled = false;
+	double budgetMs = 14.0;
+	float minScale = 0.5f;
+	bool sharpen = true;
+};
+
+bool UParseDynamicResolutionArgs(int argc, char* argv[], UDynamicResolutionConfig& config);
+
+//needs a current GL context, width/height is the full resolution
+bool UDynamicResolutionInit(const UDynamicResolutionConfig& config, int width, int height);
+void UDynamicResolutionShutdown();
+
+bool UDynamicResolutionEnabled();
+//around the scene pass: narrows the viewport to this frame's scale and times the pass
+void UDynamicResolutionBeginScene();
+void UDynamicResolutionEndScene();
+//draws the scaled corner of sourceTexture over the bound framebuffer / viewport
+void UDynamicResolutionUpscale(GLuint sourceTexture);
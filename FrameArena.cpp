@@ -0,0 +1,277 @@
+#include "FrameArena.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <vector>
+
+#include "Trace.h"
+
+using namespace std;
+
+namespace
+{
+	//frames that don't count against the allocation tracking (programs finish building, lists reach their size)
+	const int WARMUP_FRAMES = 120;
+	//overflow blocks one frame can take before the list itself has to grow (each is at least the arena's size)
+	const size_t OVERFLOW_BLOCKS = 64;
+
+	struct SubArena
+	{
+		char* base = nullptr;
+		size_t capacity = 0;
+		size_t used = 0;
+		size_t peak = 0;					//most bytes one frame needed
+		vector<char*> overflow;				//heap blocks of this frame once the arena ran out (capacity reserved up front)
+		size_t overflowBytes = 0;			//what the frame asked of them
+		size_t blockUsed = 0;				//bump offset into the last block
+		size_t blockCapacity = 0;
+		int grown = 0;
+		char pad[64];						//workers bump their arenas at the same time, keep them off each other's cache lines
+	};
+
+	vector<SubArena> gArenas;
+	long long gFrames = 0;
+
+	//allocation tracking (read by operator new on any thread)
+	atomic<bool> gTracking(false);
+	atomic<long long> gFrameAllocations(0);
+	bool gTrackEnabled = false;
+	bool gStrict = false;
+	long long gTrackedFrames = 0;
+	long long gTotalAllocations = 0;
+	long long gWorstFrameAllocations = 0;
+	long long gWorstFrame = -1;
+	thread_local bool gThreadTracked = false;
+
+	void UCountAllocation()
+	{
+		if (!gTracking.load(memory_order_relaxed) || !gThreadTracked)
+			return;
+		gFrameAllocations.fetch_add(1, memory_order_relaxed);
+		if (gStrict)
+		{
+			//no iostreams in here, they can allocate
+			fprintf(stderr, "ERROR: heap allocation in frame %lld of the frame loop (--alloc-track strict)\n", gFrames);
+			abort();
+		}
+	}
+
+	void UFreeOverflow(SubArena& arena)
+	{
+		for (char* block : arena.overflow)
+			free(block);
+		arena.overflow.clear();
+		arena.overflowBytes = 0;
+		arena.blockUsed = 0;
+		arena.blockCapacity = 0;
+	}
+}
+
+//GLOBAL NEW/DELETE (every allocation goes through UCountAllocation) ===============================================================================
+
+void* operator new(size_t size)
+{
+	UCountAllocation();
+	void* p = malloc(size > 0 ? size : 1);
+	if (p == nullptr)
+		throw bad_alloc();
+	return p;
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(size_t size, const nothrow_t&) noexcept
+{
+	UCountAllocation();
+	return malloc(size > 0 ? size : 1);
+}
+
+void* operator new[](size_t size, const nothrow_t&) noexcept
+{
+	UCountAllocation();
+	return malloc(size > 0 ? size : 1);
+}
+
+void operator delete(void* p) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+	free(p);
+}
+
+//ARENA ============================================================================================================================================
+
+bool UParseFrameArenaArgs(int argc, char* argv[], UFrameArenaConfig& config)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--frame-arena") == 0)
+		{
+			if (i + 1 >= argc || atoi(argv[i + 1]) <= 0)
+			{
+				cerr << "ERROR: --frame-arena needs a size in KB" << endl;
+				return false;
+			}
+			config.bytesPerThread = (size_t)atoi(argv[++i]) * 1024;
+		}
+		else if (strcmp(argv[i], "--alloc-track") == 0)
+		{
+			config.track = true;
+			if (i + 1 < argc && strcmp(argv[i + 1], "strict") == 0)
+			{
+				config.strict = true;
+				i++;
+			}
+		}
+	}
+	return true;
+}
+
+void UFrameArenaInit(const UFrameArenaConfig& config, int threads)
+{
+	gArenas.resize(std::max(threads, 1));
+	for (SubArena& arena : gArenas)
+	{
+		arena.base = (char*)malloc(config.bytesPerThread);
+		if (arena.base == nullptr)
+			throw bad_alloc();
+		arena.capacity = config.bytesPerThread;
+		arena.overflow.reserve(OVERFLOW_BLOCKS);
+	}
+	gTrackEnabled = config.track;
+	gStrict = config.strict;
+	gThreadTracked = true;
+	cout << "INFO: frame arena: " << gArenas.size() << " threads x " << config.bytesPerThread / 1024 << " KB"
+		<< (config.track ? (config.strict ? ", heap allocations in the frame loop abort" : ", heap allocations in the frame loop are counted") : "") << endl;
+}
+
+void UFrameArenaShutdown()
+{
+	gTracking = false;
+	size_t peak = 0, capacity = 0;
+	int grown = 0;
+	for (SubArena& arena : gArenas)
+	{
+		peak = std::max(peak, arena.peak);
+		capacity += arena.capacity;
+		grown += arena.grown;
+		UFreeOverflow(arena);
+		free(arena.base);
+	}
+	if (!gArenas.empty())
+		cout << "INFO: frame arena over " << gFrames << " frames: peak " << peak / 1024.0 << " KB on one thread, " << capacity / 1024 << " KB reserved, grew "
+			<< grown << " times" << endl;
+	if (gTrackEnabled)
+		cout << "INFO: heap allocations in the frame loop after " << WARMUP_FRAMES << " warmup frames: " << gTotalAllocations << " over " << gTrackedFrames
+			<< " frames (worst frame " << gWorstFrame << " with " << gWorstFrameAllocations << ")" << endl;
+	gArenas.clear();
+}
+
+void UFrameArenaBeginFrame()
+{
+	gFrameAllocations = 0;
+	gTracking = gTrackEnabled && gFrames >= WARMUP_FRAMES;
+}
+
+void UFrameArenaReset()
+{
+	if (gTracking)
+	{
+		gTracking = false;
+		long long allocations = gFrameAllocations.load();
+		gTotalAllocations += allocations;
+		gTrackedFrames++;
+		if (allocations > gWorstFrameAllocations)
+		{
+			gWorstFrameAllocations = allocations;
+			gWorstFrame = gFrames;
+		}
+		UTraceCounter("heap allocations", (double)allocations);
+	}
+
+	//an arena that ran out grows to what the frame needed (rounded up to a power of two), outside the tracked part
+	size_t used = 0;
+	for (size_t i = 0; i < gArenas.size(); i++)
+	{
+		SubArena& arena = gArenas[i];
+		size_t needed = arena.used + arena.overflowBytes;
+		arena.peak = std::max(arena.peak, needed);
+		used += needed;
+		if (!arena.overflow.empty())
+		{
+			UFreeOverflow(arena);
+			size_t capacity = arena.capacity;
+			while (capacity < needed)
+				capacity *= 2;
+			free(arena.base);
+			arena.base = (char*)malloc(capacity);
+			if (arena.base == nullptr)
+			{
+				arena.capacity = 0;
+				throw bad_alloc();
+			}
+			arena.capacity = capacity;
+			arena.grown++;
+			cout << "WARNING: frame arena of thread " << i << " ran out, grown to " << capacity / 1024 << " KB" << endl;
+		}
+		arena.used = 0;
+	}
+	UTraceCounter("frame arena KB", used / 1024.0);
+	gFrames++;
+}
+
+void* UFrameAlloc(size_t bytes, size_t alignment, int worker)
+{
+	SubArena& arena = gArenas[worker];
+	size_t at = (arena.used + alignment - 1) & ~(alignment - 1);
+	if (at + bytes <= arena.capacity)
+	{
+		arena.used = at + bytes;
+		return arena.base + at;
+	}
+
+	//out of space: bump through heap blocks until the reset (which grows the arena so the next frames fit). a block is
+	//at least the arena's size, so the reserved list covers far more than one frame needs and never allocates itself
+	arena.overflowBytes += bytes + alignment;
+	char* block = arena.overflow.empty() ? nullptr : arena.overflow.back();
+	uintptr_t p = block ? ((uintptr_t)block + arena.blockUsed + alignment - 1) & ~(uintptr_t)(alignment - 1) : 0;
+	if (block == nullptr || p + bytes > (uintptr_t)block + arena.blockCapacity)
+	{
+		size_t size = std::max(bytes + alignment, arena.capacity);
+		block = (char*)malloc(size);
+		if (block == nullptr)
+			throw bad_alloc();
+		arena.overflow.push_back(block);
+		arena.blockCapacity = size;
+		p = ((uintptr_t)block + alignment - 1) & ~(uintptr_t)(alignment - 1);
+	}
+	arena.blockUsed = p + bytes - (uintptr_t)block;
+	return (void*)p;
+}
+
+void UAllocTrackThisThread()
+{
+	gThreadTracked = true;
+}
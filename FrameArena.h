@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+
+//PER-FRAME ARENA ==================================================================================================================================
+//
+// --frame-arena <KB>        size of each thread's arena (default 256, grows by itself if a frame needs more)
+// --alloc-track [strict]    count the heap allocations (global operator new) the frame loop makes once it is warmed up and
+//                           report them at exit; strict aborts on the first one, so a debugger stops at the caller
+//
+// transient data of a frame (draw packets, the programs a frame has set up) comes out of a linear arena that is reset when
+// the frame ends: an allocation is a pointer bump and nothing is freed on its own. every job system thread has its own
+// sub-arena (picked by the worker index UParallelFor passes in), so workers never share one. an arena that runs out
+// takes heap blocks for the rest of the frame and grows to its high-water mark at the reset, so a steady frame doesn't
+// allocate. pointers from the arena are only valid until UFrameArenaReset.
+//
+// the tracking only counts the threads that take part in a frame (the one that called UFrameArenaInit and the job
+// workers); the simulation thread, background shader builds and --trace keep their own allocations. the first
+// frames (shader variants still being built, lists still growing) don't count.
+
+struct UFrameArenaConfig
+{
+	size_t bytesPerThread = 256 * 1024;
+	bool track = false;
+	bool strict = false;
+};
+
+bool UParseFrameArenaArgs(int argc, char* argv[], UFrameArenaConfig& config);
+
+//one sub-arena per job system thread (call after UJobsInit), the calling thread is tracked
+void UFrameArenaInit(const UFrameArenaConfig& config, int threads);
+void UFrameArenaShutdown();
+
+//start of a frame (allocation tracking is on until the reset)
+void UFrameArenaBeginFrame();
+//end of a frame: everything allocated since the last reset is gone
+void UFrameArenaReset();
+
+//bytes from worker's sub-arena (worker = index passed to the UParallelFor job, 0 on the calling thread)
+void* UFrameAlloc(size_t bytes, size_t alignment, int worker = 0);
+template <typename T>
+T* UFrameAllocArray(size_t count, int worker = 0)
+{
+	return (T*)UFrameAlloc(count * sizeof(T), alignof(T), worker);
+}
+
+//counts this thread's heap allocations while a frame is tracked (job workers call it when they start)
+void UAllocTrackThisThread();
@@ -0,0 +1,222 @@
+#include "FramePacing.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+#include <GL/glew.h>
+
+#include "Benchmark.h"
+#include "GLStats.h"
+#include "Trace.h"
+
+using namespace std;
+
+namespace
+{
+	typedef chrono::steady_clock Clock;
+
+	const int MAX_FRAMES_IN_FLIGHT = 4;
+	//latency histogram for the exit report (fixed size, so recording a frame never allocates): 0.1 ms bins up to 250 ms,
+	//the last bin takes everything slower
+	const int LATENCY_BINS = 2500;
+	const double LATENCY_BIN_MS = 0.1;
+
+	struct FrameInFlight
+	{
+		GLsync fence = 0;
+		GLuint timestampQuery = 0;
+		Clock::time_point inputTime;
+		int benchmarkFrame = -1;
+	};
+
+	UFramePacingConfig gConfig;
+	bool gActive = false;
+	FrameInFlight gFrames[MAX_FRAMES_IN_FLIGHT];
+	int gNextFrame = 0;				//ring slot the next frame uses (the oldest in flight when the ring is full)
+	Clock::time_point gInputTime;
+	Clock::time_point gDeadline;
+	long long gLatencyBins[LATENCY_BINS] = {};
+	long long gLatencyCount = 0;
+	double gLatencyMax = 0.0;
+
+	//gpu timestamp (ns) -> cpu clock, recalibrated now and then because the two clocks drift
+	long long gGpuToCpuOffset = 0;
+	Clock::time_point gLastCalibration;
+
+	long long UCpuNanoseconds(Clock::time_point time)
+	{
+		return chrono::duration_cast<chrono::nanoseconds>(time.time_since_epoch()).count();
+	}
+
+	void UCalibrate()
+	{
+		GLint64 gpuNow = 0;
+		glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+		gLastCalibration = Clock::now();
+		gGpuToCpuOffset = UCpuNanoseconds(gLastCalibration) - gpuNow;
+	}
+
+	//latency below which a fraction of the frames are (upper edge of the bin the percentile falls in)
+	double ULatencyPercentile(double fraction)
+	{
+		long long target = (long long)(gLatencyCount * fraction);
+		long long seen = 0;
+		for (int i = 0; i < LATENCY_BINS - 1; i++)
+		{
+			seen += gLatencyBins[i];
+			if (seen > target)
+				return (i + 1) * LATENCY_BIN_MS;
+		}
+		return gLatencyMax;
+	}
+
+	//block until frame finished on the gpu, then record its latency
+	void URetire(FrameInFlight& frame, bool wait)
+	{
+		if (frame.fence == 0)
+			return;
+		if (!wait && glClientWaitSync(frame.fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+			return;
+		while (wait && glClientWaitSync(frame.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 100000000) == GL_TIMEOUT_EXPIRED)
+			;
+		glDeleteSync(frame.fence);
+		frame.fence = 0;
+
+		GLuint64 gpuTime = 0;
+		glGetQueryObjectui64v(frame.timestampQuery, GL_QUERY_RESULT, &gpuTime);
+		double latencyMs = ((long long)gpuTime + gGpuToCpuOffset - UCpuNanoseconds(frame.inputTime)) / 1.0e6;
+		if (latencyMs >= 0.0)
+		{
+			gLatencyBins[std::min((int)(latencyMs / LATENCY_BIN_MS), LATENCY_BINS - 1)]++;
+			gLatencyCount++;
+			gLatencyMax = std::max(gLatencyMax, latencyMs);
+			UTraceCounter("input to present ms", latencyMs);
+			if (frame.benchmarkFrame >= 0)
+				UBenchmarkSetLatency(frame.benchmarkFrame, latencyMs);
+		}
+	}
+}
+
+bool UParseFramePacingArgs(int argc, char* argv[], UFramePacingConfig& config)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--frames-in-flight") == 0 || strcmp(argv[i], "--fps-cap") == 0)
+		{
+			if (i + 1 >= argc)
+			{
+				cerr << "ERROR: " << argv[i] << " needs a value" << endl;
+				return false;
+			}
+			if (strcmp(argv[i], "--frames-in-flight") == 0)
+				config.framesInFlight = atoi(argv[++i]);
+			else
+				config.fpsCap = atof(argv[++i]);
+		}
+	}
+	if (config.framesInFlight < 1 || config.framesInFlight > MAX_FRAMES_IN_FLIGHT || config.fpsCap < 0.0)
+	{
+		cerr << "ERROR: --frames-in-flight must be 1-" << MAX_FRAMES_IN_FLIGHT << " and --fps-cap at least 0" << endl;
+		return false;
+	}
+	return true;
+}
+
+void UFramePacingInit(const UFramePacingConfig& config)
+{
+	gConfig = config;
+	GLuint queries[MAX_FRAMES_IN_FLIGHT];
+	glGenQueries(MAX_FRAMES_IN_FLIGHT, queries);
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+		gFrames[i].timestampQuery = queries[i];
+	UCalibrate();
+	gDeadline = Clock::now();
+	gInputTime = Clock::now();
+	gActive = true;
+	cout << "INFO: frame pacing, " << config.framesInFlight << " frames in flight, cap "
+		<< (config.fpsCap > 0.0 ? to_string((int)config.fpsCap) + " fps" : string("off")) << endl;
+}
+
+void UFramePacingWait()
+{
+	if (!gActive)
+		return;
+	UTRACE_SCOPE("frame pacing");
+
+	//frame cap: sleep most of the way, spin the rest
+	if (gConfig.fpsCap > 0.0)
+	{
+		gDeadline += chrono::duration_cast<Clock::duration>(chrono::duration<double>(1.0 / gConfig.fpsCap));
+		Clock::time_point now = Clock::now();
+		if (gDeadline < now)
+			gDeadline = now;	//running behind, don't try to catch up
+		Clock::time_point sleepUntil = gDeadline - chrono::duration_cast<Clock::duration>(chrono::duration<double, milli>(gConfig.spinMs));
+		if (sleepUntil > now)
+			this_thread::sleep_until(sleepUntil);
+		while (Clock::now() < gDeadline)
+			;
+	}
+
+	//finished frames report their latency, then keep at most framesInFlight - 1 in flight while this one is built
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+		URetire(gFrames[i], false);
+	int inFlight = 0;
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+		inFlight += gFrames[i].fence != 0 ? 1 : 0;
+	for (int back = MAX_FRAMES_IN_FLIGHT; inFlight >= gConfig.framesInFlight && back > 0; back--)
+	{
+		//oldest first
+		FrameInFlight& oldest = gFrames[(gNextFrame + MAX_FRAMES_IN_FLIGHT - back) % MAX_FRAMES_IN_FLIGHT];
+		if (oldest.fence == 0)
+			continue;
+		URetire(oldest, true);
+		inFlight--;
+	}
+
+	if (Clock::now() - gLastCalibration > chrono::seconds(1))
+		UCalibrate();
+}
+
+void UFramePacingLatchInput()
+{
+	gInputTime = Clock::now();
+}
+
+void UFramePacingEndFrame(int benchmarkFrame)
+{
+	if (!gActive)
+		return;
+	FrameInFlight& frame = gFrames[gNextFrame];
+	URetire(frame, true);	//only ever waits when framesInFlight == MAX_FRAMES_IN_FLIGHT
+	glQueryCounter(frame.timestampQuery, GL_TIMESTAMP);
+	frame.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	frame.inputTime = gInputTime;
+	frame.benchmarkFrame = benchmarkFrame;
+	gNextFrame = (gNextFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+}
+
+void UFramePacingShutdown()
+{
+	if (!gActive)
+		return;
+	//oldest first, and every query is read before any is deleted
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+		URetire(gFrames[(gNextFrame + i) % MAX_FRAMES_IN_FLIGHT], true);
+	GLuint queries[MAX_FRAMES_IN_FLIGHT];
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+	{
+		queries[i] = gFrames[i].timestampQuery;
+		gFrames[i].timestampQuery = 0;
+	}
+	glDeleteQueries(MAX_FRAMES_IN_FLIGHT, queries);
+	gActive = false;
+
+	if (gLatencyCount == 0)
+		return;
+	cout << "INFO: input to present latency over " << gLatencyCount << " frames: p50 " << ULatencyPercentile(0.5)
+		<< " ms, p95 " << ULatencyPercentile(0.95) << " ms, max " << gLatencyMax << " ms" << endl;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+//FRAME PACING =====================================================================================================================================
+//
+// --frames-in-flight <n>   frames the cpu may run ahead of the gpu (1-4, default 2)
+// --fps-cap <n>            frame rate limit, 0 = none (default)
+//
+// each frame ends with a fence; before starting a frame the loop waits until the frame n back has finished on the gpu,
+// so the driver can never queue more than n frames and input sampled at the start of a frame is at most n frames old
+// when it reaches the screen. the cap sleeps until shortly before the deadline and spins the rest (sleep alone
+// overshoots by a scheduler tick). input-to-present latency is measured from the moment the view was latched to a
+// GL_TIMESTAMP written right after the swap, shifted onto the cpu clock (the gpu has finished the frame and the present
+// is queued behind it), and printed at exit and written into the benchmark output.
+
+struct UFramePacingConfig
+{
+	int framesInFlight = 2;
+	double fpsCap = 0.0;
+	double spinMs = 2.0;		//how long before the deadline sleeping stops and spinning starts
+};
+
+bool UParseFramePacingArgs(int argc, char* argv[], UFramePacingConfig& config);
+
+//needs a current GL context
+void UFramePacingInit(const UFramePacingConfig& config);
+//start of a frame: frame cap, then throttle on the fence of the frame framesInFlight back
+void UFramePacingWait();
+//the input / view for this frame were just sampled (call right before the draws are submitted)
+void UFramePacingLatchInput();
+//right after SwapBuffers: timestamp + fence this frame (benchmarkFrame = sample index to report latency to, -1 = none)
+void UFramePacingEndFrame(int benchmarkFrame);
+//drains the frames in flight and prints the latency percentiles
+void UFramePacingShutdown();
@@ -0,0 +1,563 @@
+//the wrappers call the real GL entry points, so the redirecting macros must stay off in here
+#define UGL_STATS_IMPL
+#include "GLStats.h"
+
+#ifdef UGL_INSTRUMENT
+
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+	enum UGLCall
+	{
+		CALL_ENABLE, CALL_DISABLE, CALL_DEPTH_MASK, CALL_POLYGON_OFFSET, CALL_USE_PROGRAM, CALL_BIND_VAO, CALL_BIND_BUFFER,
+		CALL_BIND_BUFFER_BASE, CALL_BUFFER_DATA, CALL_BUFFER_SUB_DATA, CALL_CLEAR_BUFFER, CALL_ACTIVE_TEXTURE, CALL_BIND_TEXTURE,
+		CALL_BIND_SAMPLER, CALL_TEX_IMAGE, CALL_TEX_STORAGE, CALL_TEX_PARAMETER, CALL_GENERATE_MIPMAP, CALL_GET_UNIFORM_LOCATION, CALL_UNIFORM, CALL_CLEAR_COLOR,
+		CALL_CLEAR, CALL_VIEWPORT, CALL_DRAW, CALL_DRAW_INDIRECT, CALL_BIND_FRAMEBUFFER, CALL_DISPATCH, CALL_DELETE, CALL_COUNT
+	};
+
+	const char* const CALL_NAMES[CALL_COUNT] =
+	{
+		"glEnable", "glDisable", "glDepthMask", "glPolygonOffset", "glUseProgram", "glBindVertexArray", "glBindBuffer",
+		"glBindBufferBase", "glBufferData", "glBufferSubData", "glClearBufferData", "glActiveTexture", "glBindTexture",
+		"glBindSampler", "glTexImage2D", "glTexStorage2D", "glTexParameteri", "glGenerateMipmap", "glGetUniformLocation", "glUniform*", "glClearColor",
+		"glClear", "glViewport*", "glDraw*", "glMultiDraw*Indirect*", "glBindFramebuffer", "glDispatchCompute", "glDelete*"
+	};
+
+	struct FrameStats
+	{
+		uint64_t calls[CALL_COUNT];
+		uint64_t redundant[CALL_COUNT];
+		uint64_t triangles;
+		uint64_t bufferBytes;
+		uint64_t textureBytes;
+		uint64_t uniformBytes;
+	};
+
+	FrameStats frame;
+	FrameStats startup;			//everything before the first frame ends (texture/mesh uploads)
+	FrameStats totals;			//sum over all frames after the first
+	uint64_t frameCount = 0;
+	ofstream csv;
+
+	//shadow copy of the state the wrappers have seen (missing entries mean unknown, never reported as redundant)
+	const GLuint UNKNOWN = 0xFFFFFFFFu;
+	map<GLenum, bool> caps;
+	GLboolean depthMask = GL_TRUE;
+	bool depthMaskKnown = false;
+	GLfloat polygonOffset[2];
+	bool polygonOffsetKnown = false;
+	GLuint currentProgram = UNKNOWN;
+	GLuint currentVao = UNKNOWN;
+	GLenum currentUnit = 0;
+	bool unitKnown = false;
+	map<GLenum, GLuint> boundBuffers;
+	map<GLuint, GLuint> vaoElementBuffers;			//element array binding lives in the vao
+	map<pair<GLenum, GLuint>, GLuint> boundBases;
+	map<pair<GLenum, GLenum>, GLuint> boundTextures;	//(unit, target) -> texture
+	map<GLuint, GLuint> boundSamplers;				//unit index -> sampler
+	map<pair<GLuint, GLint>, vector<unsigned char> > uniformValues;
+	GLfloat clearColor[4];
+	bool clearColorKnown = false;
+	GLint viewport[4];
+	bool viewportKnown = false;
+	GLuint drawFramebuffer = UNKNOWN;
+	GLuint readFramebuffer = UNKNOWN;
+
+	void UCount(UGLCall call, bool redundant)
+	{
+		frame.calls[call]++;
+		if (redundant)
+			frame.redundant[call]++;
+	}
+
+	//returns true when the location of the current program already holds these bytes (and remembers them otherwise)
+	bool USameUniform(GLint location, const void* data, size_t bytes)
+	{
+		frame.uniformBytes += bytes;
+		if (location < 0 || currentProgram == UNKNOWN)
+			return false;
+
+		vector<unsigned char>& value = uniformValues[make_pair(currentProgram, location)];
+		if (value.size() == bytes && memcmp(value.data(), data, bytes) == 0)
+			return true;
+		value.assign((const unsigned char*)data, (const unsigned char*)data + bytes);
+		return false;
+	}
+
+	//a deleted name is handed out again (shader hot reload recycles program names): forget every binding that still holds it
+	template <typename Key>
+	void UForgetBound(map<Key, GLuint>& bindings, GLuint name)
+	{
+		for (typename map<Key, GLuint>::iterator it = bindings.begin(); it != bindings.end();)
+		{
+			if (it->second == name)
+				it = bindings.erase(it);
+			else
+				++it;
+		}
+	}
+
+	uint64_t UTexelBytes(GLenum format, GLenum type)
+	{
+		uint64_t components = 4;
+		switch (format)
+		{
+		case GL_RED: case GL_DEPTH_COMPONENT: components = 1; break;
+		case GL_RG: case GL_DEPTH_STENCIL: components = 2; break;
+		case GL_RGB: case GL_BGR: components = 3; break;
+		}
+		switch (type)
+		{
+		case GL_FLOAT: case GL_UNSIGNED_INT: case GL_INT: return components * 4;
+		case GL_HALF_FLOAT: case GL_UNSIGNED_SHORT: case GL_SHORT: return components * 2;
+		case GL_UNSIGNED_INT_24_8: return 4;
+		default: return components;
+		}
+	}
+
+	void UWriteRow(const FrameStats& stats, const char* label)
+	{
+		cout << "GLSTATS " << label << ":";
+		for (int i = 0; i < CALL_COUNT; i++)
+		{
+			if (stats.calls[i] == 0)
+				continue;
+			cout << " " << CALL_NAMES[i] << "=" << stats.calls[i];
+			if (stats.redundant[i])
+				cout << " (" << stats.redundant[i] << " redundant)";
+		}
+		cout << " | triangles=" << stats.triangles << " buffer bytes=" << stats.bufferBytes
+			<< " texture bytes=" << stats.textureBytes << " uniform bytes=" << stats.uniformBytes << endl;
+	}
+}
+
+//FRAME SUMMARY ====================================================================================================================================
+
+void UGLStatsEndFrame()
+{
+	if (!csv.is_open())
+	{
+		csv.open("glstats.csv");
+		csv << "frame";
+		for (int i = 0; i < CALL_COUNT; i++)
+			csv << "," << CALL_NAMES[i];
+		for (int i = 0; i < CALL_COUNT; i++)
+			csv << ",redundant " << CALL_NAMES[i];
+		csv << ",triangles,buffer_bytes,texture_bytes,uniform_bytes\n";
+	}
+
+	csv << frameCount;
+	for (int i = 0; i < CALL_COUNT; i++)
+		csv << "," << frame.calls[i];
+	for (int i = 0; i < CALL_COUNT; i++)
+		csv << "," << frame.redundant[i];
+	csv << "," << frame.triangles << "," << frame.bufferBytes << "," << frame.textureBytes << "," << frame.uniformBytes << "\n";
+
+	if (frameCount == 0)
+		startup = frame;
+	else
+	{
+		for (int i = 0; i < CALL_COUNT; i++)
+		{
+			totals.calls[i] += frame.calls[i];
+			totals.redundant[i] += frame.redundant[i];
+		}
+		totals.triangles += frame.triangles;
+		totals.bufferBytes += frame.bufferBytes;
+		totals.textureBytes += frame.textureBytes;
+		totals.uniformBytes += frame.uniformBytes;
+	}
+
+	frameCount++;
+	memset(&frame, 0, sizeof(frame));
+}
+
+void UGLStatsShutdown()
+{
+	if (frameCount == 0)
+		return;
+
+	UWriteRow(startup, "first frame (includes loading)");
+	if (frameCount > 1)
+	{
+		uint64_t frames = frameCount - 1;
+		FrameStats average = totals;
+		for (int i = 0; i < CALL_COUNT; i++)
+		{
+			average.calls[i] /= frames;
+			average.redundant[i] /= frames;
+		}
+		average.triangles /= frames;
+		average.bufferBytes /= frames;
+		average.textureBytes /= frames;
+		average.uniformBytes /= frames;
+		UWriteRow(average, "average per frame");
+	}
+	csv.close();
+}
+
+//STATE WRAPPERS ===================================================================================================================================
+
+void UGLEnable(GLenum cap)
+{
+	map<GLenum, bool>::iterator it = caps.find(cap);
+	UCount(CALL_ENABLE, it != caps.end() && it->second);
+	caps[cap] = true;
+	glEnable(cap);
+}
+
+void UGLDisable(GLenum cap)
+{
+	map<GLenum, bool>::iterator it = caps.find(cap);
+	UCount(CALL_DISABLE, it != caps.end() && !it->second);
+	caps[cap] = false;
+	glDisable(cap);
+}
+
+void UGLDepthMask(GLboolean flag)
+{
+	UCount(CALL_DEPTH_MASK, depthMaskKnown && flag == depthMask);
+	depthMask = flag;
+	depthMaskKnown = true;
+	glDepthMask(flag);
+}
+
+void UGLPolygonOffset(GLfloat factor, GLfloat units)
+{
+	GLfloat offset[2] = { factor, units };
+	UCount(CALL_POLYGON_OFFSET, polygonOffsetKnown && memcmp(offset, polygonOffset, sizeof(offset)) == 0);
+	memcpy(polygonOffset, offset, sizeof(offset));
+	polygonOffsetKnown = true;
+	glPolygonOffset(factor, units);
+}
+
+void UGLUseProgram(GLuint program)
+{
+	UCount(CALL_USE_PROGRAM, program == currentProgram);
+	currentProgram = program;
+	glUseProgram(program);
+}
+
+void UGLBindVertexArray(GLuint array)
+{
+	UCount(CALL_BIND_VAO, array == currentVao);
+	currentVao = array;
+	glBindVertexArray(array);
+}
+
+void UGLBindBuffer(GLenum target, GLuint buffer)
+{
+	if (target == GL_ELEMENT_ARRAY_BUFFER && currentVao != UNKNOWN)
+	{
+		map<GLuint, GLuint>::iterator it = vaoElementBuffers.find(currentVao);
+		UCount(CALL_BIND_BUFFER, it != vaoElementBuffers.end() && it->second == buffer);
+		vaoElementBuffers[currentVao] = buffer;
+	}
+	else
+	{
+		map<GLenum, GLuint>::iterator it = boundBuffers.find(target);
+		UCount(CALL_BIND_BUFFER, it != boundBuffers.end() && it->second == buffer);
+		boundBuffers[target] = buffer;
+	}
+	glBindBuffer(target, buffer);
+}
+
+void UGLBindBufferBase(GLenum target, GLuint index, GLuint buffer)
+{
+	pair<GLenum, GLuint> key(target, index);
+	map<pair<GLenum, GLuint>, GLuint>::iterator it = boundBases.find(key);
+	UCount(CALL_BIND_BUFFER_BASE, it != boundBases.end() && it->second == buffer);
+	boundBases[key] = buffer;
+	//binding to an indexed point also changes the generic binding
+	boundBuffers[target] = buffer;
+	glBindBufferBase(target, index, buffer);
+}
+
+void UGLBufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage)
+{
+	UCount(CALL_BUFFER_DATA, false);
+	if (data)
+		frame.bufferBytes += size;
+	glBufferData(target, size, data, usage);
+}
+
+void UGLBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data)
+{
+	UCount(CALL_BUFFER_SUB_DATA, false);
+	frame.bufferBytes += size;
+	glBufferSubData(target, offset, size, data);
+}
+
+void UGLClearBufferData(GLenum target, GLenum internalformat, GLenum format, GLenum type, const void* data)
+{
+	//filled on the gpu, nothing is uploaded
+	UCount(CALL_CLEAR_BUFFER, false);
+	glClearBufferData(target, internalformat, format, type, data);
+}
+
+void UGLActiveTexture(GLenum texture)
+{
+	UCount(CALL_ACTIVE_TEXTURE, unitKnown && texture == currentUnit);
+	currentUnit = texture;
+	unitKnown = true;
+	glActiveTexture(texture);
+}
+
+void UGLBindTexture(GLenum target, GLuint texture)
+{
+	pair<GLenum, GLenum> key(unitKnown ? currentUnit : GL_TEXTURE0, target);
+	map<pair<GLenum, GLenum>, GLuint>::iterator it = boundTextures.find(key);
+	UCount(CALL_BIND_TEXTURE, unitKnown && it != boundTextures.end() && it->second == texture);
+	boundTextures[key] = texture;
+	glBindTexture(target, texture);
+}
+
+void UGLBindSampler(GLuint unit, GLuint sampler)
+{
+	map<GLuint, GLuint>::iterator it = boundSamplers.find(unit);
+	UCount(CALL_BIND_SAMPLER, it != boundSamplers.end() && it->second == sampler);
+	boundSamplers[unit] = sampler;
+	glBindSampler(unit, sampler);
+}
+
+void UGLTexImage2D(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const void* pixels)
+{
+	UCount(CALL_TEX_IMAGE, false);
+	if (pixels)
+		frame.textureBytes += (uint64_t)width * height * UTexelBytes(format, type);
+	glTexImage2D(target, level, internalformat, width, height, border, format, type, pixels);
+}
+
+void UGLTexStorage2D(GLenum target, GLsizei levels, GLenum internalformat, GLsizei width, GLsizei height)
+{
+	//allocates only, the texels arrive later (or are rendered)
+	UCount(CALL_TEX_STORAGE, false);
+	glTexStorage2D(target, levels, internalformat, width, height);
+}
+
+void UGLTexParameteri(GLenum target, GLenum pname, GLint param)
+{
+	UCount(CALL_TEX_PARAMETER, false);
+	glTexParameteri(target, pname, param);
+}
+
+void UGLGenerateMipmap(GLenum target)
+{
+	UCount(CALL_GENERATE_MIPMAP, false);
+	glGenerateMipmap(target);
+}
+
+//UNIFORM WRAPPERS =================================================================================================================================
+
+GLint UGLGetUniformLocation(GLuint program, const GLchar* name)
+{
+	//never redundant as far as GL is concerned, but every one of these is a string lookup in the driver
+	UCount(CALL_GET_UNIFORM_LOCATION, false);
+	return glGetUniformLocation(program, name);
+}
+
+void UGLUniform1i(GLint location, GLint v0)
+{
+	UCount(CALL_UNIFORM, USameUniform(location, &v0, sizeof(v0)));
+	glUniform1i(location, v0);
+}
+
+void UGLUniform1ui(GLint location, GLuint v0)
+{
+	UCount(CALL_UNIFORM, USameUniform(location, &v0, sizeof(v0)));
+	glUniform1ui(location, v0);
+}
+
+void UGLUniform1f(GLint location, GLfloat v0)
+{
+	UCount(CALL_UNIFORM, USameUniform(location, &v0, sizeof(v0)));
+	glUniform1f(location, v0);
+}
+
+void UGLUniform2f(GLint location, GLfloat v0, GLfloat v1)
+{
+	GLfloat value[2] = { v0, v1 };
+	UCount(CALL_UNIFORM, USameUniform(location, value, sizeof(value)));
+	glUniform2f(location, v0, v1);
+}
+
+void UGLUniform3fv(GLint location, GLsizei count, const GLfloat* value)
+{
+	UCount(CALL_UNIFORM, USameUniform(location, value, sizeof(GLfloat) * 3 * count));
+	glUniform3fv(location, count, value);
+}
+
+void UGLUniform4fv(GLint location, GLsizei count, const GLfloat* value)
+{
+	UCount(CALL_UNIFORM, USameUniform(location, value, sizeof(GLfloat) * 4 * count));
+	glUniform4fv(location, count, value);
+}
+
+void UGLUniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value)
+{
+	UCount(CALL_UNIFORM, USameUniform(location, value, sizeof(GLfloat) * 16 * count));
+	glUniformMatrix4fv(location, count, transpose, value);
+}
+
+//FRAMEBUFFER / DRAW WRAPPERS ======================================================================================================================
+
+void UGLClearColor(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha)
+{
+	GLfloat color[4] = { red, green, blue, alpha };
+	UCount(CALL_CLEAR_COLOR, clearColorKnown && memcmp(color, clearColor, sizeof(color)) == 0);
+	memcpy(clearColor, color, sizeof(color));
+	clearColorKnown = true;
+	glClearColor(red, green, blue, alpha);
+}
+
+void UGLClear(GLbitfield mask)
+{
+	UCount(CALL_CLEAR, false);
+	glClear(mask);
+}
+
+void UGLViewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+	GLint rect[4] = { x, y, width, height };
+	UCount(CALL_VIEWPORT, viewportKnown && memcmp(rect, viewport, sizeof(rect)) == 0);
+	memcpy(viewport, rect, sizeof(rect));
+	viewportKnown = true;
+	glViewport(x, y, width, height);
+}
+
+void UGLDrawArrays(GLenum mode, GLint first, GLsizei count)
+{
+	UCount(CALL_DRAW, false);
+	if (mode == GL_TRIANGLES)
+		frame.triangles += count / 3;
+	glDrawArrays(mode, first, count);
+}
+
+void UGLDrawElements(GLenum mode, GLsizei count, GLenum type, const void* indices)
+{
+	UCount(CALL_DRAW, false);
+	if (mode == GL_TRIANGLES)
+		frame.triangles += count / 3;
+	glDrawElements(mode, count, type, indices);
+}
+
+void UGLDrawElementsInstanced(GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instancecount)
+{
+	UCount(CALL_DRAW, false);
+	if (mode == GL_TRIANGLES)
+		frame.triangles += (uint64_t)(count / 3) * instancecount;
+	glDrawElementsInstanced(mode, count, type, indices, instancecount);
+}
+
+void UGLMultiDrawElementsIndirect(GLenum mode, GLenum type, const void* indirect, GLsizei drawcount, GLsizei stride)
+{
+	UCount(CALL_DRAW_INDIRECT, false);
+	glMultiDrawElementsIndirect(mode, type, indirect, drawcount, stride);
+}
+
+void UGLMultiDrawElementsIndirectCountARB(GLenum mode, GLenum type, const void* indirect, GLintptr drawcount, GLsizei maxdrawcount, GLsizei stride)
+{
+	UCount(CALL_DRAW_INDIRECT, false);
+	glMultiDrawElementsIndirectCountARB(mode, type, indirect, drawcount, maxdrawcount, stride);
+}
+
+void UGLMultiDrawElementsIndirectCount(GLenum mode, GLenum type, const void* indirect, GLintptr drawcount, GLsizei maxdrawcount, GLsizei stride)
+{
+	UCount(CALL_DRAW_INDIRECT, false);
+	glMultiDrawElementsIndirectCount(mode, type, indirect, drawcount, maxdrawcount, stride);
+}
+
+void UGLBindFramebuffer(GLenum target, GLuint framebuffer)
+{
+	bool draw = target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER;
+	bool read = target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER;
+	UCount(CALL_BIND_FRAMEBUFFER, (!draw || drawFramebuffer == framebuffer) && (!read || readFramebuffer == framebuffer));
+	if (draw)
+		drawFramebuffer = framebuffer;
+	if (read)
+		readFramebuffer = framebuffer;
+	glBindFramebuffer(target, framebuffer);
+}
+
+void UGLViewportArrayv(GLuint first, GLsizei count, const GLfloat* v)
+{
+	UCount(CALL_VIEWPORT, false);
+	//viewport 0 is what glViewport's shadow copy describes
+	if (first == 0 && count > 0)
+		viewportKnown = false;
+	glViewportArrayv(first, count, v);
+}
+
+void UGLDispatchCompute(GLuint x, GLuint y, GLuint z)
+{
+	UCount(CALL_DISPATCH, false);
+	glDispatchCompute(x, y, z);
+}
+
+//DELETE WRAPPERS ==================================================================================================================================
+
+void UGLDeleteBuffers(GLsizei n, const GLuint* buffers)
+{
+	UCount(CALL_DELETE, false);
+	for (GLsizei i = 0; i < n; i++)
+	{
+		UForgetBound(boundBuffers, buffers[i]);
+		UForgetBound(boundBases, buffers[i]);
+		UForgetBound(vaoElementBuffers, buffers[i]);
+	}
+	glDeleteBuffers(n, buffers);
+}
+
+void UGLDeleteTextures(GLsizei n, const GLuint* textures)
+{
+	UCount(CALL_DELETE, false);
+	for (GLsizei i = 0; i < n; i++)
+		UForgetBound(boundTextures, textures[i]);
+	glDeleteTextures(n, textures);
+}
+
+void UGLDeleteVertexArrays(GLsizei n, const GLuint* arrays)
+{
+	UCount(CALL_DELETE, false);
+	for (GLsizei i = 0; i < n; i++)
+	{
+		vaoElementBuffers.erase(arrays[i]);
+		if (currentVao == arrays[i])
+			currentVao = UNKNOWN;
+	}
+	glDeleteVertexArrays(n, arrays);
+}
+
+void UGLDeleteFramebuffers(GLsizei n, const GLuint* framebuffers)
+{
+	UCount(CALL_DELETE, false);
+	for (GLsizei i = 0; i < n; i++)
+	{
+		if (drawFramebuffer == framebuffers[i])
+			drawFramebuffer = UNKNOWN;
+		if (readFramebuffer == framebuffers[i])
+			readFramebuffer = UNKNOWN;
+	}
+	glDeleteFramebuffers(n, framebuffers);
+}
+
+void UGLDeleteProgram(GLuint program)
+{
+	UCount(CALL_DELETE, false);
+	uniformValues.erase(uniformValues.lower_bound(make_pair(program, (GLint)INT_MIN)), uniformValues.upper_bound(make_pair(program, (GLint)INT_MAX)));
+	if (currentProgram == program)
+		currentProgram = UNKNOWN;
+	glDeleteProgram(program);
+}
+
+#endif
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <GL/glew.h>
+
+//GL CALL INTERCEPTION (instrumentation build) =====================================================================================================
+//
+// compile with UGL_INSTRUMENT defined (e.g. /DUGL_INSTRUMENT or -DUGL_INSTRUMENT) to route the GL entry points below through
+// counting wrappers. every frame gets a row in glstats.csv with calls per type, redundant state sets (enable of an
+// already enabled cap, binding what is already bound, writing a uniform value it already holds), draws/triangles and
+// bytes uploaded to buffers/textures/uniforms (indirect draws count as draws, their triangles are only known to the gpu). a summary of the first frame and the per-frame averages is printed at exit.
+//
+// include this after <GL/glew.h> in any file whose GL calls should be counted. without UGL_INSTRUMENT nothing is wrapped
+// and the frame hooks are empty inline functions.
+
+#ifdef UGL_INSTRUMENT
+
+void UGLStatsEndFrame();		//call once per frame after swapping buffers
+void UGLStatsShutdown();
+
+void UGLEnable(GLenum cap);
+void UGLDisable(GLenum cap);
+void UGLDepthMask(GLboolean flag);
+void UGLPolygonOffset(GLfloat factor, GLfloat units);
+void UGLUseProgram(GLuint program);
+void UGLBindVertexArray(GLuint array);
+void UGLBindBuffer(GLenum target, GLuint buffer);
+void UGLBindBufferBase(GLenum target, GLuint index, GLuint buffer);
+void UGLBufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage);
+void UGLBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data);
+void UGLClearBufferData(GLenum target, GLenum internalformat, GLenum format, GLenum type, const void* data);
+void UGLActiveTexture(GLenum texture);
+void UGLBindTexture(GLenum target, GLuint texture);
+void UGLBindSampler(GLuint unit, GLuint sampler);
+void UGLTexImage2D(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const void* pixels);
+void UGLTexStorage2D(GLenum target, GLsizei levels, GLenum internalformat, GLsizei width, GLsizei height);
+void UGLTexParameteri(GLenum target, GLenum pname, GLint param);
+void UGLGenerateMipmap(GLenum target);
+GLint UGLGetUniformLocation(GLuint program, const GLchar* name);
+void UGLUniform1i(GLint location, GLint v0);
+void UGLUniform1ui(GLint location, GLuint v0);
+void UGLUniform1f(GLint location, GLfloat v0);
+void UGLUniform2f(GLint location, GLfloat v0, GLfloat v1);
+void UGLUniform3fv(GLint location, GLsizei count, const GLfloat* value);
+void UGLUniform4fv(GLint location, GLsizei count, const GLfloat* value);
+void UGLUniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value);
+void UGLClearColor(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha);
+void UGLClear(GLbitfield mask);
+void UGLViewport(GLint x, GLint y, GLsizei width, GLsizei height);
+void UGLDrawArrays(GLenum mode, GLint first, GLsizei count);
+void UGLDrawElements(GLenum mode, GLsizei count, GLenum type, const void* indices);
+void UGLDrawElementsInstanced(GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instancecount);
+void UGLMultiDrawElementsIndirect(GLenum mode, GLenum type, const void* indirect, GLsizei drawcount, GLsizei stride);
+void UGLMultiDrawElementsIndirectCountARB(GLenum mode, GLenum type, const void* indirect, GLintptr drawcount, GLsizei maxdrawcount, GLsizei stride);
+void UGLMultiDrawElementsIndirectCount(GLenum mode, GLenum type, const void* indirect, GLintptr drawcount, GLsizei maxdrawcount, GLsizei stride);
+void UGLBindFramebuffer(GLenum target, GLuint framebuffer);
+void UGLViewportArrayv(GLuint first, GLsizei count, const GLfloat* v);
+void UGLDispatchCompute(GLuint x, GLuint y, GLuint z);
+void UGLDeleteBuffers(GLsizei n, const GLuint* buffers);
+void UGLDeleteTextures(GLsizei n, const GLuint* textures);
+void UGLDeleteVertexArrays(GLsizei n, const GLuint* arrays);
+void UGLDeleteFramebuffers(GLsizei n, const GLuint* framebuffers);
+void UGLDeleteProgram(GLuint program);
+
+#ifndef UGL_STATS_IMPL
+#undef glEnable
+#undef glDisable
+#undef glDepthMask
+#undef glPolygonOffset
+#undef glUseProgram
+#undef glBindVertexArray
+#undef glBindBuffer
+#undef glBindBufferBase
+#undef glBufferData
+#undef glBufferSubData
+#undef glClearBufferData
+#undef glActiveTexture
+#undef glBindTexture
+#undef glBindSampler
+#undef glTexImage2D
+#undef glTexStorage2D
+#undef glTexParameteri
+#undef glGenerateMipmap
+#undef glGetUniformLocation
+#undef glUniform1i
+#undef glUniform1ui
+#undef glUniform1f
+#undef glUniform2f
+#undef glUniform3fv
+#undef glUniform4fv
+#undef glUniformMatrix4fv
+#undef glClearColor
+#undef glClear
+#undef glViewport
+#undef glDrawArrays
+#undef glDrawElements
+#undef glDrawElementsInstanced
+#undef glMultiDrawElementsIndirect
+#undef glMultiDrawElementsIndirectCountARB
+#undef glMultiDrawElementsIndirectCount
+#undef glBindFramebuffer
+#undef glViewportArrayv
+#undef glDispatchCompute
+#undef glDeleteBuffers
+#undef glDeleteTextures
+#undef glDeleteVertexArrays
+#undef glDeleteFramebuffers
+#undef glDeleteProgram
+#define glEnable UGLEnable
+#define glDisable UGLDisable
+#define glDepthMask UGLDepthMask
+#define glPolygonOffset UGLPolygonOffset
+#define glUseProgram UGLUseProgram
+#define glBindVertexArray UGLBindVertexArray
+#define glBindBuffer UGLBindBuffer
+#define glBindBufferBase UGLBindBufferBase
+#define glBufferData UGLBufferData
+#define glBufferSubData UGLBufferSubData
+#define glClearBufferData UGLClearBufferData
+#define glActiveTexture UGLActiveTexture
+#define glBindTexture UGLBindTexture
+#define glBindSampler UGLBindSampler
+#define glTexImage2D UGLTexImage2D
+#define glTexStorage2D UGLTexStorage2D
+#define glTexParameteri UGLTexParameteri
+#define glGenerateMipmap UGLGenerateMipmap
+#define glGetUniformLocation UGLGetUniformLocation
+#define glUniform1i UGLUniform1i
+#define glUniform1ui UGLUniform1ui
+#define glUniform1f UGLUniform1f
+#define glUniform2f UGLUniform2f
+#define glUniform3fv UGLUniform3fv
+#define glUniform4fv UGLUniform4fv
+#define glUniformMatrix4fv UGLUniformMatrix4fv
+#define glClearColor UGLClearColor
+#define glClear UGLClear
+#define glViewport UGLViewport
+#define glDrawArrays UGLDrawArrays
+#define glDrawElements UGLDrawElements
+#define glDrawElementsInstanced UGLDrawElementsInstanced
+#define glMultiDrawElementsIndirect UGLMultiDrawElementsIndirect
+#define glMultiDrawElementsIndirectCountARB UGLMultiDrawElementsIndirectCountARB
+#define glMultiDrawElementsIndirectCount UGLMultiDrawElementsIndirectCount
+#define glBindFramebuffer UGLBindFramebuffer
+#define glViewportArrayv UGLViewportArrayv
+#define glDispatchCompute UGLDispatchCompute
+#define glDeleteBuffers UGLDeleteBuffers
+#define glDeleteTextures UGLDeleteTextures
+#define glDeleteVertexArrays UGLDeleteVertexArrays
+#define glDeleteFramebuffers UGLDeleteFramebuffers
+#define glDeleteProgram UGLDeleteProgram
+#endif
+
+#else
+
+inline void UGLStatsEndFrame() {}
+inline void UGLStatsShutdown() {}
+
+#endif
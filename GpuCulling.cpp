@@ -0,0 +1,443 @@
+#include "GpuCulling.h"
+
+#include <cstring>
+#include <iostream>
+#include <map>
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include "CommandList.h"
+#include "FrameArena.h"
+#include "GLStats.h"
+#include "MultiView.h"
+#include "Trace.h"
+
+using namespace std;
+
+namespace
+{
+	//storage buffer bindings (0 and 1 are read by scene.vert too, 6 is the material table)
+	const GLuint OBJECTS_BINDING = 0;
+	const GLuint WORLDS_BINDING = 1;
+	const GLuint MESHES_BINDING = 2;
+	const GLuint BATCHES_BINDING = 3;
+	const GLuint COUNTS_BINDING = 4;
+	const GLuint COMMANDS_BINDING = 5;
+	const GLuint OBJECT_ATTRIBUTE = 4;
+	const GLuint LIGHTMAP_UV_ATTRIBUTE = 5;
+	const int CULL_GROUP_SIZE = 64;
+
+	//std430 layouts, have to match the shaders
+	struct DrawObject
+	{
+		GLuint node;
+		GLuint mesh;
+		GLuint batch;
+		GLuint command;		//fixed slot of the object (non-compacting mode)
+		GLuint material;	//index into the material table (Materials.h)
+		GLuint pad[3];
+		glm::vec4 lightmap;	//atlas scale/offset (LIGHTMAP variants)
+	};
+
+	struct DrawMesh
+	{
+		glm::vec4 sphere;	//local bounding sphere (xyz centre, w radius)
+		GLuint count;
+		GLuint firstIndex;
+		GLint baseVertex;
+		GLuint pad;
+	};
+
+	//what glMultiDrawElementsIndirect reads
+	struct DrawElementsIndirectCommand
+	{
+		GLuint count;
+		GLuint instanceCount;
+		GLuint firstIndex;
+		GLint baseVertex;
+		GLuint baseInstance;
+	};
+
+	//objects sharing a program and a texture, drawn by one multi-draw
+	struct Batch
+	{
+		int variant;
+		int texture;
+		GLuint first;		//first command of the batch's range
+		GLuint size;		//objects in the batch (= most commands it can produce)
+	};
+
+	const char* cullShaderSource = "#version 440 core\n"
+		"layout (local_size_x = 64) in;\n"
+
+		"struct DrawObject { uint node; uint mesh; uint batch; uint command; uint material; uint pad0; uint pad1; uint pad2; vec4 lightmap; };\n"
+		"struct DrawMesh { vec4 sphere; uint count; uint firstIndex; int baseVertex; uint pad; };\n"
+		"struct DrawCommand { uint count; uint instanceCount; uint firstIndex; int baseVertex; uint baseInstance; };\n"
+
+		"layout (std430, binding = 0) readonly buffer Objects { DrawObject objects[]; };\n"
+		"layout (std430, binding = 1) readonly buffer Worlds { mat4 worlds[]; };\n"
+		"layout (std430, binding = 2) readonly buffer Meshes { DrawMesh meshes[]; };\n"
+		"layout (std430, binding = 3) readonly buffer Batches { uint batchFirst[]; };\n"
+		"layout (std430, binding = 4) buffer Counts { uint batchCount[]; };\n"
+		"layout (std430, binding = 5) writeonly buffer Commands { DrawCommand commands[]; };\n"
+
+		"uniform vec4 planes[24];\n"		//six per view (MultiView.h)
+		"uniform int viewCount;\n"
+		"uniform uint instances;\n"		//one per view when the vertex shader picks the viewport
+		"uniform uint objectCount;\n"
+		"uniform bool compact;\n"
+
+		"void main()\n"
+		"{\n"
+		"	uint i = gl_GlobalInvocationID.x;\n"
+		"	if (i >= objectCount)\n"
+		"		return;\n"
+		"	DrawObject object = objects[i];\n"
+		"	DrawMesh mesh = meshes[object.mesh];\n"
+		"	mat4 world = worlds[object.node];\n"
+		//bounding sphere into world space (radius grows with the largest axis scale)
+		"	vec3 center = (world * vec4(mesh.sphere.xyz, 1.0)).xyz;\n"
+		"	float radius = mesh.sphere.w * max(length(world[0].xyz), max(length(world[1].xyz), length(world[2].xyz)));\n"
+		//drawn for every view when any of them sees it
+		"	bool visible = false;\n"
+		"	for (int v = 0; v < viewCount; v++)\n"
+		"	{\n"
+		"		bool inView = true;\n"
+		"		for (int p = 6 * v; p < 6 * v + 6; p++)\n"
+		"			inView = inView && dot(planes[p].xyz, center) + planes[p].w >= -radius;\n"
+		"		visible = visible || inView;\n"
+		"	}\n"
+		"	DrawCommand command = DrawCommand(mesh.count, instances, mesh.firstIndex, mesh.baseVertex, i);\n"
+		"	if (compact)\n"
+		"	{\n"
+		"		if (!visible)\n"
+		"			return;\n"
+		"		uint slot = atomicAdd(batchCount[object.batch], 1u);\n"
+		"		commands[batchFirst[object.batch] + slot] = command;\n"
+		"	}\n"
+		"	else\n"
+		"	{\n"
+		"		command.instanceCount = visible ? instances : 0u;\n"
+		"		commands[object.command] = command;\n"
+		"	}\n"
+		"}\n\0";
+
+	UGpuCullingConfig gConfig;
+	bool gActive = false;
+	UGpuVertexArray gVao;
+	UGpuBuffer gVertexBuffer;
+	UGpuBuffer gLightmapUVBuffer;		//only with lightmapped meshes
+	UGpuBuffer gIndexBuffer;
+	UGpuBuffer gObjectIdBuffer;
+	UGpuBuffer gObjectBuffer;
+	UGpuBuffer gWorldBuffer;
+	UGpuBuffer gMeshBuffer;
+	UGpuBuffer gBatchBuffer;
+	UGpuBuffer gCountBuffer;
+	UGpuBuffer gCommandBuffer;
+	UGpuProgram gCullProgram;
+	GLint gPlanesLoc = -1;
+	GLint gViewCountLoc = -1;
+	GLint gInstancesLoc = -1;
+	GLint gObjectCountLoc = -1;
+	GLint gCompactLoc = -1;
+	bool gCountCore = false;		//only gl 4.6: its core glMultiDrawElementsIndirectCount, the ARB pointer may be null
+	GLuint gObjectCount = 0;
+	vector<Batch> gBatches;
+
+	bool UCreateCullProgram()
+	{
+		int success = 0;
+		char infoLog[512];
+		GLuint shaderId = glCreateShader(GL_COMPUTE_SHADER);
+		glShaderSource(shaderId, 1, &cullShaderSource, NULL);
+		glCompileShader(shaderId);
+		glGetShaderiv(shaderId, GL_COMPILE_STATUS, &success);
+		if (!success)
+		{
+			glGetShaderInfoLog(shaderId, sizeof(infoLog), NULL, infoLog);
+			cout << "ERROR COMPILING CULL SHADER\n" << infoLog << endl;
+			glDeleteShader(shaderId);
+			return false;
+		}
+
+		gCullProgram.Create("gpu culling");
+		glAttachShader(gCullProgram, shaderId);
+		glLinkProgram(gCullProgram);
+		glDetachShader(gCullProgram, shaderId);
+		glDeleteShader(shaderId);
+		glGetProgramiv(gCullProgram, GL_LINK_STATUS, &success);
+		if (!success)
+		{
+			glGetProgramInfoLog(gCullProgram, sizeof(infoLog), NULL, infoLog);
+			cout << "ERROR LINKING CULL SHADER\n" << infoLog << endl;
+			gCullProgram.Reset();
+			return false;
+		}
+
+		gPlanesLoc = glGetUniformLocation(gCullProgram, "planes");
+		gViewCountLoc = glGetUniformLocation(gCullProgram, "viewCount");
+		gInstancesLoc = glGetUniformLocation(gCullProgram, "instances");
+		gObjectCountLoc = glGetUniformLocation(gCullProgram, "objectCount");
+		gCompactLoc = glGetUniformLocation(gCullProgram, "compact");
+		return true;
+	}
+
+	void UCreateBuffer(UGpuBuffer& buffer, const char* label, GLenum target, GLsizeiptr size, const void* data, GLenum usage)
+	{
+		buffer.Create(label);
+		glBindBuffer(target, buffer);
+		glBufferData(target, size, data, usage);
+		buffer.SetBytes((size_t)size);
+	}
+}
+
+bool UParseGpuCullingArgs(int argc, char* argv[], UGpuCullingConfig& config)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--gpu-culling") == 0)
+		{
+			config.enabled = true;
+			if (i + 1 < argc && strcmp(argv[i + 1], "fixed") == 0)
+			{
+				config.compact = false;
+				i++;
+			}
+		}
+	}
+	return true;
+}
+
+bool UGpuCullingInit(const UGpuCullingConfig& config, const std::vector<UDrawItem>& items, const USceneGraph& scene, UShaderVariants& variants)
+{
+	if (!config.enabled)
+		return false;
+	UTRACE_SCOPE("UGpuCullingInit");
+	gConfig = config;
+	if (gConfig.compact && !GLEW_ARB_indirect_parameters && !GLEW_VERSION_4_6)
+	{
+		cout << "WARNING: no ARB_indirect_parameters, gpu culling writes one command per object instead of compacting" << endl;
+		gConfig.compact = false;
+	}
+	gCountCore = gConfig.compact && !GLEW_ARB_indirect_parameters;
+	if (!UCreateCullProgram())
+		return false;
+
+	//every mesh into one vertex/index buffer (the indices stay 16 bit, baseVertex offsets them)
+	map<const GLMesh*, GLuint> meshIndex;
+	vector<float> vertices;
+	vector<float> lightmapUVs;
+	vector<unsigned short> indices;
+	vector<DrawMesh> meshes;
+	bool lightmapped = false;
+	for (const UDrawItem& item : items)
+	{
+		if (meshIndex.count(item.mesh) != 0)
+			continue;
+		DrawMesh mesh;
+		mesh.sphere = glm::vec4(item.mesh->boundsCenter, item.mesh->boundsRadius);
+		mesh.count = (GLuint)item.mesh->indices.size();
+		mesh.firstIndex = (GLuint)indices.size();
+		mesh.baseVertex = (GLint)(vertices.size() / FLOATS_PER_MESH_VERTEX);
+		mesh.pad = 0;
+		meshIndex[item.mesh] = (GLuint)meshes.size();
+		meshes.push_back(mesh);
+		vertices.insert(vertices.end(), item.mesh->vertices.begin(), item.mesh->vertices.end());
+		//second uv set of lightmapped meshes (zeros for the others, whose variants don't read it)
+		if (item.mesh->lightmapUVs.empty())
+			lightmapUVs.resize(lightmapUVs.size() + item.mesh->vertices.size() / FLOATS_PER_MESH_VERTEX * 2, 0.0f);
+		else
+			lightmapUVs.insert(lightmapUVs.end(), item.mesh->lightmapUVs.begin(), item.mesh->lightmapUVs.end());
+		lightmapped = lightmapped || !item.mesh->lightmapUVs.empty();
+		indices.insert(indices.end(), item.mesh->indices.begin(), item.mesh->indices.end());
+	}
+
+	//batches by program + texture (first come first drawn, like the draw list), then each object gets its slot in its batch
+	vector<DrawObject> objects(items.size());
+	vector<GLuint> objectIds(items.size());
+	for (size_t i = 0; i < items.size(); i++)
+	{
+		const UDrawItem& item = items[i];
+		int variant = UShaderVariantFind(variants, variants.keys[item.variant] | USHADER_GPU_DRIVEN);
+		size_t batch = 0;
+		while (batch < gBatches.size() && (gBatches[batch].variant != variant || gBatches[batch].texture != item.texture))
+			batch++;
+		if (batch == gBatches.size())
+			gBatches.push_back({ variant, item.texture, 0, 0 });
+
+		DrawObject& object = objects[i];
+		object.node = (GLuint)item.node;
+		object.mesh = meshIndex[item.mesh];
+		object.batch = (GLuint)batch;
+		object.command = gBatches[batch].size++;
+		object.material = (GLuint)item.material;
+		object.pad[0] = object.pad[1] = object.pad[2] = 0.0f;
+		object.lightmap = item.lightmap;
+		objectIds[i] = (GLuint)i;
+	}
+	vector<GLuint> batchFirst;
+	GLuint first = 0;
+	for (Batch& batch : gBatches)
+	{
+		batch.first = first;
+		batchFirst.push_back(first);
+		first += batch.size;
+	}
+	for (DrawObject& object : objects)
+		object.command += gBatches[object.batch].first;
+	gObjectCount = (GLuint)objects.size();
+
+	//shared geometry with the usual attributes plus the object index (instanced, so baseInstance selects it)
+	gVao.Create("gpu culling");
+	glBindVertexArray(gVao);
+	UCreateBuffer(gVertexBuffer, "gpu culling vertices", GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+	GLint stride = sizeof(float) * FLOATS_PER_MESH_VERTEX;
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, 0);
+	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, stride, (void*)(MESH_COLOR_OFFSET * sizeof(float)));
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void*)(MESH_TEXCOORD_OFFSET * sizeof(float)));
+	glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, stride, (void*)(MESH_NORMAL_OFFSET * sizeof(float)));
+	for (GLuint attribute = 0; attribute < 4; attribute++)
+		glEnableVertexAttribArray(attribute);
+	UCreateBuffer(gObjectIdBuffer, "gpu culling object ids", GL_ARRAY_BUFFER, objectIds.size() * sizeof(GLuint), objectIds.data(), GL_STATIC_DRAW);
+	glVertexAttribIPointer(OBJECT_ATTRIBUTE, 1, GL_UNSIGNED_INT, sizeof(GLuint), 0);
+	//with MultiView.h's vertex shader path a draw has one instance per view, and they all read the object at baseInstance
+	glVertexAttribDivisor(OBJECT_ATTRIBUTE, UMultiViewInstances());
+	glEnableVertexAttribArray(OBJECT_ATTRIBUTE);
+	if (lightmapped)
+	{
+		UCreateBuffer(gLightmapUVBuffer, "gpu culling lightmap uvs", GL_ARRAY_BUFFER, lightmapUVs.size() * sizeof(float), lightmapUVs.data(), GL_STATIC_DRAW);
+		glVertexAttribPointer(LIGHTMAP_UV_ATTRIBUTE, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), 0);
+		glEnableVertexAttribArray(LIGHTMAP_UV_ATTRIBUTE);
+	}
+	UCreateBuffer(gIndexBuffer, "gpu culling indices", GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned short), indices.data(), GL_STATIC_DRAW);
+	glBindVertexArray(0);
+
+	UCreateBuffer(gObjectBuffer, "gpu culling objects", GL_SHADER_STORAGE_BUFFER, objects.size() * sizeof(DrawObject), objects.data(), GL_STATIC_DRAW);
+	UCreateBuffer(gWorldBuffer, "gpu culling world matrices", GL_SHADER_STORAGE_BUFFER, scene.world.size() * sizeof(glm::mat4), scene.world.data(), GL_DYNAMIC_DRAW);
+	UCreateBuffer(gMeshBuffer, "gpu culling meshes", GL_SHADER_STORAGE_BUFFER, meshes.size() * sizeof(DrawMesh), meshes.data(), GL_STATIC_DRAW);
+	UCreateBuffer(gBatchBuffer, "gpu culling batches", GL_SHADER_STORAGE_BUFFER, batchFirst.size() * sizeof(GLuint), batchFirst.data(), GL_STATIC_DRAW);
+	UCreateBuffer(gCountBuffer, "gpu culling draw counts", GL_SHADER_STORAGE_BUFFER, gBatches.size() * sizeof(GLuint), nullptr, GL_DYNAMIC_DRAW);
+	UCreateBuffer(gCommandBuffer, "gpu culling commands", GL_SHADER_STORAGE_BUFFER, objects.size() * sizeof(DrawElementsIndirectCommand), nullptr, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	gActive = true;
+	cout << "INFO: gpu culling, " << gObjectCount << " objects, " << meshes.size() << " meshes (" << vertices.size() / FLOATS_PER_MESH_VERTEX
+		<< " vertices, " << indices.size() << " indices), " << gBatches.size() << " batches, "
+		<< (gConfig.compact ? "compacted by glMultiDrawElementsIndirectCount" : "fixed command count") << endl;
+	return true;
+}
+
+void UGpuCullingShutdown()
+{
+	if (!gActive)
+		return;
+	UGpuBuffer* buffers[] = { &gVertexBuffer, &gLightmapUVBuffer, &gIndexBuffer, &gObjectIdBuffer, &gObjectBuffer, &gWorldBuffer, &gMeshBuffer, &gBatchBuffer,
+		&gCountBuffer, &gCommandBuffer };
+	for (UGpuBuffer* buffer : buffers)
+		buffer->Reset();
+	gVao.Reset();
+	gCullProgram.Reset();
+	gBatches.clear();
+	gActive = false;
+}
+
+bool UGpuCullingReady(const UShaderVariants& variants)
+{
+	if (!gActive)
+		return false;
+	for (const Batch& batch : gBatches)
+	{
+		if (!variants.programs[batch.variant].ready)
+			return false;
+	}
+	return true;
+}
+
+void UGpuCullingUpdateTransforms(const USceneGraph& scene)
+{
+	if (!gActive)
+		return;
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, gWorldBuffer);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, scene.world.size() * sizeof(glm::mat4), scene.world.data());
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void UGpuCullingDraw(UShaderVariants& variants, const glm::mat4& view, const glm::mat4& projection, void (*setFrameUniforms)(GLuint programId))
+{
+	if (!gActive)
+		return;
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, OBJECTS_BINDING, gObjectBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, WORLDS_BINDING, gWorldBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MESHES_BINDING, gMeshBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BATCHES_BINDING, gBatchBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COUNTS_BINDING, gCountBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COMMANDS_BINDING, gCommandBuffer);
+
+	//cull pass: one invocation per object
+	{
+		UTRACE_GPU_SCOPE("gpu cull");
+		glm::vec4 planes[6 * UMULTIVIEW_MAX_VIEWS];
+		int views = UMultiViewFrustumPlanes(projection * view, planes);
+		GLuint zero = 0;
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, gCountBuffer);
+		glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		glUseProgram(gCullProgram);
+		glUniform4fv(gPlanesLoc, 6 * views, glm::value_ptr(planes[0]));
+		glUniform1i(gViewCountLoc, views);
+		glUniform1ui(gInstancesLoc, (GLuint)UMultiViewInstances());
+		glUniform1ui(gObjectCountLoc, gObjectCount);
+		glUniform1i(gCompactLoc, gConfig.compact ? 1 : 0);
+		glDispatchCompute((gObjectCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+		glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+	}
+
+	//one multi-draw per batch, programs get their frame uniforms the first time they are used
+	UTRACE_GPU_SCOPE("gpu driven draws");
+	glEnable(GL_DEPTH_TEST);
+	glBindVertexArray(gVao);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, gCommandBuffer);
+	if (gConfig.compact)
+		glBindBuffer(GL_PARAMETER_BUFFER_ARB, gCountBuffer);
+	GLuint* programsThisFrame = UFrameAllocArray<GLuint>(variants.programs.size());
+	int programsUsed = 0;
+	GLuint currentProgram = 0;
+	GLint textureLoc = -1;
+	for (size_t i = 0; i < gBatches.size(); i++)
+	{
+		const Batch& batch = gBatches[i];
+		GLuint program = UShaderVariantUse(variants, batch.variant);
+		if (program != currentProgram)
+		{
+			currentProgram = program;
+			glUseProgram(program);
+			bool first = true;
+			for (int p = 0; p < programsUsed; p++)
+				first = first && programsThisFrame[p] != program;
+			if (first)
+			{
+				setFrameUniforms(program);
+				glUniformMatrix4fv(glGetUniformLocation(program, "view"), 1, GL_FALSE, glm::value_ptr(view));
+				glUniformMatrix4fv(glGetUniformLocation(program, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+				programsThisFrame[programsUsed++] = program;
+			}
+			textureLoc = glGetUniformLocation(program, "ourTexture");
+		}
+		glUniform1i(textureLoc, batch.texture);
+
+		const void* commands = (const void*)(batch.first * sizeof(DrawElementsIndirectCommand));
+		if (gConfig.compact && gCountCore)
+			glMultiDrawElementsIndirectCount(GL_TRIANGLES, GL_UNSIGNED_SHORT, commands, (GLintptr)(i * sizeof(GLuint)), (GLsizei)batch.size, 0);
+		else if (gConfig.compact)
+			glMultiDrawElementsIndirectCountARB(GL_TRIANGLES, GL_UNSIGNED_SHORT, commands, (GLintptr)(i * sizeof(GLuint)), (GLsizei)batch.size, 0);
+		else
+			glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_SHORT, commands, (GLsizei)batch.size, 0);
+	}
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	if (gConfig.compact)
+		glBindBuffer(GL_PARAMETER_BUFFER_ARB, 0);
+	glBindVertexArray(0);
+	UTraceCounter("gpu driven batches", (double)gBatches.size());
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "Scene.h"
+#include "ShaderVariants.h"
+
+//GPU-DRIVEN CULLING AND DRAWING ===================================================================================================================
+//
+// --gpu-culling [fixed]    cull and draw the scene from the gpu (fixed = one indirect command per object with instanceCount
+//                          0 for culled ones instead of compacting, for drivers without ARB_indirect_parameters)
+//
+// every mesh goes into one shared vertex/index buffer and every draw item becomes an object in a storage buffer (scene
+// graph node, mesh, batch, material, lightmap rect). objects are grouped into batches that share a program and a
+// texture, which are the only things still changed between draws. each frame a compute shader tests every object's bounding sphere against the
+// frustum (of any view, MultiView.h) and appends a DrawElementsIndirectCommand for the visible ones to its batch's range (an atomic counter per
+// batch), then each batch is one glMultiDrawElementsIndirectCount. the draw's baseInstance is the object index, which the
+// GPU_DRIVEN variants of scene.vert read through an instanced attribute to fetch the world matrix and material.
+// the cpu does per batch work only; world matrices are re-uploaded when the scene graph changed something.
+// until every GPU_DRIVEN program has finished building the caller keeps drawing through the cpu command lists.
+
+struct UGpuCullingConfig
+{
+	bool enabled = false;
+	bool compact = true;			//glMultiDrawElementsIndirectCount (falls back to fixed without ARB_indirect_parameters)
+};
+
+bool UParseGpuCullingArgs(int argc, char* argv[], UGpuCullingConfig& config);
+
+//builds the shared geometry, the object and batch buffers and the cull shader; items must already have their variants
+bool UGpuCullingInit(const UGpuCullingConfig& config, const std::vector<UDrawItem>& items, const USceneGraph& scene, UShaderVariants& variants);
+void UGpuCullingShutdown();
+
+//true once the GPU_DRIVEN program of every batch is built
+bool UGpuCullingReady(const UShaderVariants& variants);
+//re-upload the world matrices (call when the scene graph recomputed any node)
+void UGpuCullingUpdateTransforms(const USceneGraph& scene);
+//cull + draw; setFrameUniforms is called once for each program (lights, camera position)
+void UGpuCullingDraw(UShaderVariants& variants, const glm::mat4& view, const glm::mat4& projection, void (*setFrameUniforms)(GLuint programId));
@@ -0,0 +1,203 @@
+#include "GpuResources.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <GLFW/glfw3.h>
+
+#include "GLStats.h"
+#include "Trace.h"
+
+using namespace std;
+
+namespace
+{
+	const char* const CATEGORY_NAMES[UGPU_CATEGORY_COUNT] = { "buffers", "textures", "vertex arrays", "programs", "framebuffers" };
+
+	struct Entry
+	{
+		string label;
+		size_t bytes;
+	};
+
+	//the shader compile worker registers from its own thread
+	mutex gLock;
+	unordered_map<GLuint, Entry> gLive[UGPU_CATEGORY_COUNT];
+	size_t gBytes[UGPU_CATEGORY_COUNT] = {};
+	long long gCreated[UGPU_CATEGORY_COUNT] = {};
+	size_t gPeakBytes = 0;
+	UGpuResourcesConfig gConfig;
+	long long gFrame = 0;
+	bool gClosed = false;
+
+	size_t UTotalBytes()
+	{
+		size_t total = 0;
+		for (int c = 0; c < UGPU_CATEGORY_COUNT; c++)
+			total += gBytes[c];
+		return total;
+	}
+
+	void UDeleteObject(UGpuCategory category, GLuint id)
+	{
+		switch (category)
+		{
+		case UGPU_BUFFER: glDeleteBuffers(1, &id); break;
+		case UGPU_TEXTURE: glDeleteTextures(1, &id); break;
+		case UGPU_VERTEX_ARRAY: glDeleteVertexArrays(1, &id); break;
+		case UGPU_PROGRAM: glDeleteProgram(id); break;
+		case UGPU_FRAMEBUFFER: glDeleteFramebuffers(1, &id); break;
+		default: break;
+		}
+	}
+}
+
+bool UParseGpuResourcesArgs(int argc, char* argv[], UGpuResourcesConfig& config)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--gpu-memory") == 0)
+		{
+			config.reportFrames = 600;
+			if (i + 1 < argc && argv[i + 1][0] != '-')
+			{
+				config.reportFrames = atoi(argv[++i]);
+				if (config.reportFrames <= 0)
+				{
+					cerr << "ERROR: --gpu-memory needs a frame count above 0" << endl;
+					return false;
+				}
+			}
+		}
+	}
+	return true;
+}
+
+void UGpuResourcesInit(const UGpuResourcesConfig& config)
+{
+	gConfig = config;
+	gClosed = false;
+	gFrame = 0;
+}
+
+void UGpuResourcesEndFrame()
+{
+	UTraceCounter("gpu memory KB", UGpuResourcesLiveBytes() / 1024.0);
+	gFrame++;
+	if (gConfig.reportFrames > 0 && gFrame % gConfig.reportFrames == 0)
+		UGpuResourcesReport();
+}
+
+void UGpuResourcesReport()
+{
+	lock_guard<mutex> guard(gLock);
+	cout << "INFO: gpu memory: " << UTotalBytes() / 1024 << " KB live (peak " << gPeakBytes / 1024 << " KB)";
+	for (int c = 0; c < UGPU_CATEGORY_COUNT; c++)
+		cout << ", " << gLive[c].size() << " " << CATEGORY_NAMES[c] << " " << gBytes[c] / 1024 << " KB";
+	cout << endl;
+}
+
+size_t UGpuResourcesLiveBytes()
+{
+	lock_guard<mutex> guard(gLock);
+	return UTotalBytes();
+}
+
+void UGpuResourcesShutdown()
+{
+	if (gConfig.reportFrames > 0)
+		UGpuResourcesReport();
+
+	lock_guard<mutex> guard(gLock);
+	size_t leaked = 0;
+	for (int c = 0; c < UGPU_CATEGORY_COUNT; c++)
+		leaked += gLive[c].size();
+	if (leaked == 0)
+		cout << "INFO: gpu resources: no leaks (" << gCreated[UGPU_BUFFER] << " buffers, " << gCreated[UGPU_TEXTURE] << " textures, "
+			<< gCreated[UGPU_VERTEX_ARRAY] << " vertex arrays, " << gCreated[UGPU_PROGRAM] << " programs, " << gCreated[UGPU_FRAMEBUFFER]
+			<< " framebuffers created, peak " << gPeakBytes / 1024 << " KB)" << endl;
+	else
+	{
+		cout << "WARNING: gpu resources: " << leaked << " objects (" << UTotalBytes() / 1024 << " KB) still alive at shutdown:" << endl;
+		for (int c = 0; c < UGPU_CATEGORY_COUNT; c++)
+			for (const auto& live : gLive[c])
+				cout << "WARNING:   " << CATEGORY_NAMES[c] << " " << live.first << " \"" << live.second.label << "\" " << live.second.bytes << " bytes" << endl;
+	}
+
+	//the context is about to go, handles that outlive this only forget their ids
+	for (int c = 0; c < UGPU_CATEGORY_COUNT; c++)
+	{
+		gLive[c].clear();
+		gBytes[c] = 0;
+	}
+	gClosed = true;
+}
+
+GLuint UGpuCreate(UGpuCategory category, const char* label)
+{
+	GLuint id = 0;
+	switch (category)
+	{
+	case UGPU_BUFFER: glGenBuffers(1, &id); break;
+	case UGPU_TEXTURE: glGenTextures(1, &id); break;
+	case UGPU_VERTEX_ARRAY: glGenVertexArrays(1, &id); break;
+	case UGPU_PROGRAM: id = glCreateProgram(); break;
+	case UGPU_FRAMEBUFFER: glGenFramebuffers(1, &id); break;
+	default: break;
+	}
+	UGpuTrack(category, id, label);
+	return id;
+}
+
+void UGpuDestroy(UGpuCategory category, GLuint id)
+{
+	//after the shutdown or without a context (globals torn down on an error exit) there is nothing to delete
+	if (gClosed || glfwGetCurrentContext() == nullptr)
+		return;
+	UGpuUntrack(category, id);
+	UDeleteObject(category, id);
+}
+
+void UGpuTrack(UGpuCategory category, GLuint id, const char* label)
+{
+	if (id == 0)
+		return;
+	lock_guard<mutex> guard(gLock);
+	Entry& entry = gLive[category][id];
+	gBytes[category] -= entry.bytes;
+	entry.label = label != nullptr ? label : "";
+	entry.bytes = 0;
+	gCreated[category]++;
+}
+
+void UGpuUntrack(UGpuCategory category, GLuint id)
+{
+	lock_guard<mutex> guard(gLock);
+	auto found = gLive[category].find(id);
+	if (found == gLive[category].end())
+		return;
+	gBytes[category] -= found->second.bytes;
+	gLive[category].erase(found);
+}
+
+void UGpuSetBytes(UGpuCategory category, GLuint id, size_t bytes)
+{
+	lock_guard<mutex> guard(gLock);
+	auto found = gLive[category].find(id);
+	if (found == gLive[category].end())
+		return;
+	gBytes[category] += bytes - found->second.bytes;
+	found->second.bytes = bytes;
+	gPeakBytes = std::max(gPeakBytes, UTotalBytes());
+}
+
+size_t UGpuTextureBytes(int width, int height, int bytesPerTexel, bool mipmapped)
+{
+	size_t bytes = (size_t)width * height * bytesPerTexel;
+	return mipmapped ? bytes + bytes / 3 : bytes;
+}
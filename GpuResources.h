@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstddef>
+
+#include <GL/glew.h>
+
+//GPU RESOURCE REGISTRY ============================================================================================================================
+//
+// --gpu-memory [frames]   print the live gpu objects and bytes per category every <frames> frames (default 600) and at exit
+//
+// buffers, textures, vertex arrays, programs and framebuffers are owned through UGpuHandle (deleted when the handle is
+// reset or destroyed, moved but never copied), and every handle is registered with the label it was created with and
+// the bytes its owner reports after uploading (buffer data, texture levels). the registry knows the live count and bytes
+// per category at any time (UGpuResourcesReport, "gpu memory KB" trace counter), and at shutdown everything still
+// registered is listed as a leak with its label. the bytes are what was asked for, the driver's padding and mip tails
+// aren't known. the async shader builds create and delete their programs on the compile worker through UGpuCreate and
+// UGpuDestroy (the registry is locked), UGpuTrack/UGpuUntrack are only for objects made by other gl calls.
+
+enum UGpuCategory
+{
+	UGPU_BUFFER,
+	UGPU_TEXTURE,
+	UGPU_VERTEX_ARRAY,
+	UGPU_PROGRAM,
+	UGPU_FRAMEBUFFER,
+	UGPU_CATEGORY_COUNT
+};
+
+struct UGpuResourcesConfig
+{
+	int reportFrames = 0;		//0 = only at exit
+};
+
+bool UParseGpuResourcesArgs(int argc, char* argv[], UGpuResourcesConfig& config);
+
+void UGpuResourcesInit(const UGpuResourcesConfig& config);
+//trace counter, and the periodic report with --gpu-memory
+void UGpuResourcesEndFrame();
+//live objects and bytes per category
+void UGpuResourcesReport();
+size_t UGpuResourcesLiveBytes();
+//lists what is still registered as leaked; handles destroyed after this (globals at exit) no longer touch GL
+void UGpuResourcesShutdown();
+
+//gl object of a category: created/deleted through the registry
+GLuint UGpuCreate(UGpuCategory category, const char* label);
+void UGpuDestroy(UGpuCategory category, GLuint id);
+//register/unregister an object created and deleted elsewhere
+void UGpuTrack(UGpuCategory category, GLuint id, const char* label);
+void UGpuUntrack(UGpuCategory category, GLuint id);
+void UGpuSetBytes(UGpuCategory category, GLuint id, size_t bytes);
+//bytes of a 2D texture (a full mip chain adds a third)
+size_t UGpuTextureBytes(int width, int height, int bytesPerTexel, bool mipmapped);
+
+//owning handle of one gl object (converts to the GLuint so it goes straight into gl calls)
+template <UGpuCategory C>
+struct UGpuHandle
+{
+	GLuint id = 0;
+
+	UGpuHandle() {}
+	~UGpuHandle() { Reset(); }
+	UGpuHandle(const UGpuHandle&) = delete;
+	UGpuHandle& operator=(const UGpuHandle&) = delete;
+	UGpuHandle(UGpuHandle&& other) noexcept : id(other.id) { other.id = 0; }
+	UGpuHandle& operator=(UGpuHandle&& other) noexcept
+	{
+		if (this != &other)
+		{
+			Reset();
+			id = other.id;
+			other.id = 0;
+		}
+		return *this;
+	}
+
+	operator GLuint() const { return id; }
+
+	//a new object (the old one is deleted first)
+	GLuint Create(const char* label)
+	{
+		Reset();
+		id = UGpuCreate(C, label);
+		return id;
+	}
+	void Reset()
+	{
+		if (id != 0)
+			UGpuDestroy(C, id);
+		id = 0;
+	}
+	void SetBytes(size_t bytes) const { UGpuSetBytes(C, id, bytes); }
+};
+
+typedef UGpuHandle<UGPU_BUFFER> UGpuBuffer;
+typedef UGpuHandle<UGPU_TEXTURE> UGpuTexture;
+typedef UGpuHandle<UGPU_VERTEX_ARRAY> UGpuVertexArray;
+typedef UGpuHandle<UGPU_PROGRAM> UGpuProgram;
+typedef UGpuHandle<UGPU_FRAMEBUFFER> UGpuFramebuffer;
@@ -0,0 +1,49 @@
+#include "Image.h"
+
+#include <cstdio>
+#include <iostream>
+
+using namespace std;
+
+bool UWritePPM(const char* file, int width, int height, int channels, const unsigned char* pixels)
+{
+	FILE* out = fopen(file, "wb");
+	if (!out)
+	{
+		cerr << "ERROR: could not write image " << file << endl;
+		return false;
+	}
+
+	fprintf(out, "P6\n%d %d\n255\n", width, height);
+	vector<unsigned char> row(width * 3);
+	for (int y = 0; y < height; y++)
+	{
+		const unsigned char* source = pixels + (size_t)y * width * channels;
+		for (int x = 0; x < width; x++)
+		{
+			row[x * 3 + 0] = source[x * channels + 0];
+			row[x * 3 + 1] = source[x * channels + (channels > 1 ? 1 : 0)];
+			row[x * 3 + 2] = source[x * channels + (channels > 2 ? 2 : 0)];
+		}
+		fwrite(row.data(), 1, row.size(), out);
+	}
+	fclose(out);
+	return true;
+}
+
+bool UWritePFM(const char* file, int width, int height, const float* rgb)
+{
+	FILE* out = fopen(file, "wb");
+	if (!out)
+	{
+		cerr << "ERROR: could not write image " << file << endl;
+		return false;
+	}
+
+	//pfm stores rows bottom to top, negative scale = little endian
+	fprintf(out, "PF\n%d %d\n-1.0\n", width, height);
+	for (int y = height - 1; y >= 0; y--)
+		fwrite(rgb + (size_t)y * width * 3, sizeof(float), (size_t)width * 3, out);
+	fclose(out);
+	return true;
+}
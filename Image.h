@@ -0,0 +1,19 @@
+#pragma once
+
+#include <vector>
+
+//CPU IMAGES =======================================================================================================================================
+
+//decoded image kept on the cpu (rows top to bottom, exactly as stb_image returns them)
+struct UImage
+{
+	int width = 0;
+	int height = 0;
+	int channels = 0;
+	std::vector<unsigned char> pixels;
+};
+
+//write 8 bit rgb / rgba pixels as a binary ppm (alpha is dropped), rows top to bottom
+bool UWritePPM(const char* file, int width, int height, int channels, const unsigned char* pixels);
+//write linear float rgb as a pfm (lossless, for diffing renders)
+bool UWritePFM(const char* file, int width, int height, const float* rgb);
@@ -0,0 +1,192 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "FrameArena.h"
+#include "Trace.h"
+
+using namespace std;
+
+namespace
+{
+	struct Job
+	{
+		const function<void(int, int, int)>* fn;
+		int begin;
+		int end;
+		atomic<int>* remaining;
+	};
+
+	//ring buffer of jobs (owner pushes and pops at the back, thieves take the front). it only ever grows, so once it has
+	//held a frame's worth of jobs pushing doesn't touch the heap again
+	struct JobQueue
+	{
+		mutex lock;
+		vector<Job> slots = vector<Job>(64);
+		size_t head = 0;
+		size_t count = 0;
+	};
+
+	void UPushJob(JobQueue& queue, const Job& job)
+	{
+		if (queue.count == queue.slots.size())
+		{
+			vector<Job> grown(queue.slots.size() * 2);
+			for (size_t i = 0; i < queue.count; i++)
+				grown[i] = queue.slots[(queue.head + i) % queue.slots.size()];
+			queue.slots.swap(grown);
+			queue.head = 0;
+		}
+		queue.slots[(queue.head + queue.count) % queue.slots.size()] = job;
+		queue.count++;
+	}
+
+	vector<thread> workers;
+	vector<JobQueue*> queues;			//queues[0] belongs to whichever thread calls UParallelFor from outside the pool
+	atomic<int> queuedJobs(0);
+	atomic<bool> quit(false);
+	mutex sleepLock;
+	condition_variable wake;
+	thread_local int workerIndex = 0;
+
+	bool UPopJob(int self, Job& job)
+	{
+		//own queue first (newest job, still warm in cache)
+		{
+			JobQueue& own = *queues[self];
+			lock_guard<mutex> guard(own.lock);
+			if (own.count > 0)
+			{
+				own.count--;
+				job = own.slots[(own.head + own.count) % own.slots.size()];
+				queuedJobs--;
+				return true;
+			}
+		}
+
+		//steal the oldest job from somebody else
+		int count = (int)queues.size();
+		for (int offset = 1; offset < count; offset++)
+		{
+			JobQueue& victim = *queues[(self + offset) % count];
+			lock_guard<mutex> guard(victim.lock);
+			if (victim.count > 0)
+			{
+				job = victim.slots[victim.head];
+				victim.head = (victim.head + 1) % victim.slots.size();
+				victim.count--;
+				queuedJobs--;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void URunJob(const Job& job, int self)
+	{
+		(*job.fn)(job.begin, job.end, self);
+		job.remaining->fetch_sub(1, memory_order_acq_rel);
+	}
+
+	void UWorkerLoop(int self)
+	{
+		workerIndex = self;
+		UTraceThreadName("job worker");
+		UAllocTrackThisThread();
+
+		while (!quit)
+		{
+			Job job;
+			if (UPopJob(self, job))
+			{
+				URunJob(job, self);
+				continue;
+			}
+
+			unique_lock<mutex> guard(sleepLock);
+			wake.wait(guard, [] { return quit || queuedJobs > 0; });
+		}
+	}
+}
+
+void UJobsInit(int threadCount)
+{
+	if (!queues.empty())
+		return;
+
+	if (threadCount <= 0)
+		threadCount = std::max(1, (int)thread::hardware_concurrency());
+
+	quit = false;
+	for (int i = 0; i < threadCount; i++)
+		queues.push_back(new JobQueue);
+	for (int i = 1; i < threadCount; i++)
+		workers.push_back(thread(UWorkerLoop, i));
+}
+
+void UJobsShutdown()
+{
+	{
+		lock_guard<mutex> guard(sleepLock);
+		quit = true;
+	}
+	wake.notify_all();
+	for (thread& worker : workers)
+		worker.join();
+	workers.clear();
+	for (JobQueue* queue : queues)
+		delete queue;
+	queues.clear();
+}
+
+int UJobsThreadCount()
+{
+	return queues.empty() ? 1 : (int)queues.size();
+}
+
+void UParallelFor(int count, int grain, const function<void(int begin, int end, int worker)>& fn)
+{
+	if (count <= 0)
+		return;
+	if (grain < 1)
+		grain = 1;
+
+	//no pool (or nothing to split): just run inline
+	if (queues.size() <= 1 || count <= grain)
+	{
+		fn(0, count, workerIndex);
+		return;
+	}
+
+	atomic<int> remaining((count + grain - 1) / grain);
+	{
+		JobQueue& own = *queues[workerIndex];
+		lock_guard<mutex> guard(own.lock);
+		for (int begin = 0; begin < count; begin += grain)
+		{
+			Job job = { &fn, begin, std::min(begin + grain, count), &remaining };
+			UPushJob(own, job);
+		}
+		queuedJobs += remaining.load();
+	}
+	{
+		//taking the sleep lock orders the notify after any worker that is about to wait
+		lock_guard<mutex> guard(sleepLock);
+	}
+	wake.notify_all();
+
+	//help out until every chunk of this loop is done
+	while (remaining.load(memory_order_acquire) > 0)
+	{
+		Job job;
+		if (UPopJob(workerIndex, job))
+			URunJob(job, workerIndex);
+		else
+			this_thread::yield();
+	}
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <functional>
+
+//WORK-STEALING JOB SYSTEM =========================================================================================================================
+//
+// one queue per thread (the thread that calls UParallelFor is queue 0). a thread takes work from the back of its own queue
+// and steals from the front of the others when it runs dry, so uneven jobs (e.g. busy screen tiles) balance out.
+// UParallelFor blocks until every chunk ran, and the calling thread works on chunks while it waits.
+
+void UJobsInit(int threadCount = 0);		//0 = one thread per hardware thread
+void UJobsShutdown();
+int UJobsThreadCount();						//worker threads + the calling thread, i.e. the range of the worker index
+
+//runs fn(begin, end, worker) over [0, count) in chunks of at most grain items (worker is in [0, UJobsThreadCount()))
+void UParallelFor(int count, int grain, const std::function<void(int begin, int end, int worker)>& fn);
@@ -0,0 +1,1062 @@
+#include "Lightmap.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <numeric>
+
+#include "GLStats.h"
+#include "Image.h"
+#include "JobSystem.h"
+#include "RayTracing.h"
+#include "SoftwareRasterizer.h"
+#include "Trace.h"
+
+using namespace std;
+
+namespace
+{
+	typedef chrono::steady_clock Clock;
+
+	const uint32_t LIGHTMAP_MAGIC = 0x504D4C55;		//"ULMP"
+	const uint32_t LIGHTMAP_VERSION = 1;
+	const int ATLAS_SIZE = 1024;
+	const int RECT_PADDING = 2;			//texels between two objects' rectangles
+	const int MIN_RECT_SIZE = 32;
+	const int MAX_RECT_SIZE = 512;
+	const int DILATE_PASSES = 4;		//texels grown out of the charts into the gaps (bilinear filtering reads them)
+	const float PLANAR_COSINE = 0.9f;	//triangles further than this from their chart's axis get stretched texels
+	const int LIGHTMAP_TEXTURE_UNIT = 26;
+	const int SHADOWMASK_TEXTURE_UNIT = 27;
+	const GLuint LIGHTMAP_UV_ATTRIBUTE = 5;
+	const uint32_t VERTEX_LIGHTING_MAGIC = 0x58564C55;	//"ULVX"
+	const uint32_t VERTEX_LIGHTING_VERSION = 1;
+
+	//file layout: header, objects, rgb floats (width * height * 3), shadowmask bytes (width * height * 2)
+	struct LightmapFileHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t width;
+		uint32_t height;
+		uint32_t objectCount;
+		uint32_t drawCount;			//draw list size it was baked for
+	};
+
+	struct LightmapFileObject
+	{
+		uint32_t item;				//index into the draw list
+		uint32_t vertexCount;		//of its mesh (the second uv set is regenerated from it)
+		float scaleOffset[4];		//mesh uv2 -> atlas uv
+	};
+
+	//file layout: header, vertex count of every draw (uint32_t[drawCount]), then rgba floats for each of their vertices in order
+	struct VertexLightingFileHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t drawCount;
+		uint32_t vertexCount;		//all draws together
+	};
+
+	//one static item's square of the atlas (texels)
+	struct BakeObject
+	{
+		int item;
+		float worldSide;			//side of its packed uv square in world units
+		int x, y, size;
+	};
+
+	//a point to bake: a texel of the rasterised charts or a vertex
+	struct BakePoint
+	{
+		glm::vec3 position;
+		glm::vec3 normal;			//interpolated vertex normal
+		glm::vec3 geometric;		//face normal on the same side (ray offsets)
+		glm::vec3 dx, dy;			//world step of one texel in x and y (sample jitter, 0 for vertices)
+		int index;					//atlas texel or vertex (also seeds the samples)
+	};
+
+	struct Light
+	{
+		glm::vec3 direction;	//towards the light
+		glm::vec3 diffuse;		//material.diffuse * light.diffuse (tinted for the second light)
+	};
+
+	struct BakeContext
+	{
+		const UBvh* bvh;
+		const vector<USoftTexture>* textures;
+		Light lights[2];
+		glm::vec3 environment;		//light.ambient * material.ambient, seen by bounce rays that leave the scene
+		glm::vec3 albedoScale;		//material.diffuse
+		int packets;
+		int bounces;
+	};
+
+	UGpuTexture gLightmapTexture;
+	UGpuTexture gShadowmaskTexture;
+	vector<UGpuBuffer> gUVBuffers;
+	deque<GLMesh> gVertexLitMeshes;		//a copy of its mesh per vertex lit draw (the colours differ between draws of one mesh)
+
+	//UNWRAP =======================================================================================================================================
+
+	int URoot(vector<int>& parent, int i)
+	{
+		while (parent[i] != i)
+			i = parent[i] = parent[parent[i]];
+		return i;
+	}
+
+	//shelf packing: tallest first, left to right, a new shelf when a row is full; returns the packed extent
+	glm::vec2 UShelfPack(const vector<glm::vec2>& sizes, float width, float gap, vector<glm::vec2>& positions)
+	{
+		vector<int> order(sizes.size());
+		iota(order.begin(), order.end(), 0);
+		stable_sort(order.begin(), order.end(), [&](int a, int b) { return sizes[a].y > sizes[b].y; });
+
+		positions.assign(sizes.size(), glm::vec2(0.0f));
+		glm::vec2 cursor(0.0f), extent(0.0f);
+		float shelfHeight = 0.0f;
+		for (int i : order)
+		{
+			if (cursor.x > 0.0f && cursor.x + sizes[i].x > width)
+			{
+				cursor = glm::vec2(0.0f, cursor.y + shelfHeight + gap);
+				shelfHeight = 0.0f;
+			}
+			positions[i] = cursor;
+			cursor.x += sizes[i].x + gap;
+			shelfHeight = std::max(shelfHeight, sizes[i].y);
+			extent = glm::max(extent, positions[i] + sizes[i]);
+		}
+		return extent;
+	}
+
+	//second uv set of a mesh (2 floats per vertex, 0-1), returns the side of the packed square in object units.
+	//only depends on the mesh, so the baker and the runtime get the same layout
+	float UUnwrap(const GLMesh& mesh, vector<float>& uvs, bool warn)
+	{
+		int vertexCount = (int)(mesh.vertices.size() / FLOATS_PER_MESH_VERTEX);
+		uvs.assign((size_t)vertexCount * 2, 0.0f);
+
+		//charts: triangles connected through shared vertices (a vertex has one uv, so they can't be cut apart)
+		vector<int> parent(vertexCount);
+		iota(parent.begin(), parent.end(), 0);
+		for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+		{
+			for (int k = 1; k < 3; k++)
+			{
+				int a = URoot(parent, mesh.indices[i]);
+				int b = URoot(parent, mesh.indices[i + k]);
+				if (a != b)
+					parent[b] = a;
+			}
+		}
+		map<int, int> chartOfRoot;
+		vector<glm::vec3> axes;
+		for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+		{
+			int root = URoot(parent, mesh.indices[i]);
+			if (chartOfRoot.count(root) == 0)
+			{
+				chartOfRoot[root] = (int)axes.size();
+				axes.push_back(glm::vec3(0.0f));
+			}
+		}
+
+		//each chart is projected along its area weighted normal (faces turned to agree with the vertex normals)
+		auto position = [&](int v) { const float* p = &mesh.vertices[(size_t)v * FLOATS_PER_MESH_VERTEX]; return glm::vec3(p[0], p[1], p[2]); };
+		auto normal = [&](int v) { const float* p = &mesh.vertices[(size_t)v * FLOATS_PER_MESH_VERTEX + MESH_NORMAL_OFFSET]; return glm::vec3(p[0], p[1], p[2]); };
+		vector<glm::vec3> faces;
+		for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+		{
+			int a = mesh.indices[i], b = mesh.indices[i + 1], c = mesh.indices[i + 2];
+			glm::vec3 face = glm::cross(position(b) - position(a), position(c) - position(a));
+			if (glm::dot(face, normal(a) + normal(b) + normal(c)) < 0.0f)
+				face = -face;
+			faces.push_back(face);
+			axes[chartOfRoot[URoot(parent, a)]] += face;
+		}
+		bool planar = true;
+		for (size_t t = 0; t < faces.size(); t++)
+		{
+			glm::vec3& axis = axes[chartOfRoot[URoot(parent, mesh.indices[t * 3])]];
+			float length = glm::length(faces[t]);
+			if (length > 0.0f && glm::length(axis) > 0.0f && glm::dot(faces[t] / length, glm::normalize(axis)) < PLANAR_COSINE)
+				planar = false;
+		}
+		if (!planar && warn)
+			cout << "WARNING: lightmap unwrap: a chart of a " << vertexCount << " vertex mesh isn't planar, its texels are stretched" << endl;
+
+		//chart bounds in their own plane
+		int chartCount = (int)axes.size();
+		vector<glm::vec3> tangents(chartCount), bitangents(chartCount);
+		vector<glm::vec2> boundsMin(chartCount, glm::vec2(1e30f)), boundsMax(chartCount, glm::vec2(-1e30f));
+		for (int c = 0; c < chartCount; c++)
+		{
+			glm::vec3 axis = glm::length(axes[c]) > 0.0f ? glm::normalize(axes[c]) : glm::vec3(0.0f, 0.0f, 1.0f);
+			glm::vec3 helper = fabs(axis.x) > 0.5f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+			tangents[c] = glm::normalize(glm::cross(helper, axis));
+			bitangents[c] = glm::cross(axis, tangents[c]);
+		}
+		vector<int> chartOfVertex(vertexCount, -1);
+		for (size_t i = 0; i < mesh.indices.size(); i++)
+		{
+			int v = mesh.indices[i];
+			int c = chartOfRoot[URoot(parent, v)];
+			chartOfVertex[v] = c;
+			glm::vec2 p(glm::dot(position(v), tangents[c]), glm::dot(position(v), bitangents[c]));
+			boundsMin[c] = glm::min(boundsMin[c], p);
+			boundsMax[c] = glm::max(boundsMax[c], p);
+		}
+
+		//pack once to see how big it gets, then again with a gap of 1/16 of that between the charts (and around them)
+		vector<glm::vec2> sizes(chartCount), positions;
+		float area = 0.0f, widest = 0.0f;
+		for (int c = 0; c < chartCount; c++)
+		{
+			sizes[c] = boundsMax[c] - boundsMin[c];
+			area += sizes[c].x * sizes[c].y;
+			widest = std::max(widest, sizes[c].x);
+		}
+		glm::vec2 extent = UShelfPack(sizes, std::max(widest, sqrt(area)), 0.0f, positions);
+		float gap = std::max(extent.x, extent.y) / 16.0f;
+		area = 0.0f;
+		for (int c = 0; c < chartCount; c++)
+			area += (sizes[c].x + gap) * (sizes[c].y + gap);
+		extent = UShelfPack(sizes, std::max(widest, sqrt(area)), gap, positions);
+		float side = std::max(extent.x, extent.y) + gap;
+		if (side <= 0.0f)
+			return 0.0f;
+
+		for (int v = 0; v < vertexCount; v++)
+		{
+			int c = chartOfVertex[v];
+			if (c < 0)
+				continue;
+			glm::vec2 p(glm::dot(position(v), tangents[c]), glm::dot(position(v), bitangents[c]));
+			glm::vec2 uv = (positions[c] + (p - boundsMin[c]) + glm::vec2(gap * 0.5f)) / side;
+			uvs[(size_t)v * 2] = uv.x;
+			uvs[(size_t)v * 2 + 1] = uv.y;
+		}
+		return side;
+	}
+
+	float UMeshArea(const GLMesh& mesh, const glm::mat4& model)
+	{
+		float area = 0.0f;
+		for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+		{
+			glm::vec3 p[3];
+			for (int k = 0; k < 3; k++)
+			{
+				const float* v = &mesh.vertices[(size_t)mesh.indices[i + k] * FLOATS_PER_MESH_VERTEX];
+				p[k] = glm::vec3(model * glm::vec4(v[0], v[1], v[2], 1.0f));
+			}
+			area += 0.5f * glm::length(glm::cross(p[1] - p[0], p[2] - p[0]));
+		}
+		return area;
+	}
+
+	//squares for every object at density texels per unit (lowered until they fit the atlas width), returns the atlas height
+	int ULayoutAtlas(vector<BakeObject>& objects, float& density)
+	{
+		for (int attempt = 0; attempt < 64; attempt++)
+		{
+			vector<glm::vec2> sizes(objects.size()), positions;
+			for (size_t i = 0; i < objects.size(); i++)
+			{
+				int size = std::min(std::max((int)ceil(objects[i].worldSide * density), MIN_RECT_SIZE), MAX_RECT_SIZE);
+				sizes[i] = glm::vec2((float)size);
+			}
+			glm::vec2 extent = UShelfPack(sizes, (float)(ATLAS_SIZE - 2 * RECT_PADDING), (float)RECT_PADDING, positions);
+			if (extent.y <= ATLAS_SIZE - 2 * RECT_PADDING)
+			{
+				for (size_t i = 0; i < objects.size(); i++)
+				{
+					objects[i].x = (int)positions[i].x + RECT_PADDING;
+					objects[i].y = (int)positions[i].y + RECT_PADDING;
+					objects[i].size = (int)sizes[i].x;
+				}
+				//only as tall as it needs to be (rows of 4 texels)
+				return std::min(ATLAS_SIZE, ((int)extent.y + 2 * RECT_PADDING + 3) / 4 * 4);
+			}
+			density *= 0.8f;
+		}
+		return 0;
+	}
+
+	//BAKE =========================================================================================================================================
+
+	//texels covered by one object's triangles (texel centres inside a triangle in the object's square of the atlas)
+	void URasteriseObject(const BakeObject& object, const UDrawItem& item, const glm::mat4& model, const vector<float>& uvs, int atlasWidth,
+		vector<int>& texelOf, vector<BakePoint>& texels)
+	{
+		const GLMesh& mesh = *item.mesh;
+		glm::mat3 normalMatrix = glm::mat3(glm::transpose(glm::inverse(model)));
+		for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+		{
+			glm::vec2 t[3];
+			glm::vec3 p[3], n[3];
+			for (int k = 0; k < 3; k++)
+			{
+				int index = mesh.indices[i + k];
+				const float* v = &mesh.vertices[(size_t)index * FLOATS_PER_MESH_VERTEX];
+				t[k] = glm::vec2(uvs[(size_t)index * 2], uvs[(size_t)index * 2 + 1]) * (float)object.size + glm::vec2((float)object.x, (float)object.y);
+				p[k] = glm::vec3(model * glm::vec4(v[0], v[1], v[2], 1.0f));
+				n[k] = normalMatrix * glm::vec3(v[MESH_NORMAL_OFFSET], v[MESH_NORMAL_OFFSET + 1], v[MESH_NORMAL_OFFSET + 2]);
+			}
+			glm::vec2 e1 = t[1] - t[0], e2 = t[2] - t[0];
+			float det = e1.x * e2.y - e1.y * e2.x;
+			if (fabs(det) < 1e-12f)
+				continue;
+			glm::vec3 geometric = glm::cross(p[1] - p[0], p[2] - p[0]);
+			if (glm::dot(geometric, geometric) <= 0.0f)
+				continue;
+			geometric = glm::normalize(geometric);
+			if (glm::dot(geometric, n[0] + n[1] + n[2]) < 0.0f)
+				geometric = -geometric;
+
+			//barycentrics are affine in texel space, so one texel step is a constant world step
+			glm::vec3 dx = (p[1] - p[0]) * (e2.y / det) + (p[2] - p[0]) * (-e1.y / det);
+			glm::vec3 dy = (p[1] - p[0]) * (-e2.x / det) + (p[2] - p[0]) * (e1.x / det);
+
+			int x0 = std::max((int)floor(std::min(t[0].x, std::min(t[1].x, t[2].x))), object.x);
+			int x1 = std::min((int)ceil(std::max(t[0].x, std::max(t[1].x, t[2].x))), object.x + object.size - 1);
+			int y0 = std::max((int)floor(std::min(t[0].y, std::min(t[1].y, t[2].y))), object.y);
+			int y1 = std::min((int)ceil(std::max(t[0].y, std::max(t[1].y, t[2].y))), object.y + object.size - 1);
+			for (int y = y0; y <= y1; y++)
+			{
+				for (int x = x0; x <= x1; x++)
+				{
+					glm::vec2 d = glm::vec2(x + 0.5f, y + 0.5f) - t[0];
+					float b = (d.x * e2.y - d.y * e2.x) / det;
+					float c = (e1.x * d.y - e1.y * d.x) / det;
+					float a = 1.0f - b - c;
+					if (a < -1e-5f || b < -1e-5f || c < -1e-5f)
+						continue;
+					int index = y * atlasWidth + x;
+					if (texelOf[index] >= 0)
+						continue;
+					BakePoint texel;
+					texel.position = p[0] * a + p[1] * b + p[2] * c;
+					texel.normal = n[0] * a + n[1] * b + n[2] * c;
+					texel.normal = glm::dot(texel.normal, texel.normal) > 0.0f ? glm::normalize(texel.normal) : geometric;
+					texel.geometric = geometric;
+					texel.dx = dx;
+					texel.dy = dy;
+					texel.index = index;
+					texelOf[index] = (int)texels.size();
+					texels.push_back(texel);
+				}
+			}
+		}
+	}
+
+	void UMakeBakeContext(const ULightmapConfig& config, const USceneLighting& lighting, const UBvh& bvh, const vector<USoftTexture>& textures,
+		BakeContext& k)
+	{
+		k.bvh = &bvh;
+		k.textures = &textures;
+		k.lights[0].direction = glm::normalize(-lighting.direction);
+		k.lights[0].diffuse = lighting.materialDiffuse * lighting.diffuse;
+		k.lights[1].direction = glm::normalize(-lighting.direction2);
+		k.lights[1].diffuse = lighting.materialDiffuse * (lighting.tint2 * lighting.diffuse);
+		k.environment = lighting.ambient * lighting.materialAmbient;
+		k.albedoScale = lighting.materialDiffuse;
+		k.packets = (config.samples + USIMD_WIDTH - 1) / USIMD_WIDTH;
+		k.bounces = config.bounces;
+	}
+
+	//shadow rays towards light l for the active lanes, returns the unblocked ones
+	void UTraceShadows(const BakeContext& k, int l, const URayLane lanes[USIMD_WIDTH], bool unblocked[USIMD_WIDTH], uint64_t& rays)
+	{
+		URayLane shadow[USIMD_WIDTH];
+		for (int i = 0; i < USIMD_WIDTH; i++)
+		{
+			shadow[i].origin = lanes[i].origin;
+			shadow[i].direction = k.lights[l].direction;
+			shadow[i].active = lanes[i].active;
+			unblocked[i] = false;
+		}
+		URayPacket packet;
+		UMakePacket(shadow, 1e30f, packet);
+		if (!USimdMask(packet.active))
+			return;
+		int32_t blocker[USIMD_WIDTH];
+		UTracePacket(*k.bvh, packet, true, blocker, nullptr, nullptr);
+		for (int i = 0; i < USIMD_WIDTH; i++)
+		{
+			if (!shadow[i].active)
+				continue;
+			rays++;
+			unblocked[i] = blocker[i] < 0;
+		}
+	}
+
+	//every sample of one point, 8 at a time: irradiance without the point's own albedo (the runtime multiplies it in), the
+	//fraction of samples each light reaches and of first bounces that leave the scene (1 without bounces); returns the rays traced
+	uint64_t UBakePoint(const BakeContext& k, const BakePoint& point, glm::vec3& irradiance, glm::vec2& visibility, float& openness)
+	{
+		uint64_t rays = 0;
+		glm::vec3 bounced(0.0f);
+		float visible[2] = { 0.0f, 0.0f };
+		float open = 0.0f;
+		float nDotL[2] = { glm::dot(point.normal, k.lights[0].direction), glm::dot(point.normal, k.lights[1].direction) };
+
+		for (int p = 0; p < k.packets; p++)
+		{
+			URayLane lanes[USIMD_WIDTH];
+			glm::vec3 throughput[USIMD_WIDTH];
+			uint32_t rng[USIMD_WIDTH];
+			for (int i = 0; i < USIMD_WIDTH; i++)
+			{
+				rng[i] = UHash((uint32_t)point.index ^ UHash((uint32_t)(p * USIMD_WIDTH + i) * 0x9E3779B9u));
+				glm::vec3 position = point.position + point.dx * (URandom(rng[i]) - 0.5f) + point.dy * (URandom(rng[i]) - 0.5f);
+				lanes[i].origin = position + point.geometric * URAY_EPSILON;
+				lanes[i].active = true;
+			}
+
+			//direct light on the point (shadowed)
+			for (int l = 0; l < 2; l++)
+			{
+				if (nDotL[l] <= 0.0f)
+					continue;
+				bool unblocked[USIMD_WIDTH];
+				UTraceShadows(k, l, lanes, unblocked, rays);
+				for (int i = 0; i < USIMD_WIDTH; i++)
+					visible[l] += unblocked[i] ? 1.0f : 0.0f;
+			}
+
+			//diffuse bounces: the environment where they leave, the lit surfaces where they hit
+			for (int i = 0; i < USIMD_WIDTH; i++)
+			{
+				throughput[i] = k.albedoScale;
+				lanes[i].direction = USampleHemisphere(point.normal, URandom(rng[i]), URandom(rng[i]));
+				lanes[i].active = k.bounces > 0;
+			}
+			for (int bounce = 0; bounce < k.bounces; bounce++)
+			{
+				URayPacket packet;
+				UMakePacket(lanes, 1e30f, packet);
+				if (!USimdMask(packet.active))
+					break;
+				int32_t triangle[USIMD_WIDTH];
+				float u[USIMD_WIDTH], v[USIMD_WIDTH];
+				UTracePacket(*k.bvh, packet, false, triangle, u, v);
+
+				glm::vec3 normals[USIMD_WIDTH], albedos[USIMD_WIDTH];
+				for (int i = 0; i < USIMD_WIDTH; i++)
+				{
+					if (!lanes[i].active)
+						continue;
+					rays++;
+					if (triangle[i] < 0)
+					{
+						bounced += throughput[i] * k.environment;
+						open += bounce == 0 ? 1.0f : 0.0f;
+						lanes[i].active = false;
+						continue;
+					}
+
+					//same two sided shading as the path tracer
+					const URayTriangle& tri = k.bvh->triangles[triangle[i]];
+					const URayShading& shade = k.bvh->shading[triangle[i]];
+					float w = 1.0f - u[i] - v[i];
+					glm::vec3 geometric = glm::normalize(glm::cross(tri.e1, tri.e2));
+					if (glm::dot(geometric, lanes[i].direction) > 0.0f)
+						geometric = -geometric;
+					glm::vec3 normal = shade.normal[0] * w + shade.normal[1] * u[i] + shade.normal[2] * v[i];
+					normal = glm::dot(normal, normal) > 0.0f ? glm::normalize(normal) : geometric;
+					if (glm::dot(normal, geometric) < 0.0f)
+						normal = -normal;
+					glm::vec2 uv = shade.uv[0] * w + shade.uv[1] * u[i] + shade.uv[2] * v[i];
+					normals[i] = normal;
+					albedos[i] = shade.texture >= 0 && shade.texture < (int)k.textures->size() ? USampleTexture((*k.textures)[shade.texture], uv) : glm::vec3(1.0f);
+					lanes[i].origin = tri.v0 + tri.e1 * u[i] + tri.e2 * v[i] + geometric * URAY_EPSILON;
+				}
+
+				for (int l = 0; l < 2; l++)
+				{
+					URayLane lit[USIMD_WIDTH];
+					for (int i = 0; i < USIMD_WIDTH; i++)
+					{
+						lit[i] = lanes[i];
+						lit[i].active = lanes[i].active && glm::dot(normals[i], k.lights[l].direction) > 0.0f;
+					}
+					bool unblocked[USIMD_WIDTH];
+					UTraceShadows(k, l, lit, unblocked, rays);
+					for (int i = 0; i < USIMD_WIDTH; i++)
+						if (unblocked[i])
+							bounced += throughput[i] * albedos[i] * k.lights[l].diffuse * glm::dot(normals[i], k.lights[l].direction);
+				}
+
+				for (int i = 0; i < USIMD_WIDTH; i++)
+				{
+					if (!lanes[i].active)
+						continue;
+					if (bounce + 1 < k.bounces)
+					{
+						throughput[i] *= albedos[i] * k.albedoScale;
+						lanes[i].direction = USampleHemisphere(normals[i], URandom(rng[i]), URandom(rng[i]));
+					}
+					else
+						lanes[i].active = false;
+				}
+			}
+		}
+
+		float samples = (float)(k.packets * USIMD_WIDTH);
+		irradiance = bounced / samples;
+		openness = k.bounces > 0 ? open / samples : 1.0f;
+		for (int l = 0; l < 2; l++)
+		{
+			visibility[l] = nDotL[l] > 0.0f ? visible[l] / samples : 0.0f;
+			irradiance += k.lights[l].diffuse * (std::max(nDotL[l], 0.0f) * visibility[l]);
+		}
+		return rays;
+	}
+
+	//grow the baked texels into their uncovered neighbours (chart gaps are read by bilinear filtering)
+	void UDilate(int width, int height, vector<glm::vec3>& rgb, vector<glm::vec2>& mask, vector<char>& covered)
+	{
+		for (int pass = 0; pass < DILATE_PASSES; pass++)
+		{
+			vector<char> next = covered;
+			for (int y = 0; y < height; y++)
+			{
+				for (int x = 0; x < width; x++)
+				{
+					int index = y * width + x;
+					if (covered[index])
+						continue;
+					glm::vec3 sum(0.0f);
+					glm::vec2 sumMask(0.0f);
+					int count = 0;
+					for (int dy = -1; dy <= 1; dy++)
+					{
+						for (int dx = -1; dx <= 1; dx++)
+						{
+							int nx = x + dx, ny = y + dy;
+							if (nx < 0 || ny < 0 || nx >= width || ny >= height || !covered[ny * width + nx])
+								continue;
+							sum += rgb[ny * width + nx];
+							sumMask += mask[ny * width + nx];
+							count++;
+						}
+					}
+					if (count == 0)
+						continue;
+					rgb[index] = sum / (float)count;
+					mask[index] = sumMask / (float)count;
+					next[index] = 1;
+				}
+			}
+			covered.swap(next);
+		}
+	}
+
+	bool UWriteLightmap(const string& file, int width, int height, const vector<LightmapFileObject>& objects, size_t drawCount,
+		const vector<glm::vec3>& rgb, const vector<glm::vec2>& mask)
+	{
+		LightmapFileHeader header = { LIGHTMAP_MAGIC, LIGHTMAP_VERSION, (uint32_t)width, (uint32_t)height, (uint32_t)objects.size(), (uint32_t)drawCount };
+		vector<float> floats((size_t)width * height * 3);
+		vector<unsigned char> maskBytes((size_t)width * height * 2);
+		vector<unsigned char> preview((size_t)width * height * 3);
+		for (size_t p = 0; p < rgb.size(); p++)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				floats[p * 3 + c] = rgb[p][c];
+				preview[p * 3 + c] = (unsigned char)(std::min(std::max(rgb[p][c], 0.0f), 1.0f) * 255.0f + 0.5f);
+			}
+			for (int c = 0; c < 2; c++)
+				maskBytes[p * 2 + c] = (unsigned char)(std::min(std::max(mask[p][c], 0.0f), 1.0f) * 255.0f + 0.5f);
+		}
+
+		ofstream out(file.c_str(), ios::binary);
+		if (!out || !out.write((const char*)&header, sizeof(header)) || !out.write((const char*)objects.data(), objects.size() * sizeof(LightmapFileObject))
+			|| !out.write((const char*)floats.data(), floats.size() * sizeof(float)) || !out.write((const char*)maskBytes.data(), maskBytes.size()))
+		{
+			cerr << "ERROR: could not write " << file << endl;
+			return false;
+		}
+		UWritePPM((file + ".ppm").c_str(), width, height, 3, preview.data());
+		return true;
+	}
+}
+
+//SETUP ============================================================================================================================================
+
+bool UParseLightmapArgs(int argc, char* argv[], ULightmapConfig& config)
+{
+	bool settings = false;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--bake-lightmap") == 0 || strcmp(argv[i], "--lightmap") == 0)
+		{
+			if (strcmp(argv[i], "--bake-lightmap") == 0)
+				config.bake = true;
+			else
+				config.load = true;
+			if (i + 1 < argc && argv[i + 1][0] != '-')
+				config.file = argv[++i];
+		}
+		else if (strcmp(argv[i], "--bake-vertex-lighting") == 0 || strcmp(argv[i], "--vertex-lighting") == 0)
+		{
+			if (strcmp(argv[i], "--bake-vertex-lighting") == 0)
+				config.bakeVertices = true;
+			else
+				config.loadVertices = true;
+			if (i + 1 < argc && argv[i + 1][0] != '-')
+				config.vertexFile = argv[++i];
+		}
+		else if (strcmp(argv[i], "--bake-samples") == 0 || strcmp(argv[i], "--bake-bounces") == 0 || strcmp(argv[i], "--bake-density") == 0
+			|| strcmp(argv[i], "--bake-threads") == 0)
+		{
+			if (i + 1 >= argc)
+			{
+				cerr << "ERROR: " << argv[i] << " needs a value" << endl;
+				return false;
+			}
+			settings = true;
+			if (strcmp(argv[i], "--bake-samples") == 0)
+				config.samples = std::max(1, atoi(argv[i + 1]));
+			else if (strcmp(argv[i], "--bake-bounces") == 0)
+				config.bounces = std::max(0, atoi(argv[i + 1]));
+			else if (strcmp(argv[i], "--bake-density") == 0)
+			{
+				config.density = (float)atof(argv[i + 1]);
+				if (config.density <= 0.0f)
+				{
+					cerr << "ERROR: --bake-density needs texels per unit above 0" << endl;
+					return false;
+				}
+			}
+			else
+				config.threads = atoi(argv[i + 1]);
+			i++;
+		}
+	}
+	//bake settings on their own bake the lightmap
+	if (settings && !config.bakeVertices)
+		config.bake = true;
+	return true;
+}
+
+//BAKE MODE ========================================================================================================================================
+
+int URunLightmapBaker(const ULightmapConfig& config, const std::vector<UDrawItem>& items, const USceneGraph& scene, const std::vector<USceneTexture>& textures,
+	const USceneLighting& lighting)
+{
+	UTRACE_SCOPE("bake lightmap");
+	Clock::time_point bakeStart = Clock::now();
+	UJobsInit(config.threads);
+
+	//unwrap every mesh a static item uses and give the items their squares
+	map<const GLMesh*, vector<float>> uvs;
+	map<const GLMesh*, float> sides;
+	vector<BakeObject> objects;
+	vector<UDrawItem> statics;
+	for (size_t i = 0; i < items.size(); i++)
+	{
+		const UDrawItem& item = items[i];
+		if (!item.isStatic)
+			continue;
+		statics.push_back(item);
+		if (uvs.count(item.mesh) == 0)
+			sides[item.mesh] = UUnwrap(*item.mesh, uvs[item.mesh], true);
+		float objectArea = UMeshArea(*item.mesh, glm::mat4(1.0f));
+		float worldArea = UMeshArea(*item.mesh, scene.world[item.node]);
+		if (objectArea <= 0.0f || sides[item.mesh] <= 0.0f)
+			continue;
+		objects.push_back({ (int)i, sides[item.mesh] * sqrt(worldArea / objectArea), 0, 0, 0 });
+	}
+	if (objects.empty())
+	{
+		cerr << "ERROR: nothing to bake, no draw item is static (scene file \"static\": true)" << endl;
+		UJobsShutdown();
+		return EXIT_FAILURE;
+	}
+	float density = config.density;
+	int width = ATLAS_SIZE;
+	int height = ULayoutAtlas(objects, density);
+	if (height == 0)
+	{
+		cerr << "ERROR: " << objects.size() << " objects don't fit a " << ATLAS_SIZE << " lightmap" << endl;
+		UJobsShutdown();
+		return EXIT_FAILURE;
+	}
+	if (density < config.density)
+		cout << "WARNING: lightmap density lowered to " << density << " texels per unit to fit the atlas" << endl;
+	double layoutMs = chrono::duration<double, milli>(Clock::now() - bakeStart).count();
+
+	//texels of every object (world position and normal)
+	Clock::time_point start = Clock::now();
+	vector<int> texelOf((size_t)width * height, -1);
+	vector<BakePoint> texels;
+	for (const BakeObject& object : objects)
+	{
+		const UDrawItem& item = items[object.item];
+		URasteriseObject(object, item, scene.world[item.node], uvs[item.mesh], width, texelOf, texels);
+	}
+	double rasteriseMs = chrono::duration<double, milli>(Clock::now() - start).count();
+
+	//moving objects would leave their shadows behind, so only the static ones block and bounce light
+	start = Clock::now();
+	UBvh bvh;
+	UBuildBvh(statics, scene, bvh);
+	vector<USoftTexture> soft;
+	UPrepareSoftTextures(textures, soft);
+	double bvhMs = chrono::duration<double, milli>(Clock::now() - start).count();
+
+	BakeContext k;
+	UMakeBakeContext(config, lighting, bvh, soft, k);
+
+	cout << "INFO: baking " << objects.size() << " static objects into a " << width << "x" << height << " lightmap (" << texels.size() << " texels, "
+		<< density << " per unit), " << k.packets * USIMD_WIDTH << " samples, " << k.bounces << " bounces, " << bvh.triangles.size() << " occluder triangles, "
+		<< UJobsThreadCount() << " threads" << endl;
+
+	//one job per run of texels, each texel is written by exactly one job
+	start = Clock::now();
+	vector<glm::vec3> rgb((size_t)width * height, glm::vec3(0.0f));
+	vector<glm::vec2> mask((size_t)width * height, glm::vec2(0.0f));
+	atomic<uint64_t> rays(0);
+	{
+		UTRACE_SCOPE("trace texels");
+		UParallelFor((int)texels.size(), 64, [&](int begin, int end, int)
+		{
+			uint64_t traced = 0;
+			for (int t = begin; t < end; t++)
+			{
+				glm::vec3 irradiance;
+				glm::vec2 visibility;
+				float openness;
+				traced += UBakePoint(k, texels[t], irradiance, visibility, openness);
+				rgb[texels[t].index] = irradiance;
+				mask[texels[t].index] = visibility;
+			}
+			rays += traced;
+		});
+	}
+	double traceSeconds = chrono::duration<double>(Clock::now() - start).count();
+
+	start = Clock::now();
+	vector<char> covered((size_t)width * height, 0);
+	for (const BakePoint& texel : texels)
+		covered[texel.index] = 1;
+	UDilate(width, height, rgb, mask, covered);
+	double dilateMs = chrono::duration<double, milli>(Clock::now() - start).count();
+
+	vector<LightmapFileObject> records;
+	for (const BakeObject& object : objects)
+	{
+		LightmapFileObject record;
+		record.item = (uint32_t)object.item;
+		record.vertexCount = (uint32_t)(items[object.item].mesh->vertices.size() / FLOATS_PER_MESH_VERTEX);
+		record.scaleOffset[0] = (float)object.size / width;
+		record.scaleOffset[1] = (float)object.size / height;
+		record.scaleOffset[2] = (float)object.x / width;
+		record.scaleOffset[3] = (float)object.y / height;
+		records.push_back(record);
+	}
+	bool written = UWriteLightmap(config.file, width, height, records, items.size(), rgb, mask);
+	UJobsShutdown();
+	if (!written)
+		return EXIT_FAILURE;
+
+	double totalSeconds = chrono::duration<double>(Clock::now() - bakeStart).count();
+	cout << "BAKE: layout " << layoutMs << " ms, rasterise " << rasteriseMs << " ms, bvh " << bvhMs << " ms, trace " << traceSeconds << " s ("
+		<< rays / traceSeconds / 1.0e6 << " Mrays/s), dilate " << dilateMs << " ms, total " << totalSeconds << " s" << endl;
+	cout << "INFO: " << rays << " rays, " << (texels.empty() ? 0.0 : (double)rays / texels.size()) << " per texel that a lightmapped fragment now "
+		<< "reads back with two texture fetches; wrote " << config.file << " and " << config.file << ".ppm" << endl;
+	return EXIT_SUCCESS;
+}
+
+int URunVertexLightingBaker(const ULightmapConfig& config, const std::vector<UDrawItem>& items, const USceneGraph& scene, const std::vector<USceneTexture>& textures,
+	const USceneLighting& lighting)
+{
+	UTRACE_SCOPE("bake vertex lighting");
+	Clock::time_point bakeStart = Clock::now();
+	UJobsInit(config.threads);
+
+	//every vertex of every draw in world space (draws of the same mesh are lit differently)
+	vector<BakePoint> points;
+	vector<uint32_t> counts;
+	for (const UDrawItem& item : items)
+	{
+		const glm::mat4& model = scene.world[item.node];
+		glm::mat3 normalMatrix = glm::mat3(glm::transpose(glm::inverse(model)));
+		const vector<float>& vertices = item.mesh->vertices;
+		counts.push_back((uint32_t)(vertices.size() / FLOATS_PER_MESH_VERTEX));
+		for (size_t v = 0; v < vertices.size(); v += FLOATS_PER_MESH_VERTEX)
+		{
+			BakePoint point;
+			point.position = glm::vec3(model * glm::vec4(vertices[v], vertices[v + 1], vertices[v + 2], 1.0f));
+			point.normal = normalMatrix * glm::vec3(vertices[v + MESH_NORMAL_OFFSET], vertices[v + MESH_NORMAL_OFFSET + 1], vertices[v + MESH_NORMAL_OFFSET + 2]);
+			point.normal = glm::dot(point.normal, point.normal) > 0.0f ? glm::normalize(point.normal) : glm::vec3(0.0f, 1.0f, 0.0f);
+			point.geometric = point.normal;
+			point.dx = point.dy = glm::vec3(0.0f);
+			point.index = (int)points.size();
+			points.push_back(point);
+		}
+	}
+
+	//every draw blocks and bounces light, standing where the scene file puts it
+	Clock::time_point start = Clock::now();
+	UBvh bvh;
+	UBuildBvh(items, scene, bvh);
+	vector<USoftTexture> soft;
+	UPrepareSoftTextures(textures, soft);
+	double bvhMs = chrono::duration<double, milli>(Clock::now() - start).count();
+
+	BakeContext k;
+	UMakeBakeContext(config, lighting, bvh, soft, k);
+	cout << "INFO: baking " << points.size() << " vertices of " << items.size() << " draws, " << k.packets * USIMD_WIDTH << " samples, " << k.bounces
+		<< " bounces, " << bvh.triangles.size() << " occluder triangles, " << UJobsThreadCount() << " threads" << endl;
+
+	//rgb = diffuse light (direct + bounced) without the albedo, a = fraction of the hemisphere that sees the sky
+	start = Clock::now();
+	vector<float> colours(points.size() * 4);
+	atomic<uint64_t> rays(0);
+	{
+		UTRACE_SCOPE("trace vertices");
+		UParallelFor((int)points.size(), 64, [&](int begin, int end, int)
+		{
+			uint64_t traced = 0;
+			for (int p = begin; p < end; p++)
+			{
+				glm::vec3 irradiance;
+				glm::vec2 visibility;
+				float openness;
+				traced += UBakePoint(k, points[p], irradiance, visibility, openness);
+				colours[(size_t)p * 4] = irradiance.x;
+				colours[(size_t)p * 4 + 1] = irradiance.y;
+				colours[(size_t)p * 4 + 2] = irradiance.z;
+				colours[(size_t)p * 4 + 3] = openness;
+			}
+			rays += traced;
+		});
+	}
+	double traceSeconds = chrono::duration<double>(Clock::now() - start).count();
+	UJobsShutdown();
+
+	VertexLightingFileHeader header = { VERTEX_LIGHTING_MAGIC, VERTEX_LIGHTING_VERSION, (uint32_t)items.size(), (uint32_t)points.size() };
+	ofstream out(config.vertexFile.c_str(), ios::binary);
+	if (!out || !out.write((const char*)&header, sizeof(header)) || !out.write((const char*)counts.data(), counts.size() * sizeof(uint32_t))
+		|| !out.write((const char*)colours.data(), colours.size() * sizeof(float)))
+	{
+		cerr << "ERROR: could not write " << config.vertexFile << endl;
+		return EXIT_FAILURE;
+	}
+
+	double totalSeconds = chrono::duration<double>(Clock::now() - bakeStart).count();
+	cout << "BAKE: bvh " << bvhMs << " ms, trace " << traceSeconds << " s (" << rays / traceSeconds / 1.0e6 << " Mrays/s), total " << totalSeconds << " s" << endl;
+	cout << "INFO: " << rays << " rays, " << (points.empty() ? 0.0 : (double)rays / points.size()) << " per vertex, carried to the fragments by the "
+		<< "colour attribute; wrote " << config.vertexFile << endl;
+	return EXIT_SUCCESS;
+}
+
+//RUNTIME ==========================================================================================================================================
+
+bool ULightmapLoad(const ULightmapConfig& config, std::vector<GLMesh>& meshes, std::vector<UDrawItem>& items)
+{
+	if (!config.load)
+		return false;
+	UTRACE_SCOPE("load lightmap");
+
+	ifstream in(config.file.c_str(), ios::binary);
+	LightmapFileHeader header;
+	if (!in || !in.read((char*)&header, sizeof(header)) || header.magic != LIGHTMAP_MAGIC || header.version != LIGHTMAP_VERSION)
+	{
+		cerr << "ERROR: " << config.file << " is not a lightmap (bake one with --bake-lightmap), drawing without it" << endl;
+		return false;
+	}
+	if (header.drawCount != items.size())
+	{
+		cerr << "ERROR: " << config.file << " was baked for " << header.drawCount << " draws, the scene has " << items.size() << ", drawing without it" << endl;
+		return false;
+	}
+	//the sizes come from the file: bound them by the baker's atlas and by the bytes actually there before allocating anything
+	in.seekg(0, ios::end);
+	uint64_t fileBytes = (uint64_t)in.tellg();
+	in.seekg(sizeof(header), ios::beg);
+	uint64_t expectedBytes = sizeof(header) + (uint64_t)header.objectCount * sizeof(LightmapFileObject)
+		+ (uint64_t)header.width * header.height * (3 * sizeof(float) + 2);
+	if (header.width == 0 || header.height == 0 || header.width > (uint32_t)ATLAS_SIZE || header.height > (uint32_t)ATLAS_SIZE
+		|| header.objectCount > header.drawCount || expectedBytes != fileBytes)
+	{
+		cerr << "ERROR: " << config.file << " is corrupt (" << header.width << "x" << header.height << ", " << header.objectCount << " objects, "
+			<< fileBytes << " bytes), drawing without it" << endl;
+		return false;
+	}
+	vector<LightmapFileObject> objects(header.objectCount);
+	vector<float> rgb((size_t)header.width * header.height * 3);
+	vector<unsigned char> mask((size_t)header.width * header.height * 2);
+	if (!in.read((char*)objects.data(), objects.size() * sizeof(LightmapFileObject)) || !in.read((char*)rgb.data(), rgb.size() * sizeof(float))
+		|| !in.read((char*)mask.data(), mask.size()))
+	{
+		cerr << "ERROR: " << config.file << " is truncated, drawing without it" << endl;
+		return false;
+	}
+	for (const LightmapFileObject& object : objects)
+	{
+		if (object.item >= items.size() || object.vertexCount != items[object.item].mesh->vertices.size() / FLOATS_PER_MESH_VERTEX)
+		{
+			cerr << "ERROR: " << config.file << " doesn't match the scene's meshes (bake it again), drawing without it" << endl;
+			return false;
+		}
+	}
+
+	//the lightmap keeps its range (half floats), the shadowmask is a fraction per light
+	gLightmapTexture.Create("lightmap");
+	glActiveTexture(GL_TEXTURE0 + LIGHTMAP_TEXTURE_UNIT);
+	glBindTexture(GL_TEXTURE_2D, gLightmapTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, header.width, header.height, 0, GL_RGB, GL_FLOAT, rgb.data());
+	gLightmapTexture.SetBytes(UGpuTextureBytes(header.width, header.height, 6, false));
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	gShadowmaskTexture.Create("shadowmask");
+	glActiveTexture(GL_TEXTURE0 + SHADOWMASK_TEXTURE_UNIT);
+	glBindTexture(GL_TEXTURE_2D, gShadowmaskTexture);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RG8, header.width, header.height, 0, GL_RG, GL_UNSIGNED_BYTE, mask.data());
+	gShadowmaskTexture.SetBytes(UGpuTextureBytes(header.width, header.height, 2, false));
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glActiveTexture(GL_TEXTURE0);
+
+	//the baked meshes get their second uv set back (same unwrap as the baker) as attribute 5 of their vao
+	size_t triangles = 0;
+	for (const LightmapFileObject& object : objects)
+	{
+		UDrawItem& item = items[object.item];
+		GLMesh& mesh = meshes[item.mesh - meshes.data()];
+		if (mesh.lightmapUVs.empty())
+		{
+			UUnwrap(mesh, mesh.lightmapUVs, false);
+			ULightmapAttachUVs(mesh);
+		}
+		item.lightmap = glm::vec4(object.scaleOffset[0], object.scaleOffset[1], object.scaleOffset[2], object.scaleOffset[3]);
+		triangles += mesh.indices.size() / 3;
+	}
+
+	size_t bytes = (size_t)header.width * header.height * (6 + 2);
+	cout << "INFO: lightmap " << config.file << ": " << header.width << "x" << header.height << ", " << objects.size() << " objects (" << triangles
+		<< " triangles), " << bytes / 1024 << " KB" << endl;
+	cout << "INFO: lightmapped fragments read 2 texels instead of the ambient and 2 directional diffuse terms (and with --shadows the 2 static "
+		<< "atlas lookups, 18 pcf taps), and get shadowed bounced light no frame could afford; compare --benchmark gpu ms with and without --lightmap" << endl;
+	return true;
+}
+
+void ULightmapAttachUVs(GLMesh& mesh)
+{
+	gUVBuffers.emplace_back();
+	UGpuBuffer& buffer = gUVBuffers.back();
+	buffer.Create("lightmap uvs");
+	glBindVertexArray(mesh.vao);
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	glBufferData(GL_ARRAY_BUFFER, mesh.lightmapUVs.size() * sizeof(float), mesh.lightmapUVs.data(), GL_STATIC_DRAW);
+	buffer.SetBytes(mesh.lightmapUVs.size() * sizeof(float));
+	glVertexAttribPointer(LIGHTMAP_UV_ATTRIBUTE, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), 0);
+	glEnableVertexAttribArray(LIGHTMAP_UV_ATTRIBUTE);
+	glBindVertexArray(0);
+}
+
+void ULightmapSetUniforms(GLuint programId)
+{
+	if (gLightmapTexture == 0)
+		return;
+	glUniform1i(glGetUniformLocation(programId, "lightmap"), LIGHTMAP_TEXTURE_UNIT);
+	glUniform1i(glGetUniformLocation(programId, "shadowmask"), SHADOWMASK_TEXTURE_UNIT);
+}
+
+bool UVertexLightingLoad(const ULightmapConfig& config, std::vector<UDrawItem>& items, void (*upload)(GLMesh& mesh))
+{
+	if (!config.loadVertices)
+		return false;
+	UTRACE_SCOPE("load vertex lighting");
+
+	ifstream in(config.vertexFile.c_str(), ios::binary);
+	VertexLightingFileHeader header;
+	if (!in || !in.read((char*)&header, sizeof(header)) || header.magic != VERTEX_LIGHTING_MAGIC || header.version != VERTEX_LIGHTING_VERSION)
+	{
+		cerr << "ERROR: " << config.vertexFile << " is not baked vertex lighting (bake it with --bake-vertex-lighting), drawing without it" << endl;
+		return false;
+	}
+	vector<uint32_t> counts(header.drawCount);
+	vector<float> colours((size_t)header.vertexCount * 4);
+	if (header.drawCount != items.size() || !in.read((char*)counts.data(), counts.size() * sizeof(uint32_t))
+		|| !in.read((char*)colours.data(), colours.size() * sizeof(float)))
+	{
+		cerr << "ERROR: " << config.vertexFile << " doesn't match the scene (bake it again), drawing without it" << endl;
+		return false;
+	}
+	//the colours are read at the running sum of the counts, which has to stay inside the vertexCount the file holds
+	size_t total = 0;
+	for (size_t i = 0; i < items.size(); i++)
+	{
+		if (counts[i] != items[i].mesh->vertices.size() / FLOATS_PER_MESH_VERTEX)
+		{
+			cerr << "ERROR: " << config.vertexFile << " doesn't match the scene's meshes (bake it again), drawing without it" << endl;
+			return false;
+		}
+		total += counts[i];
+	}
+	if (total != header.vertexCount)
+	{
+		cerr << "ERROR: " << config.vertexFile << " is corrupt (" << total << " vertices in its draws, " << header.vertexCount
+			<< " colours), drawing without it" << endl;
+		return false;
+	}
+
+	//each draw gets its own copy of the mesh with the baked colours (lightmapped draws keep the lightmap)
+	size_t offset = 0;
+	size_t bytes = 0;
+	int draws = 0;
+	for (size_t i = 0; i < items.size(); offset += counts[i], i++)
+	{
+		UDrawItem& item = items[i];
+		if (item.lightmap.x > 0.0f)
+			continue;
+		gVertexLitMeshes.emplace_back();
+		GLMesh& mesh = gVertexLitMeshes.back();
+		mesh.vertices = item.mesh->vertices;
+		mesh.indices = item.mesh->indices;
+		for (uint32_t v = 0; v < counts[i]; v++)
+			memcpy(&mesh.vertices[(size_t)v * FLOATS_PER_MESH_VERTEX + MESH_COLOR_OFFSET], &colours[(offset + v) * 4], 4 * sizeof(float));
+		upload(mesh);
+		item.mesh = &mesh;
+		item.vertexLit = true;
+		bytes += mesh.vertices.size() * sizeof(float) + mesh.indices.size() * sizeof(unsigned short);
+		draws++;
+	}
+
+	cout << "INFO: vertex lighting " << config.vertexFile << ": " << draws << " draws, " << header.vertexCount << " vertices, " << bytes / 1024
+		<< " KB of per-draw mesh copies" << endl;
+	cout << "INFO: vertex lit fragments take the ambient and 2 directional diffuse terms from one interpolated attribute, no texture "
+		<< "fetch and no shadow lookup; compare --benchmark gpu ms with and without --vertex-lighting" << endl;
+	return true;
+}
+
+void ULightmapShutdown()
+{
+	//the handles delete the meshes' vaos and buffers, the uv buffers and the textures
+	gVertexLitMeshes.clear();
+	gUVBuffers.clear();
+	gLightmapTexture.Reset();
+	gShadowmaskTexture.Reset();
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "Scene.h"
+
+//BAKED LIGHTMAPS ==================================================================================================================================
+//
+// --bake-lightmap [file]      bake the static objects on the cpu without a window, write <file> and a <file>.ppm preview
+//                             (default ../Resources/lightmap.bin)
+// --bake-samples <n>          hemisphere samples per texel (default 128, rounded up to whole 8 ray packets)
+// --bake-bounces <n>          indirect diffuse bounces (default 1)
+// --bake-density <texels>     texels per world unit (default 16, lowered until every object fits the 1024 atlas)
+// --bake-threads <n>          worker threads (default: one per hardware thread)
+// --lightmap [file]           draw the static objects with a baked lightmap (default ../Resources/lightmap.bin)
+// --bake-vertex-lighting [file]  bake per-vertex lighting for every draw instead (default ../Resources/vertexlighting.bin,
+//                             takes the same --bake-samples/--bake-bounces/--bake-threads)
+// --vertex-lighting [file]    draw the objects without a lightmap with baked per-vertex lighting
+//
+// every mesh gets a second uv set: triangles sharing vertices form a chart, each chart is projected onto the plane of its
+// averaged normal and the charts are shelf packed into the unit square with a gap between them. the unwrap only depends
+// on the mesh, so the runtime regenerates it instead of storing it. each static draw item (scene file "static" nodes) gets
+// a rectangle of the atlas sized by its world area. the baker rasterises the charts into texels (world position, normal)
+// and traces packets of 8 rays per texel through the path tracer's BVH, built over the static items only: direct light
+// from the two directional lights with a shadow ray per sample, plus cosine distributed bounces that pick up the lit
+// static surfaces and the ambient environment (the same conventions as --pathtrace). it keeps the visibility of each
+// light in a shadowmask so specular can still be shadowed at runtime. LIGHTMAP variants of scene.frag read the diffuse
+// lighting from the lightmap and only compute specular (and point lights); with --shadows the cascades take the light
+// the moving objects block back out of it.
+//
+// per-vertex baking is the cheap end of the same idea for coarse objects: every vertex of every draw (at the pose the scene
+// file puts it in) gets the baked diffuse light in rgb and the fraction of its hemisphere that sees the sky in alpha, and
+// the runtime writes them into the mesh's colour attribute, which the shaders didn't use. meshes are shared between draws,
+// so each vertex lit draw gets its own copy of its mesh. VERTEX_LIGHTING variants take the ambient and directional diffuse
+// from the interpolated colour and darken the specular by the occlusion, with no texture fetch and no shadow lookup.
+
+struct ULightmapConfig
+{
+	bool bake = false;
+	bool load = false;
+	std::string file = "../Resources/lightmap.bin";
+	int samples = 128;
+	int bounces = 1;
+	float density = 16.0f;
+	int threads = 0;
+	bool bakeVertices = false;
+	bool loadVertices = false;
+	std::string vertexFile = "../Resources/vertexlighting.bin";
+};
+
+bool UParseLightmapArgs(int argc, char* argv[], ULightmapConfig& config);
+
+//bake mode entry point used by main() (returns the process exit code)
+int URunLightmapBaker(const ULightmapConfig& config, const std::vector<UDrawItem>& items, const USceneGraph& scene, const std::vector<USceneTexture>& textures,
+	const USceneLighting& lighting);
+//per-vertex bake mode entry point (--bake-vertex-lighting)
+int URunVertexLightingBaker(const ULightmapConfig& config, const std::vector<UDrawItem>& items, const USceneGraph& scene, const std::vector<USceneTexture>& textures,
+	const USceneLighting& lighting);
+
+//needs a current GL context: uploads the lightmap and shadowmask, gives the meshes of baked objects their second uv set
+//(attribute 5) and sets UDrawItem::lightmap; returns false (and leaves the items lit per pixel) when the file doesn't match
+bool ULightmapLoad(const ULightmapConfig& config, std::vector<GLMesh>& meshes, std::vector<UDrawItem>& items);
+//after ULightmapLoad: points every draw without a lightmap at its own copy of its mesh with the baked colours, uploaded
+//with upload(), and sets UDrawItem::vertexLit; returns false (and leaves the items alone) when the file doesn't match
+bool UVertexLightingLoad(const ULightmapConfig& config, std::vector<UDrawItem>& items, void (*upload)(GLMesh& mesh));
+//uploads mesh.lightmapUVs as attribute 5 of the mesh's vao (the buffer is freed by ULightmapShutdown)
+void ULightmapAttachUVs(GLMesh& mesh);
+//lightmap and shadowmask samplers for a scene program (with the other frame uniforms)
+void ULightmapSetUniforms(GLuint programId);
+void ULightmapShutdown();
@@ -0,0 +1,126 @@
+#include "Materials.h"
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+#include <GLFW/glfw3.h>
+
+#include "GLStats.h"
+#include "Trace.h"
+
+using namespace std;
+
+namespace
+{
+	vector<UMaterial> gMaterials;
+	vector<string> gNames;
+	UGpuBuffer gMaterialBuffer;
+	//entries [begin, end) edited since the last upload
+	int gDirtyBegin = 0;
+	int gDirtyEnd = 0;
+	//material the [ and ] keys edit
+	int gSelected = 0;
+
+	void UMarkDirty(int index)
+	{
+		if (gDirtyBegin >= gDirtyEnd)
+		{
+			gDirtyBegin = index;
+			gDirtyEnd = index + 1;
+			return;
+		}
+		gDirtyBegin = std::min(gDirtyBegin, index);
+		gDirtyEnd = std::max(gDirtyEnd, index + 1);
+	}
+}
+
+void UMaterialsInit(const USceneFile& scene, const USceneLighting& lighting)
+{
+	gMaterials.clear();
+	gNames.clear();
+	for (uint32_t i = 0; i < scene.header->materialCount; i++)
+	{
+		const USceneFileMaterial& source = scene.materials[i];
+		UMaterial material;
+		material.ambient = lighting.materialAmbient;
+		material.shininess = source.shininess;
+		material.diffuse = lighting.materialDiffuse;
+		material.texture = source.texture;
+		material.specular = lighting.materialSpecular;
+		material.flags = source.flags;
+		gMaterials.push_back(material);
+		gNames.push_back(scene.String(source.name));
+	}
+	gDirtyBegin = gDirtyEnd = 0;
+	gSelected = 0;
+}
+
+int UMaterialCount()
+{
+	return (int)gMaterials.size();
+}
+
+const UMaterial& UMaterialGet(int index)
+{
+	return gMaterials[index];
+}
+
+const std::string& UMaterialName(int index)
+{
+	return gNames[index];
+}
+
+void UMaterialSet(int index, const UMaterial& material)
+{
+	gMaterials[index] = material;
+	UMarkDirty(index);
+}
+
+void UMaterialsUpload()
+{
+	if (gMaterialBuffer == 0)
+	{
+		//the whole table once (an empty table still gets a buffer so the binding is valid)
+		gMaterialBuffer.Create("material table");
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, gMaterialBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, std::max<size_t>(gMaterials.size(), 1) * sizeof(UMaterial), gMaterials.data(), GL_DYNAMIC_DRAW);
+		gMaterialBuffer.SetBytes(std::max<size_t>(gMaterials.size(), 1) * sizeof(UMaterial));
+		cout << "INFO: material table: " << gMaterials.size() << " materials, " << gMaterials.size() * sizeof(UMaterial) << " bytes" << endl;
+		gDirtyBegin = gDirtyEnd = 0;
+	}
+	else if (gDirtyBegin < gDirtyEnd)
+	{
+		//only the edited range, the rest of the table stays where it is
+		GLsizeiptr bytes = (gDirtyEnd - gDirtyBegin) * sizeof(UMaterial);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, gMaterialBuffer);
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, gDirtyBegin * sizeof(UMaterial), bytes, &gMaterials[gDirtyBegin]);
+		UTraceCounter("material bytes uploaded", (double)bytes);
+		gDirtyBegin = gDirtyEnd = 0;
+	}
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, UMATERIALS_BINDING, gMaterialBuffer);
+}
+
+void UMaterialsShutdown()
+{
+	gMaterialBuffer.Reset();
+}
+
+void UMaterialsKey(int key)
+{
+	if (gMaterials.empty())
+		return;
+	if (key == GLFW_KEY_M)
+		gSelected = (gSelected + 1) % (int)gMaterials.size();
+	else if (key == GLFW_KEY_LEFT_BRACKET || key == GLFW_KEY_RIGHT_BRACKET)
+	{
+		UMaterial material = gMaterials[gSelected];
+		material.shininess = key == GLFW_KEY_RIGHT_BRACKET ? std::min(material.shininess * 2.0f, 1024.0f) : std::max(material.shininess * 0.5f, 1.0f);
+		UMaterialSet(gSelected, material);
+	}
+	else
+		return;
+
+	//log the selection to the console (like the camera speed)
+	cout << "MATERIAL: " << gNames[gSelected] << " shininess " << gMaterials[gSelected].shininess << endl;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "Scene.h"
+#include "SceneFile.h"
+
+//MATERIAL TABLE ===================================================================================================================================
+//
+// M (in the window)       select the next material (prints its name and shininess)
+// [ / ]                   halve / double the selected material's shininess
+//
+// every scene file material is one entry of a table (colours, shininess, texture unit, UMaterialFlags) and a draw item
+// only carries its index. the GL side keeps the whole table in one storage buffer that scene.frag indexes with the
+// draw's material (a uniform in the cpu replayed path, the per object storage buffer in the gpu driven one), so nothing
+// material related is set between draws and draws of different materials still batch together. edits mark a dirty
+// range of entries and the next upload only sends that range. the colours start out as the scene lighting's material
+// colours (the cpu renderers and the baker light with those). the texture and flags are copied into the draw items,
+// they pick the program and the bound texture, so editing them doesn't change how a draw is batched.
+
+//std430 layout, has to match scene.frag
+struct UMaterial
+{
+	glm::vec3 ambient;
+	float shininess;
+	glm::vec3 diffuse;
+	int32_t texture;		//texture unit, -1 = none (not read by the shaders)
+	glm::vec3 specular;
+	uint32_t flags;			//UMaterialFlags
+};
+
+//storage buffer binding scene.frag reads the table from (0-5 are taken by GpuCulling.h)
+const GLuint UMATERIALS_BINDING = 6;
+
+//cpu table from the scene file (no GL needed)
+void UMaterialsInit(const USceneFile& scene, const USceneLighting& lighting);
+int UMaterialCount();
+const UMaterial& UMaterialGet(int index);
+const std::string& UMaterialName(int index);
+//replaces an entry and marks it for the next upload
+void UMaterialSet(int index, const UMaterial& material);
+
+//needs a current GL context: creates the storage buffer on the first call, afterwards sends only the entries edited since
+//the last call; binds it at UMATERIALS_BINDING (call once a frame before the draws)
+void UMaterialsUpload();
+void UMaterialsShutdown();
+
+//window keys (M, [ and ]), called from the key callback
+void UMaterialsKey(int key);
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "GpuResources.h"
+
+//interleaved vertex layout shared by every mesh: POS(3) COLOR(4) TEXTURE COORDS(2) NORMALS(3)
+const int FLOATS_PER_MESH_VERTEX = 12;
+const int MESH_COLOR_OFFSET = 3;
+const int MESH_TEXCOORD_OFFSET = 7;
+const int MESH_NORMAL_OFFSET = 9;
+
+struct GLMesh //define (in c) the GLMesh type
+{
+	UGpuVertexArray vao;	//vertex array object
+	UGpuBuffer vbos[2];		//vertex buffer object (vertices, indices)
+	GLuint nIndices;	//number of vertices in the mesh
+
+	//cpu copy of what was uploaded (same layout as the vbo), used by the software renderers
+	std::vector<float> vertices;
+	std::vector<unsigned short> indices;
+	//second uv set (2 floats per vertex) of meshes drawn with a baked lightmap, attribute 5 (Lightmap.h), empty otherwise
+	std::vector<float> lightmapUVs;
+
+	//local space bounding sphere of the vertices (frustum culling)
+	glm::vec3 boundsCenter;
+	float boundsRadius;
+};
@@ -0,0 +1,188 @@
+#include "MultiView.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "CommandList.h"
+#include "GLStats.h"
+
+using namespace std;
+
+namespace
+{
+	//orthographic views after the camera's: looking down from above, from the front (+z) and from the side (+x)
+	const glm::vec3 ORTHO_DIRECTIONS[UMULTIVIEW_MAX_VIEWS - 1] = { glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(1.0f, 0.0f, 0.0f) };
+	const glm::vec3 ORTHO_UPS[UMULTIVIEW_MAX_VIEWS - 1] = { glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f) };
+
+	bool gActive = false;
+	bool gGeometry = false;
+	int gViews = 1;
+	int gColumns = 1;
+	int gRows = 1;
+	glm::vec3 gSceneCenter(0.0f);
+	float gSceneRadius = 1.0f;
+	glm::mat4 gViewProjections[UMULTIVIEW_MAX_VIEWS];
+	glm::vec3 gViewPositions[UMULTIVIEW_MAX_VIEWS];
+	GLint gSceneViewport[4] = {};
+
+	//bounding sphere of every draw's world sphere (the orthographic views frame it)
+	void USceneBounds(const std::vector<UDrawItem>& items, const USceneGraph& scene)
+	{
+		if (items.empty())
+			return;
+		glm::vec3 lo(1e30f), hi(-1e30f);
+		for (const UDrawItem& item : items)
+		{
+			const glm::mat4& model = scene.world[item.node];
+			glm::vec3 center = glm::vec3(model * glm::vec4(item.mesh->boundsCenter, 1.0f));
+			float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+			float radius = item.mesh->boundsRadius * scale;
+			lo = glm::min(lo, center - glm::vec3(radius));
+			hi = glm::max(hi, center + glm::vec3(radius));
+		}
+		gSceneCenter = (lo + hi) * 0.5f;
+		gSceneRadius = std::max(glm::length(hi - lo) * 0.5f, 0.001f);
+	}
+}
+
+bool UParseMultiViewArgs(int argc, char* argv[], UMultiViewConfig& config)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--views") == 0)
+		{
+			if (i + 1 >= argc || (atoi(argv[i + 1]) != 2 && atoi(argv[i + 1]) != 4))
+			{
+				cerr << "ERROR: --views needs 2 or 4" << endl;
+				return false;
+			}
+			config.views = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--views-geometry") == 0)
+			config.geometry = true;
+	}
+	return true;
+}
+
+bool UMultiViewInit(const UMultiViewConfig& config, const std::vector<UDrawItem>& items, const USceneGraph& scene)
+{
+	if (config.views <= 1)
+		return false;
+
+	gViews = std::min(config.views, UMULTIVIEW_MAX_VIEWS);
+	gColumns = 2;
+	gRows = gViews > 2 ? 2 : 1;
+	gGeometry = config.geometry || !(GLEW_ARB_shader_viewport_layer_array || GLEW_AMD_vertex_shader_viewport_index);
+	USceneBounds(items, scene);
+	gActive = true;
+	cout << "INFO: " << gViews << " views in one pass (" << gColumns << "x" << gRows << "), viewport picked in the "
+		<< (gGeometry ? "geometry shader" : "vertex shader") << ", scene framed at radius " << gSceneRadius << endl;
+	return true;
+}
+
+void UMultiViewShutdown()
+{
+	gActive = false;
+	gViews = 1;
+}
+
+bool UMultiViewEnabled()
+{
+	return gActive;
+}
+
+bool UMultiViewGeometry()
+{
+	return gActive && gGeometry;
+}
+
+int UMultiViewCount()
+{
+	return gActive ? gViews : 1;
+}
+
+int UMultiViewInstances()
+{
+	return gActive && !gGeometry ? gViews : 1;
+}
+
+void UMultiViewUpdate(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& cameraPos, int width, int height)
+{
+	if (!gActive)
+		return;
+
+	//the projection was made for the whole viewport (perspective or ortho alike): narrow it to a tile
+	glm::mat4 cameraProjection = projection;
+	cameraProjection[0][0] *= (float)gColumns / gRows;
+	gViewProjections[0] = cameraProjection * view;
+	gViewPositions[0] = cameraPos;
+
+	float tileAspect = (float)(width * gRows) / std::max(height * gColumns, 1);
+	float r = gSceneRadius;
+	for (int v = 1; v < gViews; v++)
+	{
+		glm::vec3 eye = gSceneCenter + ORTHO_DIRECTIONS[v - 1] * (2.0f * r);
+		glm::mat4 orthoView = glm::lookAt(eye, gSceneCenter, ORTHO_UPS[v - 1]);
+		glm::mat4 orthoProjection = glm::ortho(-r * tileAspect, r * tileAspect, -r, r, 0.5f * r, 3.5f * r);
+		gViewProjections[v] = orthoProjection * orthoView;
+		gViewPositions[v] = eye;
+	}
+}
+
+int UMultiViewFrustumPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6 * UMULTIVIEW_MAX_VIEWS])
+{
+	if (!gActive)
+	{
+		UFrustumPlanes(viewProjection, planes);
+		return 1;
+	}
+	for (int v = 0; v < gViews; v++)
+		UFrustumPlanes(gViewProjections[v], planes + 6 * v);
+	return gViews;
+}
+
+void UMultiViewBeginScene()
+{
+	if (!gActive)
+		return;
+
+	//tiles of whatever viewport the scene pass set up (dynamic resolution may have narrowed it), gl's origin is bottom left:
+	//the camera top left, then top right, bottom left, bottom right
+	glGetIntegerv(GL_VIEWPORT, gSceneViewport);
+	float tileWidth = (float)gSceneViewport[2] / gColumns;
+	float tileHeight = (float)gSceneViewport[3] / gRows;
+	GLfloat tiles[4 * UMULTIVIEW_MAX_VIEWS];
+	for (int v = 0; v < gViews; v++)
+	{
+		int column = v % gColumns;
+		int row = gRows - 1 - v / gColumns;
+		tiles[4 * v + 0] = gSceneViewport[0] + column * tileWidth;
+		tiles[4 * v + 1] = gSceneViewport[1] + row * tileHeight;
+		tiles[4 * v + 2] = tileWidth;
+		tiles[4 * v + 3] = tileHeight;
+	}
+	glViewportArrayv(0, gViews, tiles);
+}
+
+void UMultiViewEndScene()
+{
+	if (!gActive)
+		return;
+	//glViewport sets every viewport of the array
+	glViewport(gSceneViewport[0], gSceneViewport[1], gSceneViewport[2], gSceneViewport[3]);
+}
+
+void UMultiViewSetUniforms(GLuint programId)
+{
+	if (!gActive)
+		return;
+	glUniformMatrix4fv(glGetUniformLocation(programId, "viewProjections"), gViews, GL_FALSE, glm::value_ptr(gViewProjections[0]));
+	glUniform3fv(glGetUniformLocation(programId, "viewPositions"), gViews, glm::value_ptr(gViewPositions[0]));
+	glUniform1i(glGetUniformLocation(programId, "viewCount"), gViews);
+}
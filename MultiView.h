@@ -0,0 +1,55 @@
+#pragma once
+
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "Scene.h"
+#include "SceneGraph.h"
+
+//MULTI-VIEWPORT RENDERING =========================================================================================================================
+//
+// --views <2|4>        draw the camera's view next to orthographic views of the scene in the same pass: 2 = camera + top
+//                      side by side, 4 = camera, top, front and side in a 2x2 grid
+// --views-geometry     take the geometry shader path even when the vertex shader could pick the viewport
+//
+// every view is a viewport of one viewport array, and every draw is issued once for all of them: the MULTI_VIEW variants
+// are drawn with one instance per view and the vertex shader sends instance i to viewport i (gl_ViewportIndex, from
+// ARB_shader_viewport_layer_array or AMD_vertex_shader_viewport_index). without either extension the draws stay single
+// instance and multiview.geom repeats each triangle into every viewport (geometry shader invocations). culling is shared:
+// the command lists and the gpu cull pass keep a draw when any view can see it, so the cpu cost, the draw calls and the
+// state changes are those of one view; only the vertex work grows with the views, and the pixels are split between them.
+// the orthographic views frame the scene's bounds as loaded. the shadow cascades still follow the camera's view, the
+// other views get the static atlas where the cascades don't reach.
+
+const int UMULTIVIEW_MAX_VIEWS = 4;
+
+struct UMultiViewConfig
+{
+	int views = 1;
+	bool geometry = false;		//force the geometry shader path
+};
+
+bool UParseMultiViewArgs(int argc, char* argv[], UMultiViewConfig& config);
+
+//picks the vertex or geometry shader path and frames the scene for the orthographic views, false when off
+bool UMultiViewInit(const UMultiViewConfig& config, const std::vector<UDrawItem>& items, const USceneGraph& scene);
+void UMultiViewShutdown();
+bool UMultiViewEnabled();
+bool UMultiViewGeometry();
+//views drawn (1 when off)
+int UMultiViewCount();
+//instances per draw: the view count on the vertex shader path, 1 otherwise
+int UMultiViewInstances();
+
+//this frame's views: the camera's (view, projection rescaled to its tile) first, then the orthographic ones framed for
+//tiles of a width x height target
+void UMultiViewUpdate(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& cameraPos, int width, int height);
+//frustum planes of every view (or of viewProjection when off) for culling, returns how many views they are
+int UMultiViewFrustumPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6 * UMULTIVIEW_MAX_VIEWS]);
+//splits the current viewport into the view tiles (call inside the scene pass), End puts the whole viewport back
+void UMultiViewBeginScene();
+void UMultiViewEndScene();
+//view matrices and eye positions of a MULTI_VIEW program
+void UMultiViewSetUniforms(GLuint programId);
@@ -0,0 +1,317 @@
+#include "PathTracer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "Image.h"
+#include "JobSystem.h"
+#include "RayTracing.h"
+#include "Simd.h"
+#include "SoftwareRasterizer.h"
+#include "Trace.h"
+
+using namespace std;
+
+namespace
+{
+	typedef chrono::steady_clock Clock;
+
+	const int TILE_SIZE = 16;
+	const float PI = 3.14159265f;
+
+	struct Light
+	{
+		glm::vec3 direction;	//towards the light
+		glm::vec3 diffuse;		//material.diffuse * light.diffuse (tinted for the second light)
+		glm::vec3 specular;		//material.specular * light.specular (halved / tinted like the shader)
+	};
+
+	struct TraceContext
+	{
+		const UBvh* bvh;
+		const vector<USoftTexture>* textures;
+		Light lights[2];
+		glm::vec3 environment;		//light.ambient * material.ambient, seen by bounce rays that leave the scene
+		glm::vec3 albedoScale;		//material.diffuse
+		glm::vec3 cameraPos, forward, right, up;
+		float tanHalfFov;
+		float aspect;
+		int width, height;
+		int bounces;
+	};
+
+	//one sample for the 8 pixels of a 4x2 block starting at (x, y), returns the number of rays traced
+	uint64_t UTraceBlock(const TraceContext& k, int x, int y, int pass, glm::vec3 radiance[USIMD_WIDTH], bool valid[USIMD_WIDTH])
+	{
+		uint64_t rays = 0;
+		glm::vec3 throughput[USIMD_WIDTH];
+		uint32_t rng[USIMD_WIDTH];
+		URayLane lanes[USIMD_WIDTH];
+
+		//camera rays, jittered inside the pixel
+		for (int i = 0; i < USIMD_WIDTH; i++)
+		{
+			int px = x + (i & 3);
+			int py = y + (i >> 2);
+			valid[i] = px < k.width && py < k.height;
+			radiance[i] = glm::vec3(0.0f);
+			throughput[i] = glm::vec3(1.0f);
+			rng[i] = UHash((uint32_t)(py * k.width + px) ^ UHash((uint32_t)pass * 0x9E3779B9u));
+
+			float ndcX = ((px + URandom(rng[i])) / k.width) * 2.0f - 1.0f;
+			float ndcY = 1.0f - ((py + URandom(rng[i])) / k.height) * 2.0f;
+			lanes[i].origin = k.cameraPos;
+			lanes[i].direction = glm::normalize(k.forward + k.right * (ndcX * k.tanHalfFov * k.aspect) + k.up * (ndcY * k.tanHalfFov));
+			lanes[i].active = valid[i];
+		}
+
+		for (int depth = 0; depth <= k.bounces; depth++)
+		{
+			URayPacket packet;
+			UMakePacket(lanes, 1e30f, packet);
+			int32_t triangle[USIMD_WIDTH];
+			float u[USIMD_WIDTH], v[USIMD_WIDTH];
+			UTracePacket(*k.bvh, packet, false, triangle, u, v);
+
+			URayLane shadow[2][USIMD_WIDTH];
+			glm::vec3 pending[2][USIMD_WIDTH];
+			bool any = false;
+			for (int i = 0; i < USIMD_WIDTH; i++)
+			{
+				shadow[0][i].active = shadow[1][i].active = false;
+				if (!lanes[i].active)
+					continue;
+				rays++;
+
+				//missed: camera rays see the black clear colour, bounce rays the ambient environment
+				if (triangle[i] < 0)
+				{
+					if (depth > 0)
+						radiance[i] += throughput[i] * k.environment;
+					lanes[i].active = false;
+					continue;
+				}
+
+				const URayTriangle& tri = k.bvh->triangles[triangle[i]];
+				const URayShading& shade = k.bvh->shading[triangle[i]];
+				float w = 1.0f - u[i] - v[i];
+				glm::vec3 direction = lanes[i].direction;
+				glm::vec3 position = tri.v0 + tri.e1 * u[i] + tri.e2 * v[i];
+
+				//two sided: face both normals towards the incoming ray
+				glm::vec3 geometric = glm::normalize(glm::cross(tri.e1, tri.e2));
+				if (glm::dot(geometric, direction) > 0.0f)
+					geometric = -geometric;
+				glm::vec3 normal = shade.normal[0] * w + shade.normal[1] * u[i] + shade.normal[2] * v[i];
+				normal = glm::dot(normal, normal) > 0.0f ? glm::normalize(normal) : geometric;
+				if (glm::dot(normal, geometric) < 0.0f)
+					normal = -normal;
+
+				glm::vec2 uv = shade.uv[0] * w + shade.uv[1] * u[i] + shade.uv[2] * v[i];
+				glm::vec3 albedo = shade.texture >= 0 && shade.texture < (int)k.textures->size() ? USampleTexture((*k.textures)[shade.texture], uv) : glm::vec3(1.0f);
+				glm::vec3 origin = position + geometric * URAY_EPSILON;
+
+				//direct light: the shader's diffuse + phong terms, if the shadow ray gets through
+				glm::vec3 view = -direction;
+				for (int l = 0; l < 2; l++)
+				{
+					const Light& light = k.lights[l];
+					float nDotL = glm::dot(normal, light.direction);
+					if (nDotL <= 0.0f)
+						continue;
+					glm::vec3 reflected = 2.0f * nDotL * normal - light.direction;
+					float spec = pow(std::max(glm::dot(view, reflected), 0.0f), shade.shininess);
+					pending[l][i] = throughput[i] * albedo * (light.diffuse * nDotL + light.specular * spec);
+					shadow[l][i].origin = origin;
+					shadow[l][i].direction = light.direction;
+					shadow[l][i].active = true;
+					any = true;
+				}
+
+				//continue the path with a diffuse bounce
+				if (depth < k.bounces)
+				{
+					throughput[i] *= albedo * k.albedoScale;
+					lanes[i].origin = origin;
+					lanes[i].direction = USampleHemisphere(normal, URandom(rng[i]), URandom(rng[i]));
+				}
+				else
+					lanes[i].active = false;
+			}
+
+			for (int l = 0; l < 2 && any; l++)
+			{
+				URayPacket shadowPacket;
+				UMakePacket(shadow[l], 1e30f, shadowPacket);
+				if (!USimdMask(shadowPacket.active))
+					continue;
+				int32_t blocker[USIMD_WIDTH];
+				UTracePacket(*k.bvh, shadowPacket, true, blocker, nullptr, nullptr);
+				for (int i = 0; i < USIMD_WIDTH; i++)
+				{
+					if (!shadow[l][i].active)
+						continue;
+					rays++;
+					if (blocker[i] < 0)
+						radiance[i] += pending[l][i];
+				}
+			}
+		}
+		return rays;
+	}
+
+	void UWriteReference(const string& prefix, int width, int height, const vector<glm::vec3>& accumulated, int samples)
+	{
+		vector<float> rgb((size_t)width * height * 3);
+		vector<unsigned char> bytes((size_t)width * height * 3);
+		float scale = 1.0f / samples;
+		for (size_t p = 0; p < accumulated.size(); p++)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				float value = accumulated[p][c] * scale;
+				rgb[p * 3 + c] = value;
+				bytes[p * 3 + c] = (unsigned char)(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+			}
+		}
+		UWritePFM((prefix + ".pfm").c_str(), width, height, rgb.data());
+		UWritePPM((prefix + ".ppm").c_str(), width, height, 3, bytes.data());
+	}
+}
+
+//SETUP ============================================================================================================================================
+
+bool UParsePathTracerArgs(int argc, char* argv[], UPathTracerConfig& config)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--pathtrace") == 0)
+		{
+			config.enabled = true;
+			if (i + 1 < argc && argv[i + 1][0] != '-')
+				config.outPrefix = argv[++i];
+		}
+		else if (strcmp(argv[i], "--pathtrace-spp") == 0 || strcmp(argv[i], "--pathtrace-bounces") == 0 || strcmp(argv[i], "--pathtrace-threads") == 0)
+		{
+			if (i + 1 >= argc)
+			{
+				cerr << "ERROR: " << argv[i] << " needs a value" << endl;
+				return false;
+			}
+			config.enabled = true;
+			int value = atoi(argv[i + 1]);
+			if (strcmp(argv[i], "--pathtrace-spp") == 0)
+				config.samples = std::max(1, value);
+			else if (strcmp(argv[i], "--pathtrace-bounces") == 0)
+				config.bounces = std::max(0, value);
+			else
+				config.threads = value;
+			i++;
+		}
+	}
+	return true;
+}
+
+//PATH TRACER MODE =================================================================================================================================
+
+int URunPathTracer(const UPathTracerConfig& config, const std::vector<UDrawItem>& items, const USceneGraph& scene, const std::vector<USceneTexture>& textures,
+	const USceneLighting& lighting, int width, int height, const glm::vec3& cameraPos, const glm::vec3& cameraFront, const glm::vec3& cameraUp)
+{
+	UJobsInit(config.threads);
+	cout << "INFO: path tracer, " << UJobsThreadCount() << " threads, " << USIMD_WIDTH << " wide packets"
+#ifdef USIMD_AVX2
+		<< " (AVX2)"
+#endif
+		<< endl;
+
+	Clock::time_point buildStart = Clock::now();
+	UBvh bvh;
+	UBuildBvh(items, scene, bvh);
+	double buildMs = chrono::duration<double, milli>(Clock::now() - buildStart).count();
+	cout << "INFO: SAH BVH over " << bvh.triangles.size() << " triangles, " << bvh.nodes.size() << " nodes, " << buildMs << " ms" << endl;
+
+	vector<USoftTexture> soft;
+	UPrepareSoftTextures(textures, soft);
+
+	TraceContext k;
+	k.bvh = &bvh;
+	k.textures = &soft;
+	k.lights[0].direction = glm::normalize(-lighting.direction);
+	k.lights[0].diffuse = lighting.materialDiffuse * lighting.diffuse;
+	k.lights[0].specular = lighting.materialSpecular * (glm::vec3(0.5f) * lighting.specular);
+	k.lights[1].direction = glm::normalize(-lighting.direction2);
+	k.lights[1].diffuse = lighting.materialDiffuse * (lighting.tint2 * lighting.diffuse);
+	k.lights[1].specular = lighting.materialSpecular * (lighting.tint2 * lighting.specular);
+	k.environment = lighting.ambient * lighting.materialAmbient;
+	k.albedoScale = lighting.materialDiffuse;
+	k.cameraPos = cameraPos;
+	k.forward = glm::normalize(cameraFront);
+	k.right = glm::normalize(glm::cross(k.forward, cameraUp));
+	k.up = glm::cross(k.right, k.forward);
+	k.tanHalfFov = tan(glm::radians(45.0f) * 0.5f);
+	k.aspect = (float)width / (float)height;
+	k.width = width;
+	k.height = height;
+	k.bounces = config.bounces;
+
+	vector<glm::vec3> accumulated((size_t)width * height, glm::vec3(0.0f));
+	int tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+	int tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+	uint64_t totalRays = 0;
+	double totalSeconds = 0.0;
+
+	for (int pass = 0; pass < config.samples; pass++)
+	{
+		UTRACE_SCOPE("path trace pass");
+		atomic<uint64_t> rays(0);
+		Clock::time_point passStart = Clock::now();
+
+		//one sample per pixel, one job per tile (tiles own their pixels)
+		UParallelFor(tilesX * tilesY, 1, [&](int begin, int end, int)
+		{
+			uint64_t traced = 0;
+			for (int tile = begin; tile < end; tile++)
+			{
+				int x0 = (tile % tilesX) * TILE_SIZE;
+				int y0 = (tile / tilesX) * TILE_SIZE;
+				for (int y = y0; y < std::min(y0 + TILE_SIZE, height); y += 2)
+				{
+					for (int x = x0; x < std::min(x0 + TILE_SIZE, width); x += 4)
+					{
+						glm::vec3 radiance[USIMD_WIDTH];
+						bool valid[USIMD_WIDTH];
+						traced += UTraceBlock(k, x, y, pass, radiance, valid);
+						for (int i = 0; i < USIMD_WIDTH; i++)
+							if (valid[i])
+								accumulated[(size_t)(y + (i >> 2)) * width + x + (i & 3)] += radiance[i];
+					}
+				}
+			}
+			rays += traced;
+		});
+
+		double seconds = chrono::duration<double>(Clock::now() - passStart).count();
+		totalRays += rays;
+		totalSeconds += seconds;
+
+		//refresh the files at 1, 2, 4, 8... spp and at the end
+		int samples = pass + 1;
+		if ((samples & (samples - 1)) == 0 || samples == config.samples)
+		{
+			UWriteReference(config.outPrefix, width, height, accumulated, samples);
+			cout << "PATH TRACE: " << samples << "/" << config.samples << " spp, " << rays / seconds / 1.0e6 << " Mrays/s (last pass), "
+				<< totalRays / totalSeconds / 1.0e6 << " Mrays/s (average), " << totalSeconds << " s" << endl;
+		}
+	}
+
+	cout << "INFO: " << totalRays << " rays in " << totalSeconds << " s (" << totalRays / totalSeconds / 1.0e6 << " Mrays/s), wrote "
+		<< config.outPrefix << ".ppm and " << config.outPrefix << ".pfm" << endl;
+
+	UJobsShutdown();
+	return EXIT_SUCCESS;
+}
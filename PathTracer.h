@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Scene.h"
+
+//CPU PATH-TRACED REFERENCE RENDERER ===============================================================================================================
+//
+// --pathtrace [prefix]          trace the scene on the cpu without a window, write <prefix>.ppm and <prefix>.pfm (default "reference")
+// --pathtrace-spp <n>           samples per pixel (default 64)
+// --pathtrace-bounces <n>       indirect diffuse bounces (default 2)
+// --pathtrace-threads <n>       worker threads (default: one per hardware thread)
+//
+// takes the same draw list, textures and lights as the GL loop. all triangles go into one world-space SAH BVH which is
+// traversed by packets of 8 rays (a 4x2 pixel block for camera rays) through the USimdFloat wrappers. direct lighting
+// uses the fragment shader's terms (diffuse, phong specular, tinted second light) with shadow rays, and the shader's
+// constant ambient is replaced by a uniform environment of the same radiance seen through the diffuse bounces, so
+// unoccluded surfaces match the rasteriser and the difference is shadows, occlusion and inter-reflection.
+// the image converges progressively: one sample per pixel per pass, files are refreshed at 1, 2, 4, 8... spp.
+
+struct UPathTracerConfig
+{
+	bool enabled = false;
+	std::string outPrefix = "reference";
+	int samples = 64;
+	int bounces = 2;
+	int threads = 0;
+};
+
+bool UParsePathTracerArgs(int argc, char* argv[], UPathTracerConfig& config);
+
+//path tracer mode entry point used by main() (returns the process exit code)
+int URunPathTracer(const UPathTracerConfig& config, const std::vector<UDrawItem>& items, const USceneGraph& scene, const std::vector<USceneTexture>& textures,
+	const USceneLighting& lighting, int width, int height, const glm::vec3& cameraPos, const glm::vec3& cameraFront, const glm::vec3& cameraUp);
@@ -0,0 +1,368 @@
+#include "RayTracing.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "Materials.h"
+#include "Trace.h"
+
+using namespace std;
+
+namespace
+{
+	const int SAH_BINS = 12;
+	const int MAX_LEAF_SIZE = 8;		//leaves are never bigger than this, even if SAH would prefer it
+	const float PI = 3.14159265f;
+
+	struct BuildRef
+	{
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+		glm::vec3 centroid;
+		int triangle;
+	};
+
+	struct Bin
+	{
+		glm::vec3 boundsMin = glm::vec3(1e30f);
+		glm::vec3 boundsMax = glm::vec3(-1e30f);
+		int count = 0;
+	};
+
+	float UArea(const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+	{
+		glm::vec3 d = glm::max(boundsMax - boundsMin, glm::vec3(0.0f));
+		return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+	}
+
+	//binned SAH build of refs[first, first + count) into nodes[nodeIndex], children are appended as pairs
+	void UBuildNode(UBvh& bvh, vector<BuildRef>& refs, int nodeIndex, int first, int count)
+	{
+		glm::vec3 boundsMin(1e30f), boundsMax(-1e30f), centroidMin(1e30f), centroidMax(-1e30f);
+		for (int i = first; i < first + count; i++)
+		{
+			boundsMin = glm::min(boundsMin, refs[i].boundsMin);
+			boundsMax = glm::max(boundsMax, refs[i].boundsMax);
+			centroidMin = glm::min(centroidMin, refs[i].centroid);
+			centroidMax = glm::max(centroidMax, refs[i].centroid);
+		}
+		bvh.nodes[nodeIndex].boundsMin = boundsMin;
+		bvh.nodes[nodeIndex].boundsMax = boundsMax;
+
+		//best split over all axes (cost of a node visit = one triangle test)
+		float bestCost = 1e30f;
+		int bestAxis = -1;
+		int bestSplit = 0;
+		float parentArea = UArea(boundsMin, boundsMax);
+		for (int axis = 0; axis < 3 && count > 1; axis++)
+		{
+			float extent = centroidMax[axis] - centroidMin[axis];
+			if (extent <= 0.0f)
+				continue;
+
+			Bin bins[SAH_BINS];
+			float scale = SAH_BINS / extent;
+			for (int i = first; i < first + count; i++)
+			{
+				int b = std::min(SAH_BINS - 1, (int)((refs[i].centroid[axis] - centroidMin[axis]) * scale));
+				bins[b].count++;
+				bins[b].boundsMin = glm::min(bins[b].boundsMin, refs[i].boundsMin);
+				bins[b].boundsMax = glm::max(bins[b].boundsMax, refs[i].boundsMax);
+			}
+
+			//sweep from the right to get the area/count of every right side, then from the left
+			float rightArea[SAH_BINS];
+			int rightCount[SAH_BINS];
+			glm::vec3 sweepMin(1e30f), sweepMax(-1e30f);
+			int sweepCount = 0;
+			for (int b = SAH_BINS - 1; b > 0; b--)
+			{
+				sweepMin = glm::min(sweepMin, bins[b].boundsMin);
+				sweepMax = glm::max(sweepMax, bins[b].boundsMax);
+				sweepCount += bins[b].count;
+				rightArea[b] = UArea(sweepMin, sweepMax);
+				rightCount[b] = sweepCount;
+			}
+			sweepMin = glm::vec3(1e30f);
+			sweepMax = glm::vec3(-1e30f);
+			sweepCount = 0;
+			for (int b = 0; b < SAH_BINS - 1; b++)
+			{
+				sweepMin = glm::min(sweepMin, bins[b].boundsMin);
+				sweepMax = glm::max(sweepMax, bins[b].boundsMax);
+				sweepCount += bins[b].count;
+				if (sweepCount == 0 || rightCount[b + 1] == 0)
+					continue;
+				float cost = 1.0f + (UArea(sweepMin, sweepMax) * sweepCount + rightArea[b + 1] * rightCount[b + 1]) / parentArea;
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestAxis = axis;
+					bestSplit = b;
+				}
+			}
+		}
+
+		//leaf when splitting doesn't pay off (or can't be done)
+		if (bestAxis < 0 || (bestCost >= count && count <= MAX_LEAF_SIZE))
+		{
+			bvh.nodes[nodeIndex].first = first;
+			bvh.nodes[nodeIndex].count = count;
+			bvh.nodes[nodeIndex].axis = 0;
+			return;
+		}
+
+		float scale = SAH_BINS / (centroidMax[bestAxis] - centroidMin[bestAxis]);
+		BuildRef* middle = std::partition(&refs[first], &refs[first] + count, [&](const BuildRef& ref)
+		{
+			return std::min(SAH_BINS - 1, (int)((ref.centroid[bestAxis] - centroidMin[bestAxis]) * scale)) <= bestSplit;
+		});
+		int leftCount = (int)(middle - &refs[first]);
+
+		int left = (int)bvh.nodes.size();
+		bvh.nodes.resize(bvh.nodes.size() + 2);
+		bvh.nodes[nodeIndex].first = left;
+		bvh.nodes[nodeIndex].count = 0;
+		bvh.nodes[nodeIndex].axis = bestAxis;
+		UBuildNode(bvh, refs, left, first, leftCount);
+		UBuildNode(bvh, refs, left + 1, first + leftCount, count - leftCount);
+	}
+
+	inline USimdFloat UHitBox(const UBvhNode& node, const URayPacket& ray)
+	{
+		USimdFloat tNear(0.0f);
+		USimdFloat tFar = ray.tMax;
+		for (int c = 0; c < 3; c++)
+		{
+			USimdFloat t0 = USimdMulAdd(USimdFloat(node.boundsMin[c]), ray.inverse[c], ray.originScaled[c]);
+			USimdFloat t1 = USimdMulAdd(USimdFloat(node.boundsMax[c]), ray.inverse[c], ray.originScaled[c]);
+			tNear = USimdMax(tNear, USimdMin(t0, t1));
+			tFar = USimdMin(tFar, USimdMax(t0, t1));
+		}
+		return ray.active & (tNear <= tFar);
+	}
+
+	//moller-trumbore for 8 rays against one triangle, returns the lanes with a closer hit
+	inline USimdFloat UHitTriangle(const URayTriangle& tri, const URayPacket& ray, USimdFloat& t, USimdFloat& u, USimdFloat& v)
+	{
+		USimdFloat e1[3] = { USimdFloat(tri.e1.x), USimdFloat(tri.e1.y), USimdFloat(tri.e1.z) };
+		USimdFloat e2[3] = { USimdFloat(tri.e2.x), USimdFloat(tri.e2.y), USimdFloat(tri.e2.z) };
+		const USimdFloat* d = ray.direction;
+
+		USimdFloat p[3] = { d[1] * e2[2] - d[2] * e2[1], d[2] * e2[0] - d[0] * e2[2], d[0] * e2[1] - d[1] * e2[0] };
+		USimdFloat det = USimdMulAdd(e1[0], p[0], USimdMulAdd(e1[1], p[1], e1[2] * p[2]));
+		USimdFloat inverseDet = USimdFloat(1.0f) / det;
+
+		USimdFloat s[3] = { ray.origin[0] - USimdFloat(tri.v0.x), ray.origin[1] - USimdFloat(tri.v0.y), ray.origin[2] - USimdFloat(tri.v0.z) };
+		u = USimdMulAdd(s[0], p[0], USimdMulAdd(s[1], p[1], s[2] * p[2])) * inverseDet;
+
+		USimdFloat q[3] = { s[1] * e1[2] - s[2] * e1[1], s[2] * e1[0] - s[0] * e1[2], s[0] * e1[1] - s[1] * e1[0] };
+		v = USimdMulAdd(d[0], q[0], USimdMulAdd(d[1], q[1], d[2] * q[2])) * inverseDet;
+		t = USimdMulAdd(e2[0], q[0], USimdMulAdd(e2[1], q[1], e2[2] * q[2])) * inverseDet;
+
+		USimdFloat zero(0.0f);
+		return ray.active & (USimdMax(det, -det) > USimdFloat(1e-12f)) & (u >= zero) & (v >= zero) & (u + v <= USimdFloat(1.0f))
+			& (t > USimdFloat(URAY_EPSILON)) & (t < ray.tMax);
+	}
+
+	glm::vec3 UTexel(const USoftTexture& texture, int x, int y)
+	{
+		uint32_t texel = texture.texels[(size_t)y * texture.width + x];
+		return glm::vec3(texel & 0xFF, (texel >> 8) & 0xFF, (texel >> 16) & 0xFF) * (1.0f / 255.0f);
+	}
+
+	int UWrap(int i, int size, bool repeat)
+	{
+		if (repeat)
+			return ((i % size) + size) % size;
+		return std::min(std::max(i, 0), size - 1);
+	}
+}
+
+//BVH ==============================================================================================================================================
+
+void UBuildBvh(const vector<UDrawItem>& items, const USceneGraph& scene, UBvh& bvh)
+{
+	UTRACE_SCOPE("build bvh");
+
+	//flatten every draw into world space triangles
+	vector<URayTriangle> triangles;
+	vector<URayShading> shading;
+	for (const UDrawItem& item : items)
+	{
+		const glm::mat4& model = scene.world[item.node];
+		glm::mat3 normalMatrix = glm::mat3(glm::transpose(glm::inverse(model)));
+		const GLMesh& mesh = *item.mesh;
+		for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+		{
+			glm::vec3 position[3];
+			URayShading shade;
+			for (int k = 0; k < 3; k++)
+			{
+				const float* v = &mesh.vertices[mesh.indices[i + k] * FLOATS_PER_MESH_VERTEX];
+				position[k] = glm::vec3(model * glm::vec4(v[0], v[1], v[2], 1.0f));
+				shade.normal[k] = normalMatrix * glm::vec3(v[MESH_NORMAL_OFFSET], v[MESH_NORMAL_OFFSET + 1], v[MESH_NORMAL_OFFSET + 2]);
+				shade.uv[k] = glm::vec2(v[MESH_TEXCOORD_OFFSET], v[MESH_TEXCOORD_OFFSET + 1]);
+			}
+			shade.texture = item.texture;
+			shade.shininess = UMaterialGet(item.material).shininess;
+
+			URayTriangle triangle = { position[0], position[1] - position[0], position[2] - position[0] };
+			triangles.push_back(triangle);
+			shading.push_back(shade);
+		}
+	}
+
+	vector<BuildRef> refs(triangles.size());
+	for (size_t i = 0; i < triangles.size(); i++)
+	{
+		glm::vec3 a = triangles[i].v0;
+		glm::vec3 b = a + triangles[i].e1;
+		glm::vec3 c = a + triangles[i].e2;
+		refs[i].boundsMin = glm::min(a, glm::min(b, c));
+		refs[i].boundsMax = glm::max(a, glm::max(b, c));
+		refs[i].centroid = (refs[i].boundsMin + refs[i].boundsMax) * 0.5f;
+		refs[i].triangle = (int)i;
+	}
+
+	bvh.nodes.clear();
+	bvh.nodes.reserve(triangles.size() * 2 + 1);
+	bvh.nodes.resize(1);
+	if (!refs.empty())
+		UBuildNode(bvh, refs, 0, 0, (int)refs.size());
+	else
+		bvh.nodes[0] = UBvhNode{ glm::vec3(0.0f), 0, glm::vec3(0.0f), 0, 0 };
+
+	//store the triangles in leaf order so a leaf is one contiguous run
+	bvh.triangles.resize(refs.size());
+	bvh.shading.resize(refs.size());
+	for (size_t i = 0; i < refs.size(); i++)
+	{
+		bvh.triangles[i] = triangles[refs[i].triangle];
+		bvh.shading[i] = shading[refs[i].triangle];
+	}
+}
+
+//PACKET TRAVERSAL =================================================================================================================================
+
+void UMakePacket(const URayLane lanes[USIMD_WIDTH], float tMax, URayPacket& packet)
+{
+	float origin[3][USIMD_WIDTH], direction[3][USIMD_WIDTH], inverse[3][USIMD_WIDTH];
+	int32_t active[USIMD_WIDTH];
+	int firstActive = -1;
+	for (int i = 0; i < USIMD_WIDTH; i++)
+	{
+		active[i] = lanes[i].active ? -1 : 0;
+		if (lanes[i].active && firstActive < 0)
+			firstActive = i;
+		for (int c = 0; c < 3; c++)
+		{
+			origin[c][i] = lanes[i].origin[c];
+			direction[c][i] = lanes[i].direction[c];
+			//keep the slab test free of 0 * inf
+			float d = fabs(direction[c][i]) < 1e-20f ? (direction[c][i] < 0.0f ? -1e-20f : 1e-20f) : direction[c][i];
+			inverse[c][i] = 1.0f / d;
+		}
+	}
+	for (int c = 0; c < 3; c++)
+	{
+		packet.origin[c] = USimdFloat::Load(origin[c]);
+		packet.direction[c] = USimdFloat::Load(direction[c]);
+		packet.inverse[c] = USimdFloat::Load(inverse[c]);
+		packet.originScaled[c] = -(packet.origin[c] * packet.inverse[c]);
+		packet.sign[c] = firstActive >= 0 && direction[c][firstActive] < 0.0f ? 1 : 0;
+	}
+	packet.tMax = USimdFloat(tMax);
+	packet.active = USimdAsFloat(USimdInt::Load(active));
+}
+
+void UTracePacket(const UBvh& bvh, URayPacket& ray, bool occlusion, int32_t triangle[USIMD_WIDTH], float u[USIMD_WIDTH], float v[USIMD_WIDTH])
+{
+	USimdInt hitTriangle(-1);
+	USimdFloat hitU(0.0f), hitV(0.0f);
+
+	int stack[64];
+	int top = 0;
+	stack[top++] = 0;
+	while (top > 0)
+	{
+		const UBvhNode& node = bvh.nodes[stack[--top]];
+		if (!USimdMask(UHitBox(node, ray)))
+			continue;
+
+		if (node.count == 0)
+		{
+			//far child first so the near one is popped next
+			int nearChild = node.first + ray.sign[node.axis];
+			stack[top++] = node.first + 1 - ray.sign[node.axis];
+			stack[top++] = nearChild;
+			continue;
+		}
+
+		for (int i = node.first; i < node.first + node.count; i++)
+		{
+			USimdFloat t, tu, tv;
+			USimdFloat hit = UHitTriangle(bvh.triangles[i], ray, t, tu, tv);
+			if (!USimdMask(hit))
+				continue;
+			if (occlusion)
+			{
+				hitTriangle = USimdSelect(hit, USimdInt(i), hitTriangle);
+				ray.active = USimdAndNot(hit, ray.active);
+				if (!USimdMask(ray.active))
+					break;
+				continue;
+			}
+			ray.tMax = USimdSelect(hit, t, ray.tMax);
+			hitU = USimdSelect(hit, tu, hitU);
+			hitV = USimdSelect(hit, tv, hitV);
+			hitTriangle = USimdSelect(hit, USimdInt(i), hitTriangle);
+		}
+		if (occlusion && !USimdMask(ray.active))
+			break;
+	}
+
+	hitTriangle.Store(triangle);
+	if (u)
+		hitU.Store(u);
+	if (v)
+		hitV.Store(v);
+}
+
+//SAMPLING =========================================================================================================================================
+
+glm::vec3 USampleTexture(const USoftTexture& texture, glm::vec2 uv)
+{
+	if (texture.texels.empty())
+		return glm::vec3(1.0f);
+
+	if (texture.repeat)
+		uv = glm::vec2(uv.x - floor(uv.x), uv.y - floor(uv.y));
+	else
+		uv = glm::vec2(std::min(std::max(uv.x, 0.0f), 1.0f), std::min(std::max(uv.y, 0.0f), 1.0f));
+
+	if (!texture.linear)
+		return UTexel(texture, std::min((int)(uv.x * texture.width), texture.width - 1), std::min((int)(uv.y * texture.height), texture.height - 1));
+
+	float x = uv.x * texture.width - 0.5f;
+	float y = uv.y * texture.height - 0.5f;
+	int x0 = (int)floor(x);
+	int y0 = (int)floor(y);
+	float fx = x - x0;
+	float fy = y - y0;
+	int xa = UWrap(x0, texture.width, texture.repeat), xb = UWrap(x0 + 1, texture.width, texture.repeat);
+	int ya = UWrap(y0, texture.height, texture.repeat), yb = UWrap(y0 + 1, texture.height, texture.repeat);
+	glm::vec3 top = glm::mix(UTexel(texture, xa, ya), UTexel(texture, xb, ya), fx);
+	glm::vec3 bottom = glm::mix(UTexel(texture, xa, yb), UTexel(texture, xb, yb), fx);
+	return glm::mix(top, bottom, fy);
+}
+
+glm::vec3 USampleHemisphere(const glm::vec3& n, float r1, float r2)
+{
+	float phi = 2.0f * PI * r1;
+	float radius = sqrt(r2);
+	glm::vec3 helper = fabs(n.x) > 0.5f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+	glm::vec3 tangent = glm::normalize(glm::cross(helper, n));
+	glm::vec3 bitangent = glm::cross(n, tangent);
+	return glm::normalize(tangent * (radius * cos(phi)) + bitangent * (radius * sin(phi)) + n * sqrt(std::max(0.0f, 1.0f - r2)));
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Scene.h"
+#include "Simd.h"
+#include "SoftwareRasterizer.h"
+
+//RAY TRACING ======================================================================================================================================
+//
+// shared by the path tracer (--pathtrace) and the lightmap baker (--bake-lightmap), no flags of its own.
+// UBuildBvh flattens a draw list into world-space triangles under a binned SAH BVH; UTracePacket traverses it with
+// packets of USIMD_WIDTH rays through the USimdFloat wrappers, for the closest hit or (occlusion) any hit.
+
+const float URAY_EPSILON = 1e-4f;
+
+//world space triangle in the form the intersection test wants
+struct URayTriangle
+{
+	glm::vec3 v0;
+	glm::vec3 e1;
+	glm::vec3 e2;
+};
+
+struct URayShading
+{
+	glm::vec3 normal[3];		//world space vertex normals
+	glm::vec2 uv[3];
+	int texture;
+	float shininess;
+};
+
+struct UBvhNode
+{
+	glm::vec3 boundsMin;
+	int first;					//first triangle (leaf) or left child (interior, right child is first + 1)
+	glm::vec3 boundsMax;
+	int count;					//triangles in the leaf, 0 for interior nodes
+	int axis;					//split axis of interior nodes (for front to back traversal)
+};
+
+struct UBvh
+{
+	std::vector<UBvhNode> nodes;
+	std::vector<URayTriangle> triangles;		//in leaf order
+	std::vector<URayShading> shading;			//same order
+};
+
+//8 rays traced together (inactive lanes are ignored)
+struct URayPacket
+{
+	USimdFloat origin[3];
+	USimdFloat direction[3];
+	USimdFloat inverse[3];
+	USimdFloat originScaled[3];		//-origin * inverse, so a slab test is one multiply-add per plane
+	USimdFloat tMax;
+	USimdFloat active;
+	int sign[3];					//direction signs of the first active lane (traversal order)
+};
+
+//scalar description of one lane, turned into a packet by UMakePacket
+struct URayLane
+{
+	glm::vec3 origin;
+	glm::vec3 direction;
+	bool active;
+};
+
+void UBuildBvh(const std::vector<UDrawItem>& items, const USceneGraph& scene, UBvh& bvh);
+void UMakePacket(const URayLane lanes[USIMD_WIDTH], float tMax, URayPacket& packet);
+//closest hit (occlusion = false) or any hit (occlusion = true, hit lanes are dropped from ray.active as they are found);
+//triangle gets the index into bvh.triangles (-1 = miss), u and v the barycentrics (may be null)
+void UTracePacket(const UBvh& bvh, URayPacket& ray, bool occlusion, int32_t triangle[USIMD_WIDTH], float u[USIMD_WIDTH], float v[USIMD_WIDTH]);
+
+//pcg hash (deterministic per pixel/pass, so the image doesn't depend on the thread count)
+inline uint32_t UHash(uint32_t x)
+{
+	uint32_t state = x * 747796405u + 2891336453u;
+	uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+	return (word >> 22u) ^ word;
+}
+
+inline float URandom(uint32_t& state)
+{
+	state = UHash(state);
+	return (state >> 8) * (1.0f / 16777216.0f);
+}
+
+//scalar version of the rasteriser's sampler (bilinear / nearest, repeat / clamp, no mips)
+glm::vec3 USampleTexture(const USoftTexture& texture, glm::vec2 uv);
+//cosine weighted direction around n
+glm::vec3 USampleHemisphere(const glm::vec3& n, float r1, float r2);
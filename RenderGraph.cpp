@@ -0,0 +1,418 @@
+#include "RenderGraph.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <iostream>
+
+#include "GLStats.h"
+#include "Trace.h"
+
+using namespace std;
+
+namespace
+{
+	//scene textures stay bound to units 0..n, so textures are created on a unit none of them uses
+	const int SCRATCH_TEXTURE_UNIT = 30;
+
+	bool UIsDepthFormat(GLenum format)
+	{
+		return format == GL_DEPTH_COMPONENT16 || format == GL_DEPTH_COMPONENT24 || format == GL_DEPTH_COMPONENT32F
+			|| format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH32F_STENCIL8;
+	}
+
+	size_t UBytesPerPixel(GLenum format)
+	{
+		switch (format)
+		{
+		case GL_R8: return 1;
+		case GL_DEPTH_COMPONENT16: case GL_RG8: case GL_R16F: return 2;
+		case GL_RGBA16F: case GL_RG32F: case GL_DEPTH32F_STENCIL8: return 8;
+		case GL_RGBA32F: return 16;
+		default: return 4;		//RGBA8, R32F, RG16F, R11F_G11F_B10F, DEPTH24_STENCIL8, DEPTH_COMPONENT24/32F
+		}
+	}
+
+	const char* UFormatName(GLenum format)
+	{
+		switch (format)
+		{
+		case GL_RGBA8: return "RGBA8";
+		case GL_RGBA16F: return "RGBA16F";
+		case GL_R11F_G11F_B10F: return "R11G11B10F";
+		case GL_R8: return "R8";
+		case GL_R32F: return "R32F";
+		case GL_DEPTH24_STENCIL8: return "D24S8";
+		case GL_DEPTH_COMPONENT32F: return "D32F";
+		case GL_DEPTH_COMPONENT24: return "D24";
+		case GL_DEPTH_COMPONENT16: return "D16";
+		default: return "?";
+		}
+	}
+
+	bool UTouches(const vector<int>& list, int resource)
+	{
+		return find(list.begin(), list.end(), resource) != list.end();
+	}
+
+	//passes a pass has to run after: writers of what it reads that were declared before it (or any writer, if none was)
+	vector<int> UDependencies(const URenderGraph& graph, int pass)
+	{
+		vector<int> dependencies;
+		for (int resource : graph.passes[pass].reads)
+		{
+			vector<int> earlier, later;
+			for (int other = 0; other < (int)graph.passes.size(); other++)
+			{
+				if (other != pass && UTouches(graph.passes[other].writes, resource))
+					(other < pass ? earlier : later).push_back(other);
+			}
+			const vector<int>& writers = earlier.empty() ? later : earlier;
+			dependencies.insert(dependencies.end(), writers.begin(), writers.end());
+		}
+		//a pass writing what an earlier pass wrote (e.g. a depth pre-pass) keeps the declared order
+		for (int resource : graph.passes[pass].writes)
+		{
+			for (int other = 0; other < pass; other++)
+			{
+				if (UTouches(graph.passes[other].writes, resource))
+					dependencies.push_back(other);
+			}
+		}
+		return dependencies;
+	}
+
+	double UMegabytes(size_t bytes)
+	{
+		return bytes / (1024.0 * 1024.0);
+	}
+}
+
+bool UParseRenderGraphArgs(int argc, char* argv[], bool& dump)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--render-graph-dump") == 0)
+			dump = true;
+	}
+	return true;
+}
+
+int URenderGraphImport(URenderGraph& graph, const char* name, int width, int height)
+{
+	graph.resources.push_back({ name, width, height, 0, true, false, -1, -1, -1 });
+	graph.compiled = false;
+	return (int)graph.resources.size() - 1;
+}
+
+int URenderGraphCreate(URenderGraph& graph, const char* name, int width, int height, GLenum format)
+{
+	graph.resources.push_back({ name, width, height, format, false, false, -1, -1, -1 });
+	graph.compiled = false;
+	return (int)graph.resources.size() - 1;
+}
+
+int URenderGraphCreatePersistent(URenderGraph& graph, const char* name, int width, int height, GLenum format)
+{
+	graph.resources.push_back({ name, width, height, format, false, true, -1, -1, -1 });
+	graph.compiled = false;
+	return (int)graph.resources.size() - 1;
+}
+
+void URenderGraphSetImportedSize(URenderGraph& graph, int resource, int width, int height)
+{
+	graph.resources[resource].width = width;
+	graph.resources[resource].height = height;
+}
+
+int URenderGraphAddPass(URenderGraph& graph, const char* name, const std::function<void()>& execute, bool sideEffects)
+{
+	URenderPass pass;
+	pass.name = name;
+	pass.execute = execute;
+	pass.sideEffects = sideEffects;
+	pass.culled = false;
+	graph.passes.push_back(std::move(pass));
+	graph.compiled = false;
+	return (int)graph.passes.size() - 1;
+}
+
+void URenderGraphRead(URenderGraph& graph, int pass, int resource)
+{
+	graph.passes[pass].reads.push_back(resource);
+	graph.compiled = false;
+}
+
+void URenderGraphWrite(URenderGraph& graph, int pass, int resource)
+{
+	graph.passes[pass].writes.push_back(resource);
+	graph.compiled = false;
+}
+
+bool URenderGraphCompile(URenderGraph& graph)
+{
+	UTRACE_SCOPE("URenderGraphCompile");
+	URenderGraphDestroy(graph);
+	int passCount = (int)graph.passes.size();
+
+	//cull: start from passes with visible results and pull in whatever they depend on
+	vector<vector<int>> dependencies(passCount);
+	vector<int> stack;
+	for (int pass = 0; pass < passCount; pass++)
+	{
+		dependencies[pass] = UDependencies(graph, pass);
+		bool root = graph.passes[pass].sideEffects;
+		for (int resource : graph.passes[pass].writes)
+			root = root || graph.resources[resource].imported;
+		graph.passes[pass].culled = !root;
+		if (root)
+			stack.push_back(pass);
+	}
+	while (!stack.empty())
+	{
+		int pass = stack.back();
+		stack.pop_back();
+		for (int dependency : dependencies[pass])
+		{
+			if (graph.passes[dependency].culled)
+			{
+				graph.passes[dependency].culled = false;
+				stack.push_back(dependency);
+			}
+		}
+	}
+
+	//order: repeatedly take the first declared pass whose dependencies all ran
+	vector<bool> done(passCount, false);
+	graph.order.clear();
+	int remaining = 0;
+	for (const URenderPass& pass : graph.passes)
+		remaining += pass.culled ? 0 : 1;
+	while ((int)graph.order.size() < remaining)
+	{
+		int next = -1;
+		for (int pass = 0; pass < passCount && next < 0; pass++)
+		{
+			if (graph.passes[pass].culled || done[pass])
+				continue;
+			bool ready = true;
+			for (int dependency : dependencies[pass])
+				ready = ready && (done[dependency] || graph.passes[dependency].culled);
+			if (ready)
+				next = pass;
+		}
+		if (next < 0)
+		{
+			cerr << "ERROR: render graph has a cycle between its passes" << endl;
+			return false;
+		}
+		done[next] = true;
+		graph.order.push_back(next);
+	}
+
+	//lifetimes in compiled order
+	for (URenderResource& resource : graph.resources)
+		resource.physical = resource.firstPass = resource.lastPass = -1;
+	for (int position = 0; position < (int)graph.order.size(); position++)
+	{
+		const URenderPass& pass = graph.passes[graph.order[position]];
+		for (const vector<int>* list : { &pass.reads, &pass.writes })
+		{
+			for (int id : *list)
+			{
+				URenderResource& resource = graph.resources[id];
+				if (resource.firstPass < 0)
+					resource.firstPass = position;
+				resource.lastPass = position;
+			}
+		}
+		for (int id : pass.reads)
+		{
+			bool written = false;
+			for (int before = 0; before < position && !written; before++)
+				written = UTouches(graph.passes[graph.order[before]].writes, id);
+			if (!written && !graph.resources[id].imported && !graph.resources[id].persistent && !UTouches(pass.writes, id))
+				cout << "WARNING: render graph pass " << pass.name << " reads " << graph.resources[id].name << " before anything writes it" << endl;
+		}
+	}
+
+	//alias: in order of first use, reuse a texture of the same size/format that nothing alive is using any more
+	//(persistent targets get a texture nothing else can take)
+	vector<int> transients;
+	graph.transientBytes = graph.unaliasedBytes = graph.persistentBytes = 0;
+	for (int id = 0; id < (int)graph.resources.size(); id++)
+	{
+		URenderResource& resource = graph.resources[id];
+		if (resource.imported || resource.firstPass < 0)
+			continue;
+		if (resource.persistent)
+		{
+			graph.textures.push_back({ resource.width, resource.height, resource.format, UGpuTexture(), INT_MAX });
+			resource.physical = (int)graph.textures.size() - 1;
+			graph.persistentBytes += (size_t)resource.width * resource.height * UBytesPerPixel(resource.format);
+		}
+		else
+			transients.push_back(id);
+	}
+	stable_sort(transients.begin(), transients.end(), [&](int a, int b) { return graph.resources[a].firstPass < graph.resources[b].firstPass; });
+	for (int id : transients)
+	{
+		URenderResource& resource = graph.resources[id];
+		size_t bytes = (size_t)resource.width * resource.height * UBytesPerPixel(resource.format);
+		graph.unaliasedBytes += bytes;
+		for (int t = 0; t < (int)graph.textures.size() && resource.physical < 0; t++)
+		{
+			URenderTexture& texture = graph.textures[t];
+			if (texture.width == resource.width && texture.height == resource.height && texture.format == resource.format && texture.lastPass < resource.firstPass)
+				resource.physical = t;
+		}
+		if (resource.physical < 0)
+		{
+			graph.textures.push_back({ resource.width, resource.height, resource.format, UGpuTexture(), -1 });
+			resource.physical = (int)graph.textures.size() - 1;
+			graph.transientBytes += bytes;
+		}
+		graph.textures[resource.physical].lastPass = resource.lastPass;
+	}
+
+	//the textures (linear + clamped, so any later pass can sample them)
+	glActiveTexture(GL_TEXTURE0 + SCRATCH_TEXTURE_UNIT);
+	for (URenderTexture& texture : graph.textures)
+	{
+		texture.texture.Create("render graph target");
+		glBindTexture(GL_TEXTURE_2D, texture.texture);
+		glTexStorage2D(GL_TEXTURE_2D, 1, texture.format, texture.width, texture.height);
+		texture.texture.SetBytes((size_t)texture.width * texture.height * UBytesPerPixel(texture.format));
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glActiveTexture(GL_TEXTURE0);
+
+	//one framebuffer per pass out of what it writes
+	for (int id : graph.order)
+	{
+		URenderPass& pass = graph.passes[id];
+		bool toDefault = false, toTexture = false;
+		for (int resource : pass.writes)
+			(graph.resources[resource].imported ? toDefault : toTexture) = true;
+		if (toDefault && toTexture)
+		{
+			cerr << "ERROR: render graph pass " << pass.name << " writes the backbuffer and a texture" << endl;
+			return false;
+		}
+		if (!toTexture)
+			continue;
+
+		pass.framebuffer.Create(pass.name);
+		glBindFramebuffer(GL_FRAMEBUFFER, pass.framebuffer);
+		vector<GLenum> drawBuffers;
+		for (int resource : pass.writes)
+		{
+			const URenderResource& target = graph.resources[resource];
+			GLuint texture = graph.textures[target.physical].texture;
+			if (UIsDepthFormat(target.format))
+			{
+				GLenum attachment = target.format == GL_DEPTH24_STENCIL8 || target.format == GL_DEPTH32F_STENCIL8 ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT;
+				glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, texture, 0);
+			}
+			else
+			{
+				GLenum attachment = GL_COLOR_ATTACHMENT0 + (GLenum)drawBuffers.size();
+				glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, texture, 0);
+				drawBuffers.push_back(attachment);
+			}
+		}
+		if (drawBuffers.empty())
+			glDrawBuffer(GL_NONE);
+		else
+			glDrawBuffers((GLsizei)drawBuffers.size(), drawBuffers.data());
+		GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+		if (status != GL_FRAMEBUFFER_COMPLETE)
+		{
+			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+			cerr << "ERROR: render graph pass " << pass.name << " framebuffer incomplete (0x" << hex << status << dec << ")" << endl;
+			return false;
+		}
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	graph.compiled = true;
+	cout << "INFO: render graph, " << graph.order.size() << " of " << passCount << " passes, " << graph.textures.size() << " transient textures "
+		<< UMegabytes(graph.transientBytes) << " MB (" << UMegabytes(graph.unaliasedBytes) << " MB without aliasing)";
+	if (graph.persistentBytes > 0)
+		cout << ", " << UMegabytes(graph.persistentBytes) << " MB persistent";
+	cout << endl;
+	return true;
+}
+
+void URenderGraphExecute(URenderGraph& graph)
+{
+	if (!graph.compiled)
+		return;
+	for (int id : graph.order)
+	{
+		URenderPass& pass = graph.passes[id];
+		UTraceFrameSection(pass.name);
+		glBindFramebuffer(GL_FRAMEBUFFER, pass.framebuffer);
+		if (!pass.writes.empty())
+			glViewport(0, 0, graph.resources[pass.writes[0]].width, graph.resources[pass.writes[0]].height);
+		pass.execute();
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void URenderGraphPrint(const URenderGraph& graph, std::ostream& out)
+{
+	out << "INFO: render graph passes (in execution order)" << endl;
+	for (size_t position = 0; position < graph.order.size(); position++)
+	{
+		const URenderPass& pass = graph.passes[graph.order[position]];
+		out << "INFO:   " << position << " " << pass.name;
+		for (size_t i = 0; i < pass.reads.size(); i++)
+			out << (i == 0 ? "  reads " : ", ") << graph.resources[pass.reads[i]].name;
+		for (size_t i = 0; i < pass.writes.size(); i++)
+			out << (i == 0 ? "  writes " : ", ") << graph.resources[pass.writes[i]].name;
+		out << endl;
+	}
+	for (const URenderPass& pass : graph.passes)
+	{
+		if (pass.culled)
+			out << "INFO:   culled " << pass.name << " (nothing reads what it writes)" << endl;
+	}
+	out << "INFO: render graph resources" << endl;
+	for (const URenderResource& resource : graph.resources)
+	{
+		out << "INFO:   " << resource.name << " " << resource.width << "x" << resource.height;
+		if (resource.imported)
+			out << " imported";
+		else if (resource.persistent && resource.firstPass >= 0)
+			out << " " << UFormatName(resource.format) << " " << UMegabytes((size_t)resource.width * resource.height * UBytesPerPixel(resource.format))
+				<< " MB persistent, passes " << resource.firstPass << "-" << resource.lastPass << ", texture " << resource.physical;
+		else if (resource.firstPass < 0)
+			out << " " << UFormatName(resource.format) << " unused";
+		else
+			out << " " << UFormatName(resource.format) << " " << UMegabytes((size_t)resource.width * resource.height * UBytesPerPixel(resource.format))
+				<< " MB, passes " << resource.firstPass << "-" << resource.lastPass << ", texture " << resource.physical;
+		out << endl;
+	}
+	out << "INFO: peak transient memory " << UMegabytes(graph.transientBytes) << " MB in " << graph.textures.size() << " textures ("
+		<< UMegabytes(graph.unaliasedBytes) << " MB without aliasing)" << endl;
+}
+
+void URenderGraphDestroy(URenderGraph& graph)
+{
+	for (URenderPass& pass : graph.passes)
+		pass.framebuffer.Reset();
+	//the textures' handles delete them
+	graph.textures.clear();
+	graph.compiled = false;
+}
+
+GLuint URenderGraphTexture(const URenderGraph& graph, int resource)
+{
+	int physical = graph.resources[resource].physical;
+	return physical < 0 ? 0 : graph.textures[physical].texture;
+}
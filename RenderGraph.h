@@ -0,0 +1,91 @@
+#pragma once
+
+#include <functional>
+#include <iosfwd>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "GpuResources.h"
+
+//RENDER GRAPH =====================================================================================================================================
+//
+// --render-graph-dump   print the compiled graph (pass order, culled passes, resource lifetimes, aliasing) at startup
+//
+// passes declare which resources they read and write and get an execute callback; the frame is built once and compiled:
+// passes that don't (indirectly) feed an imported resource (the backbuffer) or aren't marked as having side effects are
+// culled, the rest are ordered so every writer runs before its readers (declaration order otherwise), and each transient
+// target gets a lifetime [first pass, last pass]. transients with the same size and format whose lifetimes don't overlap
+// share one texture, so adding passes only costs memory for what is alive at the same time. each pass draws into a
+// framebuffer made of the targets it writes (colour attachments in write order, depth formats as the depth attachment).
+// persistent targets (caches) keep their contents between frames: they get a texture of their own and are never aliased.
+
+//one target (transient textures are owned by the graph, imported ones are the default framebuffer)
+struct URenderResource
+{
+	const char* name;
+	int width;
+	int height;
+	GLenum format;			//internal format (0 for imported)
+	bool imported;
+	bool persistent;		//keeps its contents between frames (never aliased)
+	int physical;			//texture it is aliased onto after compiling (-1 = none / imported)
+	int firstPass;			//position in the compiled order of its first and last use (-1 = unused)
+	int lastPass;
+};
+
+struct URenderPass
+{
+	const char* name;
+	std::function<void()> execute;
+	std::vector<int> reads;
+	std::vector<int> writes;
+	bool sideEffects;		//never culled
+	bool culled;
+	UGpuFramebuffer framebuffer;	//0 = default framebuffer
+};
+
+//a real texture, shared by every resource aliased onto it
+struct URenderTexture
+{
+	int width;
+	int height;
+	GLenum format;
+	UGpuTexture texture;
+	int lastPass;			//last use of whatever is aliased onto it so far (while compiling)
+};
+
+struct URenderGraph
+{
+	std::vector<URenderResource> resources;
+	std::vector<URenderPass> passes;
+	std::vector<int> order;					//passes to run, in order
+	std::vector<URenderTexture> textures;
+	size_t transientBytes = 0;				//memory of the aliased textures
+	size_t unaliasedBytes = 0;				//what the transients would take with a texture each
+	size_t persistentBytes = 0;
+	bool compiled = false;
+};
+
+bool UParseRenderGraphArgs(int argc, char* argv[], bool& dump);
+
+//resources (returns the resource id)
+int URenderGraphImport(URenderGraph& graph, const char* name, int width, int height);
+int URenderGraphCreate(URenderGraph& graph, const char* name, int width, int height, GLenum format);
+int URenderGraphCreatePersistent(URenderGraph& graph, const char* name, int width, int height, GLenum format);
+//imported targets can change size between frames (window resize), passes writing them get the new viewport
+void URenderGraphSetImportedSize(URenderGraph& graph, int resource, int width, int height);
+
+//passes (returns the pass id)
+int URenderGraphAddPass(URenderGraph& graph, const char* name, const std::function<void()>& execute, bool sideEffects = false);
+void URenderGraphRead(URenderGraph& graph, int pass, int resource);
+void URenderGraphWrite(URenderGraph& graph, int pass, int resource);
+
+//culls, orders, aliases and creates the textures and framebuffers (needs a current GL context)
+bool URenderGraphCompile(URenderGraph& graph);
+void URenderGraphExecute(URenderGraph& graph);
+void URenderGraphPrint(const URenderGraph& graph, std::ostream& out);
+void URenderGraphDestroy(URenderGraph& graph);
+
+//texture a resource lives in after compiling (0 for imported / culled)
+GLuint URenderGraphTexture(const URenderGraph& graph, int resource);
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Image.h"
+#include "Mesh.h"
+#include "SceneGraph.h"
+
+//SCENE DESCRIPTION SHARED BY THE GL LOOP AND THE CPU RENDERERS ====================================================================================
+
+//point light (GL only, the cpu renderers light with the two directional lights)
+struct UScenePointLight
+{
+	glm::vec3 position;
+	glm::vec3 color;
+};
+
+//the two directional lights (values the GL loop uploads as light.* uniforms, scene.frag tints the second one)
+struct USceneLighting
+{
+	glm::vec3 ambient = glm::vec3(0.5f);
+	glm::vec3 diffuse = glm::vec3(0.5f);
+	glm::vec3 specular = glm::vec3(1.0f);
+	glm::vec3 direction = glm::vec3(-5.2f, -1.0f, -0.3f);
+	glm::vec3 direction2 = glm::vec3(5.2f, -1.0f, 0.3f);
+	glm::vec3 tint2 = glm::vec3(1.0f, 0.5f, 0.25f);
+	//colours every material of the table starts with (Materials.h; the cpu renderers and the baker light with these)
+	glm::vec3 materialAmbient = glm::vec3(1.0f);
+	glm::vec3 materialDiffuse = glm::vec3(1.0f);
+	glm::vec3 materialSpecular = glm::vec3(1.0f);
+	std::vector<UScenePointLight> points;	//pointLights[] uniforms, none by default
+	bool shadows = false;					//the directional lights cast shadows (GL only, ShadowMaps.h)
+};
+
+//per material feature bits (scene file materials, used to pick the cheapest shader variant)
+enum UMaterialFlags : uint32_t
+{
+	UMATERIAL_SPECULAR = 1,			//has a specular highlight
+	UMATERIAL_ALPHA_TEST = 2,		//texels with alpha < 0.5 are cut out
+};
+
+//a loaded texture, the cpu copy stays around for the software renderers
+struct USceneTexture
+{
+	UImage image;
+	bool repeat;		//GL_REPEAT (otherwise GL_CLAMP_TO_EDGE)
+	bool linear;		//GL_LINEAR (otherwise GL_NEAREST)
+	UGpuTexture id;		//0 when running without a GL context
+};
+
+//one draw of the frame, in submission order
+struct UDrawItem
+{
+	const char* name;		//object group (used for trace sections)
+	const GLMesh* mesh;
+	int node;				//scene graph node, its world matrix is the model matrix
+	int texture;			//texture unit / index into the scene textures (from its material)
+	int material;			//index into the material table (Materials.h), which has its colours and shininess
+	uint32_t flags;			//UMaterialFlags (from its material)
+	int variant;			//shader variant it is drawn with (-1 until the GL side picks one)
+	bool isStatic;			//never moves (USCENE_DRAW_STATIC), its shadow is cached and it can be lightmapped
+	glm::vec4 lightmap;		//scale (xy) and offset (zw) of its square of the lightmap atlas, x = 0 when it is lit per pixel
+	bool vertexLit;			//its mesh's colour attribute holds baked lighting (rgb) and occlusion (a)
+};
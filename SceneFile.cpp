@@ -0,0 +1,742 @@
+#include "SceneFile.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <unordered_map>
+
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "Scene.h"
+#include "Trace.h"
+
+using namespace std;
+
+namespace
+{
+	typedef chrono::steady_clock Clock;
+
+	//JSON ========================================================================================================================================
+
+	struct JsonValue
+	{
+		enum Type { NONE, BOOLEAN, NUMBER, STRING, ARRAY, OBJECT };
+		Type type = NONE;
+		bool boolean = false;
+		double number = 0.0;
+		string text;
+		vector<JsonValue> items;
+		vector<pair<string, JsonValue> > members;
+
+		const JsonValue* Find(const char* key) const
+		{
+			for (const pair<string, JsonValue>& member : members)
+				if (member.first == key)
+					return &member.second;
+			return nullptr;
+		}
+	};
+
+	//small recursive descent parser (strings support the usual escapes, \u is kept as-is)
+	struct JsonParser
+	{
+		const char* p;
+		const char* end;
+		int line = 1;
+		string error;
+
+		void SkipSpace()
+		{
+			while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'))
+			{
+				if (*p == '\n')
+					line++;
+				p++;
+			}
+		}
+
+		bool Fail(const char* message)
+		{
+			if (error.empty())
+			{
+				ostringstream out;
+				out << message << " (line " << line << ")";
+				error = out.str();
+			}
+			return false;
+		}
+
+		bool ParseString(string& out)
+		{
+			p++;	//opening quote
+			while (p < end && *p != '"')
+			{
+				if (*p == '\\' && p + 1 < end)
+				{
+					p++;
+					switch (*p)
+					{
+					case 'n': out += '\n'; break;
+					case 't': out += '\t'; break;
+					case 'r': out += '\r'; break;
+					case 'b': out += '\b'; break;
+					case 'f': out += '\f'; break;
+					case 'u': out += "\\u"; break;
+					default: out += *p; break;
+					}
+				}
+				else
+				{
+					if (*p == '\n')
+						line++;
+					out += *p;
+				}
+				p++;
+			}
+			if (p >= end)
+				return Fail("unterminated string");
+			p++;
+			return true;
+		}
+
+		bool Parse(JsonValue& value)
+		{
+			SkipSpace();
+			if (p >= end)
+				return Fail("unexpected end of file");
+
+			if (*p == '{')
+			{
+				value.type = JsonValue::OBJECT;
+				p++;
+				SkipSpace();
+				if (p < end && *p == '}')
+				{
+					p++;
+					return true;
+				}
+				while (true)
+				{
+					SkipSpace();
+					if (p >= end || *p != '"')
+						return Fail("expected a key");
+					value.members.push_back(pair<string, JsonValue>());
+					if (!ParseString(value.members.back().first))
+						return false;
+					SkipSpace();
+					if (p >= end || *p != ':')
+						return Fail("expected ':'");
+					p++;
+					if (!Parse(value.members.back().second))
+						return false;
+					SkipSpace();
+					if (p < end && *p == ',')
+					{
+						p++;
+						continue;
+					}
+					if (p < end && *p == '}')
+					{
+						p++;
+						return true;
+					}
+					return Fail("expected ',' or '}'");
+				}
+			}
+			if (*p == '[')
+			{
+				value.type = JsonValue::ARRAY;
+				p++;
+				SkipSpace();
+				if (p < end && *p == ']')
+				{
+					p++;
+					return true;
+				}
+				while (true)
+				{
+					value.items.push_back(JsonValue());
+					if (!Parse(value.items.back()))
+						return false;
+					SkipSpace();
+					if (p < end && *p == ',')
+					{
+						p++;
+						continue;
+					}
+					if (p < end && *p == ']')
+					{
+						p++;
+						return true;
+					}
+					return Fail("expected ',' or ']'");
+				}
+			}
+			if (*p == '"')
+			{
+				value.type = JsonValue::STRING;
+				return ParseString(value.text);
+			}
+			if (end - p >= 4 && strncmp(p, "true", 4) == 0)
+			{
+				value.type = JsonValue::BOOLEAN;
+				value.boolean = true;
+				p += 4;
+				return true;
+			}
+			if (end - p >= 5 && strncmp(p, "false", 5) == 0)
+			{
+				value.type = JsonValue::BOOLEAN;
+				p += 5;
+				return true;
+			}
+			if (end - p >= 4 && strncmp(p, "null", 4) == 0)
+			{
+				p += 4;
+				return true;
+			}
+
+			char* numberEnd = nullptr;
+			value.number = strtod(p, &numberEnd);
+			if (numberEnd == p || numberEnd > end)
+				return Fail("unexpected character");
+			value.type = JsonValue::NUMBER;
+			p = numberEnd;
+			return true;
+		}
+	};
+
+	//COMPILER ====================================================================================================================================
+
+	struct StringTable
+	{
+		vector<char> blob;
+		unordered_map<string, uint32_t> offsets;
+
+		uint32_t Add(const string& text)
+		{
+			unordered_map<string, uint32_t>::iterator found = offsets.find(text);
+			if (found != offsets.end())
+				return found->second;
+			uint32_t offset = (uint32_t)blob.size();
+			blob.insert(blob.end(), text.begin(), text.end());
+			blob.push_back('\0');
+			offsets[text] = offset;
+			return offset;
+		}
+	};
+
+	const char* UString(const JsonValue& object, const char* key, const char* fallback)
+	{
+		const JsonValue* value = object.Find(key);
+		return value && value->type == JsonValue::STRING ? value->text.c_str() : fallback;
+	}
+
+	double UNumber(const JsonValue& object, const char* key, double fallback)
+	{
+		const JsonValue* value = object.Find(key);
+		return value && value->type == JsonValue::NUMBER ? value->number : fallback;
+	}
+
+	bool UBoolean(const JsonValue& object, const char* key, bool fallback)
+	{
+		const JsonValue* value = object.Find(key);
+		return value && value->type == JsonValue::BOOLEAN ? value->boolean : fallback;
+	}
+
+	glm::vec3 UVector(const JsonValue& object, const char* key, const glm::vec3& fallback)
+	{
+		const JsonValue* value = object.Find(key);
+		if (!value || value->type != JsonValue::ARRAY || value->items.size() != 3)
+			return fallback;
+		return glm::vec3((float)value->items[0].number, (float)value->items[1].number, (float)value->items[2].number);
+	}
+
+	//[degrees, x, y, z]
+	glm::quat UAxisAngle(const JsonValue& rotate, float times)
+	{
+		if (rotate.type != JsonValue::ARRAY || rotate.items.size() != 4)
+			return glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+		glm::vec3 axis((float)rotate.items[1].number, (float)rotate.items[2].number, (float)rotate.items[3].number);
+		return glm::angleAxis(glm::radians((float)rotate.items[0].number * times), glm::normalize(axis));
+	}
+
+	//looks a name up in a name -> index map, -1 (and an error) when it isn't there
+	int ULookup(const unordered_map<string, int>& map, const char* name, const char* what, const string& owner, bool& ok)
+	{
+		if (name == nullptr)
+			return -1;
+		unordered_map<string, int>::const_iterator found = map.find(name);
+		if (found == map.end())
+		{
+			cerr << "ERROR: scene: " << owner << " references unknown " << what << " \"" << name << "\"" << endl;
+			ok = false;
+			return -1;
+		}
+		return found->second;
+	}
+
+	template <class T>
+	uint64_t UAppend(vector<unsigned char>& image, const T* data, size_t count)
+	{
+		//16 byte aligned sections
+		image.resize((image.size() + 15) & ~(size_t)15, 0);
+		uint64_t offset = image.size();
+		if (count > 0)
+		{
+			image.resize(image.size() + sizeof(T) * count);
+			memcpy(&image[offset], data, sizeof(T) * count);
+		}
+		return offset;
+	}
+
+	//LOADING =====================================================================================================================================
+
+	//modification time and size, false when the file doesn't exist
+	bool UFileStamp(const string& file, long long& time, unsigned long long& bytes)
+	{
+		struct stat info;
+		if (stat(file.c_str(), &info) != 0)
+			return false;
+		time = (long long)info.st_mtime;
+		bytes = (unsigned long long)info.st_size;
+		return true;
+	}
+
+	bool UMapFile(const string& file, void*& data, size_t& bytes)
+	{
+#ifdef _WIN32
+		HANDLE handle = CreateFileA(file.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (handle == INVALID_HANDLE_VALUE)
+			return false;
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(handle, &size) || size.QuadPart == 0)
+		{
+			CloseHandle(handle);
+			return false;
+		}
+		HANDLE mapping = CreateFileMappingA(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+		CloseHandle(handle);
+		if (mapping == NULL)
+			return false;
+		data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		CloseHandle(mapping);	//the view keeps the mapping alive
+		bytes = (size_t)size.QuadPart;
+		return data != nullptr;
+#else
+		int fd = open(file.c_str(), O_RDONLY);
+		if (fd < 0)
+			return false;
+		struct stat info;
+		if (fstat(fd, &info) != 0 || info.st_size == 0)
+		{
+			close(fd);
+			return false;
+		}
+		data = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if (data == MAP_FAILED)
+		{
+			data = nullptr;
+			return false;
+		}
+		bytes = (size_t)info.st_size;
+		return true;
+#endif
+	}
+
+	void UUnmapFile(void* data, size_t bytes)
+	{
+#ifdef _WIN32
+		UnmapViewOfFile(data);
+#else
+		munmap(data, bytes);
+#endif
+	}
+
+	bool UInRange(const USceneFileHeader& header, uint64_t offset, uint64_t count, size_t elementSize)
+	{
+		return offset <= header.fileBytes && count * elementSize <= header.fileBytes - offset && offset % 4 == 0;
+	}
+
+	//point the scene at a file image (validates offsets and indices, no parsing)
+	bool UBindScene(const unsigned char* data, size_t bytes, USceneFile& scene, const string& file)
+	{
+		const USceneFileHeader* header = (const USceneFileHeader*)data;
+		if (bytes < sizeof(USceneFileHeader) || header->magic != USCENE_MAGIC || header->version != USCENE_VERSION || header->fileBytes != bytes)
+		{
+			cerr << "ERROR: " << file << " is not a version " << USCENE_VERSION << " scene file" << endl;
+			return false;
+		}
+		uint64_t nodes = header->nodeCount;
+		if (!UInRange(*header, header->meshOffset, header->meshCount, sizeof(USceneFileMesh))
+			|| !UInRange(*header, header->textureOffset, header->textureCount, sizeof(USceneFileTexture))
+			|| !UInRange(*header, header->materialOffset, header->materialCount, sizeof(USceneFileMaterial))
+			|| !UInRange(*header, header->parentOffset, nodes, sizeof(int32_t))
+			|| !UInRange(*header, header->translationOffset, nodes * 3, sizeof(float))
+			|| !UInRange(*header, header->rotationOffset, nodes * 4, sizeof(float))
+			|| !UInRange(*header, header->scaleOffset, nodes * 3, sizeof(float))
+			|| !UInRange(*header, header->drawOffset, nodes, sizeof(USceneFileDraw))
+			|| !UInRange(*header, header->nameOffset, nodes, sizeof(uint32_t))
+			|| !UInRange(*header, header->stringOffset, header->stringBytes, 1)
+			|| header->stringBytes == 0 || data[header->stringOffset + header->stringBytes - 1] != '\0')
+		{
+			cerr << "ERROR: " << file << " is truncated or corrupt" << endl;
+			return false;
+		}
+
+		scene.header = header;
+		scene.meshes = (const USceneFileMesh*)(data + header->meshOffset);
+		scene.textures = (const USceneFileTexture*)(data + header->textureOffset);
+		scene.materials = (const USceneFileMaterial*)(data + header->materialOffset);
+		scene.parents = (const int32_t*)(data + header->parentOffset);
+		scene.translations = (const float*)(data + header->translationOffset);
+		scene.rotations = (const float*)(data + header->rotationOffset);
+		scene.scales = (const float*)(data + header->scaleOffset);
+		scene.draws = (const USceneFileDraw*)(data + header->drawOffset);
+		scene.names = (const uint32_t*)(data + header->nameOffset);
+		scene.strings = (const char*)(data + header->stringOffset);
+
+		//indices and string offsets have to be usable without further checks (the blob ends in a NUL, so every offset
+		//inside it is a terminated string)
+		for (uint32_t i = 0; i < header->nodeCount; i++)
+		{
+			const USceneFileDraw& draw = scene.draws[i];
+			if (scene.parents[i] >= (int32_t)i || scene.names[i] >= header->stringBytes || draw.group >= header->stringBytes
+				|| draw.mesh >= (int32_t)header->meshCount || (draw.mesh >= 0 && (draw.material < 0 || draw.material >= (int32_t)header->materialCount)))
+			{
+				cerr << "ERROR: " << file << ": node " << i << " has invalid references" << endl;
+				return false;
+			}
+		}
+		for (uint32_t i = 0; i < header->materialCount; i++)
+		{
+			if (scene.materials[i].name >= header->stringBytes || scene.materials[i].texture >= (int32_t)header->textureCount)
+			{
+				cerr << "ERROR: " << file << ": material " << i << " has invalid references" << endl;
+				return false;
+			}
+		}
+		for (uint32_t i = 0; i < header->meshCount; i++)
+		{
+			if (scene.meshes[i].name >= header->stringBytes)
+			{
+				cerr << "ERROR: " << file << ": mesh " << i << " has an invalid name" << endl;
+				return false;
+			}
+		}
+		for (uint32_t i = 0; i < header->textureCount; i++)
+		{
+			if (scene.textures[i].name >= header->stringBytes || scene.textures[i].file >= header->stringBytes)
+			{
+				cerr << "ERROR: " << file << ": texture " << i << " has an invalid name or file" << endl;
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+//SETUP ============================================================================================================================================
+
+bool UParseSceneArgs(int argc, char* argv[], USceneFileConfig& config)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--scene") == 0)
+		{
+			if (i + 1 >= argc)
+			{
+				cerr << "ERROR: --scene needs a file" << endl;
+				return false;
+			}
+			config.file = argv[++i];
+		}
+		else if (strcmp(argv[i], "--scene-compile") == 0)
+		{
+			if (i + 2 >= argc)
+			{
+				cerr << "ERROR: --scene-compile needs <in.json> <out.bin>" << endl;
+				return false;
+			}
+			config.compileIn = argv[++i];
+			config.compileOut = argv[++i];
+		}
+	}
+	return true;
+}
+
+//COMPILE ==========================================================================================================================================
+
+bool UCompileScene(const std::string& jsonFile, std::vector<unsigned char>& image)
+{
+	UTRACE_SCOPE_ARG("compile scene", jsonFile.c_str());
+
+	ifstream in(jsonFile.c_str(), ios::binary);
+	if (!in)
+	{
+		cerr << "ERROR: could not open scene " << jsonFile << endl;
+		return false;
+	}
+	string text((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+
+	JsonValue root;
+	JsonParser parser;
+	parser.p = text.data();
+	parser.end = text.data() + text.size();
+	if (!parser.Parse(root) || root.type != JsonValue::OBJECT)
+	{
+		cerr << "ERROR: " << jsonFile << ": " << (parser.error.empty() ? "expected an object" : parser.error) << endl;
+		return false;
+	}
+
+	StringTable strings;
+	strings.Add("");
+	bool ok = true;
+	static const JsonValue empty;
+	const JsonValue* meshList = root.Find("meshes");
+	const JsonValue* textureList = root.Find("textures");
+	const JsonValue* materialList = root.Find("materials");
+	const JsonValue* nodeList = root.Find("nodes");
+
+	//meshes
+	vector<USceneFileMesh> meshes;
+	unordered_map<string, int> meshIndex;
+	for (const JsonValue& mesh : (meshList ? meshList : &empty)->items)
+	{
+		string name = UString(mesh, "name", "");
+		string type = UString(mesh, "type", "");
+		USceneFileMesh out = { strings.Add(name), 0, 0.0f, 0 };
+		if (type == "cylinder" || type == "flatCylinder")
+		{
+			out.type = type == "cylinder" ? USCENE_MESH_CYLINDER : USCENE_MESH_FLAT_CYLINDER;
+			out.parameter = (float)UNumber(mesh, "sections", 12.0);
+		}
+		else if (type == "plane")
+		{
+			out.type = USCENE_MESH_PLANE;
+			out.parameter = (float)UNumber(mesh, "scale", 1.0);
+		}
+		else if (type == "cube")
+			out.type = USCENE_MESH_CUBE;
+		else if (type == "rect")
+			out.type = USCENE_MESH_RECT;
+		else
+		{
+			cerr << "ERROR: scene: mesh \"" << name << "\" has unknown type \"" << type << "\"" << endl;
+			ok = false;
+		}
+		meshIndex[name] = (int)meshes.size();
+		meshes.push_back(out);
+	}
+
+	//textures (index = texture unit)
+	vector<USceneFileTexture> textures;
+	unordered_map<string, int> textureIndex;
+	for (const JsonValue& texture : (textureList ? textureList : &empty)->items)
+	{
+		string name = UString(texture, "name", "");
+		USceneFileTexture out;
+		out.name = strings.Add(name);
+		out.file = strings.Add(UString(texture, "file", ""));
+		out.repeat = UBoolean(texture, "repeat", false);
+		out.linear = UBoolean(texture, "linear", false);
+		out.rgba = strcmp(UString(texture, "format", "rgba"), "rgb") != 0;
+		out.channels = (uint8_t)UNumber(texture, "channels", 0.0);
+		textureIndex[name] = (int)textures.size();
+		textures.push_back(out);
+	}
+
+	//materials
+	vector<USceneFileMaterial> materials;
+	unordered_map<string, int> materialIndex;
+	for (const JsonValue& material : (materialList ? materialList : &empty)->items)
+	{
+		string name = UString(material, "name", "");
+		USceneFileMaterial out;
+		out.name = strings.Add(name);
+		out.texture = ULookup(textureIndex, UString(material, "texture", nullptr), "texture", "material " + name, ok);
+		out.shininess = (float)UNumber(material, "shininess", 1.0);
+		out.flags = (UBoolean(material, "specular", true) ? (uint32_t)UMATERIAL_SPECULAR : 0u) | (UBoolean(material, "alphaTest", false) ? (uint32_t)UMATERIAL_ALPHA_TEST : 0u);
+		materialIndex[name] = (int)materials.size();
+		materials.push_back(out);
+	}
+
+	//nodes (arrays expand in place, parents are looked up among the nodes emitted so far)
+	vector<int32_t> parents;
+	vector<float> translations, rotations, scales;
+	vector<USceneFileDraw> draws;
+	vector<uint32_t> names;
+	unordered_map<string, int> nodeIndex;
+	for (const JsonValue& node : (nodeList ? nodeList : &empty)->items)
+	{
+		string name = UString(node, "name", "");
+		int parent = ULookup(nodeIndex, UString(node, "parent", nullptr), "parent", "node " + name, ok);
+		glm::vec3 translation = UVector(node, "translation", glm::vec3(0.0f));
+		glm::vec3 scale = UVector(node, "scale", glm::vec3(1.0f));
+		glm::quat rotation(1.0f, 0.0f, 0.0f, 0.0f);
+		const JsonValue* rotate = node.Find("rotate");
+		if (rotate && rotate->type == JsonValue::ARRAY)
+			for (const JsonValue& step : rotate->items)
+				rotation = rotation * UAxisAngle(step, 1.0f);
+
+		USceneFileDraw draw = { -1, -1, strings.Add(UString(node, "group", name.c_str())), 0 };
+		if (UBoolean(node, "static", false) || (parent >= 0 && (draws[parent].flags & USCENE_DRAW_STATIC)))
+			draw.flags |= USCENE_DRAW_STATIC;
+		const char* mesh = UString(node, "mesh", nullptr);
+		if (mesh)
+		{
+			draw.mesh = ULookup(meshIndex, mesh, "mesh", "node " + name, ok);
+			draw.material = ULookup(materialIndex, UString(node, "material", ""), "material", "node " + name, ok);
+		}
+
+		int count = 1;
+		const JsonValue* array = node.Find("array");
+		const JsonValue* arrayRotate = array ? array->Find("rotate") : nullptr;
+		if (array)
+			count = std::max(1, (int)UNumber(*array, "count", 1.0));
+
+		uint32_t nameOffset = strings.Add(name);
+		for (int k = 0; k < count; k++)
+		{
+			glm::quat q = arrayRotate ? rotation * UAxisAngle(*arrayRotate, (float)k) : rotation;
+			parents.push_back(parent);
+			translations.insert(translations.end(), { translation.x, translation.y, translation.z });
+			rotations.insert(rotations.end(), { q.x, q.y, q.z, q.w });
+			scales.insert(scales.end(), { scale.x, scale.y, scale.z });
+			draws.push_back(draw);
+			names.push_back(nameOffset);
+		}
+		nodeIndex[name] = (int)parents.size() - 1;
+	}
+	if (!ok)
+		return false;
+
+	//lay the file out: header, records, node arrays, strings
+	USceneFileHeader header;
+	memset(&header, 0, sizeof(header));
+	image.assign(sizeof(USceneFileHeader), 0);
+	header.magic = USCENE_MAGIC;
+	header.version = USCENE_VERSION;
+	header.meshCount = (uint32_t)meshes.size();
+	header.textureCount = (uint32_t)textures.size();
+	header.materialCount = (uint32_t)materials.size();
+	header.nodeCount = (uint32_t)parents.size();
+	header.meshOffset = UAppend(image, meshes.data(), meshes.size());
+	header.textureOffset = UAppend(image, textures.data(), textures.size());
+	header.materialOffset = UAppend(image, materials.data(), materials.size());
+	header.parentOffset = UAppend(image, parents.data(), parents.size());
+	header.translationOffset = UAppend(image, translations.data(), translations.size());
+	header.rotationOffset = UAppend(image, rotations.data(), rotations.size());
+	header.scaleOffset = UAppend(image, scales.data(), scales.size());
+	header.drawOffset = UAppend(image, draws.data(), draws.size());
+	header.nameOffset = UAppend(image, names.data(), names.size());
+	header.stringOffset = UAppend(image, strings.blob.data(), strings.blob.size());
+	header.stringBytes = strings.blob.size();
+	header.fileBytes = image.size();
+	long long sourceTime = 0;
+	unsigned long long sourceBytes = 0;
+	if (UFileStamp(jsonFile, sourceTime, sourceBytes))
+	{
+		header.sourceTime = sourceTime;
+		header.sourceBytes = sourceBytes;
+	}
+	memcpy(image.data(), &header, sizeof(header));
+	return true;
+}
+
+bool UCompileSceneFile(const std::string& jsonFile, const std::string& binFile)
+{
+	vector<unsigned char> image;
+	if (!UCompileScene(jsonFile, image))
+		return false;
+
+	ofstream out(binFile.c_str(), ios::binary);
+	if (!out || !out.write((const char*)image.data(), image.size()))
+	{
+		cerr << "ERROR: could not write " << binFile << endl;
+		return false;
+	}
+	cout << "INFO: compiled " << jsonFile << " -> " << binFile << " (" << ((const USceneFileHeader*)image.data())->nodeCount << " nodes, "
+		<< image.size() << " bytes)" << endl;
+	return true;
+}
+
+//OPEN / CLOSE =====================================================================================================================================
+
+bool UOpenScene(const std::string& file, USceneFile& scene)
+{
+	UTRACE_SCOPE_ARG("open scene", file.c_str());
+	Clock::time_point start = Clock::now();
+
+	string binFile = file;
+	bool json = file.size() >= 5 && file.compare(file.size() - 5, 5, ".json") == 0;
+	if (json)
+		binFile = file.substr(0, file.size() - 5) + ".bin";
+
+	//map the binary (for json only when it was compiled from the source as it is now: a save in the same second as the
+	//compile still changes the size, or the time once the second has passed)
+	const char* how = "mapped";
+	bool bound = false;
+	long long sourceTime = 0;
+	unsigned long long sourceBytes = 0;
+	long long binTime = 0;
+	unsigned long long binBytes = 0;
+	if (!json || (UFileStamp(file, sourceTime, sourceBytes) && UFileStamp(binFile, binTime, binBytes)))
+	{
+		if (UMapFile(binFile, scene.mapping, scene.mappingBytes))
+		{
+			bound = UBindScene((const unsigned char*)scene.mapping, scene.mappingBytes, scene, binFile);
+			if (bound && json && (scene.header->sourceTime != sourceTime || scene.header->sourceBytes != sourceBytes))
+				bound = false;
+			if (!bound)
+			{
+				UUnmapFile(scene.mapping, scene.mappingBytes);
+				scene.mapping = nullptr;
+			}
+		}
+		else if (!json)
+			cerr << "ERROR: could not map scene " << binFile << endl;
+	}
+
+	//otherwise compile the json (and cache the binary for next time)
+	if (!bound && json)
+	{
+		if (!UCompileScene(file, scene.buffer))
+			return false;
+		ofstream out(binFile.c_str(), ios::binary);
+		if (!out || !out.write((const char*)scene.buffer.data(), scene.buffer.size()))
+			cerr << "WARNING: could not cache the compiled scene as " << binFile << endl;
+		bound = UBindScene(scene.buffer.data(), scene.buffer.size(), scene, file);
+		how = "compiled";
+	}
+	if (!bound)
+		return false;
+
+	double ms = chrono::duration<double, milli>(Clock::now() - start).count();
+	cout << "INFO: scene " << file << ": " << scene.header->nodeCount << " nodes, " << scene.header->meshCount << " meshes, "
+		<< scene.header->materialCount << " materials, " << how << " in " << ms << " ms" << endl;
+	return true;
+}
+
+void UCloseScene(USceneFile& scene)
+{
+	if (scene.mapping)
+		UUnmapFile(scene.mapping, scene.mappingBytes);
+	scene = USceneFile();
+}
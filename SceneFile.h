@@ -0,0 +1,140 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//SCENE FILES ======================================================================================================================================
+//
+// --scene <file>                      scene to load (default ../Resources/scene.json)
+// --scene-compile <in.json> <out.bin> compile a json scene to the binary form and exit
+//
+// scenes are authored as json (meshes, textures, materials and a node hierarchy, see scene.json) and compiled to a flat
+// little-endian binary that is memory-mapped at startup: the header holds offsets to fixed-size records and to the
+// node arrays (parents, translations, rotations, scales, draws, names), strings live in one NUL-terminated blob, and
+// nothing is parsed or copied on load. loading x.json uses x.bin next to it when the json's modification time and size
+// are still the ones recorded in the .bin's header, otherwise the json is compiled and the .bin is written for the next run.
+//
+// json nodes: name, parent (name of an earlier node), translation [x,y,z], rotate [[degrees, x,y,z], ...] (multiplied
+// in order), scale [x,y,z], mesh, material, group (trace section, defaults to the name) and optionally
+// array { count, rotate [degrees, x,y,z] } which expands to count nodes, the k-th one rotated k times further, and
+// static (default false, inherited by children) for objects that don't move (their shadows are cached, ShadowMaps.h).
+// json materials: name, texture, shininess, specular (default true) and alphaTest (default false).
+
+const uint32_t USCENE_MAGIC = 0x4E435355;		//"USCN"
+const uint32_t USCENE_VERSION = 4;
+
+//procedural meshes the scene can reference (the generators live in Source1.cpp)
+enum USceneMeshType : uint32_t
+{
+	USCENE_MESH_CYLINDER = 0,		//parameter = sections
+	USCENE_MESH_FLAT_CYLINDER = 1,	//parameter = sections
+	USCENE_MESH_PLANE = 2,			//parameter = half size
+	USCENE_MESH_CUBE = 3,
+	USCENE_MESH_RECT = 4,
+};
+
+struct USceneFileHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t fileBytes;
+	uint32_t meshCount;
+	uint32_t textureCount;
+	uint32_t materialCount;
+	uint32_t nodeCount;
+	uint64_t meshOffset;			//USceneFileMesh[meshCount]
+	uint64_t textureOffset;			//USceneFileTexture[textureCount]
+	uint64_t materialOffset;		//USceneFileMaterial[materialCount]
+	uint64_t parentOffset;			//int32_t[nodeCount], -1 for roots, always < the node index
+	uint64_t translationOffset;		//float[3 * nodeCount]
+	uint64_t rotationOffset;		//float[4 * nodeCount], quaternion x y z w
+	uint64_t scaleOffset;			//float[3 * nodeCount]
+	uint64_t drawOffset;			//USceneFileDraw[nodeCount]
+	uint64_t nameOffset;			//uint32_t[nodeCount], string offsets
+	uint64_t stringOffset;
+	uint64_t stringBytes;
+	int64_t sourceTime;				//modification time (seconds) and size of the json it was compiled from
+	uint64_t sourceBytes;
+};
+
+struct USceneFileMesh
+{
+	uint32_t name;			//string offset
+	uint32_t type;			//USceneMeshType
+	float parameter;
+	uint32_t reserved;
+};
+
+struct USceneFileTexture
+{
+	uint32_t name;
+	uint32_t file;
+	uint8_t repeat;			//GL_REPEAT, otherwise GL_CLAMP_TO_EDGE
+	uint8_t linear;			//GL_LINEAR, otherwise GL_NEAREST
+	uint8_t rgba;			//GL_RGBA, otherwise GL_RGB
+	uint8_t channels;		//desired channels for stbi_load (0 = as stored)
+};
+
+struct USceneFileMaterial
+{
+	uint32_t name;
+	int32_t texture;		//-1 = none
+	float shininess;
+	uint32_t flags;			//UMaterialFlags (json "specular", default true, and "alphaTest", default false)
+};
+
+//per node flags
+enum USceneDrawFlags : uint32_t
+{
+	USCENE_DRAW_STATIC = 1,			//never moves (json "static", or a static parent)
+};
+
+struct USceneFileDraw
+{
+	int32_t mesh;			//-1 = the node isn't drawn
+	int32_t material;
+	uint32_t group;			//string offset, object group used for trace sections
+	uint32_t flags;			//USceneDrawFlags
+};
+
+//a loaded (mapped or compiled in memory) scene, every pointer points into the file image
+struct USceneFile
+{
+	const USceneFileHeader* header = nullptr;
+	const USceneFileMesh* meshes = nullptr;
+	const USceneFileTexture* textures = nullptr;
+	const USceneFileMaterial* materials = nullptr;
+	const int32_t* parents = nullptr;
+	const float* translations = nullptr;
+	const float* rotations = nullptr;
+	const float* scales = nullptr;
+	const USceneFileDraw* draws = nullptr;
+	const uint32_t* names = nullptr;
+	const char* strings = nullptr;
+
+	const char* String(uint32_t offset) const { return strings + offset; }
+
+	//backing storage: a file mapping or a buffer compiled from json
+	void* mapping = nullptr;
+	size_t mappingBytes = 0;
+	std::vector<unsigned char> buffer;
+};
+
+struct USceneFileConfig
+{
+	std::string file = "../Resources/scene.json";
+	std::string compileIn;
+	std::string compileOut;
+};
+
+bool UParseSceneArgs(int argc, char* argv[], USceneFileConfig& config);
+
+//json -> binary image
+bool UCompileScene(const std::string& jsonFile, std::vector<unsigned char>& image);
+bool UCompileSceneFile(const std::string& jsonFile, const std::string& binFile);
+
+//opens a .bin (mapped) or a .json (cached .bin when up to date, otherwise compiled), reports the load time
+bool UOpenScene(const std::string& file, USceneFile& scene);
+void UCloseScene(USceneFile& scene);
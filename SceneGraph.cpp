@@ -0,0 +1,106 @@
+#include "SceneGraph.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include "Simd.h"
+
+using namespace std;
+
+namespace
+{
+	void UMarkDirty(USceneGraph& graph, int node)
+	{
+		graph.dirty[node] = 1;
+		graph.firstDirty = std::min(graph.firstDirty, node);
+	}
+}
+
+int USceneAddNode(USceneGraph& graph, int parent, const char* name, const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale)
+{
+	int node = (int)graph.parent.size();
+	if (parent >= node)
+	{
+		cerr << "ERROR: scene node " << name << " parented to a node that doesn't exist yet" << endl;
+		parent = -1;
+	}
+
+	graph.parent.push_back(parent);
+	UTransformBatchResize(graph.trs, node + 1);
+	UTransformBatchSet(graph.trs, node, translation, rotation, scale);
+	graph.local.push_back(glm::mat4(1.0f));
+	graph.world.push_back(glm::mat4(1.0f));
+	graph.dirty.push_back(0);
+	graph.name.push_back(name);
+	UMarkDirty(graph, node);
+	return node;
+}
+
+void USceneReserve(USceneGraph& graph, int count)
+{
+	graph.parent.reserve(count);
+	UTransformBatchReserve(graph.trs, count);
+	graph.local.reserve(count);
+	graph.world.reserve(count);
+	graph.dirty.reserve(count);
+	graph.name.reserve(count);
+}
+
+void USceneSetTranslation(USceneGraph& graph, int node, const glm::vec3& translation)
+{
+	graph.trs.tx[node] = translation.x;
+	graph.trs.ty[node] = translation.y;
+	graph.trs.tz[node] = translation.z;
+	UMarkDirty(graph, node);
+}
+
+void USceneSetRotation(USceneGraph& graph, int node, const glm::quat& rotation)
+{
+	graph.trs.qx[node] = rotation.x;
+	graph.trs.qy[node] = rotation.y;
+	graph.trs.qz[node] = rotation.z;
+	graph.trs.qw[node] = rotation.w;
+	UMarkDirty(graph, node);
+}
+
+void USceneSetScale(USceneGraph& graph, int node, const glm::vec3& scale)
+{
+	graph.trs.sx[node] = scale.x;
+	graph.trs.sy[node] = scale.y;
+	graph.trs.sz[node] = scale.z;
+	UMarkDirty(graph, node);
+}
+
+int USceneUpdate(USceneGraph& graph)
+{
+	int count = (int)graph.parent.size();
+	if (graph.firstDirty >= count)
+		return 0;
+
+	//local matrices of the flagged nodes, a vector of nodes at a time (vectors without a flagged node are skipped)
+	for (int first = graph.firstDirty - graph.firstDirty % USIMD_WIDTH; first < count; first += USIMD_WIDTH)
+	{
+		int last = std::min(first + USIMD_WIDTH, count);
+		if (std::find(graph.dirty.begin() + first, graph.dirty.begin() + last, 1) != graph.dirty.begin() + last)
+			UComposeTransforms(graph.trs, first, last, graph.local.data());
+	}
+
+	//parents come first, so by the time a node is visited dirty[parent] says whether the parent's world changed
+	//in this pass (everything before firstDirty is clean)
+	int updated = 0;
+	for (int node = graph.firstDirty; node < count; node++)
+	{
+		int parent = graph.parent[node];
+		bool parentChanged = parent >= 0 && graph.dirty[parent];
+		if (!graph.dirty[node] && !parentChanged)
+			continue;
+
+		graph.world[node] = parent >= 0 ? graph.world[parent] * graph.local[node] : graph.local[node];
+		graph.dirty[node] = 1;
+		updated++;
+	}
+
+	std::fill(graph.dirty.begin() + graph.firstDirty, graph.dirty.end(), 0);
+	graph.firstDirty = count;
+	return updated;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "TransformBatch.h"
+
+//SCENE GRAPH ======================================================================================================================================
+//
+// flat node store with parent links, local translation/rotation/scale and cached local and world matrices. a node can
+// only be parented to a node created before it, so the arrays are always in topological order and one forward pass
+// updates the whole hierarchy. the setters only flag a node; USceneUpdate recomputes flagged nodes and everything below
+// them, starting at the first flagged index, and returns straight away when nothing changed. the local TRS is kept
+// structure-of-arrays and the local matrices of flagged nodes are composed 8 at a time by the batch kernel.
+
+struct USceneGraph
+{
+	//one entry per node (index = node id)
+	std::vector<int> parent;				//-1 for roots
+	UTransformBatch trs;					//local translation, rotation and scale (TransformBatch.h)
+	std::vector<glm::mat4> local;			//translation * rotation * scale
+	std::vector<glm::mat4> world;			//parent world * local
+	std::vector<uint8_t> dirty;				//local TRS changed since the last update
+	std::vector<const char*> name;
+	int firstDirty = 0;						//lowest flagged node (== node count when clean)
+};
+
+//returns the new node id
+int USceneAddNode(USceneGraph& graph, int parent, const char* name, const glm::vec3& translation = glm::vec3(0.0f),
+	const glm::quat& rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f), const glm::vec3& scale = glm::vec3(1.0f));
+
+//preallocate for a known node count (scene files)
+void USceneReserve(USceneGraph& graph, int count);
+
+void USceneSetTranslation(USceneGraph& graph, int node, const glm::vec3& translation);
+void USceneSetRotation(USceneGraph& graph, int node, const glm::quat& rotation);
+void USceneSetScale(USceneGraph& graph, int node, const glm::vec3& scale);
+
+//recompute the world matrices of dirty subtrees, returns how many nodes were recomputed
+int USceneUpdate(USceneGraph& graph);
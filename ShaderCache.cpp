@@ -0,0 +1,203 @@
+#include "ShaderCache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+#include "GLStats.h"
+#include "Trace.h"
+
+using namespace std;
+
+namespace
+{
+	const uint32_t CACHE_MAGIC = 0x42505355;	//"USPB"
+	const uint32_t CACHE_VERSION = 1;
+
+	struct CacheFileHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint64_t key;
+		uint32_t format;		//binaryFormat from glGetProgramBinary
+		uint32_t length;
+	};
+
+	UShaderCacheConfig gConfig;
+	bool gSupported = false;		//driver offers at least one binary format
+	uint64_t gDriverHash = 0;
+	UShaderCacheStats gStats;
+
+	const uint64_t FNV_OFFSET = 14695981039346656037ull;
+	const uint64_t FNV_PRIME = 1099511628211ull;
+
+	uint64_t UFnv1a(uint64_t hash, const char* text)
+	{
+		for (; text && *text; text++)
+			hash = (hash ^ (unsigned char)*text) * FNV_PRIME;
+		//separator so ("ab", "c") and ("a", "bc") differ
+		return (hash ^ 0xFF) * FNV_PRIME;
+	}
+
+	string UCacheFile(uint64_t key)
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "%016llx.glbin", (unsigned long long)key);
+		return gConfig.directory + "/" + name;
+	}
+
+	void UMakeDirectory(const string& directory)
+	{
+#ifdef _WIN32
+		_mkdir(directory.c_str());
+#else
+		mkdir(directory.c_str(), 0755);
+#endif
+	}
+}
+
+bool UParseShaderCacheArgs(int argc, char* argv[], UShaderCacheConfig& config)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--shader-cache") == 0)
+		{
+			if (i + 1 >= argc)
+			{
+				cerr << "ERROR: --shader-cache needs a directory" << endl;
+				return false;
+			}
+			config.directory = argv[++i];
+		}
+		else if (strcmp(argv[i], "--no-shader-cache") == 0)
+			config.enabled = false;
+	}
+	return true;
+}
+
+void UShaderCacheInit(const UShaderCacheConfig& config)
+{
+	gConfig = config;
+
+	GLint formats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	gSupported = formats > 0;
+
+	gDriverHash = FNV_OFFSET;
+	gDriverHash = UFnv1a(gDriverHash, (const char*)glGetString(GL_VENDOR));
+	gDriverHash = UFnv1a(gDriverHash, (const char*)glGetString(GL_RENDERER));
+	gDriverHash = UFnv1a(gDriverHash, (const char*)glGetString(GL_VERSION));
+
+	if (gConfig.enabled && !gSupported)
+		cout << "INFO: driver reports no program binary formats, shader cache disabled" << endl;
+	if (gConfig.enabled && gSupported)
+		UMakeDirectory(gConfig.directory);
+}
+
+uint64_t UShaderCacheKey(const char* const* sources, int count)
+{
+	uint64_t hash = gDriverHash;
+	for (int i = 0; i < count; i++)
+		hash = UFnv1a(hash, sources[i]);
+	return hash;
+}
+
+bool UShaderCacheLoad(uint64_t key, GLuint program)
+{
+	if (!gConfig.enabled || !gSupported)
+	{
+		gStats.misses++;
+		return false;
+	}
+	UTRACE_SCOPE("shader cache load");
+
+	ifstream in(UCacheFile(key).c_str(), ios::binary);
+	CacheFileHeader header;
+	if (!in || !in.read((char*)&header, sizeof(header)) || header.magic != CACHE_MAGIC || header.version != CACHE_VERSION || header.key != key)
+	{
+		gStats.misses++;
+		return false;
+	}
+	//a corrupt length must not size the allocation: it has to be what the file holds after the header
+	in.seekg(0, ios::end);
+	streamoff fileBytes = in.tellg();
+	in.seekg(sizeof(header), ios::beg);
+	if (fileBytes < 0 || header.length == 0 || (uint64_t)header.length > (uint64_t)fileBytes - sizeof(header))
+	{
+		cerr << "WARNING: shader cache entry " << UCacheFile(key) << " is corrupt, rebuilding" << endl;
+		gStats.misses++;
+		return false;
+	}
+	vector<char> binary(header.length);
+	if (!in.read(binary.data(), binary.size()))
+	{
+		gStats.misses++;
+		return false;
+	}
+
+	//a driver that changed internally (same version string) may still refuse the binary, that is not an error
+	glProgramBinary(program, header.format, binary.data(), (GLsizei)binary.size());
+	GLint success = 0;
+	glGetProgramiv(program, GL_LINK_STATUS, &success);
+	if (!success)
+	{
+		gStats.misses++;
+		gStats.rejected++;
+		return false;
+	}
+	gStats.hits++;
+	return true;
+}
+
+void UShaderCachePrepare(GLuint program)
+{
+	if (gConfig.enabled && gSupported)
+		glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+void UShaderCacheStore(uint64_t key, GLuint program)
+{
+	if (!gConfig.enabled || !gSupported)
+		return;
+	UTRACE_SCOPE("shader cache store");
+
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+		return;
+	vector<char> binary(length);
+	GLenum format = 0;
+	glGetProgramBinary(program, length, &length, &format, binary.data());
+
+	CacheFileHeader header = { CACHE_MAGIC, CACHE_VERSION, key, (uint32_t)format, (uint32_t)length };
+	//write next to the final name and rename so a crash never leaves a truncated entry behind
+	string file = UCacheFile(key);
+	string temp = file + ".tmp";
+	{
+		ofstream out(temp.c_str(), ios::binary);
+		if (!out || !out.write((const char*)&header, sizeof(header)) || !out.write(binary.data(), length))
+		{
+			cerr << "WARNING: could not write shader cache entry " << temp << endl;
+			return;
+		}
+	}
+	remove(file.c_str());
+	rename(temp.c_str(), file.c_str());
+}
+
+void UShaderCacheAddTime(double milliseconds)
+{
+	gStats.milliseconds += milliseconds;
+}
+
+const UShaderCacheStats& UShaderCacheGetStats()
+{
+	return gStats;
+}
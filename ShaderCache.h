@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include <GL/glew.h>
+
+//SHADER PROGRAM BINARY CACHE ======================================================================================================================
+//
+// --shader-cache <dir>     where linked program binaries are kept (default "shadercache")
+// --no-shader-cache        always compile and link from source
+//
+// programs are keyed by a 64-bit FNV-1a hash of their sources plus GL_VENDOR, GL_RENDERER and GL_VERSION, so a driver
+// update or a different gpu never sees a stale binary. a hit loads <dir>/<key>.glbin with glProgramBinary; when the
+// driver rejects it (link status false) the program is compiled from source as usual and the file rewritten with the
+// new glGetProgramBinary output.
+
+struct UShaderCacheConfig
+{
+	bool enabled = true;
+	std::string directory = "shadercache";
+};
+
+//what happened to the programs created so far (printed with the startup time)
+struct UShaderCacheStats
+{
+	int hits = 0;
+	int misses = 0;
+	int rejected = 0;			//binaries the driver refused (counted in misses too)
+	double milliseconds = 0.0;	//time spent creating programs, cache lookups included
+};
+
+bool UParseShaderCacheArgs(int argc, char* argv[], UShaderCacheConfig& config);
+
+//call once with a current context (reads the driver strings and binary format support)
+void UShaderCacheInit(const UShaderCacheConfig& config);
+
+uint64_t UShaderCacheKey(const char* const* sources, int count);
+
+//returns true when program was linked from the cached binary
+bool UShaderCacheLoad(uint64_t key, GLuint program);
+//call before glLinkProgram on a miss so the driver keeps the binary around
+void UShaderCachePrepare(GLuint program);
+void UShaderCacheStore(uint64_t key, GLuint program);
+
+void UShaderCacheAddTime(double milliseconds);
+const UShaderCacheStats& UShaderCacheGetStats();
@@ -0,0 +1,407 @@
+#include "ShaderProgram.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#include <sys/stat.h>
+
+#include "GLStats.h"
+#include "GpuResources.h"
+#include "ShaderCache.h"
+#include "Trace.h"
+
+using namespace std;
+
+struct UShaderBuild
+{
+	string vertexSource;
+	string fragmentSource;
+	string geometrySource;			//empty without a geometry stage
+	long long vertexTime = -1;
+	long long fragmentTime = -1;
+	long long geometryTime = -1;
+	uint64_t cacheKey = 0;
+	double startTime = 0.0;
+
+	GLuint program = 0;
+	GLuint vertexShader = 0;
+	GLuint fragmentShader = 0;
+	GLuint geometryShader = 0;
+
+	//worker path: the worker links, reads the status and log, then fences
+	GLsync fence = 0;
+	atomic<bool> done;
+	bool linked = false;
+	string log;
+
+	UShaderBuild() : done(false) {}
+};
+
+namespace
+{
+	bool gParallelExtension = false;	//KHR/ARB_parallel_shader_compile
+
+	//compile worker (only without the extension)
+	GLFWwindow* gWorkerWindow = nullptr;
+	thread gWorker;
+	mutex gWorkerMutex;
+	condition_variable gWorkerWake;
+	deque<UShaderBuild*> gWorkerQueue;
+	bool gWorkerQuit = false;
+
+	long long UFileTime(const string& file)
+	{
+		struct stat info;
+		if (stat(file.c_str(), &info) != 0)
+			return -1;
+		return (long long)info.st_mtime;
+	}
+
+	bool UReadFile(const string& file, string& text)
+	{
+		ifstream in(file.c_str(), ios::binary);
+		if (!in)
+			return false;
+		ostringstream contents;
+		contents << in.rdbuf();
+		text = contents.str();
+		return true;
+	}
+
+	//the defines go right after "#version ...", which has to stay the first line
+	void UInjectDefines(string& source, const string& defines)
+	{
+		if (defines.empty())
+			return;
+		size_t version = source.find("#version");
+		size_t lineEnd = version == string::npos ? string::npos : source.find('\n', version);
+		if (lineEnd == string::npos)
+			source.insert(0, defines);
+		else
+			source.insert(lineEnd + 1, defines);
+	}
+
+	//"a.vert + a.frag" plus the defines in short form for messages
+	string UProgramLabel(const UShaderProgram& program)
+	{
+		string label = program.vertexFile + " + " + program.fragmentFile + (program.geometryFile.empty() ? "" : " + " + program.geometryFile);
+		if (program.defines.empty())
+			return label;
+		istringstream lines(program.defines);
+		string directive, name, value, list;
+		while (lines >> directive >> name >> value)
+			list += (list.empty() ? "" : " ") + name + "=" + value;
+		return label + " [" + list + "]";
+	}
+
+	//issue compile and link without asking for any status (that is what would block)
+	void UIssueBuild(UShaderBuild& build)
+	{
+		const char* vertexSource = build.vertexSource.c_str();
+		const char* fragmentSource = build.fragmentSource.c_str();
+		if (build.program == 0)
+			build.program = UGpuCreate(UGPU_PROGRAM, "shader program");
+		build.vertexShader = glCreateShader(GL_VERTEX_SHADER);
+		build.fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+		glShaderSource(build.vertexShader, 1, &vertexSource, NULL);
+		glShaderSource(build.fragmentShader, 1, &fragmentSource, NULL);
+		glCompileShader(build.vertexShader);
+		glCompileShader(build.fragmentShader);
+		glAttachShader(build.program, build.vertexShader);
+		glAttachShader(build.program, build.fragmentShader);
+		if (!build.geometrySource.empty())
+		{
+			const char* geometrySource = build.geometrySource.c_str();
+			build.geometryShader = glCreateShader(GL_GEOMETRY_SHADER);
+			glShaderSource(build.geometryShader, 1, &geometrySource, NULL);
+			glCompileShader(build.geometryShader);
+			glAttachShader(build.program, build.geometryShader);
+		}
+		UShaderCachePrepare(build.program);
+		glLinkProgram(build.program);
+	}
+
+	//link result and error log (blocks until the link is done), releases the shader objects
+	bool UFinishBuild(UShaderBuild& build)
+	{
+		char infoLog[1024];
+		GLint success = 0;
+		glGetProgramiv(build.program, GL_LINK_STATUS, &success);
+		if (!success)
+		{
+			//the compile logs say more than the link log when a stage didn't compile
+			GLint compiled = 0;
+			glGetShaderiv(build.vertexShader, GL_COMPILE_STATUS, &compiled);
+			if (!compiled)
+			{
+				glGetShaderInfoLog(build.vertexShader, sizeof(infoLog), NULL, infoLog);
+				build.log += string("ERROR COMPILING VERTEX SHADER\n") + infoLog;
+			}
+			glGetShaderiv(build.fragmentShader, GL_COMPILE_STATUS, &compiled);
+			if (!compiled)
+			{
+				glGetShaderInfoLog(build.fragmentShader, sizeof(infoLog), NULL, infoLog);
+				build.log += string("ERROR COMPILING FRAGMENT SHADER\n") + infoLog;
+			}
+			if (build.geometryShader != 0)
+			{
+				glGetShaderiv(build.geometryShader, GL_COMPILE_STATUS, &compiled);
+				if (!compiled)
+				{
+					glGetShaderInfoLog(build.geometryShader, sizeof(infoLog), NULL, infoLog);
+					build.log += string("ERROR COMPILING GEOMETRY SHADER\n") + infoLog;
+				}
+			}
+			glGetProgramInfoLog(build.program, sizeof(infoLog), NULL, infoLog);
+			build.log += string("ERROR LINKING SHADER PROGRAM\n") + infoLog;
+		}
+
+		glDetachShader(build.program, build.vertexShader);
+		glDetachShader(build.program, build.fragmentShader);
+		glDeleteShader(build.vertexShader);
+		glDeleteShader(build.fragmentShader);
+		if (build.geometryShader != 0)
+		{
+			glDetachShader(build.program, build.geometryShader);
+			glDeleteShader(build.geometryShader);
+		}
+		build.vertexShader = build.fragmentShader = build.geometryShader = 0;
+		build.linked = success != 0;
+		return build.linked;
+	}
+
+	void UWorkerMain()
+	{
+		glfwMakeContextCurrent(gWorkerWindow);
+		while (true)
+		{
+			UShaderBuild* build = nullptr;
+			{
+				unique_lock<mutex> lock(gWorkerMutex);
+				gWorkerWake.wait(lock, [] { return gWorkerQuit || !gWorkerQueue.empty(); });
+				if (gWorkerQueue.empty())
+					break;
+				build = gWorkerQueue.front();
+				gWorkerQueue.pop_front();
+			}
+
+			UIssueBuild(*build);
+			UFinishBuild(*build);
+			//the fence makes the linked program visible to the window's context once it has signalled
+			build->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			glFlush();
+			build->done.store(true, memory_order_release);
+		}
+		glfwMakeContextCurrent(NULL);
+	}
+
+	//true once a build can be picked up without waiting
+	bool UBuildFinished(UShaderBuild& build)
+	{
+		if (gWorkerWindow)
+		{
+			if (!build.done.load(memory_order_acquire))
+				return false;
+			GLenum status = glClientWaitSync(build.fence, 0, 0);
+			if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+				return false;
+			glDeleteSync(build.fence);
+			build.fence = 0;
+			return true;
+		}
+		if (!gParallelExtension)
+			return true;
+		GLint complete = 0;
+		glGetProgramiv(build.program, GL_COMPLETION_STATUS_KHR, &complete);
+		return complete != 0;
+	}
+
+	//swap a linked program in, or report why it didn't link and keep the current one
+	void UCompleteBuild(UShaderProgram& program, UShaderBuild& build, bool linked)
+	{
+		program.vertexTime = build.vertexTime;
+		program.fragmentTime = build.fragmentTime;
+		program.geometryTime = build.geometryTime;
+		if (!linked)
+		{
+			cout << build.log << endl;
+			cerr << "ERROR: " << UProgramLabel(program) << " failed to build, still drawing with the "
+				<< (program.ready ? "previous version" : "fallback program") << endl;
+			UGpuDestroy(UGPU_PROGRAM, build.program);
+			return;
+		}
+
+		if (program.ready)
+			UGpuDestroy(UGPU_PROGRAM, program.id);
+		program.id = build.program;
+		program.ready = true;
+		program.version++;
+		cout << "INFO: " << UProgramLabel(program) << " ready (version " << program.version << ") after "
+			<< (glfwGetTime() - build.startTime) * 1000.0 << " ms" << endl;
+	}
+
+	//read the files and start building (a cache hit finishes straight away)
+	bool UStartBuild(UShaderProgram& program)
+	{
+		UTRACE_SCOPE_ARG("shader build", program.fragmentFile.c_str());
+		double startTime = glfwGetTime();
+
+		UShaderBuild* build = new UShaderBuild();
+		build->startTime = startTime;
+		build->vertexTime = UFileTime(program.vertexFile);
+		build->fragmentTime = UFileTime(program.fragmentFile);
+		build->geometryTime = program.geometryFile.empty() ? -1 : UFileTime(program.geometryFile);
+		if (!UReadFile(program.vertexFile, build->vertexSource) || !UReadFile(program.fragmentFile, build->fragmentSource)
+			|| (!program.geometryFile.empty() && !UReadFile(program.geometryFile, build->geometrySource)))
+		{
+			cerr << "ERROR: could not read " << UProgramLabel(program) << endl;
+			program.vertexTime = build->vertexTime;
+			program.fragmentTime = build->fragmentTime;
+			program.geometryTime = build->geometryTime;
+			delete build;
+			return false;
+		}
+		UInjectDefines(build->vertexSource, program.defines);
+		UInjectDefines(build->fragmentSource, program.defines);
+		if (!build->geometrySource.empty())
+			UInjectDefines(build->geometrySource, program.defines);
+
+		const char* sources[] = { build->vertexSource.c_str(), build->fragmentSource.c_str(), build->geometrySource.c_str() };
+		build->cacheKey = UShaderCacheKey(sources, build->geometrySource.empty() ? 2 : 3);
+		build->program = UGpuCreate(UGPU_PROGRAM, "shader program");
+		if (UShaderCacheLoad(build->cacheKey, build->program))
+		{
+			UCompleteBuild(program, *build, true);
+			delete build;
+		}
+		else if (gWorkerWindow)
+		{
+			//the worker makes its own program object
+			UGpuDestroy(UGPU_PROGRAM, build->program);
+			build->program = 0;
+			program.build = build;
+			{
+				lock_guard<mutex> lock(gWorkerMutex);
+				gWorkerQueue.push_back(build);
+			}
+			gWorkerWake.notify_one();
+		}
+		else
+		{
+			UIssueBuild(*build);
+			program.build = build;
+		}
+		UShaderCacheAddTime((glfwGetTime() - startTime) * 1000.0);
+		return true;
+	}
+}
+
+void UShaderProgramsInit(GLFWwindow* window)
+{
+	gParallelExtension = GLEW_KHR_parallel_shader_compile || GLEW_ARB_parallel_shader_compile;
+	if (gParallelExtension)
+	{
+		//let the driver use as many compiler threads as it likes
+		if (GLEW_KHR_parallel_shader_compile)
+			glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+		else
+			glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+		cout << "INFO: shaders compile in the background (parallel_shader_compile)" << endl;
+		return;
+	}
+
+	//hidden 1x1 window whose context shares objects with the main one (same version hints as the main window)
+	glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+	gWorkerWindow = glfwCreateWindow(1, 1, "shader compiler", NULL, window);
+	glfwWindowHint(GLFW_VISIBLE, GL_TRUE);
+	if (gWorkerWindow == NULL)
+	{
+		cout << "INFO: no shared context for a compile thread, shaders compile on the main thread" << endl;
+		return;
+	}
+	gWorker = thread(UWorkerMain);
+	cout << "INFO: shaders compile in the background (worker thread with a shared context)" << endl;
+}
+
+void UShaderProgramsShutdown()
+{
+	if (!gWorkerWindow)
+		return;
+	{
+		lock_guard<mutex> lock(gWorkerMutex);
+		gWorkerQuit = true;
+	}
+	gWorkerWake.notify_one();
+	gWorker.join();
+	glfwDestroyWindow(gWorkerWindow);
+	gWorkerWindow = nullptr;
+}
+
+bool UShaderProgramLoad(UShaderProgram& program, const char* vertexFile, const char* fragmentFile, GLuint fallback, const std::string& defines,
+	const char* geometryFile)
+{
+	program.vertexFile = vertexFile;
+	program.fragmentFile = fragmentFile;
+	program.geometryFile = geometryFile != nullptr ? geometryFile : "";
+	program.defines = defines;
+	program.fallback = fallback;
+	program.id = fallback;
+	return UStartBuild(program);
+}
+
+GLuint UShaderProgramUpdate(UShaderProgram& program, double time)
+{
+	if (program.build && UBuildFinished(*program.build))
+	{
+		UShaderBuild* build = program.build;
+		program.build = nullptr;
+		bool linked = gWorkerWindow ? build->linked : UFinishBuild(*build);
+		if (linked)
+			UShaderCacheStore(build->cacheKey, build->program);
+		UCompleteBuild(program, *build, linked);
+		delete build;
+	}
+
+	//hot reload (one stat per file twice a second, the rebuild runs like the first one)
+	if (!program.build && time >= program.nextPoll)
+	{
+		program.nextPoll = time + 0.5;
+		if (UFileTime(program.vertexFile) != program.vertexTime || UFileTime(program.fragmentFile) != program.fragmentTime
+			|| (!program.geometryFile.empty() && UFileTime(program.geometryFile) != program.geometryTime))
+		{
+			cout << "INFO: reloading " << UProgramLabel(program) << endl;
+			UStartBuild(program);
+		}
+	}
+	return program.id;
+}
+
+void UShaderProgramDestroy(UShaderProgram& program)
+{
+	//a build the worker still holds has to finish first
+	if (program.build)
+	{
+		if (gWorkerWindow)
+		{
+			while (!program.build->done.load(memory_order_acquire))
+				this_thread::yield();
+			glClientWaitSync(program.build->fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+			glDeleteSync(program.build->fence);
+		}
+		else
+			UFinishBuild(*program.build);
+		UGpuDestroy(UGPU_PROGRAM, program.build->program);
+		delete program.build;
+		program.build = nullptr;
+	}
+	if (program.ready)
+		UGpuDestroy(UGPU_PROGRAM, program.id);
+	program.id = program.fallback;
+	program.ready = false;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <string>
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+//ASYNC SHADER PROGRAMS + HOT RELOAD ===============================================================================================================
+//
+// programs built from shader files without blocking the render loop. with GL_KHR_parallel_shader_compile (or the ARB
+// version) compile and link are issued on the main thread and polled with GL_COMPLETION_STATUS_KHR; without it a worker
+// thread with its own context (sharing objects with the window) compiles and links, then signals a fence the main thread
+// polls. until the first build succeeds the program draws with the fallback passed in, and a build that fails keeps
+// whatever was in use before (the fallback or the last good version) so a typo while editing never takes the scene down.
+// the files are checked for changes twice a second and rebuilt in the background (the old program stays in use until
+// the new one has linked). a cached binary (see ShaderCache.h) skips the build altogether.
+
+struct UShaderBuild;	//in flight compile/link
+
+struct UShaderProgram
+{
+	std::string vertexFile;
+	std::string fragmentFile;
+	std::string geometryFile;		//optional third stage (empty = none)
+	std::string defines;			//"#define" lines injected after the #version line of both stages (permutations)
+	GLuint id = 0;					//program to draw with this frame
+	GLuint fallback = 0;			//drawn with until the first build succeeds (not owned)
+	bool ready = false;				//id is a build of the files, not the fallback
+	int version = 0;				//successful builds so far
+	long long vertexTime = -1;		//modification times of the files last built
+	long long fragmentTime = -1;
+	long long geometryTime = -1;
+	double nextPoll = 0.0;
+	UShaderBuild* build = nullptr;
+};
+
+//call once with the window current (starts the compile worker when the extension is missing)
+void UShaderProgramsInit(GLFWwindow* window);
+void UShaderProgramsShutdown();
+
+//reads the files and starts the first build (false when a file can't be read, the fallback is used meanwhile); the
+//defines go into every stage, geometryFile adds a geometry shader
+bool UShaderProgramLoad(UShaderProgram& program, const char* vertexFile, const char* fragmentFile, GLuint fallback, const std::string& defines = "",
+	const char* geometryFile = nullptr);
+//once per frame: picks up finished builds and starts a rebuild when a file changed, returns the program to draw with
+GLuint UShaderProgramUpdate(UShaderProgram& program, double time);
+void UShaderProgramDestroy(UShaderProgram& program);
@@ -0,0 +1,149 @@
+#include "ShaderVariants.h"
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+
+#include "Materials.h"
+
+using namespace std;
+
+namespace
+{
+	bool UAnyNonZero(const glm::vec3& v)
+	{
+		return v.x != 0.0f || v.y != 0.0f || v.z != 0.0f;
+	}
+}
+
+uint32_t UShaderVariantKey(uint32_t features, int directionalLights, int pointLights)
+{
+	directionalLights = std::min(std::max(directionalLights, 0), USHADER_MAX_DIRECTIONAL_LIGHTS);
+	pointLights = std::min(std::max(pointLights, 0), USHADER_MAX_POINT_LIGHTS);
+	return features | (uint32_t)directionalLights << 8 | (uint32_t)pointLights << 16;
+}
+
+std::string UShaderVariantDefines(uint32_t key)
+{
+	ostringstream defines;
+	defines << "#define DIRECTIONAL_LIGHTS " << ((key >> 8) & 0xFF) << "\n"
+		<< "#define POINT_LIGHTS " << ((key >> 16) & 0xFF) << "\n"
+		<< "#define TEXTURED " << ((key & USHADER_TEXTURED) ? 1 : 0) << "\n"
+		<< "#define SPECULAR " << ((key & USHADER_SPECULAR) ? 1 : 0) << "\n"
+		<< "#define ALPHA_TEST " << ((key & USHADER_ALPHA_TEST) ? 1 : 0) << "\n"
+		<< "#define GPU_DRIVEN " << ((key & USHADER_GPU_DRIVEN) ? 1 : 0) << "\n"
+		<< "#define SHADOWS " << ((key & USHADER_SHADOWS) ? 1 : 0) << "\n"
+		<< "#define LIGHTMAP " << ((key & USHADER_LIGHTMAP) ? 1 : 0) << "\n"
+		<< "#define VERTEX_LIGHTING " << ((key & USHADER_VERTEX_LIGHTING) ? 1 : 0) << "\n"
+		<< "#define MULTI_VIEW " << ((key & USHADER_MULTI_VIEW) ? 1 : 0) << "\n";
+	return defines.str();
+}
+
+void UShaderVariantsInit(UShaderVariants& variants, const char* vertexFile, const char* fragmentFile, GLuint fallback)
+{
+	variants.vertexFile = vertexFile;
+	variants.fragmentFile = fragmentFile;
+	variants.fallback = fallback;
+}
+
+int UShaderVariantFind(UShaderVariants& variants, uint32_t key)
+{
+	for (size_t i = 0; i < variants.keys.size(); i++)
+	{
+		if (variants.keys[i] == key)
+		{
+			variants.objects[i]++;
+			return (int)i;
+		}
+	}
+
+	variants.keys.push_back(key);
+	variants.programs.push_back(UShaderProgram());
+	variants.objects.push_back(1);
+	variants.draws.push_back(0);
+	if ((key & USHADER_MULTI_VIEW) && !variants.geometryFile.empty())
+		UShaderProgramLoad(variants.programs.back(), variants.vertexFile.c_str(), variants.fragmentFile.c_str(), variants.fallback,
+			UShaderVariantDefines(key) + "#define MULTI_VIEW_GEOMETRY 1\n", variants.geometryFile.c_str());
+	else
+		UShaderProgramLoad(variants.programs.back(), variants.vertexFile.c_str(), variants.fragmentFile.c_str(), variants.fallback, UShaderVariantDefines(key));
+	return (int)variants.keys.size() - 1;
+}
+
+uint32_t UShaderVariantSelect(const UDrawItem& item, const USceneLighting& lighting)
+{
+	//both directional lights share the diffuse/specular colours, so they are either both on or both off
+	const UMaterial& material = UMaterialGet(item.material);
+	bool directionalDiffuse = UAnyNonZero(lighting.diffuse) && UAnyNonZero(material.diffuse);
+	bool directionalSpecular = UAnyNonZero(lighting.specular);
+	int directional = directionalDiffuse || directionalSpecular ? 2 : 0;
+	int points = 0;
+	for (const UScenePointLight& point : lighting.points)
+		points += UAnyNonZero(point.color) ? 1 : 0;
+
+	uint32_t features = 0;
+	if (item.texture >= 0)
+		features |= USHADER_TEXTURED;
+	if ((item.flags & UMATERIAL_ALPHA_TEST) && item.texture >= 0)
+		features |= USHADER_ALPHA_TEST;
+	//a material without a highlight, or lights without specular, skips the pow() and reflect() per light
+	bool anySpecularLight = (directional > 0 && directionalSpecular) || points > 0;
+	if ((item.flags & UMATERIAL_SPECULAR) && UAnyNonZero(material.specular) && anySpecularLight)
+		features |= USHADER_SPECULAR;
+	//vertex lit objects have their shadows baked in and don't take the cascades (too coarse to carry them)
+	if (lighting.shadows && directional > 0 && (item.lightmap.x > 0.0f || !item.vertexLit))
+		features |= USHADER_SHADOWS;
+	//baked objects keep the cascades only for the shadows of the moving ones
+	if (item.lightmap.x > 0.0f)
+		features |= USHADER_LIGHTMAP;
+	else if (item.vertexLit)
+		features |= USHADER_VERTEX_LIGHTING;
+	return UShaderVariantKey(features, directional, points);
+}
+
+void UShaderVariantsUpdate(UShaderVariants& variants, double time)
+{
+	for (UShaderProgram& program : variants.programs)
+		UShaderProgramUpdate(program, time);
+}
+
+GLuint UShaderVariantUse(UShaderVariants& variants, int variant)
+{
+	variants.draws[variant]++;
+	return variants.programs[variant].id;
+}
+
+void UShaderVariantsReport(const UShaderVariants& variants)
+{
+	int possible = 256 * (USHADER_MAX_DIRECTIONAL_LIGHTS + 1) * (USHADER_MAX_POINT_LIGHTS + 1);
+	long long total = 0;
+	for (long long draws : variants.draws)
+		total += draws;
+
+	cout << "INFO: shader variants: " << variants.keys.size() << " built of " << possible << " possible" << endl;
+	for (size_t i = 0; i < variants.keys.size(); i++)
+	{
+		uint32_t key = variants.keys[i];
+		cout << "INFO:   dir " << ((key >> 8) & 0xFF) << " point " << ((key >> 16) & 0xFF)
+			<< ((key & USHADER_TEXTURED) ? " textured" : " untextured")
+			<< ((key & USHADER_SPECULAR) ? " specular" : "")
+			<< ((key & USHADER_ALPHA_TEST) ? " alpha-test" : "")
+			<< ((key & USHADER_GPU_DRIVEN) ? " gpu-driven" : "")
+			<< ((key & USHADER_SHADOWS) ? " shadowed" : "")
+			<< ((key & USHADER_LIGHTMAP) ? " lightmapped" : "")
+			<< ((key & USHADER_VERTEX_LIGHTING) ? " vertex-lit" : "")
+			<< ((key & USHADER_MULTI_VIEW) ? " multi-view" : "")
+			<< ": " << variants.objects[i] << " objects, " << variants.draws[i] << " draws ("
+			<< (total > 0 ? 100.0 * variants.draws[i] / total : 0.0) << "%)"
+			<< (variants.programs[i].ready ? "" : ", never finished building") << endl;
+	}
+}
+
+void UShaderVariantsDestroy(UShaderVariants& variants)
+{
+	for (UShaderProgram& program : variants.programs)
+		UShaderProgramDestroy(program);
+	variants.keys.clear();
+	variants.programs.clear();
+	variants.objects.clear();
+	variants.draws.clear();
+}
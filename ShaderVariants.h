@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Scene.h"
+#include "ShaderProgram.h"
+
+//SHADER PERMUTATIONS ==============================================================================================================================
+//
+// scene.frag is written against feature flags (DIRECTIONAL_LIGHTS, POINT_LIGHTS, TEXTURED, SPECULAR, ALPHA_TEST, SHADOWS, LIGHTMAP, VERTEX_LIGHTING, and GPU_DRIVEN
+// and MULTI_VIEW in both stages) and every combination is a separate program built by injecting the matching #defines. a variant is only built the first time
+// something asks for it (through the async/cached path in ShaderProgram.h, so it draws with the fallback until then).
+// each draw item gets the cheapest variant that still renders it the same: no sampling without a texture, no specular
+// when the material or the lights have none, lights that contribute nothing are left out.
+
+enum UShaderFeature : uint32_t
+{
+	USHADER_TEXTURED = 1,
+	USHADER_SPECULAR = 2,
+	USHADER_ALPHA_TEST = 4,
+	USHADER_GPU_DRIVEN = 8,		//per object data from storage buffers, drawn by multi-draw indirect (GpuCulling.h)
+	USHADER_SHADOWS = 16,		//directional lights shadowed by the cached static atlas and the dynamic cascades (ShadowMaps.h)
+	USHADER_LIGHTMAP = 32,		//diffuse light and static shadows from the baked lightmap, only specular per pixel (Lightmap.h)
+	USHADER_VERTEX_LIGHTING = 64,	//diffuse light and occlusion baked into the colour attribute, no shadow lookups (Lightmap.h)
+	USHADER_MULTI_VIEW = 128,	//one draw covers every view of MultiView.h (per view instance, or multiview.geom)
+};
+
+const int USHADER_MAX_DIRECTIONAL_LIGHTS = 2;
+const int USHADER_MAX_POINT_LIGHTS = 4;
+
+//features | directional lights << 8 | point lights << 16
+uint32_t UShaderVariantKey(uint32_t features, int directionalLights, int pointLights);
+std::string UShaderVariantDefines(uint32_t key);
+
+struct UShaderVariants
+{
+	std::string vertexFile;
+	std::string fragmentFile;
+	GLuint fallback = 0;
+	std::string geometryFile;				//multiview.geom when MULTI_VIEW variants take the geometry shader path
+	//one entry per variant built so far
+	std::vector<uint32_t> keys;
+	std::vector<UShaderProgram> programs;
+	std::vector<int> objects;				//draw items using it
+	std::vector<long long> draws;			//draws issued with it
+};
+
+void UShaderVariantsInit(UShaderVariants& variants, const char* vertexFile, const char* fragmentFile, GLuint fallback);
+//index of the variant for key (starts building it when it is new)
+int UShaderVariantFind(UShaderVariants& variants, uint32_t key);
+//cheapest variant that draws item correctly under lighting
+uint32_t UShaderVariantSelect(const UDrawItem& item, const USceneLighting& lighting);
+//once per frame (finished builds, hot reload)
+void UShaderVariantsUpdate(UShaderVariants& variants, double time);
+//program to draw variant with (counts the draw)
+GLuint UShaderVariantUse(UShaderVariants& variants, int variant);
+//variants built out of the possible ones and how much each is used
+void UShaderVariantsReport(const UShaderVariants& variants);
+void UShaderVariantsDestroy(UShaderVariants& variants);
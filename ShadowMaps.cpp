@@ -0,0 +1,570 @@
+#include "ShadowMaps.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include "GLStats.h"
+#include "Trace.h"
+
+using namespace std;
+
+namespace
+{
+	const int LIGHTS = 2;
+	//timestamps in flight (results are read back this many frames late)
+	const int QUERY_FRAMES = 4;
+	//scene textures stay bound to units 0..n and 30/31 are taken by the render graph and the upscale
+	const int STATIC_TEXTURE_UNIT = 28;
+	const int CASCADE_TEXTURE_UNIT = 29;
+
+	const char* casterVertexShaderSource = "#version 440 core\n"
+		"layout (location = 0) in vec3 aPos;\n"
+		"uniform mat4 lightMatrix;\n"
+		"uniform mat4 model;\n"
+		"void main()\n"
+		"{\n"
+		"	gl_Position = lightMatrix * model * vec4(aPos, 1.0);\n"
+		"}\n\0";
+
+	//depth only
+	const char* casterFragmentShaderSource = "#version 440 core\n"
+		"void main()\n"
+		"{\n"
+		"}\n\0";
+
+	//light space box a tile covers
+	struct UShadowView
+	{
+		glm::mat4 clip;			//world -> light clip space (drawing the casters)
+		glm::mat4 tile;			//world -> 0-1 inside the tile (scene.frag)
+		float texel;			//world size of a texel (normal offset)
+		glm::vec2 center;		//light space square (caster culling)
+		glm::vec2 halfSize;
+	};
+
+	UShadowConfig gConfig;
+	bool gActive = false;
+	const std::vector<UDrawItem>* gItems = nullptr;
+	const USceneGraph* gScene = nullptr;
+	const USceneLighting* gLighting = nullptr;
+	std::vector<int> gStaticItems;
+	std::vector<int> gDynamicItems;
+	UGpuProgram gCasterProgram;
+	GLint gLightMatrixLoc = -1;
+	GLint gModelLoc = -1;
+	GLuint gSampler = 0;
+	URenderGraph* gGraph = nullptr;
+	int gStaticAtlas = -1;
+	int gCascadeAtlas = -1;
+
+	//static cache: valid until a light turns or a static caster moves
+	bool gCacheValid = false;
+	glm::vec3 gCachedDirections[LIGHTS];
+	std::vector<glm::mat4> gCachedWorlds;
+	UShadowView gStaticViews[LIGHTS];
+	//this frame's cascades
+	UShadowView gCascadeViews[LIGHTS][USHADOW_MAX_CASCADES];
+	float gSplits[USHADOW_MAX_CASCADES];
+	glm::vec3 gSceneCenter;
+	float gSceneRadius = 0.0f;
+
+	//gpu time of the static pass (when it drew) and the cascade pass, read back a few frames late
+	GLuint gQueries[QUERY_FRAMES * 3];
+	bool gQueryPending[QUERY_FRAMES];
+	bool gQueryRedrew[QUERY_FRAMES];
+	int gFrame = 0;
+	//for the exit report
+	long long gHits = 0;
+	long long gMisses = 0;
+	long long gStaticDraws = 0;
+	long long gDynamicDraws = 0;
+	double gStaticMs = 0.0;
+	int gStaticSamples = 0;
+	double gCascadeMs = 0.0;
+	int gCascadeSamples = 0;
+
+	bool UCompile(GLenum type, const char* source, GLuint& shaderId)
+	{
+		int success = 0;
+		char infoLog[512];
+		shaderId = glCreateShader(type);
+		glShaderSource(shaderId, 1, &source, NULL);
+		glCompileShader(shaderId);
+		glGetShaderiv(shaderId, GL_COMPILE_STATUS, &success);
+		if (!success)
+		{
+			glGetShaderInfoLog(shaderId, sizeof(infoLog), NULL, infoLog);
+			cout << "ERROR COMPILING SHADOW CASTER SHADER\n" << infoLog << endl;
+			return false;
+		}
+		return true;
+	}
+
+	bool UCreateCasterProgram()
+	{
+		GLuint vertexShaderId = 0, fragmentShaderId = 0;
+		bool compiled = UCompile(GL_VERTEX_SHADER, casterVertexShaderSource, vertexShaderId)
+			&& UCompile(GL_FRAGMENT_SHADER, casterFragmentShaderSource, fragmentShaderId);
+		int success = 0;
+		if (compiled)
+		{
+			char infoLog[512];
+			gCasterProgram.Create("shadow caster");
+			glAttachShader(gCasterProgram, vertexShaderId);
+			glAttachShader(gCasterProgram, fragmentShaderId);
+			glLinkProgram(gCasterProgram);
+			glGetProgramiv(gCasterProgram, GL_LINK_STATUS, &success);
+			if (!success)
+			{
+				glGetProgramInfoLog(gCasterProgram, sizeof(infoLog), NULL, infoLog);
+				cout << "ERROR LINKING SHADOW CASTER SHADER\n" << infoLog << endl;
+			}
+			glDetachShader(gCasterProgram, vertexShaderId);
+			glDetachShader(gCasterProgram, fragmentShaderId);
+		}
+		glDeleteShader(vertexShaderId);
+		glDeleteShader(fragmentShaderId);
+		if (!success)
+		{
+			gCasterProgram.Reset();
+			return false;
+		}
+
+		gLightMatrixLoc = glGetUniformLocation(gCasterProgram, "lightMatrix");
+		gModelLoc = glGetUniformLocation(gCasterProgram, "model");
+		return true;
+	}
+
+	//bounding sphere of a draw in world space (xyz centre, w radius)
+	glm::vec4 UWorldSphere(const UDrawItem& item)
+	{
+		const glm::mat4& world = gScene->world[item.node];
+		float scale = std::max(glm::length(glm::vec3(world[0])), std::max(glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2]))));
+		return glm::vec4(glm::vec3(world * glm::vec4(item.mesh->boundsCenter, 1.0f)), item.mesh->boundsRadius * scale);
+	}
+
+	//rotation into light space, looking down the light direction
+	glm::mat4 ULightRotation(const glm::vec3& direction)
+	{
+		glm::vec3 forward = glm::normalize(direction);
+		glm::vec3 up = std::fabs(forward.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+		return glm::lookAt(glm::vec3(0.0f), forward, up);
+	}
+
+	//light space square [center +- halfSize] over the depth of the whole scene, as clip and tile matrices
+	UShadowView UMakeView(const glm::mat4& rotation, const glm::vec2& center, const glm::vec2& halfSize)
+	{
+		float sceneDepth = (rotation * glm::vec4(gSceneCenter, 1.0f)).z;
+		UShadowView view;
+		view.center = center;
+		view.halfSize = halfSize;
+		view.clip = glm::ortho(center.x - halfSize.x, center.x + halfSize.x, center.y - halfSize.y, center.y + halfSize.y,
+			-(sceneDepth + gSceneRadius), -(sceneDepth - gSceneRadius)) * rotation;
+		//clip (-1..1) -> tile (0..1)
+		glm::mat4 bias(glm::vec4(0.5f, 0.0f, 0.0f, 0.0f), glm::vec4(0.0f, 0.5f, 0.0f, 0.0f), glm::vec4(0.0f, 0.0f, 0.5f, 0.0f), glm::vec4(0.5f, 0.5f, 0.5f, 1.0f));
+		view.tile = bias * view.clip;
+		view.texel = 2.0f * std::max(halfSize.x, halfSize.y) / gConfig.size;
+		return view;
+	}
+
+	//does a caster's sphere touch the square of a view (depth always covers the whole scene)
+	bool UInView(const UShadowView& view, const glm::mat4& rotation, const glm::vec4& sphere)
+	{
+		glm::vec4 p = rotation * glm::vec4(glm::vec3(sphere), 1.0f);
+		return std::fabs(p.x - view.center.x) <= view.halfSize.x + sphere.w && std::fabs(p.y - view.center.y) <= view.halfSize.y + sphere.w;
+	}
+
+	void USceneBounds()
+	{
+		glm::vec3 boundsMin(1e30f), boundsMax(-1e30f);
+		for (const UDrawItem& item : *gItems)
+		{
+			glm::vec4 sphere = UWorldSphere(item);
+			boundsMin = glm::min(boundsMin, glm::vec3(sphere) - glm::vec3(sphere.w));
+			boundsMax = glm::max(boundsMax, glm::vec3(sphere) + glm::vec3(sphere.w));
+		}
+		gSceneCenter = (boundsMin + boundsMax) * 0.5f;
+		gSceneRadius = glm::length(boundsMax - boundsMin) * 0.5f + 0.01f;
+	}
+
+	//draws the casters of a list that touch a view into the current viewport, returns how many
+	int UDrawCasters(const std::vector<int>& list, const UShadowView& view, const glm::mat4& rotation)
+	{
+		glUniformMatrix4fv(gLightMatrixLoc, 1, GL_FALSE, glm::value_ptr(view.clip));
+		int drawn = 0;
+		for (int index : list)
+		{
+			const UDrawItem& item = (*gItems)[index];
+			if (!UInView(view, rotation, UWorldSphere(item)))
+				continue;
+			glUniformMatrix4fv(gModelLoc, 1, GL_FALSE, glm::value_ptr(gScene->world[item.node]));
+			glBindVertexArray(item.mesh->vao);
+			glDrawElements(GL_TRIANGLES, item.mesh->nIndices, GL_UNSIGNED_SHORT, NULL);
+			drawn++;
+		}
+		return drawn;
+	}
+
+	void UBeginCasters()
+	{
+		glUseProgram(gCasterProgram);
+		glEnable(GL_DEPTH_TEST);
+		glDepthMask(GL_TRUE);
+		//slope scaled offset against acne (the sunset lights graze the tabletop)
+		glEnable(GL_POLYGON_OFFSET_FILL);
+		glPolygonOffset(1.5f, 2.0f);
+		glClear(GL_DEPTH_BUFFER_BIT);
+	}
+
+	void UEndCasters()
+	{
+		glBindVertexArray(0);
+		glDisable(GL_POLYGON_OFFSET_FILL);
+	}
+
+	//finished frames go into the pass times (the slot about to be reused has to be read, the others only if ready)
+	void UReadQueries(int slot)
+	{
+		for (int i = 0; i < QUERY_FRAMES; i++)
+		{
+			int pendingSlot = (slot + i) % QUERY_FRAMES;
+			if (!gQueryPending[pendingSlot])
+				continue;
+			GLint available = 0;
+			glGetQueryObjectiv(gQueries[pendingSlot * 3 + 2], GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!available && pendingSlot != slot)
+				continue;
+			GLuint64 begin = 0, cached = 0, end = 0;
+			glGetQueryObjectui64v(gQueries[pendingSlot * 3], GL_QUERY_RESULT, &begin);
+			glGetQueryObjectui64v(gQueries[pendingSlot * 3 + 1], GL_QUERY_RESULT, &cached);
+			glGetQueryObjectui64v(gQueries[pendingSlot * 3 + 2], GL_QUERY_RESULT, &end);
+			gQueryPending[pendingSlot] = false;
+			if (gQueryRedrew[pendingSlot])
+			{
+				gStaticMs += (cached - begin) / 1.0e6;
+				gStaticSamples++;
+			}
+			gCascadeMs += (end - cached) / 1.0e6;
+			gCascadeSamples++;
+			UTraceCounter("shadow gpu ms", (end - begin) / 1.0e6);
+		}
+	}
+
+	//static cache pass: redraws the static casters only when the cache was dropped
+	void UStaticPass()
+	{
+		int slot = gFrame % QUERY_FRAMES;
+		UReadQueries(slot);
+		glQueryCounter(gQueries[slot * 3], GL_TIMESTAMP);
+		gQueryRedrew[slot] = !gCacheValid;
+		UTraceCounter("shadow cache hit", gCacheValid ? 1.0 : 0.0);
+		if (gCacheValid)
+		{
+			gHits++;
+			glQueryCounter(gQueries[slot * 3 + 1], GL_TIMESTAMP);
+			return;
+		}
+		gMisses++;
+
+		//one tile per light, fitted around everything (the static shadows fall on dynamic objects too)
+		USceneBounds();
+		UBeginCasters();
+		for (int light = 0; light < LIGHTS; light++)
+		{
+			gCachedDirections[light] = light == 0 ? gLighting->direction : gLighting->direction2;
+			glm::mat4 rotation = ULightRotation(gCachedDirections[light]);
+			glm::vec3 boundsMin(1e30f), boundsMax(-1e30f);
+			for (const UDrawItem& item : *gItems)
+			{
+				glm::vec4 sphere = UWorldSphere(item);
+				glm::vec3 p = glm::vec3(rotation * glm::vec4(glm::vec3(sphere), 1.0f));
+				boundsMin = glm::min(boundsMin, p - glm::vec3(sphere.w));
+				boundsMax = glm::max(boundsMax, p + glm::vec3(sphere.w));
+			}
+			glm::vec2 center((boundsMin.x + boundsMax.x) * 0.5f, (boundsMin.y + boundsMax.y) * 0.5f);
+			glm::vec2 halfSize((boundsMax.x - boundsMin.x) * 0.5f, (boundsMax.y - boundsMin.y) * 0.5f);
+			gStaticViews[light] = UMakeView(rotation, center, halfSize);
+			glViewport(light * gConfig.size, 0, gConfig.size, gConfig.size);
+			gStaticDraws += UDrawCasters(gStaticItems, gStaticViews[light], rotation);
+		}
+		UEndCasters();
+
+		gCachedWorlds.clear();
+		for (int index : gStaticItems)
+			gCachedWorlds.push_back(gScene->world[(*gItems)[index].node]);
+		gCacheValid = true;
+		glQueryCounter(gQueries[slot * 3 + 1], GL_TIMESTAMP);
+	}
+
+	//cascade pass: the dynamic casters, every frame
+	void UCascadePass()
+	{
+		UBeginCasters();
+		int drawn = 0;
+		for (int light = 0; light < LIGHTS; light++)
+		{
+			glm::mat4 rotation = ULightRotation(light == 0 ? gLighting->direction : gLighting->direction2);
+			for (int cascade = 0; cascade < gConfig.cascades; cascade++)
+			{
+				glViewport(cascade * gConfig.size, light * gConfig.size, gConfig.size, gConfig.size);
+				drawn += UDrawCasters(gDynamicItems, gCascadeViews[light][cascade], rotation);
+			}
+		}
+		UEndCasters();
+		gDynamicDraws += drawn;
+		UTraceCounter("shadow casters drawn", drawn);
+
+		int slot = gFrame % QUERY_FRAMES;
+		glQueryCounter(gQueries[slot * 3 + 2], GL_TIMESTAMP);
+		gQueryPending[slot] = true;
+		gFrame++;
+
+		//both atlases stay bound for the scene programs (compared through the sampler, the textures keep their own state)
+		glActiveTexture(GL_TEXTURE0 + STATIC_TEXTURE_UNIT);
+		glBindTexture(GL_TEXTURE_2D, URenderGraphTexture(*gGraph, gStaticAtlas));
+		glBindSampler(STATIC_TEXTURE_UNIT, gSampler);
+		glActiveTexture(GL_TEXTURE0 + CASCADE_TEXTURE_UNIT);
+		glBindTexture(GL_TEXTURE_2D, URenderGraphTexture(*gGraph, gCascadeAtlas));
+		glBindSampler(CASCADE_TEXTURE_UNIT, gSampler);
+		glActiveTexture(GL_TEXTURE0);
+	}
+
+	//near and far plane of a perspective or orthographic projection
+	void UNearFar(const glm::mat4& projection, float& nearPlane, float& farPlane)
+	{
+		if (projection[2][3] != 0.0f)
+		{
+			nearPlane = projection[3][2] / (projection[2][2] - 1.0f);
+			farPlane = projection[3][2] / (projection[2][2] + 1.0f);
+		}
+		else
+		{
+			nearPlane = (projection[3][2] + 1.0f) / projection[2][2];
+			farPlane = (projection[3][2] - 1.0f) / projection[2][2];
+		}
+	}
+}
+
+bool UParseShadowArgs(int argc, char* argv[], UShadowConfig& config)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--shadows") == 0)
+		{
+			config.enabled = true;
+			if (i + 1 < argc && argv[i + 1][0] != '-')
+				config.cascades = atoi(argv[++i]);
+			if (config.cascades < 1 || config.cascades > USHADOW_MAX_CASCADES)
+			{
+				cerr << "ERROR: --shadows needs 1-" << USHADOW_MAX_CASCADES << " cascades" << endl;
+				return false;
+			}
+		}
+		else if (strcmp(argv[i], "--shadow-size") == 0)
+		{
+			if (i + 1 >= argc || atoi(argv[i + 1]) < 64 || atoi(argv[i + 1]) > 4096)
+			{
+				cerr << "ERROR: --shadow-size needs 64-4096 texels" << endl;
+				return false;
+			}
+			config.size = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--shadow-distance") == 0)
+		{
+			if (i + 1 >= argc || atof(argv[i + 1]) <= 0.0)
+			{
+				cerr << "ERROR: --shadow-distance needs a distance above 0" << endl;
+				return false;
+			}
+			config.distance = (float)atof(argv[++i]);
+		}
+	}
+	return true;
+}
+
+bool UShadowsInit(const UShadowConfig& config, const std::vector<UDrawItem>& items, const USceneGraph& scene, const USceneLighting& lighting)
+{
+	if (!config.enabled)
+		return false;
+	gConfig = config;
+	gItems = &items;
+	gScene = &scene;
+	gLighting = &lighting;
+	if (!UCreateCasterProgram())
+		return false;
+
+	gStaticItems.clear();
+	gDynamicItems.clear();
+	for (int i = 0; i < (int)items.size(); i++)
+		(items[i].isStatic ? gStaticItems : gDynamicItems).push_back(i);
+
+	//depth compare with hardware bilinear pcf
+	glGenSamplers(1, &gSampler);
+	glSamplerParameteri(gSampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glSamplerParameteri(gSampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glSamplerParameteri(gSampler, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glSamplerParameteri(gSampler, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glSamplerParameteri(gSampler, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glSamplerParameteri(gSampler, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+	glGenQueries(QUERY_FRAMES * 3, gQueries);
+	for (int i = 0; i < QUERY_FRAMES; i++)
+		gQueryPending[i] = gQueryRedrew[i] = false;
+	gFrame = 0;
+	gCacheValid = false;
+	USceneBounds();
+	gActive = true;
+	cout << "INFO: shadows, " << config.cascades << " cascades over " << config.distance << " units, " << config.size << " texel tiles, "
+		<< gStaticItems.size() << " static casters cached, " << gDynamicItems.size() << " dynamic" << endl;
+	return true;
+}
+
+void UShadowsAddPasses(URenderGraph& graph, int scenePass)
+{
+	if (!gActive)
+		return;
+	gGraph = &graph;
+	gStaticAtlas = URenderGraphCreatePersistent(graph, "shadow static atlas", LIGHTS * gConfig.size, gConfig.size, GL_DEPTH_COMPONENT24);
+	gCascadeAtlas = URenderGraphCreate(graph, "shadow cascades", gConfig.cascades * gConfig.size, LIGHTS * gConfig.size, GL_DEPTH_COMPONENT24);
+	int staticPass = URenderGraphAddPass(graph, "shadow cache", UStaticPass);
+	URenderGraphWrite(graph, staticPass, gStaticAtlas);
+	int cascadePass = URenderGraphAddPass(graph, "shadow cascades", UCascadePass);
+	URenderGraphWrite(graph, cascadePass, gCascadeAtlas);
+	URenderGraphRead(graph, scenePass, gStaticAtlas);
+	URenderGraphRead(graph, scenePass, gCascadeAtlas);
+	//the persistent texture is new after compiling
+	gCacheValid = false;
+}
+
+void UShadowsSceneChanged()
+{
+	if (!gActive || !gCacheValid)
+		return;
+	for (size_t i = 0; i < gStaticItems.size(); i++)
+	{
+		if (memcmp(&gCachedWorlds[i], &gScene->world[(*gItems)[gStaticItems[i]].node], sizeof(glm::mat4)) != 0)
+		{
+			gCacheValid = false;
+			return;
+		}
+	}
+}
+
+void UShadowsUpdate(const glm::mat4& view, const glm::mat4& projection)
+{
+	if (!gActive)
+		return;
+	if (gCacheValid && (gCachedDirections[0] != gLighting->direction || gCachedDirections[1] != gLighting->direction2))
+		gCacheValid = false;
+	//dynamic casters move, the depth range of the cascades has to keep up
+	USceneBounds();
+
+	//splits between uniform and logarithmic over [near, distance]
+	float nearPlane, farPlane;
+	UNearFar(projection, nearPlane, farPlane);
+	float distance = std::min(gConfig.distance, farPlane);
+	for (int cascade = 0; cascade < gConfig.cascades; cascade++)
+	{
+		float t = (cascade + 1) / (float)gConfig.cascades;
+		float uniform = nearPlane + (distance - nearPlane) * t;
+		float logarithmic = nearPlane * pow(distance / nearPlane, t);
+		gSplits[cascade] = uniform + (logarithmic - uniform) * 0.75f;
+	}
+
+	//frustum corners (near and far plane) in world space
+	glm::mat4 inverseViewProjection = glm::inverse(projection * view);
+	glm::vec3 nearCorners[4], farCorners[4];
+	for (int i = 0; i < 4; i++)
+	{
+		float x = (i & 1) ? 1.0f : -1.0f, y = (i & 2) ? 1.0f : -1.0f;
+		glm::vec4 n = inverseViewProjection * glm::vec4(x, y, -1.0f, 1.0f);
+		glm::vec4 f = inverseViewProjection * glm::vec4(x, y, 1.0f, 1.0f);
+		nearCorners[i] = glm::vec3(n) / n.w;
+		farCorners[i] = glm::vec3(f) / f.w;
+	}
+
+	for (int light = 0; light < LIGHTS; light++)
+	{
+		glm::mat4 rotation = ULightRotation(light == 0 ? gLighting->direction : gLighting->direction2);
+		float sliceStart = nearPlane;
+		for (int cascade = 0; cascade < gConfig.cascades; cascade++)
+		{
+			//the slice's corners lie on the frustum edges, linear in view depth
+			float a = (sliceStart - nearPlane) / (farPlane - nearPlane);
+			float b = (gSplits[cascade] - nearPlane) / (farPlane - nearPlane);
+			glm::vec3 corners[8];
+			glm::vec3 center(0.0f);
+			for (int i = 0; i < 4; i++)
+			{
+				corners[i] = nearCorners[i] + (farCorners[i] - nearCorners[i]) * a;
+				corners[i + 4] = nearCorners[i] + (farCorners[i] - nearCorners[i]) * b;
+				center += corners[i] + corners[i + 4];
+			}
+			center = center / 8.0f;
+			float radius = 0.0f;
+			for (const glm::vec3& corner : corners)
+				radius = std::max(radius, glm::length(corner - center));
+			//size only depends on the slice, position moves in whole texels
+			radius = ceil(radius * 16.0f) / 16.0f;
+			float texel = 2.0f * radius / gConfig.size;
+			glm::vec4 lightCenter = rotation * glm::vec4(center, 1.0f);
+			glm::vec2 snapped(floor(lightCenter.x / texel) * texel, floor(lightCenter.y / texel) * texel);
+			gCascadeViews[light][cascade] = UMakeView(rotation, snapped, glm::vec2(radius, radius));
+			sliceStart = gSplits[cascade];
+		}
+	}
+}
+
+void UShadowsSetUniforms(GLuint programId)
+{
+	if (!gActive)
+		return;
+	glUniform1i(glGetUniformLocation(programId, "shadowStatic"), STATIC_TEXTURE_UNIT);
+	glUniform1i(glGetUniformLocation(programId, "shadowCascades"), CASCADE_TEXTURE_UNIT);
+	glUniform1i(glGetUniformLocation(programId, "shadowCascadeCount"), gConfig.cascades);
+	glm::vec4 splits(0.0f), cascadeTexels(0.0f);
+	for (int cascade = 0; cascade < gConfig.cascades; cascade++)
+	{
+		splits[cascade] = gSplits[cascade];
+		cascadeTexels[cascade] = gCascadeViews[0][cascade].texel;
+	}
+	glUniform4fv(glGetUniformLocation(programId, "shadowSplits"), 1, glm::value_ptr(splits));
+	glUniform4fv(glGetUniformLocation(programId, "shadowCascadeTexel"), 1, glm::value_ptr(cascadeTexels));
+	glUniform2f(glGetUniformLocation(programId, "shadowStaticTexel"), gStaticViews[0].texel, gStaticViews[1].texel);
+	for (int light = 0; light < LIGHTS; light++)
+	{
+		char name[64];
+		snprintf(name, sizeof(name), "shadowStaticMatrix[%d]", light);
+		glUniformMatrix4fv(glGetUniformLocation(programId, name), 1, GL_FALSE, glm::value_ptr(gStaticViews[light].tile));
+		for (int cascade = 0; cascade < gConfig.cascades; cascade++)
+		{
+			snprintf(name, sizeof(name), "shadowCascadeMatrix[%d]", light * USHADOW_MAX_CASCADES + cascade);
+			glUniformMatrix4fv(glGetUniformLocation(programId, name), 1, GL_FALSE, glm::value_ptr(gCascadeViews[light][cascade].tile));
+		}
+	}
+}
+
+void UShadowsShutdown()
+{
+	if (!gActive)
+		return;
+	glDeleteQueries(QUERY_FRAMES * 3, gQueries);
+	glDeleteSamplers(1, &gSampler);
+	gCasterProgram.Reset();
+	gActive = false;
+
+	long long frames = gHits + gMisses;
+	if (frames == 0)
+		return;
+	cout << "INFO: shadows over " << frames << " frames: static cache hit rate " << 100.0 * gHits / frames << "% (" << gMisses << " redraws, "
+		<< (gStaticSamples > 0 ? gStaticMs / gStaticSamples : 0.0) << " ms gpu and " << (double)gStaticDraws / std::max(gMisses, 1LL) << " draws each), "
+		<< "cascades " << (gCascadeSamples > 0 ? gCascadeMs / gCascadeSamples : 0.0) << " ms gpu and " << (double)gDynamicDraws / frames
+		<< " draws per frame (" << gDynamicItems.size() << " dynamic casters x " << LIGHTS * gConfig.cascades << " cascades without culling)" << endl;
+}
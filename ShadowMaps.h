@@ -0,0 +1,49 @@
+#pragma once
+
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "RenderGraph.h"
+#include "Scene.h"
+#include "SceneGraph.h"
+
+//SHADOW MAPS ======================================================================================================================================
+//
+// --shadows [cascades]      shadow the two directional lights, dynamic casters in 1-4 cascades (default 3)
+// --shadow-size <texels>    size of one cascade / one light's tile of the static atlas (default 1024)
+// --shadow-distance <d>     view distance the cascades cover (default 20)
+//
+// static casters (scene file "static" nodes: tabletop, speaker, charger) are drawn into a persistent render graph atlas,
+// one tile per light fitted around the whole scene, and only drawn again when a light direction changes or one of them
+// moves; every other frame the pass is a cache hit and draws nothing. the dynamic casters are drawn every frame into a
+// transient atlas of cascades (one row per light): the view range is split between uniform and logarithmic, each slice
+// is covered by a light-space square around its bounding sphere (so its size doesn't change when the camera turns) that
+// is snapped to whole texels (so edges don't crawl when it moves). casters outside a cascade are skipped. scene.frag
+// (SHADOWS variants) takes the darker of the two lookups, with 3x3 pcf and a normal offset of about a texel.
+
+struct UShadowConfig
+{
+	bool enabled = false;
+	int cascades = 3;
+	int size = 1024;
+	float distance = 20.0f;
+};
+
+const int USHADOW_MAX_CASCADES = 4;
+
+bool UParseShadowArgs(int argc, char* argv[], UShadowConfig& config);
+
+//needs a current GL context, items, scene and lighting have to outlive it; returns whether shadows are on
+bool UShadowsInit(const UShadowConfig& config, const std::vector<UDrawItem>& items, const USceneGraph& scene, const USceneLighting& lighting);
+//static cache and cascade passes, scenePass reads both atlases
+void UShadowsAddPasses(URenderGraph& graph, int scenePass);
+//after nodes moved (USceneUpdate > 0): drops the cached atlas when a static caster is one of them
+void UShadowsSceneChanged();
+//fits the cascades to this frame's camera (before the graph executes)
+void UShadowsUpdate(const glm::mat4& view, const glm::mat4& projection);
+//atlases, light matrices and splits for a scene program (with the other frame uniforms)
+void UShadowsSetUniforms(GLuint programId);
+//prints the cache hit rate and pass times
+void UShadowsShutdown();
@@ -0,0 +1,197 @@
+#pragma once
+
+//8-WIDE SIMD WRAPPERS =============================================================================================================================
+//
+// USimdFloat / USimdInt hold 8 lanes. with AVX2 enabled (/arch:AVX2 or -mavx2 -mfma) they map to __m256/__m256i, otherwise
+// to plain arrays the compiler can still auto-vectorize. masks are USimdFloat values whose lanes are all ones or all zeros.
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define USIMD_AVX2 1
+#endif
+
+const int USIMD_WIDTH = 8;
+
+#ifdef USIMD_AVX2
+
+struct USimdInt;
+
+struct USimdFloat
+{
+	__m256 v;
+	USimdFloat() {}
+	USimdFloat(__m256 value) : v(value) {}
+	USimdFloat(float s) : v(_mm256_set1_ps(s)) {}
+	static USimdFloat Load(const float* p) { return _mm256_loadu_ps(p); }
+	static USimdFloat Lanes(float a, float b, float c, float d, float e, float f, float g, float h) { return _mm256_setr_ps(a, b, c, d, e, f, g, h); }
+	void Store(float* p) const { _mm256_storeu_ps(p, v); }
+};
+
+struct USimdInt
+{
+	__m256i v;
+	USimdInt() {}
+	USimdInt(__m256i value) : v(value) {}
+	USimdInt(int32_t s) : v(_mm256_set1_epi32(s)) {}
+	static USimdInt Load(const int32_t* p) { return _mm256_loadu_si256((const __m256i*)p); }
+	void Store(int32_t* p) const { _mm256_storeu_si256((__m256i*)p, v); }
+};
+
+inline USimdFloat operator+(USimdFloat a, USimdFloat b) { return _mm256_add_ps(a.v, b.v); }
+inline USimdFloat operator-(USimdFloat a, USimdFloat b) { return _mm256_sub_ps(a.v, b.v); }
+inline USimdFloat operator*(USimdFloat a, USimdFloat b) { return _mm256_mul_ps(a.v, b.v); }
+inline USimdFloat operator/(USimdFloat a, USimdFloat b) { return _mm256_div_ps(a.v, b.v); }
+inline USimdFloat operator-(USimdFloat a) { return _mm256_xor_ps(a.v, _mm256_set1_ps(-0.0f)); }
+inline USimdFloat operator<(USimdFloat a, USimdFloat b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ); }
+inline USimdFloat operator<=(USimdFloat a, USimdFloat b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ); }
+inline USimdFloat operator>(USimdFloat a, USimdFloat b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ); }
+inline USimdFloat operator>=(USimdFloat a, USimdFloat b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ); }
+inline USimdFloat operator&(USimdFloat a, USimdFloat b) { return _mm256_and_ps(a.v, b.v); }
+inline USimdFloat operator|(USimdFloat a, USimdFloat b) { return _mm256_or_ps(a.v, b.v); }
+inline USimdFloat USimdAndNot(USimdFloat mask, USimdFloat a) { return _mm256_andnot_ps(mask.v, a.v); }	//~mask & a
+inline USimdFloat USimdSelect(USimdFloat mask, USimdFloat a, USimdFloat b) { return _mm256_blendv_ps(b.v, a.v, mask.v); }
+inline USimdFloat USimdMin(USimdFloat a, USimdFloat b) { return _mm256_min_ps(a.v, b.v); }
+inline USimdFloat USimdMax(USimdFloat a, USimdFloat b) { return _mm256_max_ps(a.v, b.v); }
+inline USimdFloat USimdSqrt(USimdFloat a) { return _mm256_sqrt_ps(a.v); }
+inline USimdFloat USimdFloor(USimdFloat a) { return _mm256_floor_ps(a.v); }
+inline USimdFloat USimdMulAdd(USimdFloat a, USimdFloat b, USimdFloat c) { return _mm256_fmadd_ps(a.v, b.v, c.v); }
+inline int USimdMask(USimdFloat mask) { return _mm256_movemask_ps(mask.v); }
+inline float USimdLane(USimdFloat a, int lane) { float lanes[8]; a.Store(lanes); return lanes[lane]; }
+
+inline USimdInt operator+(USimdInt a, USimdInt b) { return _mm256_add_epi32(a.v, b.v); }
+inline USimdInt operator-(USimdInt a, USimdInt b) { return _mm256_sub_epi32(a.v, b.v); }
+inline USimdInt operator*(USimdInt a, USimdInt b) { return _mm256_mullo_epi32(a.v, b.v); }
+inline USimdInt operator&(USimdInt a, USimdInt b) { return _mm256_and_si256(a.v, b.v); }
+inline USimdInt operator|(USimdInt a, USimdInt b) { return _mm256_or_si256(a.v, b.v); }
+inline USimdInt operator>>(USimdInt a, int bits) { return _mm256_srli_epi32(a.v, bits); }
+inline USimdInt operator<<(USimdInt a, int bits) { return _mm256_slli_epi32(a.v, bits); }
+inline USimdInt USimdMin(USimdInt a, USimdInt b) { return _mm256_min_epi32(a.v, b.v); }
+inline USimdInt USimdMax(USimdInt a, USimdInt b) { return _mm256_max_epi32(a.v, b.v); }
+inline USimdFloat USimdLess(USimdInt a, USimdInt b) { return _mm256_castsi256_ps(_mm256_cmpgt_epi32(b.v, a.v)); }
+inline USimdInt USimdSelect(USimdFloat mask, USimdInt a, USimdInt b) { return _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(b.v), _mm256_castsi256_ps(a.v), mask.v)); }
+inline USimdInt USimdToInt(USimdFloat a) { return _mm256_cvttps_epi32(a.v); }					//truncates
+inline USimdFloat USimdToFloat(USimdInt a) { return _mm256_cvtepi32_ps(a.v); }
+inline USimdInt USimdAsInt(USimdFloat a) { return _mm256_castps_si256(a.v); }
+inline USimdFloat USimdAsFloat(USimdInt a) { return _mm256_castsi256_ps(a.v); }
+inline USimdInt USimdGather(const uint32_t* base, USimdInt index) { return _mm256_i32gather_epi32((const int*)base, index.v, 4); }
+
+#else
+
+struct USimdInt;
+
+struct USimdFloat
+{
+	float v[8];
+	USimdFloat() {}
+	USimdFloat(float s) { for (int i = 0; i < 8; i++) v[i] = s; }
+	static USimdFloat Load(const float* p) { USimdFloat r; memcpy(r.v, p, sizeof(r.v)); return r; }
+	static USimdFloat Lanes(float a, float b, float c, float d, float e, float f, float g, float h) { USimdFloat r; float l[8] = { a, b, c, d, e, f, g, h }; memcpy(r.v, l, sizeof(l)); return r; }
+	void Store(float* p) const { memcpy(p, v, sizeof(v)); }
+};
+
+struct USimdInt
+{
+	int32_t v[8];
+	USimdInt() {}
+	USimdInt(int32_t s) { for (int i = 0; i < 8; i++) v[i] = s; }
+	static USimdInt Load(const int32_t* p) { USimdInt r; memcpy(r.v, p, sizeof(r.v)); return r; }
+	void Store(int32_t* p) const { memcpy(p, v, sizeof(v)); }
+};
+
+#define USIMD_LANES(type, expr) type r; for (int i = 0; i < 8; i++) { expr; } return r;
+inline float UMaskLane(bool b) { uint32_t bits = b ? 0xFFFFFFFFu : 0u; float f; memcpy(&f, &bits, 4); return f; }
+inline uint32_t UBits(float f) { uint32_t bits; memcpy(&bits, &f, 4); return bits; }
+inline float UFloatBits(uint32_t bits) { float f; memcpy(&f, &bits, 4); return f; }
+
+inline USimdFloat operator+(USimdFloat a, USimdFloat b) { USIMD_LANES(USimdFloat, r.v[i] = a.v[i] + b.v[i]) }
+inline USimdFloat operator-(USimdFloat a, USimdFloat b) { USIMD_LANES(USimdFloat, r.v[i] = a.v[i] - b.v[i]) }
+inline USimdFloat operator*(USimdFloat a, USimdFloat b) { USIMD_LANES(USimdFloat, r.v[i] = a.v[i] * b.v[i]) }
+inline USimdFloat operator/(USimdFloat a, USimdFloat b) { USIMD_LANES(USimdFloat, r.v[i] = a.v[i] / b.v[i]) }
+inline USimdFloat operator-(USimdFloat a) { USIMD_LANES(USimdFloat, r.v[i] = -a.v[i]) }
+inline USimdFloat operator<(USimdFloat a, USimdFloat b) { USIMD_LANES(USimdFloat, r.v[i] = UMaskLane(a.v[i] < b.v[i])) }
+inline USimdFloat operator<=(USimdFloat a, USimdFloat b) { USIMD_LANES(USimdFloat, r.v[i] = UMaskLane(a.v[i] <= b.v[i])) }
+inline USimdFloat operator>(USimdFloat a, USimdFloat b) { USIMD_LANES(USimdFloat, r.v[i] = UMaskLane(a.v[i] > b.v[i])) }
+inline USimdFloat operator>=(USimdFloat a, USimdFloat b) { USIMD_LANES(USimdFloat, r.v[i] = UMaskLane(a.v[i] >= b.v[i])) }
+inline USimdFloat operator&(USimdFloat a, USimdFloat b) { USIMD_LANES(USimdFloat, r.v[i] = UFloatBits(UBits(a.v[i]) & UBits(b.v[i]))) }
+inline USimdFloat operator|(USimdFloat a, USimdFloat b) { USIMD_LANES(USimdFloat, r.v[i] = UFloatBits(UBits(a.v[i]) | UBits(b.v[i]))) }
+inline USimdFloat USimdAndNot(USimdFloat mask, USimdFloat a) { USIMD_LANES(USimdFloat, r.v[i] = UFloatBits(~UBits(mask.v[i]) & UBits(a.v[i]))) }
+inline USimdFloat USimdSelect(USimdFloat mask, USimdFloat a, USimdFloat b) { USIMD_LANES(USimdFloat, r.v[i] = (UBits(mask.v[i]) >> 31) ? a.v[i] : b.v[i]) }
+inline USimdFloat USimdMin(USimdFloat a, USimdFloat b) { USIMD_LANES(USimdFloat, r.v[i] = a.v[i] < b.v[i] ? a.v[i] : b.v[i]) }
+inline USimdFloat USimdMax(USimdFloat a, USimdFloat b) { USIMD_LANES(USimdFloat, r.v[i] = a.v[i] > b.v[i] ? a.v[i] : b.v[i]) }
+inline USimdFloat USimdSqrt(USimdFloat a) { USIMD_LANES(USimdFloat, r.v[i] = std::sqrt(a.v[i])) }
+inline USimdFloat USimdFloor(USimdFloat a) { USIMD_LANES(USimdFloat, r.v[i] = std::floor(a.v[i])) }
+inline USimdFloat USimdMulAdd(USimdFloat a, USimdFloat b, USimdFloat c) { USIMD_LANES(USimdFloat, r.v[i] = a.v[i] * b.v[i] + c.v[i]) }
+inline int USimdMask(USimdFloat mask) { int bits = 0; for (int i = 0; i < 8; i++) bits |= (int)(UBits(mask.v[i]) >> 31) << i; return bits; }
+inline float USimdLane(USimdFloat a, int lane) { return a.v[lane]; }
+
+inline USimdInt operator+(USimdInt a, USimdInt b) { USIMD_LANES(USimdInt, r.v[i] = a.v[i] + b.v[i]) }
+inline USimdInt operator-(USimdInt a, USimdInt b) { USIMD_LANES(USimdInt, r.v[i] = a.v[i] - b.v[i]) }
+inline USimdInt operator*(USimdInt a, USimdInt b) { USIMD_LANES(USimdInt, r.v[i] = a.v[i] * b.v[i]) }
+inline USimdInt operator&(USimdInt a, USimdInt b) { USIMD_LANES(USimdInt, r.v[i] = a.v[i] & b.v[i]) }
+inline USimdInt operator|(USimdInt a, USimdInt b) { USIMD_LANES(USimdInt, r.v[i] = a.v[i] | b.v[i]) }
+inline USimdInt operator>>(USimdInt a, int bits) { USIMD_LANES(USimdInt, r.v[i] = (int32_t)((uint32_t)a.v[i] >> bits)) }
+inline USimdInt operator<<(USimdInt a, int bits) { USIMD_LANES(USimdInt, r.v[i] = (int32_t)((uint32_t)a.v[i] << bits)) }
+inline USimdInt USimdMin(USimdInt a, USimdInt b) { USIMD_LANES(USimdInt, r.v[i] = a.v[i] < b.v[i] ? a.v[i] : b.v[i]) }
+inline USimdInt USimdMax(USimdInt a, USimdInt b) { USIMD_LANES(USimdInt, r.v[i] = a.v[i] > b.v[i] ? a.v[i] : b.v[i]) }
+inline USimdFloat USimdLess(USimdInt a, USimdInt b) { USIMD_LANES(USimdFloat, r.v[i] = UMaskLane(a.v[i] < b.v[i])) }
+inline USimdInt USimdSelect(USimdFloat mask, USimdInt a, USimdInt b) { USIMD_LANES(USimdInt, r.v[i] = (UBits(mask.v[i]) >> 31) ? a.v[i] : b.v[i]) }
+inline USimdInt USimdToInt(USimdFloat a) { USIMD_LANES(USimdInt, r.v[i] = (int32_t)a.v[i]) }
+inline USimdFloat USimdToFloat(USimdInt a) { USIMD_LANES(USimdFloat, r.v[i] = (float)a.v[i]) }
+inline USimdInt USimdAsInt(USimdFloat a) { USIMD_LANES(USimdInt, r.v[i] = (int32_t)UBits(a.v[i])) }
+inline USimdFloat USimdAsFloat(USimdInt a) { USIMD_LANES(USimdFloat, r.v[i] = UFloatBits((uint32_t)a.v[i])) }
+inline USimdInt USimdGather(const uint32_t* base, USimdInt index) { USIMD_LANES(USimdInt, r.v[i] = (int32_t)base[index.v[i]]) }
+#undef USIMD_LANES
+
+#endif
+
+//SHARED HELPERS (written once against the wrappers) ===============================================================================================
+
+inline USimdFloat USimdClamp(USimdFloat a, float lo, float hi) { return USimdMin(USimdMax(a, USimdFloat(lo)), USimdFloat(hi)); }
+
+inline USimdFloat USimdAllOnes() { return USimdAsFloat(USimdInt(-1)); }
+
+//log2 for x > 0 (mantissa folded into [sqrt(1/2), sqrt(2)), atanh series, ~1e-7 relative error)
+inline USimdFloat USimdLog2(USimdFloat x)
+{
+	USimdInt bits = USimdAsInt(x);
+	USimdInt exponent = (bits >> 23) - USimdInt(127);
+	USimdFloat mantissa = USimdAsFloat((bits & USimdInt(0x007FFFFF)) | USimdInt(0x3F800000));
+	USimdFloat big = mantissa > USimdFloat(1.41421356f);
+	mantissa = USimdSelect(big, mantissa * USimdFloat(0.5f), mantissa);
+	exponent = USimdSelect(big, exponent + USimdInt(1), exponent);
+
+	USimdFloat t = (mantissa - USimdFloat(1.0f)) / (mantissa + USimdFloat(1.0f));
+	USimdFloat t2 = t * t;
+	USimdFloat series = USimdMulAdd(t2, USimdMulAdd(t2, USimdMulAdd(t2, USimdFloat(1.0f / 7.0f), USimdFloat(1.0f / 5.0f)), USimdFloat(1.0f / 3.0f)), USimdFloat(1.0f));
+	return USimdMulAdd(t * series, USimdFloat(2.88539008f), USimdToFloat(exponent));	//2/ln(2)
+}
+
+//2^x (integer part through the exponent bits, fraction through a degree 6 series)
+inline USimdFloat USimdExp2(USimdFloat x)
+{
+	x = USimdClamp(x, -126.0f, 126.0f);
+	USimdFloat whole = USimdFloor(x);
+	USimdFloat f = (x - whole) * USimdFloat(0.69314718f);
+	USimdFloat p = USimdMulAdd(f, USimdFloat(1.0f / 720.0f), USimdFloat(1.0f / 120.0f));
+	p = USimdMulAdd(f, p, USimdFloat(1.0f / 24.0f));
+	p = USimdMulAdd(f, p, USimdFloat(1.0f / 6.0f));
+	p = USimdMulAdd(f, p, USimdFloat(0.5f));
+	p = USimdMulAdd(f, p, USimdFloat(1.0f));
+	p = USimdMulAdd(f, p, USimdFloat(1.0f));
+	USimdFloat scale = USimdAsFloat((USimdToInt(whole) + USimdInt(127)) << 23);
+	return p * scale;
+}
+
+//pow(x, y) for x >= 0 (0 stays 0, as in GLSL for positive exponents)
+inline USimdFloat USimdPow(USimdFloat x, USimdFloat y)
+{
+	USimdFloat positive = x > USimdFloat(0.0f);
+	USimdFloat safe = USimdSelect(positive, x, USimdFloat(1.0f));
+	return USimdSelect(positive, USimdExp2(USimdLog2(safe) * y), USimdFloat(0.0f));
+}
+
+inline USimdFloat USimdRcpSqrt(USimdFloat x) { return USimdFloat(1.0f) / USimdSqrt(x); }
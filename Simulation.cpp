@@ -0,0 +1,202 @@
+#include "Simulation.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+#include "Trace.h"
+
+using namespace std;
+
+namespace
+{
+	typedef chrono::steady_clock Clock;
+
+	//one published step: the state before and after it
+	struct Snapshot
+	{
+		long long tick;
+		USimState previous;
+		USimState current;
+	};
+
+	//lock-free triple buffer: the writer fills its own slot and swaps it with the shared one, the reader swaps the
+	//shared one for its own only when something new was published (bit 4 of the shared index)
+	const unsigned FRESH = 4;
+	Snapshot gSlots[3];
+	atomic<unsigned> gShared(1);
+	unsigned gWriteSlot = 0;
+	unsigned gReadSlot = 2;
+
+	//input handed over by the window thread
+	mutex gInputMutex;
+	uint32_t gKeys = 0;
+	float gCameraSpeed = 0.01f;
+	float gYawOffset = 0.0f;
+	float gPitchOffset = 0.0f;
+
+	thread gThread;
+	atomic<bool> gRunning(false);
+	double gStep = 1.0 / 120.0;
+	Clock::time_point gStart;
+
+	void UPublish(const Snapshot& snapshot)
+	{
+		gSlots[gWriteSlot] = snapshot;
+		gWriteSlot = gShared.exchange(gWriteSlot | FRESH) & 3;
+	}
+
+	//one fixed step of camera movement (same rules as the old per-frame UProcessInput, scaled to the step length)
+	void UStep(USimState& state, uint32_t keys, float cameraSpeed, float yawOffset, float pitchOffset)
+	{
+		state.yaw += yawOffset;
+		state.pitch = std::min(std::max(state.pitch + pitchOffset, -89.0f), 89.0f);
+
+		glm::vec3 front;
+		front.x = cos(glm::radians(state.yaw)) * cos(glm::radians(state.pitch));
+		front.y = sin(glm::radians(state.pitch));
+		front.z = sin(glm::radians(state.yaw)) * cos(glm::radians(state.pitch));
+		front = glm::normalize(front);
+		const glm::vec3 up(0.0f, 1.0f, 0.0f);
+		glm::vec3 right = glm::normalize(glm::cross(front, up));
+
+		float distance = cameraSpeed * 60.0f * (float)gStep;
+		if (keys & USIM_KEY_FORWARD)
+			state.cameraPos += distance * front;
+		if (keys & USIM_KEY_BACK)
+			state.cameraPos -= distance * front;
+		if (keys & USIM_KEY_LEFT)
+			state.cameraPos -= right * distance;
+		if (keys & USIM_KEY_RIGHT)
+			state.cameraPos += right * distance;
+		if (keys & USIM_KEY_DOWN)
+			state.cameraPos -= distance * up;
+		if (keys & USIM_KEY_UP)
+			state.cameraPos += distance * up;
+
+		state.time += gStep;
+	}
+
+	void UUpdateThread(USimState state)
+	{
+		UTraceThreadName("simulation");
+		Snapshot snapshot = { 0, state, state };
+		long long tick = 0;
+		Clock::time_point next = gStart;
+		while (gRunning.load(memory_order_relaxed))
+		{
+			next += chrono::duration_cast<Clock::duration>(chrono::duration<double>(gStep));
+			this_thread::sleep_until(next);
+			//after a long stall (debugger, window drag) drop the missed steps instead of fast-forwarding through them
+			if (Clock::now() - next > chrono::milliseconds(250))
+			{
+				long long skipped = (long long)(chrono::duration<double>(Clock::now() - next).count() / gStep);
+				next += chrono::duration_cast<Clock::duration>(chrono::duration<double>(gStep * skipped));
+				tick += skipped;
+				state.time += gStep * skipped;
+			}
+
+			UTRACE_SCOPE("simulation step");
+			uint32_t keys;
+			float cameraSpeed, yawOffset, pitchOffset;
+			{
+				lock_guard<mutex> lock(gInputMutex);
+				keys = gKeys;
+				cameraSpeed = gCameraSpeed;
+				yawOffset = gYawOffset;
+				pitchOffset = gPitchOffset;
+				gYawOffset = gPitchOffset = 0.0f;
+			}
+
+			snapshot.previous = state;
+			UStep(state, keys, cameraSpeed, yawOffset, pitchOffset);
+			tick++;
+			snapshot.current = state;
+			snapshot.tick = tick;
+			UPublish(snapshot);
+		}
+	}
+}
+
+bool UParseSimulationArgs(int argc, char* argv[], USimConfig& config)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--sim-hz") == 0)
+		{
+			if (i + 1 >= argc || atof(argv[i + 1]) <= 0.0)
+			{
+				cerr << "ERROR: --sim-hz needs a rate above 0" << endl;
+				return false;
+			}
+			config.hz = atof(argv[++i]);
+		}
+	}
+	return true;
+}
+
+void USimulationStart(const USimConfig& config, const USimState& initial)
+{
+	gStep = 1.0 / config.hz;
+	gStart = Clock::now();
+	Snapshot first = { 0, initial, initial };
+	for (Snapshot& slot : gSlots)
+		slot = first;
+	gShared.store(1);
+	gWriteSlot = 0;
+	gReadSlot = 2;
+
+	gRunning = true;
+	gThread = thread(UUpdateThread, initial);
+	cout << "INFO: simulation thread at " << config.hz << " Hz" << endl;
+}
+
+void USimulationStop()
+{
+	if (!gRunning)
+		return;
+	gRunning = false;
+	gThread.join();
+}
+
+bool USimulationRunning()
+{
+	return gRunning;
+}
+
+void USimulationSetInput(uint32_t keys, float cameraSpeed)
+{
+	lock_guard<mutex> lock(gInputMutex);
+	gKeys = keys;
+	gCameraSpeed = cameraSpeed;
+}
+
+void USimulationAddLook(float yawOffset, float pitchOffset)
+{
+	lock_guard<mutex> lock(gInputMutex);
+	gYawOffset += yawOffset;
+	gPitchOffset += pitchOffset;
+}
+
+long long USimulationSample(USimState& state)
+{
+	if (gShared.load(memory_order_acquire) & FRESH)
+		gReadSlot = gShared.exchange(gReadSlot) & 3;
+	const Snapshot& snapshot = gSlots[gReadSlot];
+
+	//render one step behind real time: step k ends at k * step, so the blend factor is how far we are past it
+	double now = chrono::duration<double>(Clock::now() - gStart).count();
+	float alpha = (float)std::min(std::max((now - snapshot.tick * gStep) / gStep, 0.0), 1.0);
+
+	state.cameraPos = glm::mix(snapshot.previous.cameraPos, snapshot.current.cameraPos, alpha);
+	state.yaw = glm::mix(snapshot.previous.yaw, snapshot.current.yaw, alpha);
+	state.pitch = glm::mix(snapshot.previous.pitch, snapshot.current.pitch, alpha);
+	state.time = snapshot.previous.time + (snapshot.current.time - snapshot.previous.time) * alpha;
+	return snapshot.tick;
+}
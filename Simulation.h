@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+//FIXED-TIMESTEP SIMULATION THREAD =================================================================================================================
+//
+// --sim-hz <n>     simulation rate of the update thread (default 120)
+//
+// the window thread only samples input (keys held, mouse look, scroll speed) and hands it over; a separate update thread
+// steps the camera (and any animation state) at a fixed rate and publishes each step as a snapshot holding the previous
+// and the current state through a lock-free triple buffer. the renderer draws one step behind real time, interpolating
+// between the two states of the newest snapshot, so motion is the same at any frame rate and simulation cost no longer
+// scales with the number of frames drawn. camera speed is in units per 1/60 s (the old per-frame step at 60 fps).
+
+enum USimKey : uint32_t
+{
+	USIM_KEY_FORWARD = 1,
+	USIM_KEY_BACK = 2,
+	USIM_KEY_LEFT = 4,
+	USIM_KEY_RIGHT = 8,
+	USIM_KEY_DOWN = 16,
+	USIM_KEY_UP = 32,
+};
+
+struct USimConfig
+{
+	double hz = 120.0;
+};
+
+//what the simulation owns (everything the frame needs to know about the world state)
+struct USimState
+{
+	glm::vec3 cameraPos;
+	float yaw;
+	float pitch;
+	double time;			//simulation time in seconds (drives animation)
+};
+
+bool UParseSimulationArgs(int argc, char* argv[], USimConfig& config);
+
+void USimulationStart(const USimConfig& config, const USimState& initial);
+void USimulationStop();
+bool USimulationRunning();
+
+//input from the window thread (keys held right now, accumulated look offsets in degrees, camera speed)
+void USimulationSetInput(uint32_t keys, float cameraSpeed);
+void USimulationAddLook(float yawOffset, float pitchOffset);
+
+//state to draw right now, interpolated between the two newest steps; returns the newest step number
+long long USimulationSample(USimState& state);
@@ -0,0 +1,681 @@
+#include "SoftwareRasterizer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bitset>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include <glm/gtx/transform.hpp>
+
+#include "Benchmark.h"
+#include "JobSystem.h"
+#include "Materials.h"
+#include "Simd.h"
+#include "Trace.h"
+
+using namespace std;
+
+namespace
+{
+	const int TILE_SIZE = 64;
+	const int BLOCK_W = 4;
+	const int BLOCK_H = 2;
+	//world position(3), normal(3), texture coords(2)
+	const int ATTRIBUTES = 8;
+
+	struct ClipVertex
+	{
+		glm::vec4 clip;
+		float attr[ATTRIBUTES];
+	};
+
+	struct SetupTriangle
+	{
+		float edgeA[3], edgeB[3], edgeC[3];		//edge i is opposite vertex i, positive inside
+		bool topLeft[3];
+		float invArea;
+		float z[3];
+		float invW[3];
+		float attr[3][ATTRIBUTES];				//pre-multiplied by 1/w for perspective correct interpolation
+		int minX, minY, maxX, maxY;				//inclusive pixel bounds, clamped to the target
+		int texture;
+		float shininess;
+	};
+
+	struct DrawConstants
+	{
+		glm::mat4 mvp;
+		glm::mat4 model;
+		glm::mat3 normal;
+	};
+
+	//per frame scratch, reused between frames so steady state rendering does not allocate
+	struct Chunk
+	{
+		vector<SetupTriangle> triangles;
+		vector<vector<uint32_t> > bins;			//per tile, indices into triangles
+		uint64_t binned;
+	};
+	vector<DrawConstants> drawConstants;
+	vector<int> triangleStart;					//prefix sum of triangles per draw item
+	vector<Chunk> chunks;
+
+	ClipVertex UFetchVertex(const GLMesh& mesh, const DrawConstants& constants, unsigned short index)
+	{
+		const float* v = &mesh.vertices[index * FLOATS_PER_MESH_VERTEX];
+		glm::vec4 position(v[0], v[1], v[2], 1.0f);
+		glm::vec3 world = glm::vec3(constants.model * position);
+		glm::vec3 normal = constants.normal * glm::vec3(v[MESH_NORMAL_OFFSET], v[MESH_NORMAL_OFFSET + 1], v[MESH_NORMAL_OFFSET + 2]);
+
+		ClipVertex out;
+		out.clip = constants.mvp * position;
+		out.attr[0] = world.x; out.attr[1] = world.y; out.attr[2] = world.z;
+		out.attr[3] = normal.x; out.attr[4] = normal.y; out.attr[5] = normal.z;
+		out.attr[6] = v[MESH_TEXCOORD_OFFSET]; out.attr[7] = v[MESH_TEXCOORD_OFFSET + 1];
+		return out;
+	}
+
+	ClipVertex ULerp(const ClipVertex& a, const ClipVertex& b, float t)
+	{
+		ClipVertex out;
+		out.clip = a.clip + (b.clip - a.clip) * t;
+		for (int i = 0; i < ATTRIBUTES; i++)
+			out.attr[i] = a.attr[i] + (b.attr[i] - a.attr[i]) * t;
+		return out;
+	}
+
+	//clip a triangle against the near plane (z >= -w), returns the vertex count of the resulting polygon (0, 3 or 4)
+	int UClipNear(const ClipVertex in[3], ClipVertex out[4])
+	{
+		int count = 0;
+		for (int i = 0; i < 3; i++)
+		{
+			const ClipVertex& a = in[i];
+			const ClipVertex& b = in[(i + 1) % 3];
+			float da = a.clip.z + a.clip.w;
+			float db = b.clip.z + b.clip.w;
+			if (da >= 0.0f)
+				out[count++] = a;
+			if ((da >= 0.0f) != (db >= 0.0f))
+				out[count++] = ULerp(a, b, da / (da - db));
+		}
+		return count;
+	}
+
+	//edge function through a and b, evaluated with the end points in a canonical order so two triangles that share the
+	//edge compute bit-identical (negated) values and the top-left rule gives every pixel to exactly one of them
+	void USetupEdge(glm::vec2 a, glm::vec2 b, float& A, float& B, float& C)
+	{
+		bool swapped = a.y > b.y || (a.y == b.y && a.x > b.x);
+		glm::vec2 lo = swapped ? b : a;
+		glm::vec2 hi = swapped ? a : b;
+		A = lo.y - hi.y;
+		B = hi.x - lo.x;
+		C = (hi.y - lo.y) * lo.x - (hi.x - lo.x) * lo.y;
+		if (swapped)
+		{
+			A = -A;
+			B = -B;
+			C = -C;
+		}
+	}
+
+	void USetupTriangle(const ClipVertex v[3], int texture, float shininess, int width, int height, Chunk& chunk)
+	{
+		glm::vec2 screen[3];
+		float z[3], invW[3];
+		for (int i = 0; i < 3; i++)
+		{
+			invW[i] = 1.0f / v[i].clip.w;
+			screen[i].x = (v[i].clip.x * invW[i] * 0.5f + 0.5f) * width;
+			screen[i].y = (0.5f - v[i].clip.y * invW[i] * 0.5f) * height;
+			z[i] = v[i].clip.z * invW[i] * 0.5f + 0.5f;
+		}
+
+		//signed area (no face culling, the GL path doesn't cull either), make it positive by swapping two vertices
+		float area = (screen[1].x - screen[0].x) * (screen[2].y - screen[0].y) - (screen[1].y - screen[0].y) * (screen[2].x - screen[0].x);
+		if (area == 0.0f || area != area)
+			return;
+		int order[3] = { 0, 1, 2 };
+		if (area < 0.0f)
+		{
+			order[1] = 2;
+			order[2] = 1;
+			area = -area;
+		}
+
+		SetupTriangle tri;
+		float minX = (float)width, minY = (float)height, maxX = 0.0f, maxY = 0.0f;
+		for (int i = 0; i < 3; i++)
+		{
+			int s = order[i];
+			tri.z[i] = z[s];
+			tri.invW[i] = invW[s];
+			for (int a = 0; a < ATTRIBUTES; a++)
+				tri.attr[i][a] = v[s].attr[a] * invW[s];
+			minX = std::min(minX, screen[s].x);
+			minY = std::min(minY, screen[s].y);
+			maxX = std::max(maxX, screen[s].x);
+			maxY = std::max(maxY, screen[s].y);
+		}
+
+		//edge i is opposite vertex i
+		for (int i = 0; i < 3; i++)
+		{
+			glm::vec2 a = screen[order[(i + 1) % 3]];
+			glm::vec2 b = screen[order[(i + 2) % 3]];
+			USetupEdge(a, b, tri.edgeA[i], tri.edgeB[i], tri.edgeC[i]);
+			tri.topLeft[i] = tri.edgeA[i] > 0.0f || (tri.edgeA[i] == 0.0f && tri.edgeB[i] > 0.0f);
+		}
+		tri.invArea = 1.0f / area;
+
+		tri.minX = std::max(0, (int)floor(minX));
+		tri.minY = std::max(0, (int)floor(minY));
+		tri.maxX = std::min(width - 1, (int)ceil(maxX));
+		tri.maxY = std::min(height - 1, (int)ceil(maxY));
+		if (tri.minX > tri.maxX || tri.minY > tri.maxY)
+			return;
+		tri.texture = texture;
+		tri.shininess = shininess;
+
+		uint32_t index = (uint32_t)chunk.triangles.size();
+		chunk.triangles.push_back(tri);
+		chunk.binned++;
+
+		int tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+		for (int ty = tri.minY / TILE_SIZE; ty <= tri.maxY / TILE_SIZE; ty++)
+			for (int tx = tri.minX / TILE_SIZE; tx <= tri.maxX / TILE_SIZE; tx++)
+				chunk.bins[ty * tilesX + tx].push_back(index);
+	}
+
+	//vertex processing, clipping, setup and binning for the submitted triangles [begin, end)
+	void UProcessTriangles(const vector<UDrawItem>& items, int begin, int end, int width, int height, Chunk& chunk)
+	{
+		int draw = (int)(upper_bound(triangleStart.begin(), triangleStart.end(), begin) - triangleStart.begin()) - 1;
+		for (int t = begin; t < end; t++)
+		{
+			while (t >= triangleStart[draw + 1])
+				draw++;
+			const UDrawItem& item = items[draw];
+			const GLMesh& mesh = *item.mesh;
+			const DrawConstants& constants = drawConstants[draw];
+			int local = (t - triangleStart[draw]) * 3;
+
+			ClipVertex v[3];
+			for (int i = 0; i < 3; i++)
+				v[i] = UFetchVertex(mesh, constants, mesh.indices[local + i]);
+
+			//trivially reject triangles completely outside one of the side/far planes
+			bool outside = false;
+			for (int axis = 0; axis < 3 && !outside; axis++)
+			{
+				outside = (v[0].clip[axis] > v[0].clip.w && v[1].clip[axis] > v[1].clip.w && v[2].clip[axis] > v[2].clip.w)
+					|| (axis < 2 && v[0].clip[axis] < -v[0].clip.w && v[1].clip[axis] < -v[1].clip.w && v[2].clip[axis] < -v[2].clip.w);
+			}
+			if (outside)
+				continue;
+
+			ClipVertex polygon[4];
+			int count = UClipNear(v, polygon);
+			for (int i = 2; i < count; i++)
+			{
+				ClipVertex fan[3] = { polygon[0], polygon[i - 1], polygon[i] };
+				USetupTriangle(fan, item.texture, UMaterialGet(item.material).shininess, width, height, chunk);
+			}
+		}
+	}
+
+	//bilinear / nearest texture fetch for 8 lanes
+	void USample(const USoftTexture& texture, USimdFloat u, USimdFloat v, USimdFloat rgb[3])
+	{
+		if (texture.texels.empty())
+		{
+			rgb[0] = rgb[1] = rgb[2] = USimdFloat(1.0f);
+			return;
+		}
+
+		USimdFloat w((float)texture.width);
+		USimdFloat h((float)texture.height);
+		if (texture.repeat)
+		{
+			u = u - USimdFloor(u);
+			v = v - USimdFloor(v);
+		}
+		else
+		{
+			u = USimdClamp(u, 0.0f, 1.0f);
+			v = USimdClamp(v, 0.0f, 1.0f);
+		}
+
+		USimdInt maxX(texture.width - 1);
+		USimdInt maxY(texture.height - 1);
+		USimdInt stride(texture.width);
+
+		if (!texture.linear)
+		{
+			USimdInt x = USimdMin(USimdMax(USimdToInt(USimdFloor(u * w)), USimdInt(0)), maxX);
+			USimdInt y = USimdMin(USimdMax(USimdToInt(USimdFloor(v * h)), USimdInt(0)), maxY);
+			USimdInt texel = USimdGather(texture.texels.data(), y * stride + x);
+			for (int c = 0; c < 3; c++)
+				rgb[c] = USimdToFloat((texel >> (8 * c)) & USimdInt(0xFF)) * USimdFloat(1.0f / 255.0f);
+			return;
+		}
+
+		USimdFloat x = u * w - USimdFloat(0.5f);
+		USimdFloat y = v * h - USimdFloat(0.5f);
+		USimdFloat x0f = USimdFloor(x);
+		USimdFloat y0f = USimdFloor(y);
+		USimdFloat fx = x - x0f;
+		USimdFloat fy = y - y0f;
+		USimdInt x0 = USimdToInt(x0f);
+		USimdInt y0 = USimdToInt(y0f);
+		USimdInt x1 = x0 + USimdInt(1);
+		USimdInt y1 = y0 + USimdInt(1);
+		if (texture.repeat)
+		{
+			//u, v are in [0, 1) so the neighbours are at most one texel outside
+			x0 = USimdSelect(USimdLess(x0, USimdInt(0)), x0 + USimdInt(texture.width), x0);
+			y0 = USimdSelect(USimdLess(y0, USimdInt(0)), y0 + USimdInt(texture.height), y0);
+			x1 = USimdSelect(USimdLess(maxX, x1), x1 - USimdInt(texture.width), x1);
+			y1 = USimdSelect(USimdLess(maxY, y1), y1 - USimdInt(texture.height), y1);
+		}
+		x0 = USimdMin(USimdMax(x0, USimdInt(0)), maxX);
+		y0 = USimdMin(USimdMax(y0, USimdInt(0)), maxY);
+		x1 = USimdMin(USimdMax(x1, USimdInt(0)), maxX);
+		y1 = USimdMin(USimdMax(y1, USimdInt(0)), maxY);
+
+		USimdInt t00 = USimdGather(texture.texels.data(), y0 * stride + x0);
+		USimdInt t10 = USimdGather(texture.texels.data(), y0 * stride + x1);
+		USimdInt t01 = USimdGather(texture.texels.data(), y1 * stride + x0);
+		USimdInt t11 = USimdGather(texture.texels.data(), y1 * stride + x1);
+		USimdFloat scale(1.0f / 255.0f);
+		for (int c = 0; c < 3; c++)
+		{
+			USimdInt mask(0xFF);
+			USimdFloat c00 = USimdToFloat((t00 >> (8 * c)) & mask);
+			USimdFloat c10 = USimdToFloat((t10 >> (8 * c)) & mask);
+			USimdFloat c01 = USimdToFloat((t01 >> (8 * c)) & mask);
+			USimdFloat c11 = USimdToFloat((t11 >> (8 * c)) & mask);
+			USimdFloat top = USimdMulAdd(c10 - c00, fx, c00);
+			USimdFloat bottom = USimdMulAdd(c11 - c01, fx, c01);
+			rgb[c] = USimdMulAdd(bottom - top, fy, top) * scale;
+		}
+	}
+
+	struct ShadeConstants
+	{
+		glm::vec3 cameraPos;
+		glm::vec3 lightDir;
+		glm::vec3 lightDir2;
+		glm::vec3 ambient;			//light.ambient * material.ambient
+		glm::vec3 diffuse;			//material.diffuse * light.diffuse
+		glm::vec3 diffuse2;			//material.diffuse * tint * light.diffuse
+		glm::vec3 specular;			//material.specular * 0.5 * light.specular
+		glm::vec3 specular2;		//material.specular * tint * light.specular
+	};
+
+	inline USimdFloat UDot(const USimdFloat a[3], const glm::vec3& b)
+	{
+		return USimdMulAdd(a[0], USimdFloat(b.x), USimdMulAdd(a[1], USimdFloat(b.y), a[2] * USimdFloat(b.z)));
+	}
+
+	inline USimdFloat UDot(const USimdFloat a[3], const USimdFloat b[3])
+	{
+		return USimdMulAdd(a[0], b[0], USimdMulAdd(a[1], b[1], a[2] * b[2]));
+	}
+
+	inline void UNormalize(USimdFloat v[3])
+	{
+		USimdFloat scale = USimdRcpSqrt(USimdMax(UDot(v, v), USimdFloat(1e-20f)));
+		for (int c = 0; c < 3; c++)
+			v[c] = v[c] * scale;
+	}
+
+	//the two-light phong of fragmentShaderSource, 8 fragments at a time
+	void UShade(const ShadeConstants& k, float shininess, const USimdFloat world[3], USimdFloat normal[3], const USimdFloat texel[3], USimdFloat rgb[3])
+	{
+		UNormalize(normal);
+
+		USimdFloat view[3] = { USimdFloat(k.cameraPos.x) - world[0], USimdFloat(k.cameraPos.y) - world[1], USimdFloat(k.cameraPos.z) - world[2] };
+		UNormalize(view);
+
+		USimdFloat zero(0.0f);
+		USimdFloat power(shininess);
+
+		//reflect(-L, N) = 2 dot(N, L) N - L
+		USimdFloat nDotL = UDot(normal, k.lightDir);
+		USimdFloat diff = USimdMax(nDotL, zero);
+		USimdFloat reflected[3];
+		for (int c = 0; c < 3; c++)
+			reflected[c] = USimdMulAdd(nDotL + nDotL, normal[c], USimdFloat(-k.lightDir[c]));
+		USimdFloat spec = USimdPow(USimdMax(UDot(view, reflected), zero), power);
+
+		USimdFloat nDotL2 = UDot(normal, k.lightDir2);
+		USimdFloat diff2 = USimdMax(nDotL2, zero);
+		for (int c = 0; c < 3; c++)
+			reflected[c] = USimdMulAdd(nDotL2 + nDotL2, normal[c], USimdFloat(-k.lightDir2[c]));
+		USimdFloat spec2 = USimdPow(USimdMax(UDot(view, reflected), zero), power);
+
+		for (int c = 0; c < 3; c++)
+		{
+			USimdFloat light = USimdFloat(k.ambient[c]);
+			light = USimdMulAdd(diff, USimdFloat(k.diffuse[c]), light);
+			light = USimdMulAdd(diff2, USimdFloat(k.diffuse2[c]), light);
+			light = USimdMulAdd(spec, USimdFloat(k.specular[c]), light);
+			light = USimdMulAdd(spec2, USimdFloat(k.specular2[c]), light);
+			rgb[c] = light * texel[c];
+		}
+	}
+
+	void URasterTriangle(const SetupTriangle& tri, const ShadeConstants& constants, const vector<USoftTexture>& textures,
+		int tileX0, int tileY0, int tileX1, int tileY1, USoftwareTarget& target, uint64_t& fragments)
+	{
+		int x0 = std::max(tri.minX, tileX0) & ~(BLOCK_W - 1);
+		int y0 = std::max(tri.minY, tileY0) & ~(BLOCK_H - 1);
+		int x1 = std::min(tri.maxX, tileX1);
+		int y1 = std::min(tri.maxY, tileY1);
+		if (x0 > x1 || y0 > y1)
+			return;
+
+		static const USoftTexture noTexture;
+		const USoftTexture& texture = tri.texture >= 0 && tri.texture < (int)textures.size() ? textures[tri.texture] : noTexture;
+		const USimdFloat laneX = USimdFloat::Lanes(0.5f, 1.5f, 2.5f, 3.5f, 0.5f, 1.5f, 2.5f, 3.5f);
+		const USimdFloat laneY = USimdFloat::Lanes(0.5f, 0.5f, 0.5f, 0.5f, 1.5f, 1.5f, 1.5f, 1.5f);
+		const USimdFloat zero(0.0f);
+		const USimdFloat width((float)target.width);
+		const USimdFloat height((float)target.height);
+
+		for (int by = y0; by <= y1; by += BLOCK_H)
+		{
+			USimdFloat py = USimdFloat((float)by) + laneY;
+			for (int bx = x0; bx <= x1; bx += BLOCK_W)
+			{
+				USimdFloat px = USimdFloat((float)bx) + laneX;
+
+				//coverage (top-left rule) + pixels inside the target
+				USimdFloat edge[3];
+				USimdFloat mask = (px < width) & (py < height);
+				for (int e = 0; e < 3; e++)
+				{
+					edge[e] = USimdMulAdd(USimdFloat(tri.edgeA[e]), px, USimdMulAdd(USimdFloat(tri.edgeB[e]), py, USimdFloat(tri.edgeC[e])));
+					mask = mask & (tri.topLeft[e] ? edge[e] >= zero : edge[e] > zero);
+				}
+				if (!USimdMask(mask))
+					continue;
+
+				//barycentrics and depth test (GL_LESS)
+				USimdFloat l0 = edge[0] * USimdFloat(tri.invArea);
+				USimdFloat l1 = edge[1] * USimdFloat(tri.invArea);
+				USimdFloat l2 = edge[2] * USimdFloat(tri.invArea);
+				USimdFloat z = USimdMulAdd(l0, USimdFloat(tri.z[0]), USimdMulAdd(l1, USimdFloat(tri.z[1]), l2 * USimdFloat(tri.z[2])));
+
+				size_t block = ((size_t)(by / BLOCK_H) * target.blocksX + bx / BLOCK_W) * USIMD_WIDTH;
+				float* depth = &target.depth[block];
+				USimdFloat stored = USimdFloat::Load(depth);
+				mask = mask & (z < stored) & (z >= zero);
+				int bits = USimdMask(mask);
+				if (!bits)
+					continue;
+				USimdSelect(mask, z, stored).Store(depth);
+
+				//perspective correct attributes
+				USimdFloat w = USimdFloat(1.0f) / USimdMulAdd(l0, USimdFloat(tri.invW[0]), USimdMulAdd(l1, USimdFloat(tri.invW[1]), l2 * USimdFloat(tri.invW[2])));
+				USimdFloat attr[ATTRIBUTES];
+				for (int a = 0; a < ATTRIBUTES; a++)
+					attr[a] = USimdMulAdd(l0, USimdFloat(tri.attr[0][a]), USimdMulAdd(l1, USimdFloat(tri.attr[1][a]), l2 * USimdFloat(tri.attr[2][a]))) * w;
+
+				USimdFloat texel[3], rgb[3];
+				USample(texture, attr[6], attr[7], texel);
+				UShade(constants, tri.shininess, &attr[0], &attr[3], texel, rgb);
+
+				//pack to rgba8 and write the covered lanes
+				USimdInt packed(0xFF000000);
+				for (int c = 0; c < 3; c++)
+					packed = packed | (USimdToInt(USimdMulAdd(USimdClamp(rgb[c], 0.0f, 1.0f), USimdFloat(255.0f), USimdFloat(0.5f))) << (8 * c));
+				int32_t* color = (int32_t*)&target.color[block];
+				USimdSelect(mask, packed, USimdInt::Load(color)).Store(color);
+
+				fragments += bitset<USIMD_WIDTH>((unsigned long)bits).count();
+			}
+		}
+	}
+}
+
+//SETUP ============================================================================================================================================
+
+bool UParseSoftwareArgs(int argc, char* argv[], USoftwareConfig& config)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--software") == 0)
+		{
+			config.enabled = true;
+			if (i + 1 < argc && argv[i + 1][0] != '-')
+				config.outFile = argv[++i];
+		}
+		else if (strcmp(argv[i], "--software-bench") == 0 || strcmp(argv[i], "--software-threads") == 0)
+		{
+			if (i + 1 >= argc)
+			{
+				cerr << "ERROR: " << argv[i] << " needs a value" << endl;
+				return false;
+			}
+			config.enabled = true;
+			if (strcmp(argv[i], "--software-bench") == 0)
+				config.benchFrames = atoi(argv[++i]);
+			else
+				config.threads = atoi(argv[++i]);
+		}
+	}
+	return true;
+}
+
+void UPrepareSoftTextures(const std::vector<USceneTexture>& textures, std::vector<USoftTexture>& soft)
+{
+	soft.resize(textures.size());
+	for (size_t i = 0; i < textures.size(); i++)
+	{
+		const UImage& image = textures[i].image;
+		USoftTexture& out = soft[i];
+		out.width = image.width;
+		out.height = image.height;
+		out.repeat = textures[i].repeat;
+		out.linear = textures[i].linear;
+		out.texels.resize((size_t)image.width * image.height);
+		for (size_t p = 0; p < out.texels.size(); p++)
+		{
+			const unsigned char* source = &image.pixels[p * image.channels];
+			uint32_t r = source[0];
+			uint32_t g = image.channels > 1 ? source[1] : r;
+			uint32_t b = image.channels > 2 ? source[2] : r;
+			out.texels[p] = r | (g << 8) | (b << 16) | 0xFF000000u;
+		}
+	}
+}
+
+void UResizeSoftwareTarget(USoftwareTarget& target, int width, int height)
+{
+	target.width = width;
+	target.height = height;
+	target.blocksX = (width + BLOCK_W - 1) / BLOCK_W;
+	target.blocksY = (height + BLOCK_H - 1) / BLOCK_H;
+	size_t pixels = (size_t)target.blocksX * target.blocksY * USIMD_WIDTH;
+	target.color.assign(pixels, 0xFF000000u);
+	target.depth.assign(pixels, 1.0f);
+}
+
+//RENDER ===========================================================================================================================================
+
+void USoftwareRender(const std::vector<UDrawItem>& items, const USceneGraph& scene, const std::vector<USoftTexture>& textures, const USceneLighting& lighting,
+	const glm::mat4& view, const glm::mat4& projection, const glm::vec3& cameraPos, USoftwareTarget& target, USoftwareStats& stats)
+{
+	UTRACE_SCOPE("USoftwareRender");
+
+	//per draw constants (what URenderMesh would upload)
+	drawConstants.resize(items.size());
+	triangleStart.resize(items.size() + 1);
+	triangleStart[0] = 0;
+	glm::mat4 viewProjection = projection * view;
+	for (size_t i = 0; i < items.size(); i++)
+	{
+		DrawConstants& constants = drawConstants[i];
+		constants.model = scene.world[items[i].node];
+		constants.mvp = viewProjection * constants.model;
+		constants.normal = glm::mat3(glm::transpose(glm::inverse(constants.model)));
+		triangleStart[i + 1] = triangleStart[i] + (int)items[i].mesh->indices.size() / 3;
+	}
+	int triangles = triangleStart.back();
+
+	int tilesX = (target.width + TILE_SIZE - 1) / TILE_SIZE;
+	int tilesY = (target.height + TILE_SIZE - 1) / TILE_SIZE;
+	int tileCount = tilesX * tilesY;
+
+	//front end: vertex work, clipping, setup and binning in contiguous chunks so tiles can replay them in submission order
+	int chunkCount = std::max(1, std::min(UJobsThreadCount() * 4, (triangles + 63) / 64));
+	int perChunk = (triangles + chunkCount - 1) / chunkCount;
+	if (chunks.size() < (size_t)chunkCount)
+		chunks.resize(chunkCount);
+	for (int c = 0; c < chunkCount; c++)
+	{
+		chunks[c].triangles.clear();
+		chunks[c].bins.resize(tileCount);
+		for (vector<uint32_t>& bin : chunks[c].bins)
+			bin.clear();
+		chunks[c].binned = 0;
+	}
+
+	{
+		UTRACE_SCOPE("setup + binning");
+		UParallelFor(chunkCount, 1, [&](int begin, int end, int)
+		{
+			for (int c = begin; c < end; c++)
+				UProcessTriangles(items, std::min(c * perChunk, triangles), std::min((c + 1) * perChunk, triangles), target.width, target.height, chunks[c]);
+		});
+	}
+
+	ShadeConstants constants;
+	constants.cameraPos = cameraPos;
+	constants.lightDir = glm::normalize(-lighting.direction);
+	constants.lightDir2 = glm::normalize(-lighting.direction2);
+	constants.ambient = lighting.ambient * lighting.materialAmbient;
+	constants.diffuse = lighting.materialDiffuse * lighting.diffuse;
+	constants.diffuse2 = lighting.materialDiffuse * (lighting.tint2 * lighting.diffuse);
+	constants.specular = lighting.materialSpecular * (glm::vec3(0.5f) * lighting.specular);
+	constants.specular2 = lighting.materialSpecular * (lighting.tint2 * lighting.specular);
+
+	//back end: one job per tile, each tile clears and owns its pixels so no synchronisation is needed
+	atomic<uint64_t> fragments(0);
+	{
+		UTRACE_SCOPE("rasterise tiles");
+		UParallelFor(tileCount, 1, [&](int begin, int end, int)
+		{
+			uint64_t shaded = 0;
+			for (int tile = begin; tile < end; tile++)
+			{
+				int tileX0 = (tile % tilesX) * TILE_SIZE;
+				int tileY0 = (tile / tilesX) * TILE_SIZE;
+				int tileX1 = std::min(tileX0 + TILE_SIZE, target.blocksX * BLOCK_W) - 1;
+				int tileY1 = std::min(tileY0 + TILE_SIZE, target.blocksY * BLOCK_H) - 1;
+
+				//clear (glClearColor(0, 0, 0, 1) + depth 1.0)
+				for (int by = tileY0; by <= tileY1; by += BLOCK_H)
+				{
+					size_t first = ((size_t)(by / BLOCK_H) * target.blocksX + tileX0 / BLOCK_W) * USIMD_WIDTH;
+					size_t count = (size_t)((tileX1 - tileX0 + 1) / BLOCK_W) * USIMD_WIDTH;
+					std::fill(target.color.begin() + first, target.color.begin() + first + count, 0xFF000000u);
+					std::fill(target.depth.begin() + first, target.depth.begin() + first + count, 1.0f);
+				}
+
+				for (int c = 0; c < chunkCount; c++)
+				{
+					const Chunk& chunk = chunks[c];
+					for (uint32_t index : chunk.bins[tile])
+						URasterTriangle(chunk.triangles[index], constants, textures, tileX0, tileY0, tileX1, tileY1, target, shaded);
+				}
+			}
+			fragments += shaded;
+		});
+	}
+
+	stats.triangles += triangles;
+	for (int c = 0; c < chunkCount; c++)
+		stats.binned += chunks[c].binned;
+	stats.fragments += fragments;
+}
+
+void UResolveSoftwareTarget(const USoftwareTarget& target, std::vector<unsigned char>& rgba)
+{
+	rgba.resize((size_t)target.width * target.height * 4);
+	for (int y = 0; y < target.height; y++)
+	{
+		for (int x = 0; x < target.width; x++)
+		{
+			size_t block = ((size_t)(y / BLOCK_H) * target.blocksX + x / BLOCK_W) * USIMD_WIDTH;
+			uint32_t texel = target.color[block + (y % BLOCK_H) * BLOCK_W + (x % BLOCK_W)];
+			memcpy(&rgba[((size_t)y * target.width + x) * 4], &texel, 4);
+		}
+	}
+}
+
+//SOFTWARE MODE ====================================================================================================================================
+
+int URunSoftwareRenderer(const USoftwareConfig& config, const std::vector<UDrawItem>& items, const USceneGraph& scene, const std::vector<USceneTexture>& textures,
+	const USceneLighting& lighting, int width, int height, const glm::vec3& cameraPos, const glm::vec3& cameraFront, const glm::vec3& cameraUp)
+{
+	UJobsInit(config.threads);
+	cout << "INFO: software rasteriser, " << UJobsThreadCount() << " threads"
+#ifdef USIMD_AVX2
+		<< ", AVX2"
+#endif
+		<< endl;
+
+	vector<USoftTexture> soft;
+	UPrepareSoftTextures(textures, soft);
+	USoftwareTarget target;
+	UResizeSoftwareTarget(target, width, height);
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)width / (float)height, 0.1f, 100.0f);
+
+	if (config.benchFrames > 0)
+	{
+		//fly the benchmark camera path once over the requested number of frames
+		vector<UCameraKey> path;
+		UDefaultCameraPath(path);
+		USoftwareStats stats;
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		for (int frame = 0; frame < config.benchFrames; frame++)
+		{
+			glm::vec3 position;
+			float yaw, pitch;
+			USampleCameraPath(path, path.back().time * frame / std::max(config.benchFrames - 1, 1), position, yaw, pitch);
+			glm::vec3 front(cos(glm::radians(yaw)) * cos(glm::radians(pitch)), sin(glm::radians(pitch)), sin(glm::radians(yaw)) * cos(glm::radians(pitch)));
+			glm::mat4 view = glm::lookAt(position, position + front, cameraUp);
+			USoftwareRender(items, scene, soft, lighting, view, projection, position, target, stats);
+		}
+		double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		double frames = config.benchFrames;
+		cout << "SOFTWARE BENCH: " << config.benchFrames << " frames " << width << "x" << height << ", "
+			<< seconds * 1000.0 / frames << " ms/frame, "
+			<< stats.triangles / seconds / 1.0e6 << " Mtris/s, "
+			<< frames * width * height / seconds / 1.0e6 << " Mpix/s, "
+			<< stats.fragments / seconds / 1.0e6 << " Mfrags/s shaded" << endl;
+	}
+	else
+	{
+		USoftwareStats stats;
+		glm::mat4 view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
+		USoftwareRender(items, scene, soft, lighting, view, projection, cameraPos, target, stats);
+		cout << "INFO: " << stats.triangles << " triangles, " << stats.binned << " binned, " << stats.fragments << " fragments shaded" << endl;
+	}
+
+	vector<unsigned char> rgba;
+	UResolveSoftwareTarget(target, rgba);
+	bool written = UWritePPM(config.outFile.c_str(), width, height, 4, rgba.data());
+	if (written)
+		cout << "INFO: wrote " << config.outFile << endl;
+
+	UJobsShutdown();
+	return written ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Scene.h"
+
+//TILE-BASED SOFTWARE RASTERISER ===================================================================================================================
+//
+// --software [out.ppm]        render the scene on the cpu without creating a window or GL context, write out.ppm
+// --software-bench <frames>   render frames along the benchmark camera path and report Mtris/s and Mpix/s
+// --software-threads <n>      worker threads (default: one per hardware thread)
+//
+// same vertex layout, transforms and two-light phong shading as vertexShaderSource/fragmentShaderSource, textures follow
+// the GL sampler settings (bilinear for GL_LINEAR, nearest for GL_NEAREST, repeat/clamp). triangles are clipped against
+// the near plane, binned into 64x64 screen tiles and every tile is rasterised by one job on the work-stealing pool,
+// 8 pixels (two 2x2 quads) at a time through the USimdFloat wrappers (AVX2 when available).
+
+struct USoftwareConfig
+{
+	bool enabled = false;
+	std::string outFile = "software.ppm";
+	int benchFrames = 0;
+	int threads = 0;
+};
+
+//texture converted for fast sampling (rgba8 packed, r in the low byte)
+struct USoftTexture
+{
+	int width = 0;
+	int height = 0;
+	bool repeat = false;
+	bool linear = false;
+	std::vector<uint32_t> texels;
+};
+
+//color/depth target, stored in 4x2 pixel blocks so one 8 wide vector covers one block
+struct USoftwareTarget
+{
+	int width = 0;
+	int height = 0;
+	int blocksX = 0;
+	int blocksY = 0;
+	std::vector<uint32_t> color;
+	std::vector<float> depth;
+};
+
+struct USoftwareStats
+{
+	uint64_t triangles = 0;		//submitted
+	uint64_t binned = 0;		//after clipping/trivial rejection
+	uint64_t fragments = 0;		//passed the depth test and were shaded
+};
+
+bool UParseSoftwareArgs(int argc, char* argv[], USoftwareConfig& config);
+
+void UPrepareSoftTextures(const std::vector<USceneTexture>& textures, std::vector<USoftTexture>& soft);
+void UResizeSoftwareTarget(USoftwareTarget& target, int width, int height);
+void USoftwareRender(const std::vector<UDrawItem>& items, const USceneGraph& scene, const std::vector<USoftTexture>& textures, const USceneLighting& lighting,
+	const glm::mat4& view, const glm::mat4& projection, const glm::vec3& cameraPos, USoftwareTarget& target, USoftwareStats& stats);
+//row-major rgba8 copy of the color target (rows top to bottom)
+void UResolveSoftwareTarget(const USoftwareTarget& target, std::vector<unsigned char>& rgba);
+
+//software mode entry point used by main() (returns the process exit code)
+int URunSoftwareRenderer(const USoftwareConfig& config, const std::vector<UDrawItem>& items, const USceneGraph& scene, const std::vector<USceneTexture>& textures,
+	const USceneLighting& lighting, int width, int height, const glm::vec3& cameraPos, const glm::vec3& cameraFront, const glm::vec3& cameraUp);
@@ -1,7 +1,13 @@
 #include <iostream>         // cout, cerr
 #include <cstdlib>          // EXIT_FAILURE
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <chrono>
 #include <GL/glew.h>        // GLEW library
 #include <GLFW/glfw3.h>     // GLFW library
+#include "GLStats.h"        // GL call counting (only active in UGL_INSTRUMENT builds)
 
 //glm headers
 #include <glm/glm.hpp>
@@ -11,6 +17,52 @@
 //image loader for texturing
 #include "stb_image.h"
 
+//scripted camera benchmark mode
+#include "Benchmark.h"
+//chrome trace export
+#include "Trace.h"
+//meshes, textures and the draw list (shared with the cpu renderers)
+#include "Mesh.h"
+#include "Scene.h"
+#include "SceneGraph.h"
+#include "SceneFile.h"
+#include "SoftwareRasterizer.h"
+#include "PathTracer.h"
+//offline lightmap baker + the runtime that draws static objects with it
+#include "Lightmap.h"
+//linked program binaries kept between runs
+#include "ShaderCache.h"
+//fixed-timestep update thread
+#include "Simulation.h"
+//fence-throttled frames in flight, frame cap, input latency
+#include "FramePacing.h"
+//draw list culled and encoded on worker threads, replayed on the GL thread
+#include "CommandList.h"
+#include "JobSystem.h"
+//compute shader culling + multi-draw indirect
+#include "GpuCulling.h"
+//offscreen scene target scaled to a gpu time budget
+#include "DynamicResolution.h"
+//passes with declared inputs/outputs, transient targets aliased by lifetime
+#include "RenderGraph.h"
+//cached static caster atlas + dynamic cascades for the directional lights
+#include "ShadowMaps.h"
+//background shader builds with a fallback program and hot reload, one program per feature permutation
+#include "ShaderProgram.h"
+#include "ShaderVariants.h"
+//structure-of-arrays TRS composed 8 objects at a time (+ its microbenchmark)
+#include "TransformBatch.h"
+//static draws pre-transformed and merged into world space clusters
+#include "StaticGeometry.h"
+//every material in one storage buffer, draws only carry an index
+#include "Materials.h"
+//per-frame linear allocator, heap allocation tracking for the frame loop
+#include "FrameArena.h"
+//owning handles for gl objects, live gpu memory per category and the leak list at exit
+#include "GpuResources.h"
+//camera and orthographic views side by side in one pass (--views)
+#include "MultiView.h"
+
 using namespace std; // Uses the standard namespace
 
 // Unnamed namespace
@@ -22,24 +74,13 @@ namespace
 	const int WINDOW_WIDTH = 800;
 	const int WINDOW_HEIGHT = 600;
 
-	struct GLMesh //define (in c) the GLMesh type
-	{
-		GLuint vao;			//vertex array object
-		GLuint vbos[2];			//vertex buffer object
-		GLuint nIndices;	//number of vertices in the mesh
-	};
-
 	GLFWwindow* gWindow = nullptr;
-	//battery meshes
-	GLMesh gMesh;
-	//plane mesh
-	GLMesh plane;
-	//cube mesh
-	GLMesh cube;
-	GLMesh flatCylinder;
-	GLMesh rect;
+	//meshes referenced by the scene file (index = scene mesh index)
+	std::vector<GLMesh> gMeshes;
 
-	GLuint gProgramId;
+	GLuint gProgramId;						//program the frame draws with (the scene program once built, the fallback until then)
+	GLuint gFallbackProgramId;
+	UShaderVariants gShaderVariants;		//scene.vert + scene.frag permutations, built in the background and hot reloaded
 
 	//for standardized movement speed
 	float deltaTime = 0.0f;	// Time between current frame and last frame
@@ -53,9 +94,55 @@ namespace
 	float yaw = -90;
 	float pitch = 0;
 	bool firstMouse = true;
-	float cameraSpeed = 0.01;
+	float cameraSpeed = 0.01;		//units per 1/60 s
+	//for the fixed-timestep update thread (camera movement, animation)
+	USimConfig gSimConfig;
+	UFramePacingConfig gFramePacing;
+	//for building the draw commands on the job system
+	UCommandListConfig gCommandListConfig;
+	//for the per-frame arena and the frame loop's heap allocation tracking (--frame-arena, --alloc-track)
+	UFrameArenaConfig gFrameArena;
+	//for the live gpu memory report (--gpu-memory) and the leak list at exit
+	UGpuResourcesConfig gGpuResources;
+	//for drawing orthographic views next to the camera's in the same pass (--views)
+	UMultiViewConfig gMultiView;
+	UCommandLists gCommandLists;
+	//for culling and drawing from the gpu (--gpu-culling)
+	UGpuCullingConfig gGpuCulling;
+	//for rendering the scene at a resolution that fits the gpu budget (--dynamic-resolution)
+	UDynamicResolutionConfig gDynamicResolution;
+	//for shadowing the directional lights (--shadows)
+	UShadowConfig gShadows;
+	//for the passes of a frame
+	URenderGraph gFrameGraph;
+	bool gRenderGraphDump = false;
 	//for toggling orthonographic projection
 	bool ortho = false;
+	//for benchmark mode (scripted camera) and camera path recording
+	UBenchmarkConfig gBenchmark;
+	std::vector<UCameraKey> gCameraPath;
+	std::vector<UCameraKey> gRecordedPath;
+	//for the cpu tile rasteriser (--software)
+	USoftwareConfig gSoftware;
+	//for the cpu path-traced reference (--pathtrace)
+	UPathTracerConfig gPathTracer;
+	//for baking (--bake-lightmap) and drawing with (--lightmap) the static objects' lightmap
+	ULightmapConfig gLightmap;
+	//for the batch transform microbenchmark (--bench-transforms)
+	UTransformBenchConfig gTransformBench;
+	//for merging the static draws at load (--freeze-static)
+	UStaticGeometryConfig gStaticGeometry;
+	//for the program binary cache and the startup time report
+	UShaderCacheConfig gShaderCache;
+	std::chrono::steady_clock::time_point gStartupStart;
+	//scene shared by the GL loop and the software renderer
+	USceneLighting gLighting;
+	std::vector<USceneTexture> gTextures;	//index = texture unit
+	std::vector<UDrawItem> gDrawList;		//every draw of a frame, in order
+	USceneGraph gScene;						//transform hierarchy of the draw list
+	//scene file (stays mapped while running, draw item names point into it)
+	USceneFileConfig gSceneConfig;
+	USceneFile gSceneFile;
 	//for texturing 
 
 }
@@ -64,38 +151,43 @@ namespace
 
 bool UInitialize(int, char*[], GLFWwindow** window);
 void UResizeWindow(GLFWwindow* window, int width, int height);
-glm::vec3 UProcessInput(GLFWwindow* window);
+uint32_t UProcessInput(GLFWwindow* window);
+void UUpdateCameraFront();
 
 void UCreateCylinderWallMesh(GLMesh &mesh, float numSections);
 void UCreateFlatCylinderWallMesh(GLMesh &mesh, float numSections);
 void UCreatePlaneMesh(GLMesh &mesh, float scale);
 void UCreateCubeMesh(GLMesh &mesh);
 void UCreateRectMesh(GLMesh &mesh);
+void UUploadMesh(GLMesh &mesh);
 void UDestroyMesh(GLMesh &mesh);
+void UCreateScene(const USceneFile& scene);
 
-void URenderMesh(const GLMesh& mesh, glm::mat4 translation, glm::mat4 rotation, glm::mat4 scale, glm::mat4 view);
+glm::mat4 UProjection();
+void UDrawScene(const glm::mat4& view, const glm::mat4& projection);
+void USetFrameUniforms(GLuint programId);
 
 bool UCreateShaderProgram(const char* vertexShaderSource, const char* fragShaderSource, GLuint &programId);
 void UDestroyShaderProgram(GLuint programId);
 
+unsigned char* ULoadImage(const char* file, int* width, int* height, int* nrChannels, int desiredChannels);
+void UCreateTexture(const char* file, bool repeat, bool linear, GLenum format, int desiredChannels);
+
 //mouse input callbacks
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 //p callback
 void p_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
 
-//VERTEX SHADER SOURCE =====================================================================================================================
+//FALLBACK SHADER SOURCE (drawn with until scene.vert/scene.frag have been built in the background) ===========================================
 
-const char *vertexShaderSource = "#version 440 core\n"
-"layout (location = 0) in vec3 aPos;\n" //Position coordinates
-"layout (location = 1) in vec4 colorFromVBO;\n" //color values
-"layout (location = 2) in vec2 texCoordFromVBO;\n"  //texture coorinate values
-"layout (location = 3) in vec3 aNormal;\n" //normal vector values (for lighting)
+const char *fallbackVertexShaderSource = "#version 440 core\n"
+"layout (location = 0) in vec3 aPos;\n"
+"layout (location = 2) in vec2 texCoordFromVBO;\n"
+"layout (location = 3) in vec3 aNormal;\n"
 
-"out vec4 colorFromVS;\n" //to pass to FS
 "out vec2 texCoord;\n"
 "out vec3 normal;\n"
-"out vec3 fragPos;\n"
 
 "uniform mat4 model;\n"
 "uniform mat4 view;\n"
@@ -103,93 +195,24 @@ const char *vertexShaderSource = "#version 440 core\n"
 
 "void main()\n"
 "{\n"
-"	normal = mat3(transpose(inverse(model))) * aNormal;\n"
-"   gl_Position = projection * view * model * vec4(aPos, 1.0f);\n" //transforms vertices to clip coords (creates view)
-"	colorFromVS = colorFromVBO;\n"
-"	texCoord = vec2(texCoordFromVBO.x, texCoordFromVBO.y);\n"
-"	fragPos = vec3(model * vec4(aPos, 1.0));\n"
+"	normal = mat3(model) * aNormal;\n"
+"	gl_Position = projection * view * model * vec4(aPos, 1.0f);\n"
+"	texCoord = texCoordFromVBO;\n"
 "}\0";
 
-//TEXTURED FRAGMENT SHADER SOURCE ===================================================================================================================
-
-const char *fragmentShaderSource = "#version 440 core\n"
-"struct Material\n" //material object for lighting properties
-"{\n"
-"vec3 ambient;\n"
-"vec3 diffuse;\n"
-"vec3 specular;\n"
-"float shininess;\n"
-"};\n"
-
-"struct Light\n"
-"{\n"
-"	vec3 position;\n"
-"	vec3 ambient;\n"
-"	vec3 diffuse;\n"
-"	vec3 specular;\n"
-"	vec3 direction;\n"
-"	vec3 direction2;\n"
-"};\n"
-
-"in vec4 colorFromVS;\n" //get color from VS
-"in vec2 texCoord;\n" //get texture coordinates from VS
-"in vec3 fragPos;\n" //get fragment position from VS
+const char *fallbackFragmentShaderSource = "#version 440 core\n"
+"in vec2 texCoord;\n"
 "in vec3 normal;\n"
 
-"out vec4 FragColor;\n" 
-
-//get color for object and light from uniforms
-"uniform vec3 objColor;\n"
-"uniform vec3 lightColor;\n"
-"uniform vec3 lightPos;\n"
-"uniform vec3 lightPos2;\n"
-"uniform vec3 cameraPos;\n"
-"uniform Material material;\n"
-"uniform Light light;\n"
-//uniform for setting texture
+"out vec4 FragColor;\n"
+
 "uniform sampler2D ourTexture;\n"
 
 "void main()\n"
 "{\n"
-//LIGHT1/////////////////////////////////////////////////////////////////////////////////////////////////////////////
-//directional lighting
-"	vec3 lightDir = normalize(-light.direction);\n"
-
-//ambient lighting
-"	vec3 ambient = light.ambient * material.ambient;\n"
-
-//diffuse lighting
-"	vec3 norm = normalize(normal);\n"
-"	//vec3 lightDir = normalize(lightPos - fragPos);\n"
-"	float diff = max(dot(norm, lightDir), 0.0);\n"
-"	vec3 diffuse = (diff * material.diffuse) * light.diffuse;\n"
-
-//specular lighting
-"	vec3 viewDir = normalize(cameraPos - fragPos);\n"
-"	vec3 reflectDir = reflect(-lightDir, norm);\n"//, norm;\n"
-"	float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);\n" //32 is the 'shininess'
-"	vec3 specular = (spec * material.specular) * (vec3(0.5, 0.5, 0.5) * light.specular);\n"
-
-
-//"	vec3 result = (ambient + diffuse + specular) * texture(ourTexture, texCoord).rgb;\n"// * objColor;\n"
-//"   FragColor = vec4(result, 1.0);\n"// colorFromVS;\n //set our color to the one we got from the FS
-//LIGHT2 ///////////////////////////////////////////////////////////////////////////////////////////////////////////
-//directional lighting
-"	vec3 lightDir2 = normalize(-light.direction2);\n" //opposite the first one
-
-//diffuse lighting
-"	float diff2 = max(dot(norm, lightDir2), 0.0);\n"
-"	diffuse = diffuse + ((diff2 * material.diffuse) * (vec3(1.0, 0.5, 0.25) * light.diffuse));\n"
-
-//specular lighting
-"	vec3 reflectDir2 = reflect(-lightDir2, norm);\n"//, norm;\n"
-"	float spec2 = pow(max(dot(viewDir, reflectDir2), 0.0), material.shininess);\n" //32 is the 'shininess'
-"	specular = specular + ((spec2 * material.specular) * (vec3(1.0, 0.5, 0.25) * light.specular));\n"
-
-
-"	vec3 result = (ambient + diffuse + specular) * texture(ourTexture, texCoord).rgb;\n"// * objColor;\n"
-"   FragColor = vec4(result, 1.0);\n"// colorFromVS;\n //set our color to the one we got from the FS
-
+//one fixed overhead light, no specular
+"	float light = 0.35 + 0.65 * max(dot(normalize(normal), vec3(0.26, 0.86, 0.43)), 0.0);\n"
+"	FragColor = vec4(light * texture(ourTexture, texCoord).rgb, 1.0);\n"
 "}\n\0";
 
 
@@ -198,462 +221,289 @@ const char *fragmentShaderSource = "#version 440 core\n"
 
 int main(int argc, char* argv[])
 {
-	if (!UInitialize(argc, argv, &gWindow))
+	gStartupStart = std::chrono::steady_clock::now();
+	UTraceParseArgs(argc, argv);
+	if (!UParseSoftwareArgs(argc, argv, gSoftware) || !UParsePathTracerArgs(argc, argv, gPathTracer) || !UParseSceneArgs(argc, argv, gSceneConfig)
+		|| !UParseLightmapArgs(argc, argv, gLightmap) || !UParseTransformBenchArgs(argc, argv, gTransformBench)
+		|| !UParseStaticGeometryArgs(argc, argv, gStaticGeometry))
 		return EXIT_FAILURE;
+	//matrices/s of the batch kernel against glm and exit
+	if (gTransformBench.enabled)
+		return URunTransformBenchmark(gTransformBench);
+	//offline scene compile (json -> mapped binary) and exit
+	if (!gSceneConfig.compileIn.empty())
+		return UCompileSceneFile(gSceneConfig.compileIn, gSceneConfig.compileOut) ? EXIT_SUCCESS : EXIT_FAILURE;
+	//the cpu renderers and the baker run without a window (meshes and textures then only get their cpu copy)
+	bool cpuOnly = gSoftware.enabled || gPathTracer.enabled || gLightmap.bake || gLightmap.bakeVertices;
+	if (!cpuOnly)
+	{
+		if (!UInitialize(argc, argv, &gWindow))
+			return EXIT_FAILURE;
+		UTraceGpuInit();
+	}
 
-	UCreateCylinderWallMesh(gMesh, 12.0f);
-	UCreateFlatCylinderWallMesh(flatCylinder, 24.0f);
-	UCreatePlaneMesh(plane, 5.0f);
-	UCreateRectMesh(rect);
-	UCreateCubeMesh(cube);
-
-	//BOTH BATTS TRANSFORM
-	glm::mat4 bothBatts = glm::translate(glm::vec3(-1.5f, 0.0f, -0.5f));
-
-	//BATTERY1 BODY TRANSFORMATION AND SCALE MATRICIES 
-	glm::mat4 translation = bothBatts * glm::translate(glm::vec3(-1.0f,  0.2f, 2.0f));
-	glm::mat4 scale = glm::scale(glm::vec3(0.2f, 0.2f, 1.3f));
-	glm::mat4 rotationInit = glm::rotate(75.0f, glm::vec3(0.0f, 1.0f, 0.0f));
-
-	//BATTERY2 BODY TRANSFORMATIONS
-	glm::mat4 translationB2 = bothBatts * glm::translate(glm::vec3(-0.3f, 0.18f, 2.5f));
-	glm::mat4 rotationYB2 = glm::rotate(glm::radians(-23.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-	glm::mat4 rotationXB2 = glm::rotate(glm::radians(270.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-	glm::mat4 rotationInitB2 = rotationYB2 * rotationXB2;
-
-	//BATTERY TERMINAL1 TRANSFORMATION AND SCALE MATRICIES 
-	glm::mat4 translationT = glm::translate(glm::vec3(-0.48f, 0.0f, 1.15f));
-	glm::mat4 scaleT = glm::scale(glm::vec3(0.1f, 0.1f, 0.09f));
-
-	//BATTERY TERMINAL2 TRANSFORMATION AND SCALE MATRICIES 
-	glm::mat4 translationT2 = translationB2 * glm::translate(glm::vec3(-1.15f, 0.48f, 0.0f));
-
-	//PLANE TRANSFORMATION AND SCALE MATRICES
-	glm::mat4 translationPl = glm::translate(glm::vec3(0.0f, 0.0f, 0.0f));
-	glm::mat4 scalePl = glm::scale(glm::vec3(1.0f, 1.0f, 1.0f));
-	glm::mat4 rotationPl = glm::rotate(0.0f, glm::vec3(0.0f, 1.0f, 1.0f));
-
-
-	//CHARGER ACTUAL TRANSFORM
-	glm::mat4 chargerActual = glm::translate(glm::vec3(3.7, 0.0, 0.5));
-	//CHARGER BODY TRANSFORMATION AND SCALE MATRICIES 
-	glm::mat4 translationCB = chargerActual * glm::translate(glm::vec3(0.0f, 0.39f, 0.0f));
-	glm::mat4 scaleCorrect = glm::scale(glm::vec3(0.5f, 0.5f, 1.0f));
-	glm::mat4 scaleCB = scaleCorrect * glm::scale(glm::vec3(0.75f, 0.75f, 0.75f));
-	glm::mat4 rotationCB = glm::rotate(12.0f, glm::vec3(0.0f, 1.0f, 0.0f));
-
-	//CHARGER PRONG1 TRANSFORMATION AND SCALE MATRICIES 
-	glm::mat4 translationP1 = chargerActual * glm::translate(glm::vec3(0.0f, 1.0f, 0.38f));
-	glm::mat4 scaleP1 = scaleCorrect * glm::scale(glm::vec3(0.05f, 0.5f, 0.2f));
-	glm::mat4 rotationP1 = rotationCB;
-
-	//CHARGER PRONG2 TRANSFORMATION AND SCALE MATRICIES 
-	glm::mat4 translationP2 = chargerActual * glm::translate(glm::vec3(-0.33f, 1.0f, 0.16f));
-	glm::mat4 scaleP2 = scaleCorrect * glm::scale(glm::vec3(0.05f, 0.5f, 0.2f));
-	glm::mat4 rotationP2 = rotationCB;
-
-	//CD TRANSFORMATION AND SCALE MATRICIES 
-	glm::mat4 translationCD = glm::translate(glm::vec3(2.0f, 0.002f, 1.0f));
-	glm::mat4 scaleCD = glm::scale(glm::vec3(2.0f, 2.0f, 0.01f));
-	glm::mat4 rotationInitCD = glm::rotate(glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-
-
-	//SPEAKER TRANSFORMATION AND SCALE MATRICIES 
-	glm::mat4 translationSP = glm::translate(glm::vec3(-0.5f, 1.0f, -1.5f));
-	glm::mat4 scaleSP = scaleCorrect * glm::scale(glm::vec3(6.5f, 2.0f, 2.0f));
-	glm::mat4 rotationSP = glm::rotate(glm::radians(10.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-
-
+	//meshes, textures, scene graph and draw list all come from the scene file
+	if (!UOpenScene(gSceneConfig.file, gSceneFile))
+		return EXIT_FAILURE;
+	UCreateScene(gSceneFile);
+	UMaterialsInit(gSceneFile, gLighting);
 
 	//camera stuff===========================================
 	cameraPos = glm::vec3(0.0f, 2.0f, 9.0f);
 	cameraFront = glm::vec3(0.0f, 0.0f, -1.0f);
 	cameraUp = glm::vec3(0.0f, 1.0f, 0.0f);
 
-	//create textured shader program and store in gProgramId (if it fails, abort)
-	if (!UCreateShaderProgram(vertexShaderSource, fragmentShaderSource, gProgramId))
-	{
-		std::cout << std::endl << "ABORTING PROGRAM\n" << std::endl;
-		exit(EXIT_SUCCESS);
-	}
-
-	//texturing stuff========================================
+	//the fallback program is tiny and built up front (if even that fails, abort); the textured scene program builds in
+	//the background from the shader files and replaces it once linked
+	if (!cpuOnly)
 	{
-		unsigned int groundTexture, batteryTexture, terminalTexture, bodyTexture, prongTexture, cdTexture, speakerTexture;
-		// texture 1
-		// ---------
-		glActiveTexture(GL_TEXTURE0);
-		glGenTextures(1, &groundTexture);
-		glBindTexture(GL_TEXTURE_2D, groundTexture);
-		// set the texture wrapping parameters
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);	// set texture wrapping to GL_REPEAT (default wrapping method)
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		// set texture filtering parameters
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		// load image, create texture and generate mipmaps
-		int width, height, nrChannels;
-
-		unsigned char *data = stbi_load("../Resources/tabletop.jpg", &width, &height, &nrChannels, 0);
-		if (data)
+		if (!UCreateShaderProgram(fallbackVertexShaderSource, fallbackFragmentShaderSource, gFallbackProgramId))
 		{
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-			glGenerateMipmap(GL_TEXTURE_2D);
+			std::cout << std::endl << "ABORTING PROGRAM\n" << std::endl;
+			exit(EXIT_SUCCESS);
 		}
-		else
+		UShaderProgramsInit(gWindow);
+		UShaderVariantsInit(gShaderVariants, "../Resources/scene.vert", "../Resources/scene.frag", gFallbackProgramId);
+		//every object gets the cheapest permutation that draws it correctly (only the ones in use get built)
+		ULightmapLoad(gLightmap, gMeshes, gDrawList);
+		UVertexLightingLoad(gLightmap, gDrawList, UUploadMesh);
+		UFreezeStaticGeometry(gStaticGeometry, gDrawList, gScene, UUploadMesh);
+		gLighting.shadows = UShadowsInit(gShadows, gDrawList, gScene, gLighting);
+		//with several views every object is drawn once for all of them
+		uint32_t viewFeatures = 0;
+		if (UMultiViewInit(gMultiView, gDrawList, gScene))
 		{
-			std::cout << "Failed to load texture" << std::endl;
-		}
-		stbi_image_free(data);
-		// texture 2
-		// ---------
-		glActiveTexture(GL_TEXTURE1);
-		glGenTextures(1, &batteryTexture);
-		glBindTexture(GL_TEXTURE_2D, batteryTexture);
-		// set the texture wrapping parameters
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);	// set texture wrapping to GL_REPEAT (default wrapping method)
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-		// set texture filtering parameters
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-		// load image, create texture and generate mipmaps
-		data = stbi_load("../Resources/battery.png", &width, &height, &nrChannels, 0);
-		if (data)
-		{
-			// note that the awesomeface.png has transparency and thus an alpha channel, so make sure to tell OpenGL the data type is of GL_RGBA
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-			glGenerateMipmap(GL_TEXTURE_2D);
+			viewFeatures = USHADER_MULTI_VIEW;
+			if (UMultiViewGeometry())
+				gShaderVariants.geometryFile = "../Resources/multiview.geom";
 		}
-		else
-		{
-			std::cout << "Failed to load texture" << std::endl;
-		}
-		stbi_image_free(data);
-
-		// texture 3
-		// ---------
-		glActiveTexture(GL_TEXTURE2);
-		glGenTextures(1, &terminalTexture);
-		glBindTexture(GL_TEXTURE_2D, terminalTexture);
-		// set the texture wrapping parameters
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);	// set texture wrapping to GL_REPEAT (default wrapping method)
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-		// set texture filtering parameters
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-		// load image, create texture and generate mipmaps
-		data = stbi_load("../Resources/terminal.png", &width, &height, &nrChannels, 0);
-		if (data)
-		{
-			// note that the awesomeface.png has transparency and thus an alpha channel, so make sure to tell OpenGL the data type is of GL_RGBA
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-			glGenerateMipmap(GL_TEXTURE_2D);
-		}
-		else
-		{
-			std::cout << "Failed to load texture" << std::endl;
-		}
-		stbi_image_free(data);
-
-		// texture 4
-		// ---------
-		glActiveTexture(GL_TEXTURE3);
-		glGenTextures(1, &bodyTexture);
-		glBindTexture(GL_TEXTURE_2D, bodyTexture);
-		// set the texture wrapping parameters
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);	// set texture wrapping to GL_REPEAT (default wrapping method)
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-		// set texture filtering parameters
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-		// load image, create texture and generate mipmaps
-		data = stbi_load("../Resources/chargertop.png", &width, &height, &nrChannels, 0);
-		if (data)
-		{
-			// note that the awesomeface.png has transparency and thus an alpha channel, so make sure to tell OpenGL the data type is of GL_RGBA
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-			glGenerateMipmap(GL_TEXTURE_2D);
-		}
-		else
-		{
-			std::cout << "Failed to load texture" << std::endl;
-		}
-		stbi_image_free(data);
-
-		// texture 5
-		// ---------
-		glActiveTexture(GL_TEXTURE4);
-		glGenTextures(1, &prongTexture);
-		glBindTexture(GL_TEXTURE_2D, prongTexture);
-		// set the texture wrapping parameters
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);	// set texture wrapping to GL_REPEAT (default wrapping method)
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-		// set texture filtering parameters
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-		// load image, create texture and generate mipmaps
-		data = stbi_load("../Resources/prongs.png", &width, &height, &nrChannels, 0);
-		if (data)
-		{
-			// note that the awesomeface.png has transparency and thus an alpha channel, so make sure to tell OpenGL the data type is of GL_RGBA
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-			glGenerateMipmap(GL_TEXTURE_2D);
-		}
-		else
-		{
-			std::cout << "Failed to load texture" << std::endl;
-		}
-		stbi_image_free(data);
-
-		// texture 6
-		// ---------
-		glActiveTexture(GL_TEXTURE5);
-		glGenTextures(1, &cdTexture);
-		glBindTexture(GL_TEXTURE_2D, cdTexture);
-		// set the texture wrapping parameters
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);	// set texture wrapping to GL_REPEAT (default wrapping method)
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-		// set texture filtering parameters
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		// load image, create texture and generate mipmaps
-		data = stbi_load("../Resources/cd.png", &width, &height, &nrChannels, 4);
-		if (data)
-		{
-			// note that the awesomeface.png has transparency and thus an alpha channel, so make sure to tell OpenGL the data type is of GL_RGBA
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-			glGenerateMipmap(GL_TEXTURE_2D);
-
-		}
-		else
-		{
-			std::cout << "Failed to load texture" << std::endl;
-		}
-		stbi_image_free(data);
+		for (UDrawItem& item : gDrawList)
+			item.variant = UShaderVariantFind(gShaderVariants, UShaderVariantSelect(item, gLighting) | viewFeatures);
+		UGpuCullingInit(gGpuCulling, gDrawList, gScene, gShaderVariants);
+		gProgramId = gFallbackProgramId;
+	}
 
-		// texture 7
-		// ---------
-		glActiveTexture(GL_TEXTURE6);
-		glGenTextures(1, &speakerTexture);
-		glBindTexture(GL_TEXTURE_2D, speakerTexture);
-		// set the texture wrapping parameters
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);	// set texture wrapping to GL_REPEAT (default wrapping method)
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-		// set texture filtering parameters
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		// load image, create texture and generate mipmaps
-		data = stbi_load("../Resources/speaker.png", &width, &height, &nrChannels, 4);
-		if (data)
-		{
-			// note that the awesomeface.png has transparency and thus an alpha channel, so make sure to tell OpenGL the data type is of GL_RGBA
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-			glGenerateMipmap(GL_TEXTURE_2D);
+	//cpu modes render the start view (or the software bench path) and exit
+	if (cpuOnly)
+	{
+		int result = EXIT_SUCCESS;
+		if (gSoftware.enabled)
+			result = URunSoftwareRenderer(gSoftware, gDrawList, gScene, gTextures, gLighting, WINDOW_WIDTH, WINDOW_HEIGHT, cameraPos, cameraFront, cameraUp);
+		if (gPathTracer.enabled && result == EXIT_SUCCESS)
+			result = URunPathTracer(gPathTracer, gDrawList, gScene, gTextures, gLighting, WINDOW_WIDTH, WINDOW_HEIGHT, cameraPos, cameraFront, cameraUp);
+		if (gLightmap.bake && result == EXIT_SUCCESS)
+			result = URunLightmapBaker(gLightmap, gDrawList, gScene, gTextures, gLighting);
+		if (gLightmap.bakeVertices && result == EXIT_SUCCESS)
+			result = URunVertexLightingBaker(gLightmap, gDrawList, gScene, gTextures, gLighting);
+		UTraceFlush();
+		UCloseScene(gSceneFile);
+		return result;
+	}
 
-		}
-		else
+	//benchmark setup (replayed camera path + frame timing)
+	if (gBenchmark.enabled)
+	{
+		if (gBenchmark.pathFile.empty())
+			UDefaultCameraPath(gCameraPath);
+		else if (!ULoadCameraPath(gBenchmark.pathFile, gCameraPath))
+			exit(EXIT_FAILURE);
+		UBenchmarkStart(gBenchmark, gCameraPath);
+
+		//fixed workload per frame for the Mtris/s, Mpix/s numbers
+		size_t triangles = 0;
+		for (const UDrawItem& item : gDrawList)
+			triangles += item.mesh->nIndices / 3;
+		UBenchmarkSetWorkload((double)triangles, (double)WINDOW_WIDTH * WINDOW_HEIGHT);
+	}
+	else
+	{
+		USimState initial = { cameraPos, yaw, pitch, 0.0 };
+		USimulationStart(gSimConfig, initial);
+	}
+	int benchmarkFrame = 0;
+	float recordStart = glfwGetTime();
+
+	//frame graph: the scene pass draws straight into the window, or into transient targets that an upscale pass
+	//stretches over it when the resolution is dynamic; with shadows it reads the static and cascade atlases
+	glm::mat4 view, projection;
+	int backbuffer = URenderGraphImport(gFrameGraph, "backbuffer", WINDOW_WIDTH, WINDOW_HEIGHT);
+	int scenePass = URenderGraphAddPass(gFrameGraph, "scene", [&]()
+	{
+		UDynamicResolutionBeginScene();
+		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		UMultiViewBeginScene();
+		UDrawScene(view, projection);
+		UMultiViewEndScene();
+		UDynamicResolutionEndScene();
+	});
+	UShadowsAddPasses(gFrameGraph, scenePass);
+	if (UDynamicResolutionEnabled())
+	{
+		int sceneColor = URenderGraphCreate(gFrameGraph, "scene color", WINDOW_WIDTH, WINDOW_HEIGHT, GL_RGBA8);
+		int sceneDepth = URenderGraphCreate(gFrameGraph, "scene depth", WINDOW_WIDTH, WINDOW_HEIGHT, GL_DEPTH24_STENCIL8);
+		URenderGraphWrite(gFrameGraph, scenePass, sceneColor);
+		URenderGraphWrite(gFrameGraph, scenePass, sceneDepth);
+		int upscalePass = URenderGraphAddPass(gFrameGraph, "upscale", [sceneColor]()
 		{
-			std::cout << "Failed to load texture" << std::endl;
-		}
-		stbi_image_free(data);
+			UDynamicResolutionUpscale(URenderGraphTexture(gFrameGraph, sceneColor));
+		});
+		URenderGraphRead(gFrameGraph, upscalePass, sceneColor);
+		URenderGraphWrite(gFrameGraph, upscalePass, backbuffer);
 	}
-
+	else
+		URenderGraphWrite(gFrameGraph, scenePass, backbuffer);
+	if (!URenderGraphCompile(gFrameGraph))
+		exit(EXIT_FAILURE);
+	if (gRenderGraphDump)
+		URenderGraphPrint(gFrameGraph, cout);
 
 	// render loop
 	// -----------	
 
 	while (!glfwWindowShouldClose(gWindow))
 	{
-		glUseProgram(gProgramId);
-		//LIGHTING STUFF===============================================================
-
-		//light 1 color
-		GLuint ambientLiLoc = glGetUniformLocation(gProgramId, "light.ambient");
-		GLuint diffuseLiLoc = glGetUniformLocation(gProgramId, "light.diffuse");
-		GLuint specularLiLoc = glGetUniformLocation(gProgramId, "light.specular");
-		glm::vec3 lightColor;
-		lightColor.x = 1.0f;//(sin(glfwGetTime() * 2.0f));
-		lightColor.y = 1.0f;//(sin(glfwGetTime() * 0.7f));
-		lightColor.z = 1.0f;//(sin(glfwGetTime() * 1.3f));
-		glm::vec3 diffuseColor = lightColor * glm::vec3(0.5f); // decrease the influence
-		glm::vec3 ambientColor = diffuseColor * glm::vec3(1.0f); // low influence
-
-
-
-		glUniform3fv(ambientLiLoc, 1, glm::value_ptr(ambientColor));
-		glUniform3fv(diffuseLiLoc, 1, glm::value_ptr(diffuseColor));
-		glUniform3fv(specularLiLoc, 1, glm::value_ptr(glm::vec3(1.0f, 1.0f, 1.0f)));
-
-		GLuint ambientLoc = glGetUniformLocation(gProgramId, "material.ambient");
-		GLuint diffuseLoc = glGetUniformLocation(gProgramId, "material.diffuse");
-		GLuint specularLoc = glGetUniformLocation(gProgramId, "material.specular");
-		GLuint shininessLoc = glGetUniformLocation(gProgramId, "material.shininess");
-
-		glm::vec3 ambientVal(1.0f, 1.0f, 1.0f);
-		glm::vec3 diffuseVal(1.0f, 1.0f, 1.0f);
-		glm::vec3 specularVal(1.0f, 1.0f, 1.0f);
-
-		glUniform3fv(ambientLoc, 1, glm::value_ptr(ambientVal));
-		glUniform3fv(diffuseLoc, 1, glm::value_ptr(diffuseVal));
-		glUniform3fv(specularLoc, 1, glm::value_ptr(specularVal));
-		glUniform1f(shininessLoc, 999.0f);
-
-		GLuint objColorLoc = glGetUniformLocation(gProgramId, "objColor");
-		GLuint lightColorLoc = glGetUniformLocation(gProgramId, "lightColor");
-		//values
-		glm::vec3 objectColor(1.0f, 1.0f, 1.0f);
-
-		//setting uniforms
-		glUniform3fv(objColorLoc, 1, glm::value_ptr(objectColor));
-		glUniform3fv(lightColorLoc, 1, glm::value_ptr(lightColor));
-
-		//set light position uniform
-		GLuint lightPosLoc = glGetUniformLocation(gProgramId, "lightPos");
-		GLuint lightPos2Loc = glGetUniformLocation(gProgramId, "lightPos2");
-		glm::vec3 lightPos(3.0f, 3.0f, 3.0f);
-		glm::vec3 lightPos2(-3.0f, 3.0f, -3.0f);
-		glUniform3fv(lightPosLoc, 1, glm::value_ptr(lightPos));
-		glUniform3fv(lightPos2Loc, 1, glm::value_ptr(lightPos2));
-
-		//set light direction uniform
-		GLuint lightDirectionLoc = glGetUniformLocation(gProgramId, "light.direction");
-		glUniform3fv(lightDirectionLoc, 1, glm::value_ptr(glm::vec3(-5.2f, -1.0f, -0.3f)));
-		//set light direction2 uniform
-		GLuint lightDirection2Loc = glGetUniformLocation(gProgramId, "light.direction2");
-		glUniform3fv(lightDirection2Loc, 1, glm::value_ptr(glm::vec3(5.2f, -1.0f, 0.3f)));
-
-		//==============================================================================
-
-		//clear buffers
-		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		//frame cap and at most framesInFlight frames queued on the gpu (before anything of this frame is sampled)
+		UFramePacingWait();
+		UFrameArenaBeginFrame();
 
-		//init view matrix for camera 
-		glm::mat4 view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
+		//benchmark mode drives the camera from the path with a fixed timestep (warmup frames hold the first key)
+		if (gBenchmark.enabled)
+		{
+			float simTime = std::max(benchmarkFrame - gBenchmark.warmupFrames, 0) * gBenchmark.timestep;
+			if (simTime > gCameraPath.back().time)
+				break;
+			USampleCameraPath(gCameraPath, simTime, cameraPos, yaw, pitch);
+			UUpdateCameraFront();
+			UBenchmarkBeginFrame();
+			benchmarkFrame++;
+		}
 
-		//get input (camera movement)
-		cameraPos = UProcessInput(gWindow);
-		GLuint cameraPosLoc = glGetUniformLocation(gProgramId, "cameraPos");
-		glUniform3fv(cameraPosLoc, 1, glm::value_ptr(cameraPos));
+		UTraceBegin("frame");
+		//finished background builds / edited shader files
+		UShaderVariantsUpdate(gShaderVariants, glfwGetTime());
 
-		//get delta time (currently unused)
+		//frame time (only traced, movement is stepped by the simulation thread)
 		float currentFrame = glfwGetTime();
 		deltaTime = currentFrame - lastFrame;
 		lastFrame = currentFrame;
-//======TABLETOP========================================================================================
-		//set shader program and texutre for ground
-		glUseProgram(gProgramId);
-		glUniform1i(glGetUniformLocation(gProgramId, "ourTexture"), 0);
-
-		//create plane
-		URenderMesh(plane, translationPl, rotationPl ,scalePl, view);
-
-//======BATTERY 1========================================================================================
-		//set texture for battery 
-		glUniform1i(glGetUniformLocation(gProgramId, "ourTexture"), 1);
-		//set shininess for battery
-		glUniform1f(shininessLoc, 12.0f);
-
-		//render the body mesh
-		GLfloat rotationFactor = 0;
-		for (int i = 0; i < 12; i++)
-		{
-			glm::mat4 rotation = rotationInit * glm::rotate(glm::radians(rotationFactor), glm::vec3(0.0f, 0.0f, 1.0f));
-			URenderMesh(gMesh, translation, rotation, scale, view);
-			rotationFactor += 30.0f;
-		}
-
-		//set shininess for terminal
-		glUniform1f(shininessLoc, 2.0f);
-
-		//set texture for terminal
-		glUniform1i(glGetUniformLocation(gProgramId, "ourTexture"), 2);
+		UTraceCounter("deltaTime ms", deltaTime * 1000.0);
 
-		rotationFactor = 0;
-		//render the terminal mesh
-		for (int i = 0; i < 12; i++)
+		//world matrices of whatever moved since the last frame (nothing, unless something animates a node)
+		int nodesUpdated = USceneUpdate(gScene);
+		UTraceCounter("scene nodes updated", nodesUpdated);
+		if (nodesUpdated > 0)
 		{
-			glm::mat4 rotation = rotationInit * glm::rotate(glm::radians(rotationFactor), glm::vec3(0.0f, 0.0f, 1.0f));
-			URenderMesh(gMesh, translationT * translation, rotation, scaleT, view);
-			rotationFactor += 30.0f;
+			UGpuCullingUpdateTransforms(gScene);
+			UShadowsSceneChanged();
 		}
 
-//======BATTERY 2========================================================================================
-		//set texture for battery 
-		glUniform1i(glGetUniformLocation(gProgramId, "ourTexture"), 1);
-		//set shininess for battery
-		glUniform1f(shininessLoc, 12.0f);
-
-		//render the body mesh
-		rotationFactor = 0;
-		for (int i = 0; i < 12; i++)
+		//late latch: everything that doesn't depend on the camera is done, so poll events and sample the input as close to
+		//the draws as possible. hand it to the simulation thread and draw its state interpolated to now (the benchmark path
+		//owns the camera while replaying)
+		UTraceFrameSection("input");
+		glfwPollEvents();
+		if (!gBenchmark.enabled)
 		{
-			glm::mat4 rotation = rotationInitB2 * glm::rotate(glm::radians(rotationFactor), glm::vec3(0.0f, 0.0f, 1.0f));
-			URenderMesh(gMesh, translationB2, rotation, scale, view);
-			rotationFactor += 30.0f;
+			USimulationSetInput(UProcessInput(gWindow), cameraSpeed);
+			USimState state;
+			UTraceCounter("simulation step", (double)USimulationSample(state));
+			cameraPos = state.cameraPos;
+			yaw = state.yaw;
+			pitch = state.pitch;
+			UUpdateCameraFront();
 		}
+		else if (glfwGetKey(gWindow, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+			glfwSetWindowShouldClose(gWindow, true);
 
-		//set shininess for terminal
-		glUniform1f(shininessLoc, 2.0f);
-
-		//set texture for terminal
-		glUniform1i(glGetUniformLocation(gProgramId, "ourTexture"), 2);
-
-		rotationFactor = 0;
-		//render the terminal mesh
-		for (int i = 0; i < 12; i++)
+		//init view matrix for camera 
+		view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
+		UFramePacingLatchInput();
+
+//======FRAME GRAPH========================================================================================
+		//material edits since the last frame (only their range of the table)
+		UMaterialsUpload();
+		projection = UProjection();
+		UShadowsUpdate(view, projection);
+		int windowWidth, windowHeight;
+		glfwGetFramebufferSize(gWindow, &windowWidth, &windowHeight);
+		UMultiViewUpdate(view, projection, cameraPos, windowWidth, windowHeight);
+		URenderGraphSetImportedSize(gFrameGraph, backbuffer, windowWidth, windowHeight);
+		URenderGraphExecute(gFrameGraph);
+
+		// glfw: Swap buffers (IO events are polled at the late latch above).
+		UTraceFrameSection("swap");
+		UBenchmarkEndCpu();
+		glfwSwapBuffers(gWindow);    // Flips the the back buffer with the front buffer every frame.
+		UFramePacingEndFrame(UBenchmarkCurrentFrame());
+		UTraceFrameSection(nullptr);
+		UTraceEnd();
+		UTraceGpuCollect();
+		UGLStatsEndFrame();
+		UGpuResourcesEndFrame();
+		UBenchmarkEndFrame();
+		//everything the frame took from the arena is gone (the gpu has its own copies by now)
+		UFrameArenaReset();
+
+		//record the live camera (10 keys per second is plenty for the spline), after the reset: the path grows on the heap
+		//and that isn't the frame's allocation
+		if (!gBenchmark.recordFile.empty() && !gBenchmark.enabled)
 		{
-			glm::mat4 rotation = rotationInitB2 * glm::rotate(glm::radians(rotationFactor), glm::vec3(0.0f, 0.0f, 1.0f));
-			URenderMesh(gMesh, translationT2, rotation, scaleT, view);
-			rotationFactor += 30.0f;
+			float recordTime = glfwGetTime() - recordStart;
+			if (gRecordedPath.empty() || recordTime - gRecordedPath.back().time >= 0.1f)
+			{
+				UCameraKey key = { recordTime, cameraPos, yaw, pitch };
+				gRecordedPath.push_back(key);
+			}
 		}
 
-//======CHARGER BODY========================================================================================
-		//set texture
-		glUniform1i(glGetUniformLocation(gProgramId, "ourTexture"), 3);
-		URenderMesh(cube, translationCB, rotationCB, scaleCB, view);
-
-//======CHARGER PRONG1========================================================================================
-		glUniform1i(glGetUniformLocation(gProgramId, "ourTexture"), 4);
-		glUniform1f(shininessLoc, 1.0f);
-		URenderMesh(cube, translationP1, rotationP1, scaleP1, view);
-
-//======CHARGER PRONG2========================================================================================
-		URenderMesh(cube, translationP2, rotationP2, scaleP2, view);
-
-//======CD ===================================================================================================
-		glUniform1i(glGetUniformLocation(gProgramId, "ourTexture"), 5);
-		//render the cd mesh/*
-		for (int i = 0; i < 24; i++)
+		//startup = launch to the first presented frame (run twice to compare a cold and a warm shader cache)
+		if (gStartupStart != std::chrono::steady_clock::time_point())
 		{
-			glm::mat4 rotationCD = rotationInitCD * glm::rotate(glm::radians(rotationFactor), glm::vec3(0.0f, 0.0f, 1.0f));
-			URenderMesh(flatCylinder, translationCD, rotationCD, scaleCD, view);
-			rotationFactor += 15.0f;
+			double startupMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - gStartupStart).count();
+			const UShaderCacheStats& shaders = UShaderCacheGetStats();
+			const char* cache = !gShaderCache.enabled ? "off" : shaders.misses == 0 ? "warm" : "cold";
+			cout << "INFO: startup " << startupMs << " ms to first frame, shader programs " << shaders.milliseconds << " ms (" << cache << " cache: "
+				<< shaders.hits << " loaded, " << shaders.misses << " compiled, " << shaders.rejected << " rejected)" << endl;
+			UBenchmarkSetStartup(startupMs, shaders.milliseconds, cache);
+			gStartupStart = std::chrono::steady_clock::time_point();
 		}
+	}
 
-//======SPEAKER ==============================================================================================
-		glUniform1i(glGetUniformLocation(gProgramId, "ourTexture"), 6);
-		URenderMesh(rect, translationSP, rotationSP, scaleSP, view);
-		diffuseColor = lightColor * glm::vec3(0.002f); // decrease the influence
-		ambientColor = diffuseColor * glm::vec3(0.001f); // low influence
-
-		glUniform3fv(ambientLiLoc, 1, glm::value_ptr(ambientColor));
-		glUniform3fv(diffuseLiLoc, 1, glm::value_ptr(diffuseColor));
-
+	USimulationStop();
+	UFramePacingShutdown();
+	UCommandListsShutdown();
+	UFrameArenaShutdown();
 
-		// glfw: Swap buffers and poll IO events (keys pressed/released, mouse moved, and so on).
-		glfwPollEvents();
-		glfwSwapBuffers(gWindow);    // Flips the the back buffer with the front buffer every frame.
-	}
+	//write benchmark results / recorded camera path
+	if (gBenchmark.enabled)
+		UBenchmarkFinish(gBenchmark);
+	if (!gBenchmark.recordFile.empty() && !gRecordedPath.empty())
+		USaveCameraPath(gBenchmark.recordFile, gRecordedPath);
+	UTraceGpuShutdown();
+	UTraceFlush();
+	UGLStatsShutdown();
 
 
 	//destroy meshes and shader to clean up
-	UDestroyMesh(gMesh);
-	UDestroyMesh(cube);
-	UDestroyMesh(plane);
-	UDestroyMesh(flatCylinder);
-	UDestroyMesh(rect);
-	UDestroyShaderProgram(gProgramId);
+	for (GLMesh& mesh : gMeshes)
+		UDestroyMesh(mesh);
+	UGpuCullingShutdown();
+	UShadowsShutdown();
+	UStaticGeometryShutdown();
+	ULightmapShutdown();
+	UMaterialsShutdown();
+	URenderGraphDestroy(gFrameGraph);
+	UDynamicResolutionShutdown();
+	UMultiViewShutdown();
+	UShaderVariantsReport(gShaderVariants);
+	UShaderVariantsDestroy(gShaderVariants);
+	UShaderProgramsShutdown();
+	UDestroyShaderProgram(gFallbackProgramId);
+	gTextures.clear();
+	//whatever is still registered now was never deleted
+	UGpuResourcesShutdown();
+	UCloseScene(gSceneFile);
 
 	exit(EXIT_SUCCESS); // Terminates the program successfully
 }
@@ -662,6 +512,18 @@ int main(int argc, char* argv[])
 
 bool UInitialize(int argc, char* argv[], GLFWwindow** window)
 {
+	UTRACE_SCOPE("UInitialize");
+
+	//command line options
+	if (!UParseBenchmarkArgs(argc, argv, gBenchmark) || !UParseShaderCacheArgs(argc, argv, gShaderCache) || !UParseSimulationArgs(argc, argv, gSimConfig)
+		|| !UParseFramePacingArgs(argc, argv, gFramePacing) || !UParseCommandListArgs(argc, argv, gCommandListConfig)
+		|| !UParseGpuCullingArgs(argc, argv, gGpuCulling) || !UParseDynamicResolutionArgs(argc, argv, gDynamicResolution)
+		|| !UParseRenderGraphArgs(argc, argv, gRenderGraphDump) || !UParseShadowArgs(argc, argv, gShadows)
+		|| !UParseFrameArenaArgs(argc, argv, gFrameArena) || !UParseGpuResourcesArgs(argc, argv, gGpuResources)
+		|| !UParseMultiViewArgs(argc, argv, gMultiView))
+		return false;
+	UGpuResourcesInit(gGpuResources);
+
 	// GLFW: initialize and configure (specify desired OpenGL version)
 	// ------------------------------
 	glfwInit();
@@ -706,39 +568,48 @@ bool UInitialize(int argc, char* argv[], GLFWwindow** window)
 
 	// Displays GPU OpenGL version
 	cout << "INFO: OpenGL Version: " << glGetString(GL_VERSION) << endl;
+	UShaderCacheInit(gShaderCache);
+
+	//benchmark runs as fast as possible (no vsync)
+	if (gBenchmark.enabled)
+		glfwSwapInterval(0);
+	UFramePacingInit(gFramePacing);
+	UCommandListsInit(gCommandListConfig);
+	UFrameArenaInit(gFrameArena, UJobsThreadCount());
+	UDynamicResolutionInit(gDynamicResolution, WINDOW_WIDTH, WINDOW_HEIGHT);
 
 	return true;
 }
 
 //PROCESS INPUT FUNCTION (standard)================================================================================================================
 
-glm::vec3 UProcessInput(GLFWwindow* window)
+uint32_t UProcessInput(GLFWwindow* window)
 {
 	if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
 		glfwSetWindowShouldClose(window, true);
 
-	//camera movement-------------------------------
+	//camera movement keys held (the simulation thread moves the camera)-------------------------------
+	uint32_t keys = 0;
 	//forward
 	if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
-		cameraPos += cameraSpeed * cameraFront;
+		keys |= USIM_KEY_FORWARD;
 	//backward
 	if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
-		cameraPos -= cameraSpeed * cameraFront;
+		keys |= USIM_KEY_BACK;
 	//strafe left
 	if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
-		cameraPos -= glm::normalize(glm::cross(cameraFront, cameraUp)) * cameraSpeed;
+		keys |= USIM_KEY_LEFT;
 	//strafe right
 	if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
-		cameraPos += glm::normalize(glm::cross(cameraFront, cameraUp)) * cameraSpeed;
+		keys |= USIM_KEY_RIGHT;
 	//fly down
 	if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS)
-		cameraPos -= cameraSpeed * cameraUp;
+		keys |= USIM_KEY_DOWN;
 	//fly up
 	if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS)
-		cameraPos += cameraSpeed * cameraUp;
+		keys |= USIM_KEY_UP;
 
-	//return cameraPos for use
-	return cameraPos;
+	return keys;
 
 }
 
@@ -753,6 +624,8 @@ void UResizeWindow(GLFWwindow* window, int width, int height)
 
 void UCreateCylinderWallMesh(GLMesh &mesh, float numSections)
 {
+	UTRACE_SCOPE("UCreateCylinderWallMesh");
+
 	float sectionAngle((360 / numSections) / 2);
 
 	float vertices[] =
@@ -790,42 +663,10 @@ void UCreateCylinderWallMesh(GLMesh &mesh, float numSections)
 
 	};
 
-	glGenVertexArrays(1, &mesh.vao);			//init vao
-	glBindVertexArray(mesh.vao);				//bind vertex array to the vao
-
-	//generate buffers for vertex and index info
-	glGenBuffers(2, mesh.vbos);					//init buffer
-	glBindBuffer(GL_ARRAY_BUFFER, mesh.vbos[0]);//bind the vertex info to the 0th vbo
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW); //send vertex data to gpu (VBO)
-
-	//indexing vertex attributes so VBO knows what the hell is going on with it's data
-
-	mesh.nIndices = sizeof(indices) / sizeof(indices[0]);
-
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.vbos[1]);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-
-	//how many floats per vertex and color? (3 for 3 3d coordinates) (4 for RGB and alpha values)
-	const GLuint FLOATS_PER_VERTEX = 3;
-	const GLuint FLOATS_PER_COLOR = 4;
-	const GLuint FLOATS_PER_TEXCORD = 2;
-	const GLuint FLOATS_PER_NORMAL = 3;
-
-	//indicate stride between vertex info (slice point for each individual vertex)
-	GLint stride = sizeof(float) * (FLOATS_PER_VERTEX + FLOATS_PER_COLOR + FLOATS_PER_TEXCORD + FLOATS_PER_NORMAL);
-
-	//tell GPU how to handle VBO info
-	glVertexAttribPointer(0, FLOATS_PER_VERTEX, GL_FLOAT, GL_FALSE, stride, 0);
-	glEnableVertexAttribArray(0); //initial coordinate position (it's just the first position in our simple array)
-
-	glVertexAttribPointer(1, FLOATS_PER_COLOR, GL_FLOAT, GL_FALSE, stride, (void*)(4 * sizeof(float)));
-	glEnableVertexAttribArray(1);
-
-	glVertexAttribPointer(2, FLOATS_PER_TEXCORD, GL_FLOAT, GL_FALSE, stride, (void*)(7 * sizeof(float)));
-	glEnableVertexAttribArray(2);
-
-	glVertexAttribPointer(3, FLOATS_PER_NORMAL, GL_FLOAT, GL_FALSE, stride, (void*)(9 * sizeof(float)));
-	glEnableVertexAttribArray(3);
+	//keep a cpu copy (software renderers) and upload it
+	mesh.vertices.assign(vertices, vertices + sizeof(vertices) / sizeof(vertices[0]));
+	mesh.indices.assign(indices, indices + sizeof(indices) / sizeof(indices[0]));
+	UUploadMesh(mesh);
 
 }
 
@@ -833,6 +674,8 @@ void UCreateCylinderWallMesh(GLMesh &mesh, float numSections)
 
 void UCreateFlatCylinderWallMesh(GLMesh &mesh, float numSections)
 {
+	UTRACE_SCOPE("UCreateFlatCylinderWallMesh");
+
 	float sectionAngle((360 / numSections) / 2);
 
 	float vertices[] =
@@ -870,42 +713,10 @@ void UCreateFlatCylinderWallMesh(GLMesh &mesh, float numSections)
 
 	};
 
-	glGenVertexArrays(1, &mesh.vao);			//init vao
-	glBindVertexArray(mesh.vao);				//bind vertex array to the vao
-
-	//generate buffers for vertex and index info
-	glGenBuffers(2, mesh.vbos);					//init buffer
-	glBindBuffer(GL_ARRAY_BUFFER, mesh.vbos[0]);//bind the vertex info to the 0th vbo
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW); //send vertex data to gpu (VBO)
-
-	//indexing vertex attributes so VBO knows what the hell is going on with it's data
-
-	mesh.nIndices = sizeof(indices) / sizeof(indices[0]);
-
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.vbos[1]);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-
-	//how many floats per vertex and color? (3 for 3 3d coordinates) (4 for RGB and alpha values)
-	const GLuint FLOATS_PER_VERTEX = 3;
-	const GLuint FLOATS_PER_COLOR = 4;
-	const GLuint FLOATS_PER_TEXCORD = 2;
-	const GLuint FLOATS_PER_NORMAL = 3;
-
-	//indicate stride between vertex info (slice point for each individual vertex)
-	GLint stride = sizeof(float) * (FLOATS_PER_VERTEX + FLOATS_PER_COLOR + FLOATS_PER_TEXCORD + FLOATS_PER_NORMAL);
-
-	//tell GPU how to handle VBO info
-	glVertexAttribPointer(0, FLOATS_PER_VERTEX, GL_FLOAT, GL_FALSE, stride, 0);
-	glEnableVertexAttribArray(0); //initial coordinate position (it's just the first position in our simple array)
-
-	glVertexAttribPointer(1, FLOATS_PER_COLOR, GL_FLOAT, GL_FALSE, stride, (void*)(4 * sizeof(float)));
-	glEnableVertexAttribArray(1);
-
-	glVertexAttribPointer(2, FLOATS_PER_TEXCORD, GL_FLOAT, GL_FALSE, stride, (void*)(7 * sizeof(float)));
-	glEnableVertexAttribArray(2);
-
-	glVertexAttribPointer(3, FLOATS_PER_NORMAL, GL_FLOAT, GL_FALSE, stride, (void*)(9 * sizeof(float)));
-	glEnableVertexAttribArray(3);
+	//keep a cpu copy (software renderers) and upload it
+	mesh.vertices.assign(vertices, vertices + sizeof(vertices) / sizeof(vertices[0]));
+	mesh.indices.assign(indices, indices + sizeof(indices) / sizeof(indices[0]));
+	UUploadMesh(mesh);
 
 }
 
@@ -913,6 +724,8 @@ void UCreateFlatCylinderWallMesh(GLMesh &mesh, float numSections)
 
 void UCreatePlaneMesh(GLMesh &mesh, float scale)
 {
+	UTRACE_SCOPE("UCreatePlaneMesh");
+
 	float vertices[] =
 	{
 		//POS						//COLOR							//TEXTURE COORDS				//NORMALS
@@ -929,48 +742,18 @@ void UCreatePlaneMesh(GLMesh &mesh, float scale)
 		0, 3, 2 
 	};
 
-	glGenVertexArrays(1, &mesh.vao);			//init vao
-	glBindVertexArray(mesh.vao);				//bind vertex array to the vao
-
-	//generate buffers for vertex and index info
-	glGenBuffers(2, mesh.vbos);					//init buffer
-	glBindBuffer(GL_ARRAY_BUFFER, mesh.vbos[0]);//bind the vertex info to the 0th vbo
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW); //send vertex data to gpu (VBO)
-
-	//indexing vertex attributes so VBO knows what the hell is going on with it's data
-
-	mesh.nIndices = sizeof(indices) / sizeof(indices[0]);
-
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.vbos[1]);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-
-	//how many floats per vertex and color? (3 for 3 3d coordinates) (4 for RGB and alpha values)
-	const GLuint FLOATS_PER_VERTEX = 3;
-	const GLuint FLOATS_PER_COLOR = 4;
-	const GLuint FLOATS_PER_TEXCORD = 2;
-	const GLuint FLOATS_PER_NORMAL = 3;
-
-	//indicate stride between vertex info (slice point for each individual vertex)
-	GLint stride = sizeof(float) * (FLOATS_PER_VERTEX + FLOATS_PER_COLOR + FLOATS_PER_TEXCORD + FLOATS_PER_NORMAL);
-
-	//tell GPU how to handle VBO info
-	glVertexAttribPointer(0, FLOATS_PER_VERTEX, GL_FLOAT, GL_FALSE, stride, 0);
-	glEnableVertexAttribArray(0); //initial coordinate position (it's just the first position in our simple array)
-
-	glVertexAttribPointer(1, FLOATS_PER_COLOR, GL_FLOAT, GL_FALSE, stride, (void*)(3 * sizeof(float)));
-	glEnableVertexAttribArray(1);
-
-	glVertexAttribPointer(2, FLOATS_PER_TEXCORD, GL_FLOAT, GL_FALSE, stride, (void*)(7 * sizeof(float)));
-	glEnableVertexAttribArray(2);
-
-	glVertexAttribPointer(3, FLOATS_PER_NORMAL, GL_FLOAT, GL_FALSE, stride, (void*)(9 * sizeof(float)));
-	glEnableVertexAttribArray(3);
+	//keep a cpu copy (software renderers) and upload it
+	mesh.vertices.assign(vertices, vertices + sizeof(vertices) / sizeof(vertices[0]));
+	mesh.indices.assign(indices, indices + sizeof(indices) / sizeof(indices[0]));
+	UUploadMesh(mesh);
 
 }
 
 //CREATE RECT FUNCTION ============================================================================================================================
 void UCreateRectMesh(GLMesh &mesh)
 {
+	UTRACE_SCOPE("UCreateRectMesh");
+
 	float vertices[] =
 	{
 			   //POS					   //COLOR				  //TEXTURE COORDS				       //NORMALS
@@ -1028,48 +811,18 @@ void UCreateRectMesh(GLMesh &mesh)
 		20, 23, 22,
 	};
 
-	glGenVertexArrays(1, &mesh.vao);			//init vao
-	glBindVertexArray(mesh.vao);				//bind vertex array to the vao
-
-	//generate buffers for vertex and index info
-	glGenBuffers(2, mesh.vbos);					//init buffer
-	glBindBuffer(GL_ARRAY_BUFFER, mesh.vbos[0]);//bind the vertex info to the 0th vbo
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW); //send vertex data to gpu (VBO)
-
-	//indexing vertex attributes so VBO knows what the hell is going on with it's data
-
-	mesh.nIndices = sizeof(indices) / sizeof(indices[0]);
-
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.vbos[1]);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-
-	//how many floats per vertex and color? (3 for 3 3d coordinates) (4 for RGB and alpha values)
-	const GLuint FLOATS_PER_VERTEX = 3;
-	const GLuint FLOATS_PER_COLOR = 4;
-	const GLuint FLOATS_PER_TEXCORD = 2;
-	const GLuint FLOATS_PER_NORMAL = 3;
-
-	//indicate stride between vertex info (slice point for each individual vertex)
-	GLint stride = sizeof(float) * (FLOATS_PER_VERTEX + FLOATS_PER_COLOR + FLOATS_PER_TEXCORD + FLOATS_PER_NORMAL);
-
-	//tell GPU how to handle VBO info
-	glVertexAttribPointer(0, FLOATS_PER_VERTEX, GL_FLOAT, GL_FALSE, stride, 0);
-	glEnableVertexAttribArray(0); //initial coordinate position (it's just the first position in our simple array)
-
-	glVertexAttribPointer(1, FLOATS_PER_COLOR, GL_FLOAT, GL_FALSE, stride, (void*)(3 * sizeof(float)));
-	glEnableVertexAttribArray(1);
-
-	glVertexAttribPointer(2, FLOATS_PER_TEXCORD, GL_FLOAT, GL_FALSE, stride, (void*)(7 * sizeof(float)));
-	glEnableVertexAttribArray(2);
-
-	glVertexAttribPointer(3, FLOATS_PER_NORMAL, GL_FLOAT, GL_FALSE, stride, (void*)(9 * sizeof(float)));
-	glEnableVertexAttribArray(3);
+	//keep a cpu copy (software renderers) and upload it
+	mesh.vertices.assign(vertices, vertices + sizeof(vertices) / sizeof(vertices[0]));
+	mesh.indices.assign(indices, indices + sizeof(indices) / sizeof(indices[0]));
+	UUploadMesh(mesh);
 
 }
 
 //CREATE CUBE MESH==============================================================================================================
 void UCreateCubeMesh(GLMesh &mesh)
 {
+	UTRACE_SCOPE("UCreateCubeMesh");
+
 	float vertices[] =
 	{
 		//POS					   //COLOR				  //TEXTURE COORDS				       //NORMALS
@@ -1127,20 +880,49 @@ void UCreateCubeMesh(GLMesh &mesh)
 		20, 23, 22,
 	};
 
-	glGenVertexArrays(1, &mesh.vao);			//init vao
+	//keep a cpu copy (software renderers) and upload it
+	mesh.vertices.assign(vertices, vertices + sizeof(vertices) / sizeof(vertices[0]));
+	mesh.indices.assign(indices, indices + sizeof(indices) / sizeof(indices[0]));
+	UUploadMesh(mesh);
+
+}
+
+//UPLOAD MESH FUNCTION ==============================================================================================================================
+
+void UUploadMesh(GLMesh &mesh)
+{
+	mesh.nIndices = (GLuint)mesh.indices.size();
+
+	//bounding sphere around the centre of the vertex box (culling)
+	glm::vec3 boundsMin(1e30f), boundsMax(-1e30f);
+	for (size_t i = 0; i < mesh.vertices.size(); i += FLOATS_PER_MESH_VERTEX)
+	{
+		glm::vec3 position(mesh.vertices[i], mesh.vertices[i + 1], mesh.vertices[i + 2]);
+		boundsMin = glm::min(boundsMin, position);
+		boundsMax = glm::max(boundsMax, position);
+	}
+	mesh.boundsCenter = (boundsMin + boundsMax) * 0.5f;
+	mesh.boundsRadius = 0.0f;
+	for (size_t i = 0; i < mesh.vertices.size(); i += FLOATS_PER_MESH_VERTEX)
+		mesh.boundsRadius = std::max(mesh.boundsRadius, glm::length(glm::vec3(mesh.vertices[i], mesh.vertices[i + 1], mesh.vertices[i + 2]) - mesh.boundsCenter));
+
+	//no GL context in software mode
+	if (gWindow == nullptr)
+		return;
+
+	mesh.vao.Create("mesh");					//init vao
 	glBindVertexArray(mesh.vao);				//bind vertex array to the vao
 
 	//generate buffers for vertex and index info
-	glGenBuffers(2, mesh.vbos);					//init buffer
+	mesh.vbos[0].Create("mesh vertices");		//init buffer
+	mesh.vbos[1].Create("mesh indices");
 	glBindBuffer(GL_ARRAY_BUFFER, mesh.vbos[0]);//bind the vertex info to the 0th vbo
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW); //send vertex data to gpu (VBO)
-
-	//indexing vertex attributes so VBO knows what the hell is going on with it's data
-
-	mesh.nIndices = sizeof(indices) / sizeof(indices[0]);
+	glBufferData(GL_ARRAY_BUFFER, mesh.vertices.size() * sizeof(float), mesh.vertices.data(), GL_STATIC_DRAW); //send vertex data to gpu (VBO)
+	mesh.vbos[0].SetBytes(mesh.vertices.size() * sizeof(float));
 
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.vbos[1]);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.indices.size() * sizeof(unsigned short), mesh.indices.data(), GL_STATIC_DRAW);
+	mesh.vbos[1].SetBytes(mesh.indices.size() * sizeof(unsigned short));
 
 	//how many floats per vertex and color? (3 for 3 3d coordinates) (4 for RGB and alpha values)
 	const GLuint FLOATS_PER_VERTEX = 3;
@@ -1149,39 +931,106 @@ void UCreateCubeMesh(GLMesh &mesh)
 	const GLuint FLOATS_PER_NORMAL = 3;
 
 	//indicate stride between vertex info (slice point for each individual vertex)
-	GLint stride = sizeof(float) * (FLOATS_PER_VERTEX + FLOATS_PER_COLOR + FLOATS_PER_TEXCORD + FLOATS_PER_NORMAL);
+	GLint stride = sizeof(float) * FLOATS_PER_MESH_VERTEX;
 
 	//tell GPU how to handle VBO info
 	glVertexAttribPointer(0, FLOATS_PER_VERTEX, GL_FLOAT, GL_FALSE, stride, 0);
 	glEnableVertexAttribArray(0); //initial coordinate position (it's just the first position in our simple array)
 
-	glVertexAttribPointer(1, FLOATS_PER_COLOR, GL_FLOAT, GL_FALSE, stride, (void*)(3 * sizeof(float)));
+	glVertexAttribPointer(1, FLOATS_PER_COLOR, GL_FLOAT, GL_FALSE, stride, (void*)(MESH_COLOR_OFFSET * sizeof(float)));
 	glEnableVertexAttribArray(1);
 
-	glVertexAttribPointer(2, FLOATS_PER_TEXCORD, GL_FLOAT, GL_FALSE, stride, (void*)(7 * sizeof(float)));
+	glVertexAttribPointer(2, FLOATS_PER_TEXCORD, GL_FLOAT, GL_FALSE, stride, (void*)(MESH_TEXCOORD_OFFSET * sizeof(float)));
 	glEnableVertexAttribArray(2);
 
-	glVertexAttribPointer(3, FLOATS_PER_NORMAL, GL_FLOAT, GL_FALSE, stride, (void*)(9 * sizeof(float)));
+	glVertexAttribPointer(3, FLOATS_PER_NORMAL, GL_FLOAT, GL_FALSE, stride, (void*)(MESH_NORMAL_OFFSET * sizeof(float)));
 	glEnableVertexAttribArray(3);
-
 }
 
 //DESTROY MESH FUNCTION ============================================================================================================================
 void UDestroyMesh(GLMesh &mesh)
 {
-	glDeleteVertexArrays(1, &mesh.vao);
-	glDeleteBuffers(1, mesh.vbos);
+	//both buffers (the index buffer used to be left behind)
+	mesh.vao.Reset();
+	mesh.vbos[0].Reset();
+	mesh.vbos[1].Reset();
+}
+
+//CREATE SCENE FUNCTION (meshes, textures, graph nodes and draw list from a loaded scene file) =====================================================
+void UCreateScene(const USceneFile& scene)
+{
+	UTRACE_SCOPE("create scene");
+
+	//meshes (resized once, the draw list keeps pointers into it)
+	gMeshes.resize(scene.header->meshCount);
+	for (uint32_t i = 0; i < scene.header->meshCount; i++)
+	{
+		const USceneFileMesh& mesh = scene.meshes[i];
+		switch (mesh.type)
+		{
+		case USCENE_MESH_CYLINDER: UCreateCylinderWallMesh(gMeshes[i], mesh.parameter); break;
+		case USCENE_MESH_FLAT_CYLINDER: UCreateFlatCylinderWallMesh(gMeshes[i], mesh.parameter); break;
+		case USCENE_MESH_PLANE: UCreatePlaneMesh(gMeshes[i], mesh.parameter); break;
+		case USCENE_MESH_CUBE: UCreateCubeMesh(gMeshes[i]); break;
+		case USCENE_MESH_RECT: UCreateRectMesh(gMeshes[i]); break;
+		default: cerr << "ERROR: unknown mesh type " << mesh.type << " in scene" << endl; break;
+		}
+	}
+
+	//textures (scene texture index = texture unit)
+	{
+		UTRACE_SCOPE("load textures");
+		for (uint32_t i = 0; i < scene.header->textureCount; i++)
+		{
+			const USceneFileTexture& texture = scene.textures[i];
+			UCreateTexture(scene.String(texture.file), texture.repeat != 0, texture.linear != 0, texture.rgba ? GL_RGBA : GL_RGB, texture.channels);
+		}
+	}
+
+	//nodes are stored parents first, so they go straight into the graph; drawn nodes also get a draw item
+	uint32_t nodeCount = scene.header->nodeCount;
+	USceneReserve(gScene, (int)nodeCount);
+	gDrawList.reserve(nodeCount);
+	for (uint32_t i = 0; i < nodeCount; i++)
+	{
+		const float* t = scene.translations + 3 * i;
+		const float* r = scene.rotations + 4 * i;
+		const float* s = scene.scales + 3 * i;
+		int node = USceneAddNode(gScene, scene.parents[i], scene.String(scene.names[i]), glm::vec3(t[0], t[1], t[2]), glm::quat(r[3], r[0], r[1], r[2]), glm::vec3(s[0], s[1], s[2]));
+
+		const USceneFileDraw& draw = scene.draws[i];
+		if (draw.mesh < 0)
+			continue;
+		const USceneFileMaterial& material = scene.materials[draw.material];
+		gDrawList.push_back({ scene.String(draw.group), &gMeshes[draw.mesh], node, material.texture, draw.material, material.flags, -1,
+			(draw.flags & USCENE_DRAW_STATIC) != 0, glm::vec4(0.0f), false });
+	}
+
+	//world matrices for everything (nothing is flagged again unless a node moves)
+	USceneUpdate(gScene);
 }
 
 //CREATE SHADER PROGRAM FUNCTION ===================================================================================================================
 bool UCreateShaderProgram(const char* vertexShaderSource, const char* fragShaderSource, GLuint &programId)
 {
+	UTRACE_SCOPE("UCreateShaderProgram");
+	double startTime = glfwGetTime();
+
 	//error handling vars
 	int success = 0;
 	char infoLog[512];
 
 	//create the program and point to programId
-	programId = glCreateProgram();
+	programId = UGpuCreate(UGPU_PROGRAM, "fallback");
+
+	//linked binary from an earlier run with the same sources and driver
+	const char* sources[] = { vertexShaderSource, fragShaderSource };
+	uint64_t cacheKey = UShaderCacheKey(sources, 2);
+	if (UShaderCacheLoad(cacheKey, programId))
+	{
+		UShaderCacheAddTime((glfwGetTime() - startTime) * 1000.0);
+		return true;
+	}
 
 	//create shader ids
 	GLuint vertexShaderId = glCreateShader(GL_VERTEX_SHADER);
@@ -1200,6 +1049,10 @@ bool UCreateShaderProgram(const char* vertexShaderSource, const char* fragShader
 		glGetShaderInfoLog(vertexShaderId, 512, NULL, infoLog);
 		std::cout << "ERROR COMPILING VERTEX SHADER\n" << infoLog << std::endl;
 
+		glDeleteShader(vertexShaderId);
+		glDeleteShader(fragmentShaderId);
+		UGpuDestroy(UGPU_PROGRAM, programId);
+		programId = 0;
 		return false;
 	}
 
@@ -1211,6 +1064,10 @@ bool UCreateShaderProgram(const char* vertexShaderSource, const char* fragShader
 		glGetShaderInfoLog(fragmentShaderId, sizeof(infoLog), NULL, infoLog);
 		std::cout << "ERROR COMPILING FRAGMENT SHADER\n" << infoLog << std::endl;
 	
+		glDeleteShader(vertexShaderId);
+		glDeleteShader(fragmentShaderId);
+		UGpuDestroy(UGPU_PROGRAM, programId);
+		programId = 0;
 		return false;
 	}
 
@@ -1219,6 +1076,7 @@ bool UCreateShaderProgram(const char* vertexShaderSource, const char* fragShader
 	glAttachShader(programId, fragmentShaderId);
 
 	//link for use
+	UShaderCachePrepare(programId);
 	glLinkProgram(programId);
 	glGetProgramiv(programId, GL_LINK_STATUS, &success);
 	if (!success)
@@ -1226,9 +1084,22 @@ bool UCreateShaderProgram(const char* vertexShaderSource, const char* fragShader
 		glGetProgramInfoLog(programId, sizeof(infoLog), NULL, infoLog);
 		std::cout << "ERROR LINKING SHADER PROGRAM\n" << infoLog << std::endl;
 
+		//the attached shaders are only flagged for deletion here, they go with the program
+		glDeleteShader(vertexShaderId);
+		glDeleteShader(fragmentShaderId);
+		UGpuDestroy(UGPU_PROGRAM, programId);
+		programId = 0;
 		return false;
 	}
 
+	//the shaders aren't needed once linked
+	glDetachShader(programId, vertexShaderId);
+	glDetachShader(programId, fragmentShaderId);
+	glDeleteShader(vertexShaderId);
+	glDeleteShader(fragmentShaderId);
+
+	UShaderCacheStore(cacheKey, programId);
+	UShaderCacheAddTime((glfwGetTime() - startTime) * 1000.0);
 	return true;
 }
 
@@ -1236,53 +1107,221 @@ bool UCreateShaderProgram(const char* vertexShaderSource, const char* fragShader
 
 void UDestroyShaderProgram(GLuint programId)
 {
-	glDeleteProgram(programId);
+	UGpuDestroy(UGPU_PROGRAM, programId);
 }
 
-//RENDER FUNCTION ===================================================================================================================================
+//LOAD IMAGE FUNCTION (stb_image, traced) ==========================================================================================================
 
-void URenderMesh(const GLMesh& mesh, glm::mat4 translation, glm::mat4 rotation, glm::mat4 scale, glm::mat4 view)
+unsigned char* ULoadImage(const char* file, int* width, int* height, int* nrChannels, int desiredChannels)
 {
-	//enable z-depth
-	glEnable(GL_DEPTH_TEST);
-
-	//right to left order for transformations (ORDER MATTERS!)
-	glm::mat4 model = translation * rotation * scale;
-	//^^^ THIS CREATES A TRANSFORMATION MATRIX WE CAN APPLY TO THE MESH USING THE DATA FROM EACH PRECEEDING MATRIX
+	UTRACE_SCOPE_ARG("stbi_load", file);
+	return stbi_load(file, width, height, nrChannels, desiredChannels);
+}
 
-	//initialize projection matrix
-	glm::mat4 projection;
+//CREATE TEXTURE FUNCTION (next texture unit, keeps the cpu copy) ====================================================================================
 
-	//create projection matrix
-	if (ortho == false)
+void UCreateTexture(const char* file, bool repeat, bool linear, GLenum format, int desiredChannels)
+{
+	USceneTexture texture;
+	texture.repeat = repeat;
+	texture.linear = linear;
+
+	// load image
+	int width, height, nrChannels;
+	unsigned char *data = ULoadImage(file, &width, &height, &nrChannels, desiredChannels);
+	if (data)
 	{
-		projection = glm::perspective(glm::radians(45.0f), (GLfloat)WINDOW_WIDTH / (GLfloat)WINDOW_HEIGHT, 0.1f, 100.0f); //perspective projection
+		texture.image.width = width;
+		texture.image.height = height;
+		texture.image.channels = desiredChannels ? desiredChannels : nrChannels;
+		texture.image.pixels.assign(data, data + (size_t)width * height * texture.image.channels);
 	}
 	else
 	{
-		projection = glm::ortho(-5.0f, 5.0f, -5.0f, 5.0f, 0.1f, 100.0f); //orthogonol projection
+		std::cout << "Failed to load texture" << std::endl;
+	}
+	stbi_image_free(data);
+
+	//create the GL texture on the unit matching its index
+	if (gWindow != nullptr)
+	{
+		glActiveTexture(GL_TEXTURE0 + (GLenum)gTextures.size());
+		texture.id.Create(file);
+		glBindTexture(GL_TEXTURE_2D, texture.id);
+		// set the texture wrapping parameters
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, repeat ? GL_REPEAT : GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, repeat ? GL_REPEAT : GL_CLAMP_TO_EDGE);
+		// set texture filtering parameters
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, linear ? GL_LINEAR : GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, linear ? GL_LINEAR : GL_NEAREST);
+		if (data)
+		{
+			glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, texture.image.pixels.data());
+			glGenerateMipmap(GL_TEXTURE_2D);
+			texture.id.SetBytes(UGpuTextureBytes(width, height, format == GL_RGBA ? 4 : 3, true));
+		}
+	}
+
+	gTextures.push_back(std::move(texture));
+}
+
+//FRAME UNIFORMS (lights and camera; set once per program per frame, materials come from their storage buffer) ===========================================
+void USetFrameUniforms(GLuint programId)
+{
+	//light 1 color
+	GLint ambientLiLoc = glGetUniformLocation(programId, "light.ambient");
+	GLint diffuseLiLoc = glGetUniformLocation(programId, "light.diffuse");
+	GLint specularLiLoc = glGetUniformLocation(programId, "light.specular");
+	glm::vec3 lightColor(1.0f);
+	glm::vec3 diffuseColor = lightColor * gLighting.diffuse; // decrease the influence
+	glm::vec3 ambientColor = lightColor * gLighting.ambient; // low influence
+
+	glUniform3fv(ambientLiLoc, 1, glm::value_ptr(ambientColor));
+	glUniform3fv(diffuseLiLoc, 1, glm::value_ptr(diffuseColor));
+	glUniform3fv(specularLiLoc, 1, glm::value_ptr(gLighting.specular));
+
+	GLint objColorLoc = glGetUniformLocation(programId, "objColor");
+	GLint lightColorLoc = glGetUniformLocation(programId, "lightColor");
+	glm::vec3 objectColor(1.0f, 1.0f, 1.0f);
+	glUniform3fv(objColorLoc, 1, glm::value_ptr(objectColor));
+	glUniform3fv(lightColorLoc, 1, glm::value_ptr(lightColor));
+
+	//set light direction uniforms
+	GLint lightDirectionLoc = glGetUniformLocation(programId, "light.direction");
+	glUniform3fv(lightDirectionLoc, 1, glm::value_ptr(gLighting.direction));
+	GLint lightDirection2Loc = glGetUniformLocation(programId, "light.direction2");
+	glUniform3fv(lightDirection2Loc, 1, glm::value_ptr(gLighting.direction2));
+
+	//point lights (only variants built with POINT_LIGHTS > 0 have these)
+	for (size_t i = 0; i < gLighting.points.size() && i < (size_t)USHADER_MAX_POINT_LIGHTS; i++)
+	{
+		//names on the stack, this runs every frame
+		char name[64];
+		snprintf(name, sizeof(name), "pointLights[%d].position", (int)i);
+		glUniform3fv(glGetUniformLocation(programId, name), 1, glm::value_ptr(gLighting.points[i].position));
+		snprintf(name, sizeof(name), "pointLights[%d].color", (int)i);
+		glUniform3fv(glGetUniformLocation(programId, name), 1, glm::value_ptr(gLighting.points[i].color));
 	}
 
-	//setting up MVP
-	GLint modelLoc = glGetUniformLocation(gProgramId, "model");
-	GLint viewLoc = glGetUniformLocation(gProgramId, "view");
-	GLint projLoc = glGetUniformLocation(gProgramId, "projection");
+	GLint cameraPosLoc = glGetUniformLocation(programId, "cameraPos");
+	glUniform3fv(cameraPosLoc, 1, glm::value_ptr(cameraPos));
 
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-	glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
+	//shadow atlases and this frame's cascades (only SHADOWS variants have these)
+	UShadowsSetUniforms(programId);
+	//baked lightmap and shadowmask (only LIGHTMAP variants have these)
+	ULightmapSetUniforms(programId);
+	//every view's matrix and eye (only MULTI_VIEW variants have these)
+	UMultiViewSetUniforms(programId);
+}
 
-	//WIREFRAME MODE
-	//glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+//DRAW SCENE (gpu driven when ready, otherwise the command lists built on the job system) ===========================================================
 
-	//bind the vao so we dont have to send things to the vbo
-	glBindVertexArray(mesh.vao);
-	//draw the triangles
-	glDrawElements(GL_TRIANGLES, mesh.nIndices, GL_UNSIGNED_SHORT, NULL);
+void UDrawScene(const glm::mat4& view, const glm::mat4& projection)
+{
+	//gpu driven: a compute pass culls and writes the indirect commands, one multi-draw per batch (until its programs are
+	//built the cpu command lists below draw the scene)
+	if (UGpuCullingReady(gShaderVariants))
+	{
+		UTraceFrameSection("gpu driven");
+		UGpuCullingDraw(gShaderVariants, view, projection, USetFrameUniforms);
+	}
+	else
+	{
+		//workers cull the draw list against the frusta and encode the draw packets, this thread only replays them
+		UTraceFrameSection("build commands");
+		glm::vec4 planes[6 * UMULTIVIEW_MAX_VIEWS];
+		int views = UMultiViewFrustumPlanes(projection * view, planes);
+		UTraceCounter("draw packets", UCommandListsBuild(gCommandLists, gDrawList, gScene, planes, views));
+		UTraceCounter("draws culled", gCommandLists.culled);
+
+		//the program changes with the object's shader variant (each program gets its lighting and camera uniforms the first
+		//time it is used in a frame); texture unit and material only change between object groups, so only set them when they do
+		glEnable(GL_DEPTH_TEST);
+		//at most one entry per variant (the ones still building share the fallback)
+		GLuint* programsThisFrame = UFrameAllocArray<GLuint>(gShaderVariants.programs.size());
+		int programsUsed = 0;
+		GLint modelLoc = -1;
+		GLint textureLoc = -1;
+		GLint materialLoc = -1;
+		GLint lightmapLoc = -1;
+		gProgramId = 0;
+		const char* section = nullptr;
+		int boundTexture = -1;
+		int boundMaterial = -1;
+		//one instance per view when the vertex shader picks the viewport
+		int instances = UMultiViewInstances();
+		bool multiView = UMultiViewEnabled();
+		for (const UCommandList& list : gCommandLists.lists)
+		{
+			for (int p = 0; p < list.count; p++)
+			{
+				const UDrawPacket& packet = list.packets[p];
+				if (section == nullptr || strcmp(section, packet.name) != 0)
+				{
+					UTraceFrameSection(packet.name);
+					section = packet.name;
+				}
+				//with several views the fallback would stack every view's copy in the first viewport, so the packet waits
+				//for its MULTI_VIEW variant
+				if (multiView && !gShaderVariants.programs[packet.variant].ready)
+					continue;
+				GLuint program = UShaderVariantUse(gShaderVariants, packet.variant);
+				if (program != gProgramId)
+				{
+					gProgramId = program;
+					glUseProgram(gProgramId);
+					if (std::find(programsThisFrame, programsThisFrame + programsUsed, gProgramId) == programsThisFrame + programsUsed)
+					{
+						USetFrameUniforms(gProgramId);
+						glUniformMatrix4fv(glGetUniformLocation(gProgramId, "view"), 1, GL_FALSE, glm::value_ptr(view));
+						glUniformMatrix4fv(glGetUniformLocation(gProgramId, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+						programsThisFrame[programsUsed++] = gProgramId;
+					}
+					modelLoc = glGetUniformLocation(gProgramId, "model");
+					textureLoc = glGetUniformLocation(gProgramId, "ourTexture");
+					materialLoc = glGetUniformLocation(gProgramId, "materialIndex");
+					lightmapLoc = glGetUniformLocation(gProgramId, "lightmapScaleOffset");
+					boundTexture = -1;
+					boundMaterial = -1;
+				}
+				if (packet.texture != boundTexture)
+				{
+					glUniform1i(textureLoc, packet.texture);
+					boundTexture = packet.texture;
+				}
+				if (packet.material != boundMaterial)
+				{
+					glUniform1i(materialLoc, packet.material);
+					boundMaterial = packet.material;
+				}
+				glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(packet.model));
+				if (lightmapLoc >= 0)
+					glUniform4fv(lightmapLoc, 1, glm::value_ptr(packet.lightmap));
+				glBindVertexArray(packet.vao);
+				if (instances > 1)
+					glDrawElementsInstanced(GL_TRIANGLES, packet.count, GL_UNSIGNED_SHORT, NULL, instances);
+				else
+					glDrawElements(GL_TRIANGLES, packet.count, GL_UNSIGNED_SHORT, NULL);
+			}
+		}
+		glBindVertexArray(0);
+		UTraceCounter("shader programs used", (double)programsUsed);
+	}
+}
 
-	//"unbind" vao
-	glBindVertexArray(0);
+//PROJECTION (perspective, or orthographic while P is toggled) ======================================================================================
 
+glm::mat4 UProjection()
+{
+	//create projection matrix
+	if (ortho == false)
+	{
+		return glm::perspective(glm::radians(45.0f), (GLfloat)WINDOW_WIDTH / (GLfloat)WINDOW_HEIGHT, 0.1f, 100.0f); //perspective projection
+	}
+	else
+	{
+		return glm::ortho(-5.0f, 5.0f, -5.0f, 5.0f, 0.1f, 100.0f); //orthogonol projection
+	}
 }
 
 //MOUSE CALLBACK ====================================================================================================================================
@@ -1307,17 +1346,14 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos)
 	xoffset *= sensitivity;
 	yoffset *= sensitivity;
 
-	//change pitch and yaw depending on new position
-	yaw += xoffset;
-	pitch += yoffset;
+	//change pitch and yaw depending on new position (applied, and pitch clamped to +-89, on the next simulation step)
+	USimulationAddLook(xoffset, yoffset);
+}
 
-	//restrict camera from rotating past straight up (90) or straight down (-90)
-	if (pitch > 89.0f)
-		pitch = 89.0f;
-	if (pitch < -89.0f)
-		pitch = -89.0f;
+//CAMERA FRONT FROM YAW/PITCH =======================================================================================================================
 
-	//set direction and apply to cameraFront (used in setting view)
+void UUpdateCameraFront()
+{
 	glm::vec3 direction;
 	direction.x = cos(glm::radians(yaw)) * cos(glm::radians(pitch));
 	direction.y = sin(glm::radians(pitch));
@@ -1329,8 +1365,7 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos)
 
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 {
-	//NOTE: I decided not to normalize movement speed based on delta time
-	//since you're able to change the speed anyway.
+	//speed is per 1/60 s, the simulation thread scales it to its step length
 
 	cameraSpeed = glm::abs(cameraSpeed + (yoffset * 0.01));
 	//define minimum speed
@@ -1351,5 +1386,10 @@ void p_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
 	{
 		ortho = !ortho;
 	}
+	//material edits (M selects, [ and ] change the shininess)
+	else if (action == GLFW_PRESS)
+	{
+		UMaterialsKey(key);
+	}
 }
 
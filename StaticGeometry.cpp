@@ -0,0 +1,249 @@
+#include "StaticGeometry.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <set>
+#include <string>
+
+#include "Lightmap.h"
+#include "Materials.h"
+#include "Trace.h"
+
+using namespace std;
+
+namespace
+{
+	typedef chrono::steady_clock Clock;
+
+	//16 bit indices: a cluster never has more triangles than this (3 vertices each at worst)
+	const int MAX_CLUSTER_TRIANGLES = 65535 / 3;
+
+	deque<GLMesh> gFrozenMeshes;
+	deque<string> gFrozenNames;
+
+	//static draws that are drawn the same way, appended in world space
+	struct FreezeGroup
+	{
+		int material;
+		bool lightmapped;
+		bool vertexLit;
+		int texture;
+		uint32_t flags;
+		vector<float> vertices;			//FLOATS_PER_MESH_VERTEX each
+		vector<float> lightmapUVs;		//already inside the atlas (lightmapped groups)
+		vector<uint32_t> indices;		//into vertices, 3 per triangle
+	};
+
+	size_t UMeshBytes(const GLMesh& mesh)
+	{
+		return mesh.vertices.size() * sizeof(float) + mesh.indices.size() * sizeof(unsigned short) + mesh.lightmapUVs.size() * sizeof(float);
+	}
+
+	//one draw's vertices through its world matrix into the group
+	void UAppendDraw(FreezeGroup& group, const UDrawItem& item, const glm::mat4& model)
+	{
+		const GLMesh& mesh = *item.mesh;
+		glm::mat3 normalMatrix = glm::mat3(glm::transpose(glm::inverse(model)));
+		uint32_t base = (uint32_t)(group.vertices.size() / FLOATS_PER_MESH_VERTEX);
+		size_t vertexCount = mesh.vertices.size() / FLOATS_PER_MESH_VERTEX;
+		for (size_t v = 0; v < vertexCount; v++)
+		{
+			const float* source = &mesh.vertices[v * FLOATS_PER_MESH_VERTEX];
+			size_t at = group.vertices.size();
+			group.vertices.insert(group.vertices.end(), source, source + FLOATS_PER_MESH_VERTEX);
+			glm::vec3 position = glm::vec3(model * glm::vec4(source[0], source[1], source[2], 1.0f));
+			glm::vec3 normal = normalMatrix * glm::vec3(source[MESH_NORMAL_OFFSET], source[MESH_NORMAL_OFFSET + 1], source[MESH_NORMAL_OFFSET + 2]);
+			if (glm::dot(normal, normal) > 0.0f)
+				normal = glm::normalize(normal);
+			memcpy(&group.vertices[at], &position, 3 * sizeof(float));
+			memcpy(&group.vertices[at + MESH_NORMAL_OFFSET], &normal, 3 * sizeof(float));
+			if (group.lightmapped)
+			{
+				group.lightmapUVs.push_back(mesh.lightmapUVs[v * 2] * item.lightmap.x + item.lightmap.z);
+				group.lightmapUVs.push_back(mesh.lightmapUVs[v * 2 + 1] * item.lightmap.y + item.lightmap.w);
+			}
+		}
+
+		//a mirroring matrix turns the triangles around, swap two corners to keep them facing out
+		bool mirrored = glm::determinant(glm::mat3(model)) < 0.0f;
+		for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+		{
+			group.indices.push_back(base + mesh.indices[i]);
+			group.indices.push_back(base + mesh.indices[i + (mirrored ? 2 : 1)]);
+			group.indices.push_back(base + mesh.indices[i + (mirrored ? 1 : 2)]);
+		}
+	}
+
+	//triangles order[begin, end) of the group as a mesh of their own (only the vertices they use)
+	void UBuildCluster(const FreezeGroup& group, const vector<uint32_t>& order, size_t begin, size_t end, vector<int>& remap, GLMesh& mesh)
+	{
+		vector<uint32_t> used;
+		for (size_t t = begin; t < end; t++)
+		{
+			for (int corner = 0; corner < 3; corner++)
+			{
+				uint32_t vertex = group.indices[order[t] * 3 + corner];
+				if (remap[vertex] < 0)
+				{
+					remap[vertex] = (int)(mesh.vertices.size() / FLOATS_PER_MESH_VERTEX);
+					used.push_back(vertex);
+					const float* source = &group.vertices[(size_t)vertex * FLOATS_PER_MESH_VERTEX];
+					mesh.vertices.insert(mesh.vertices.end(), source, source + FLOATS_PER_MESH_VERTEX);
+					if (group.lightmapped)
+					{
+						mesh.lightmapUVs.push_back(group.lightmapUVs[(size_t)vertex * 2]);
+						mesh.lightmapUVs.push_back(group.lightmapUVs[(size_t)vertex * 2 + 1]);
+					}
+				}
+				mesh.indices.push_back((unsigned short)remap[vertex]);
+			}
+		}
+		for (uint32_t vertex : used)
+			remap[vertex] = -1;
+	}
+}
+
+bool UParseStaticGeometryArgs(int argc, char* argv[], UStaticGeometryConfig& config)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--freeze-static") == 0)
+		{
+			config.enabled = true;
+			if (i + 1 < argc && argv[i + 1][0] != '-')
+				config.clusterTriangles = std::min(std::max(1, atoi(argv[++i])), MAX_CLUSTER_TRIANGLES);
+		}
+	}
+	return true;
+}
+
+int UFreezeStaticGeometry(const UStaticGeometryConfig& config, std::vector<UDrawItem>& items, USceneGraph& scene, void (*upload)(GLMesh& mesh))
+{
+	if (!config.enabled)
+		return 0;
+	UTRACE_SCOPE("freeze static geometry");
+	Clock::time_point start = Clock::now();
+
+	//static draws into their groups, everything else stays as it is (and in its order)
+	vector<FreezeGroup> groups;
+	vector<UDrawItem> kept;
+	set<const GLMesh*> sourceMeshes;
+	size_t sourceBytes = 0;
+	size_t sourceVertices = 0;
+	int frozenDraws = 0;
+	for (const UDrawItem& item : items)
+	{
+		if (!item.isStatic)
+		{
+			kept.push_back(item);
+			continue;
+		}
+		bool lightmapped = item.lightmap.x > 0.0f;
+		size_t g = 0;
+		while (g < groups.size() && (groups[g].material != item.material || groups[g].lightmapped != lightmapped || groups[g].vertexLit != item.vertexLit))
+			g++;
+		if (g == groups.size())
+		{
+			FreezeGroup group;
+			group.material = item.material;
+			group.lightmapped = lightmapped;
+			group.vertexLit = item.vertexLit;
+			group.texture = item.texture;
+			group.flags = item.flags;
+			groups.push_back(group);
+		}
+		UAppendDraw(groups[g], item, scene.world[item.node]);
+		if (sourceMeshes.insert(item.mesh).second)
+			sourceBytes += UMeshBytes(*item.mesh);
+		sourceVertices += item.mesh->vertices.size() / FLOATS_PER_MESH_VERTEX;
+		frozenDraws++;
+	}
+	if (frozenDraws == 0)
+	{
+		cout << "INFO: static freeze: the scene has no static draws" << endl;
+		return 0;
+	}
+
+	//every cluster is already in world space
+	int root = USceneAddNode(scene, -1, "static geometry");
+	size_t drawsBefore = items.size();
+	size_t frozenBytes = 0;
+	size_t frozenVertices = 0;
+	int clusters = 0;
+	for (const FreezeGroup& group : groups)
+	{
+		//median splits along the longest axis of the triangle centres until every range is small enough
+		size_t triangles = group.indices.size() / 3;
+		vector<glm::vec3> centres(triangles);
+		vector<uint32_t> order(triangles);
+		for (size_t t = 0; t < triangles; t++)
+		{
+			glm::vec3 sum(0.0f);
+			for (int corner = 0; corner < 3; corner++)
+			{
+				const float* p = &group.vertices[(size_t)group.indices[t * 3 + corner] * FLOATS_PER_MESH_VERTEX];
+				sum += glm::vec3(p[0], p[1], p[2]);
+			}
+			centres[t] = sum / 3.0f;
+			order[t] = (uint32_t)t;
+		}
+		vector<int> remap(group.vertices.size() / FLOATS_PER_MESH_VERTEX, -1);
+		vector<pair<size_t, size_t>> ranges(1, make_pair((size_t)0, triangles));
+		while (!ranges.empty())
+		{
+			size_t begin = ranges.back().first;
+			size_t end = ranges.back().second;
+			ranges.pop_back();
+			if (end - begin > (size_t)config.clusterTriangles)
+			{
+				glm::vec3 low(1e30f), high(-1e30f);
+				for (size_t t = begin; t < end; t++)
+				{
+					low = glm::min(low, centres[order[t]]);
+					high = glm::max(high, centres[order[t]]);
+				}
+				glm::vec3 extent = high - low;
+				int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : extent.y >= extent.z ? 1 : 2;
+				size_t middle = begin + (end - begin) / 2;
+				nth_element(order.begin() + begin, order.begin() + middle, order.begin() + end,
+					[&](uint32_t a, uint32_t b) { return centres[a][axis] < centres[b][axis]; });
+				ranges.push_back(make_pair(middle, end));
+				ranges.push_back(make_pair(begin, middle));
+				continue;
+			}
+
+			gFrozenMeshes.emplace_back();
+			GLMesh& mesh = gFrozenMeshes.back();
+			UBuildCluster(group, order, begin, end, remap, mesh);
+			upload(mesh);
+			if (group.lightmapped)
+				ULightmapAttachUVs(mesh);
+			gFrozenNames.push_back("static " + UMaterialName(group.material));
+			kept.push_back({ gFrozenNames.back().c_str(), &mesh, root, group.texture, group.material, group.flags, -1, true,
+				group.lightmapped ? glm::vec4(1.0f, 1.0f, 0.0f, 0.0f) : glm::vec4(0.0f), group.vertexLit });
+			frozenBytes += UMeshBytes(mesh);
+			frozenVertices += mesh.vertices.size() / FLOATS_PER_MESH_VERTEX;
+			clusters++;
+		}
+	}
+	items.swap(kept);
+
+	double ms = chrono::duration<double, milli>(Clock::now() - start).count();
+	cout << "INFO: static freeze: " << frozenDraws << " static draws -> " << clusters << " clusters (" << groups.size() << " material groups, at most "
+		<< config.clusterTriangles << " triangles each), draws per frame before culling " << drawsBefore << " -> " << items.size() << ", " << ms << " ms" << endl;
+	cout << "INFO: static geometry: " << sourceVertices << " vertices drawn from " << sourceMeshes.size() << " shared meshes (" << sourceBytes / 1024.0
+		<< " KB) -> " << frozenVertices << " world space vertices (" << frozenBytes / 1024.0 << " KB, " << ((double)frozenBytes - (double)sourceBytes) / 1024.0
+		<< " KB difference; the shared meshes stay loaded for the other draws)" << endl;
+	return frozenDraws;
+}
+
+void UStaticGeometryShutdown()
+{
+	//the meshes' handles delete their vao and buffers
+	gFrozenMeshes.clear();
+	gFrozenNames.clear();
+}
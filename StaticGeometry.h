@@ -0,0 +1,33 @@
+#pragma once
+
+#include <vector>
+
+#include "Mesh.h"
+#include "Scene.h"
+#include "SceneGraph.h"
+
+//STATIC GEOMETRY FREEZE ===========================================================================================================================
+//
+// --freeze-static [triangles]   merge the static draws into world space clusters of at most <triangles> (default 4096)
+//
+// the scene file's static nodes never move, so their draws can be baked once at load: every vertex goes through its
+// draw's world matrix (normals through the normal matrix), draws that are drawn the same way (material, lightmapped,
+// vertex lit) are appended into one vertex/index list, and each list is split at the median of its triangle centres
+// along the longest axis until every cluster has at most <triangles> triangles and fits 16 bit indices. each cluster is
+// one draw item with its own world space mesh and bounding sphere (under an identity root node), so the static part of
+// the scene is a few draws that can still be culled piece by piece. lightmapped draws get their atlas rectangle folded
+// into the second uv set. it runs after the lightmap and vertex lighting loads (which check their files against the
+// original draws) and before the shadow atlas, the shader variants and the gpu culling see the draw list.
+
+struct UStaticGeometryConfig
+{
+	bool enabled = false;
+	int clusterTriangles = 4096;
+};
+
+bool UParseStaticGeometryArgs(int argc, char* argv[], UStaticGeometryConfig& config);
+
+//replaces the static draws of items with the merged clusters (upload gives each cluster mesh its vao), returns how many
+//static draws went into them
+int UFreezeStaticGeometry(const UStaticGeometryConfig& config, std::vector<UDrawItem>& items, USceneGraph& scene, void (*upload)(GLMesh& mesh));
+void UStaticGeometryShutdown();
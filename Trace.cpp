@@ -0,0 +1,389 @@
+#include "Trace.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "GLStats.h"
+
+using namespace std;
+
+namespace
+{
+	typedef chrono::steady_clock Clock;
+
+	//events per chunk, a thread allocates a new chunk only when its current one fills up
+	const size_t CHUNK_EVENTS = 4096;
+	//pseudo thread id used for gpu events
+	const uint32_t GPU_TID = 0;
+
+	struct Event
+	{
+		int64_t ts;			//ns since trace start
+		int64_t dur;		//ns, only for complete ('X') events
+		const char* name;
+		const char* arg;
+		double value;
+		char phase;			//B, E, C or X
+	};
+
+	struct Chunk
+	{
+		Event events[CHUNK_EVENTS];
+		atomic<size_t> count;		//published with release so a flush never reads a half written event
+		atomic<Chunk*> next;
+		Chunk() : count(0), next(nullptr) {}
+	};
+
+	struct ThreadBuffer
+	{
+		uint32_t tid;
+		const char* name;
+		Chunk* head;		//read by the flush
+		Chunk* tail;		//written by the owning thread only
+	};
+
+	bool enabled = false;
+	string outFile = "trace.json";
+	Clock::time_point startTime;
+
+	mutex registryMutex;				//only taken when a thread registers and when flushing
+	vector<ThreadBuffer*> registry;
+	atomic<uint32_t> nextTid(1);
+	thread_local ThreadBuffer* localBuffer = nullptr;
+
+	//gpu state (GL thread only)
+	struct GpuEvent
+	{
+		const char* name;
+		GLuint begin;
+		GLuint end;			//0 while the scope is still open
+	};
+	ThreadBuffer* gpuBuffer = nullptr;
+	vector<GLuint> freeQueries;
+	vector<GLuint> allQueries;
+	deque<GpuEvent> pendingGpu;
+	vector<size_t> openGpu;				//indices (from the back of pendingGpu) of open scopes
+	int64_t gpuOffset = 0;				//cpu ns - gpu ns
+	int64_t lastCalibration = 0;
+	bool sectionOpen = false;
+
+	int64_t UNow()
+	{
+		return chrono::duration_cast<chrono::nanoseconds>(Clock::now() - startTime).count();
+	}
+
+	ThreadBuffer* URegisterBuffer(uint32_t tid, const char* name)
+	{
+		ThreadBuffer* buffer = new ThreadBuffer;
+		buffer->tid = tid;
+		buffer->name = name;
+		buffer->head = buffer->tail = new Chunk;
+
+		lock_guard<mutex> lock(registryMutex);
+		registry.push_back(buffer);
+		return buffer;
+	}
+
+	ThreadBuffer* ULocalBuffer()
+	{
+		if (!localBuffer)
+			localBuffer = URegisterBuffer(nextTid++, nullptr);
+		return localBuffer;
+	}
+
+	void UPush(ThreadBuffer* buffer, const Event& event)
+	{
+		Chunk* chunk = buffer->tail;
+		size_t count = chunk->count.load(memory_order_relaxed);
+		if (count == CHUNK_EVENTS)
+		{
+			Chunk* next = new Chunk;
+			chunk->next.store(next, memory_order_release);
+			buffer->tail = chunk = next;
+			count = 0;
+		}
+		chunk->events[count] = event;
+		chunk->count.store(count + 1, memory_order_release);
+	}
+
+	void UCalibrateGpu()
+	{
+		GLint64 gpuNow = 0;
+		glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+		lastCalibration = UNow();
+		gpuOffset = lastCalibration - gpuNow;
+	}
+
+	GLuint UAcquireQuery()
+	{
+		if (freeQueries.empty())
+		{
+			GLuint queries[32];
+			glGenQueries(32, queries);
+			freeQueries.insert(freeQueries.end(), queries, queries + 32);
+			allQueries.insert(allQueries.end(), queries, queries + 32);
+		}
+		GLuint query = freeQueries.back();
+		freeQueries.pop_back();
+		return query;
+	}
+
+	void UWriteString(ostream& out, const char* text)
+	{
+		out << '"';
+		for (const char* c = text; *c; c++)
+		{
+			if (*c == '\n')
+				out << "\\n";
+			else if (*c == '\t')
+				out << "\\t";
+			else if ((unsigned char)*c < 0x20)
+			{
+				char escaped[8];
+				snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned char)*c);
+				out << escaped;
+			}
+			else
+			{
+				if (*c == '"' || *c == '\\')
+					out << '\\';
+				out << *c;
+			}
+		}
+		out << '"';
+	}
+}
+
+//SETUP ============================================================================================================================================
+
+void UTraceParseArgs(int argc, char* argv[])
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--trace") == 0)
+		{
+			enabled = true;
+			//optional output file
+			if (i + 1 < argc && argv[i + 1][0] != '-')
+				outFile = argv[++i];
+		}
+	}
+
+	if (enabled)
+	{
+		startTime = Clock::now();
+		UTraceThreadName("main");
+	}
+}
+
+bool UTraceEnabled()
+{
+	return enabled;
+}
+
+void UTraceThreadName(const char* name)
+{
+	if (enabled)
+		ULocalBuffer()->name = name;
+}
+
+//CPU EVENTS =======================================================================================================================================
+
+void UTraceBegin(const char* name, const char* arg)
+{
+	if (!enabled)
+		return;
+	Event event = { UNow(), 0, name, arg, 0.0, 'B' };
+	UPush(ULocalBuffer(), event);
+}
+
+void UTraceEnd()
+{
+	if (!enabled)
+		return;
+	Event event = { UNow(), 0, nullptr, nullptr, 0.0, 'E' };
+	UPush(ULocalBuffer(), event);
+}
+
+void UTraceCounter(const char* name, double value)
+{
+	if (!enabled)
+		return;
+	Event event = { UNow(), 0, name, nullptr, value, 'C' };
+	UPush(ULocalBuffer(), event);
+}
+
+//GPU EVENTS =======================================================================================================================================
+
+void UTraceGpuInit()
+{
+	if (!enabled || gpuBuffer)
+		return;
+	gpuBuffer = URegisterBuffer(GPU_TID, "GPU");
+	UCalibrateGpu();
+}
+
+void UTraceGpuBegin(const char* name)
+{
+	if (!gpuBuffer)
+		return;
+	GpuEvent event = { name, UAcquireQuery(), 0 };
+	glQueryCounter(event.begin, GL_TIMESTAMP);
+	pendingGpu.push_back(event);
+	openGpu.push_back(pendingGpu.size() - 1);
+}
+
+void UTraceGpuEnd()
+{
+	if (!gpuBuffer || openGpu.empty())
+		return;
+	GLuint query = UAcquireQuery();
+	glQueryCounter(query, GL_TIMESTAMP);
+	pendingGpu[openGpu.back()].end = query;
+	openGpu.pop_back();
+}
+
+void UTraceGpuCollect()
+{
+	if (!gpuBuffer)
+		return;
+
+	//events come out in begin order, an open outer scope holds back the inner ones until it closes
+	while (!pendingGpu.empty() && pendingGpu.front().end != 0)
+	{
+		GpuEvent& front = pendingGpu.front();
+		GLint available = 0;
+		glGetQueryObjectiv(front.end, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+			break;
+
+		GLuint64 begin = 0, end = 0;
+		glGetQueryObjectui64v(front.begin, GL_QUERY_RESULT, &begin);
+		glGetQueryObjectui64v(front.end, GL_QUERY_RESULT, &end);
+		Event event = { (int64_t)begin + gpuOffset, (int64_t)(end - begin), front.name, nullptr, 0.0, 'X' };
+		UPush(gpuBuffer, event);
+
+		freeQueries.push_back(front.begin);
+		freeQueries.push_back(front.end);
+		pendingGpu.pop_front();
+		for (size_t& open : openGpu)
+			open--;
+	}
+
+	//the two clocks drift apart slowly, re-align once a second
+	if (UNow() - lastCalibration > 1000000000)
+		UCalibrateGpu();
+}
+
+void UTraceGpuShutdown()
+{
+	if (!gpuBuffer)
+		return;
+
+	//wait for whatever is still in flight so the last frame makes it into the trace
+	glFinish();
+	while (!openGpu.empty())
+		UTraceGpuEnd();
+	UTraceGpuCollect();
+
+	if (!allQueries.empty())
+		glDeleteQueries((GLsizei)allQueries.size(), allQueries.data());
+	allQueries.clear();
+	freeQueries.clear();
+	pendingGpu.clear();
+}
+
+void UTraceFrameSection(const char* name)
+{
+	if (!enabled)
+		return;
+
+	if (sectionOpen)
+	{
+		UTraceGpuEnd();
+		UTraceEnd();
+	}
+	sectionOpen = name != nullptr;
+	if (sectionOpen)
+	{
+		UTraceBegin(name);
+		UTraceGpuBegin(name);
+	}
+}
+
+//FLUSH ============================================================================================================================================
+
+bool UTraceFlush()
+{
+	if (!enabled)
+		return false;
+
+	ofstream out(outFile.c_str());
+	if (!out)
+	{
+		cerr << "ERROR: could not write trace " << outFile << endl;
+		return false;
+	}
+
+	//microsecond timestamps with ns precision, the default 6 significant digits would round after a few seconds
+	out << fixed << setprecision(3);
+
+	lock_guard<mutex> lock(registryMutex);
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	bool first = true;
+	size_t written = 0;
+	for (ThreadBuffer* buffer : registry)
+	{
+		if (buffer->name)
+		{
+			out << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->tid << ",\"args\":{\"name\":";
+			UWriteString(out, buffer->name);
+			out << "}}";
+			first = false;
+		}
+
+		for (Chunk* chunk = buffer->head; chunk; chunk = chunk->next.load(memory_order_acquire))
+		{
+			size_t count = chunk->count.load(memory_order_acquire);
+			for (size_t i = 0; i < count; i++)
+			{
+				const Event& event = chunk->events[i];
+				out << (first ? "" : ",\n") << "{\"ph\":\"" << event.phase << "\",\"pid\":1,\"tid\":" << buffer->tid << ",\"ts\":" << event.ts / 1000.0;
+				if (event.name)
+				{
+					out << ",\"name\":";
+					UWriteString(out, event.name);
+				}
+				if (event.phase == 'X')
+					out << ",\"dur\":" << event.dur / 1000.0;
+				if (event.phase == 'C')
+					out << ",\"args\":{\"value\":" << event.value << "}";
+				else if (event.arg)
+				{
+					out << ",\"args\":{\"detail\":";
+					UWriteString(out, event.arg);
+					out << "}";
+				}
+				out << "}";
+				first = false;
+				written++;
+			}
+		}
+	}
+	out << "\n]}\n";
+
+	cout << "TRACE: " << written << " events -> " << outFile << endl;
+	return true;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+//CHROME TRACE (PERFETTO JSON) EXPORT ==============================================================================================================
+//
+// --trace [file.json]   record cpu scopes, counters and gpu timestamps and write them to file.json (default trace.json)
+//                       at exit, open it in https://ui.perfetto.dev or chrome://tracing
+//
+// every thread writes into its own buffer (no locks on the recording path), names and args are stored as pointers so
+// they must be string literals (or otherwise outlive the trace). gpu scopes use GL_TIMESTAMP queries which are read
+// back late and shifted onto the cpu clock so both land on the same timeline.
+
+//setup / teardown
+void UTraceParseArgs(int argc, char* argv[]);
+bool UTraceEnabled();
+void UTraceThreadName(const char* name);
+bool UTraceFlush();
+
+//cpu events
+void UTraceBegin(const char* name, const char* arg = nullptr);
+void UTraceEnd();
+void UTraceCounter(const char* name, double value);
+
+//gpu events (GL thread only, needs a current context)
+void UTraceGpuInit();
+void UTraceGpuBegin(const char* name);
+void UTraceGpuEnd();
+void UTraceGpuCollect();		//call once per frame, reads back finished queries without stalling
+void UTraceGpuShutdown();
+
+//closes the previous frame section (cpu + gpu) and opens the next one, nullptr only closes (GL thread only)
+void UTraceFrameSection(const char* name);
+
+//scoped cpu event (remembers whether tracing was on when it started so begin/end always pair up)
+struct UTraceScope
+{
+	bool active;
+	UTraceScope(const char* name, const char* arg = nullptr) : active(UTraceEnabled()) { if (active) UTraceBegin(name, arg); }
+	~UTraceScope() { if (active) UTraceEnd(); }
+};
+
+//scoped gpu event
+struct UTraceGpuScope
+{
+	bool active;
+	UTraceGpuScope(const char* name) : active(UTraceEnabled()) { if (active) UTraceGpuBegin(name); }
+	~UTraceGpuScope() { if (active) UTraceGpuEnd(); }
+};
+
+#define UTRACE_JOIN2(a, b) a##b
+#define UTRACE_JOIN(a, b) UTRACE_JOIN2(a, b)
+#define UTRACE_SCOPE(name) UTraceScope UTRACE_JOIN(traceScope, __LINE__)(name)
+#define UTRACE_SCOPE_ARG(name, arg) UTraceScope UTRACE_JOIN(traceScope, __LINE__)(name, arg)
+#define UTRACE_GPU_SCOPE(name) UTraceGpuScope UTRACE_JOIN(traceGpuScope, __LINE__)(name)
@@ -0,0 +1,280 @@
+#include "TransformBatch.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <random>
+
+#include <glm/gtx/transform.hpp>
+
+#include "JobSystem.h"
+#include "Simd.h"
+#include "Trace.h"
+
+using namespace std;
+
+namespace
+{
+	typedef chrono::steady_clock Clock;
+
+	//vectors per parallel chunk (512 objects)
+	const int CHUNK_VECTORS = 64;
+	//timed passes per path, the best one counts
+	const int BENCH_PASSES = 5;
+
+	int UPadded(int count)
+	{
+		return (count + USIMD_WIDTH - 1) / USIMD_WIDTH * USIMD_WIDTH;
+	}
+
+	//what the draw loop used to do per object: three matrices by value and two full multiplies
+	glm::mat4 UComposeSeparate(glm::mat4 translation, glm::mat4 rotation, glm::mat4 scale)
+	{
+		return translation * rotation * scale;
+	}
+}
+
+//BATCH ============================================================================================================================================
+
+void UTransformBatchResize(UTransformBatch& batch, int count)
+{
+	int padded = UPadded(count);
+	//padding lanes past the old count go back to identity before they become real transforms
+	for (int i = count; i < batch.count; i++)
+		UTransformBatchSet(batch, i, glm::vec3(0.0f), glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(1.0f));
+	batch.tx.resize(padded, 0.0f);
+	batch.ty.resize(padded, 0.0f);
+	batch.tz.resize(padded, 0.0f);
+	batch.qx.resize(padded, 0.0f);
+	batch.qy.resize(padded, 0.0f);
+	batch.qz.resize(padded, 0.0f);
+	batch.qw.resize(padded, 1.0f);
+	batch.sx.resize(padded, 1.0f);
+	batch.sy.resize(padded, 1.0f);
+	batch.sz.resize(padded, 1.0f);
+	batch.count = count;
+}
+
+void UTransformBatchReserve(UTransformBatch& batch, int count)
+{
+	int padded = UPadded(count);
+	for (vector<float>* component : { &batch.tx, &batch.ty, &batch.tz, &batch.qx, &batch.qy, &batch.qz, &batch.qw, &batch.sx, &batch.sy, &batch.sz })
+		component->reserve(padded);
+}
+
+void UTransformBatchSet(UTransformBatch& batch, int index, const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale)
+{
+	batch.tx[index] = translation.x;
+	batch.ty[index] = translation.y;
+	batch.tz[index] = translation.z;
+	batch.qx[index] = rotation.x;
+	batch.qy[index] = rotation.y;
+	batch.qz[index] = rotation.z;
+	batch.qw[index] = rotation.w;
+	batch.sx[index] = scale.x;
+	batch.sy[index] = scale.y;
+	batch.sz[index] = scale.z;
+}
+
+void UComposeTransforms(const UTransformBatch& batch, int begin, int end, glm::mat4* world, const glm::mat4* viewProjection, glm::mat4* worldViewProjection)
+{
+	bool project = viewProjection != nullptr && worldViewProjection != nullptr;
+	//vp[column * 4 + row] broadcast once for the whole range
+	USimdFloat vp[16];
+	if (project)
+	{
+		for (int c = 0; c < 4; c++)
+			for (int r = 0; r < 4; r++)
+				vp[c * 4 + r] = USimdFloat((*viewProjection)[c][r]);
+	}
+
+	//12 varying elements of the world matrix (columns 0-2 rows 0-2, then the translation) and 16 of the projected one
+	float lanes[12][USIMD_WIDTH];
+	float projected[16][USIMD_WIDTH];
+	for (int first = begin - begin % USIMD_WIDTH; first < end; first += USIMD_WIDTH)
+	{
+		USimdFloat x = USimdFloat::Load(&batch.qx[first]);
+		USimdFloat y = USimdFloat::Load(&batch.qy[first]);
+		USimdFloat z = USimdFloat::Load(&batch.qz[first]);
+		USimdFloat w = USimdFloat::Load(&batch.qw[first]);
+		USimdFloat sx = USimdFloat::Load(&batch.sx[first]);
+		USimdFloat sy = USimdFloat::Load(&batch.sy[first]);
+		USimdFloat sz = USimdFloat::Load(&batch.sz[first]);
+
+		//rotation from the unit quaternion (glm::mat3_cast), each column scaled
+		USimdFloat one(1.0f);
+		USimdFloat two(2.0f);
+		USimdFloat xx = x * x, yy = y * y, zz = z * z;
+		USimdFloat xy = x * y, xz = x * z, yz = y * z;
+		USimdFloat wx = w * x, wy = w * y, wz = w * z;
+		USimdFloat m[12];
+		m[0] = (one - two * (yy + zz)) * sx;
+		m[1] = two * (xy + wz) * sx;
+		m[2] = two * (xz - wy) * sx;
+		m[3] = two * (xy - wz) * sy;
+		m[4] = (one - two * (xx + zz)) * sy;
+		m[5] = two * (yz + wx) * sy;
+		m[6] = two * (xz + wy) * sz;
+		m[7] = two * (yz - wx) * sz;
+		m[8] = (one - two * (xx + yy)) * sz;
+		m[9] = USimdFloat::Load(&batch.tx[first]);
+		m[10] = USimdFloat::Load(&batch.ty[first]);
+		m[11] = USimdFloat::Load(&batch.tz[first]);
+		for (int e = 0; e < 12; e++)
+			m[e].Store(lanes[e]);
+
+		//viewProjection * world with world's last row 0 0 0 1: column c = vp0 * w[c].x + vp1 * w[c].y + vp2 * w[c].z (+ vp3)
+		if (project)
+		{
+			for (int c = 0; c < 4; c++)
+			{
+				for (int r = 0; r < 4; r++)
+				{
+					USimdFloat sum = c == 3 ? vp[12 + r] : USimdFloat(0.0f);
+					sum = USimdMulAdd(vp[r], m[c * 3], sum);
+					sum = USimdMulAdd(vp[4 + r], m[c * 3 + 1], sum);
+					sum = USimdMulAdd(vp[8 + r], m[c * 3 + 2], sum);
+					sum.Store(projected[c * 4 + r]);
+				}
+			}
+		}
+
+		int last = std::min(first + USIMD_WIDTH, end);
+		for (int i = std::max(first, begin); i < last; i++)
+		{
+			int lane = i - first;
+			glm::mat4& out = world[i];
+			out[0] = glm::vec4(lanes[0][lane], lanes[1][lane], lanes[2][lane], 0.0f);
+			out[1] = glm::vec4(lanes[3][lane], lanes[4][lane], lanes[5][lane], 0.0f);
+			out[2] = glm::vec4(lanes[6][lane], lanes[7][lane], lanes[8][lane], 0.0f);
+			out[3] = glm::vec4(lanes[9][lane], lanes[10][lane], lanes[11][lane], 1.0f);
+			if (project)
+			{
+				glm::mat4& p = worldViewProjection[i];
+				for (int c = 0; c < 4; c++)
+					p[c] = glm::vec4(projected[c * 4][lane], projected[c * 4 + 1][lane], projected[c * 4 + 2][lane], projected[c * 4 + 3][lane]);
+			}
+		}
+	}
+}
+
+void UComposeTransformsParallel(const UTransformBatch& batch, glm::mat4* world, const glm::mat4* viewProjection, glm::mat4* worldViewProjection)
+{
+	UTRACE_SCOPE("compose transforms");
+	int vectors = UPadded(batch.count) / USIMD_WIDTH;
+	UParallelFor(vectors, CHUNK_VECTORS, [&](int begin, int end, int)
+	{
+		UComposeTransforms(batch, begin * USIMD_WIDTH, std::min(end * USIMD_WIDTH, batch.count), world, viewProjection, worldViewProjection);
+	});
+}
+
+//BENCHMARK ========================================================================================================================================
+
+bool UParseTransformBenchArgs(int argc, char* argv[], UTransformBenchConfig& config)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--bench-transforms") == 0)
+		{
+			config.enabled = true;
+			if (i + 1 < argc && argv[i + 1][0] != '-')
+				config.count = std::max(1, atoi(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--bench-transforms-threads") == 0)
+		{
+			if (i + 1 >= argc)
+			{
+				cerr << "ERROR: " << argv[i] << " needs a value" << endl;
+				return false;
+			}
+			config.enabled = true;
+			config.threads = atoi(argv[++i]);
+		}
+	}
+	return true;
+}
+
+int URunTransformBenchmark(const UTransformBenchConfig& config)
+{
+	UJobsInit(config.threads);
+	int count = config.count;
+	cout << "INFO: transform benchmark, " << count << " objects, " << USIMD_WIDTH << " wide"
+#ifdef USIMD_AVX2
+		<< " (AVX2)"
+#endif
+		<< ", " << UJobsThreadCount() << " threads" << endl;
+
+	//random poses in a 100 unit box, unit quaternions, scales 0.1-4
+	mt19937 random(12345);
+	uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	vector<glm::vec3> translations(count), scales(count);
+	vector<glm::quat> rotations(count);
+	UTransformBatch batch;
+	UTransformBatchResize(batch, count);
+	for (int i = 0; i < count; i++)
+	{
+		translations[i] = glm::vec3(unit(random), unit(random), unit(random)) * 50.0f;
+		glm::quat q(unit(random), unit(random), unit(random), unit(random));
+		rotations[i] = glm::length(q) > 1e-3f ? glm::normalize(q) : glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+		scales[i] = glm::vec3(unit(random), unit(random), unit(random)) * 1.95f + glm::vec3(2.05f);
+		UTransformBatchSet(batch, i, translations[i], rotations[i], scales[i]);
+	}
+	glm::mat4 viewProjection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 100.0f)
+		* glm::lookAt(glm::vec3(0.0f, 2.0f, 9.0f), glm::vec3(0.0f, 2.0f, 8.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+	vector<glm::mat4> referenceWorld(count), referenceProjected(count), world(count), projected(count);
+	auto best = [](const function<void()>& run)
+	{
+		double seconds = 1e30;
+		for (int pass = 0; pass < BENCH_PASSES; pass++)
+		{
+			Clock::time_point start = Clock::now();
+			run();
+			seconds = std::min(seconds, chrono::duration<double>(Clock::now() - start).count());
+		}
+		return seconds;
+	};
+
+	double glmSeconds = best([&]()
+	{
+		for (int i = 0; i < count; i++)
+		{
+			referenceWorld[i] = UComposeSeparate(glm::translate(translations[i]), glm::mat4_cast(rotations[i]), glm::scale(scales[i]));
+			referenceProjected[i] = viewProjection * referenceWorld[i];
+		}
+	});
+	double batchSeconds = best([&]() { UComposeTransforms(batch, 0, count, world.data(), &viewProjection, projected.data()); });
+	double parallelSeconds = best([&]() { UComposeTransformsParallel(batch, world.data(), &viewProjection, projected.data()); });
+	int threads = UJobsThreadCount();
+	UJobsShutdown();
+
+	//relative to the element size (projected elements get large)
+	float difference = 0.0f;
+	for (int i = 0; i < count; i++)
+	{
+		for (int c = 0; c < 4; c++)
+		{
+			for (int r = 0; r < 4; r++)
+			{
+				difference = std::max(difference, fabsf(world[i][c][r] - referenceWorld[i][c][r]) / std::max(1.0f, fabsf(referenceWorld[i][c][r])));
+				difference = std::max(difference, fabsf(projected[i][c][r] - referenceProjected[i][c][r]) / std::max(1.0f, fabsf(referenceProjected[i][c][r])));
+			}
+		}
+	}
+
+	//world + world-view-projection per object
+	cout << "TRANSFORMS: glm per call " << count / glmSeconds / 1.0e6 << " M objects/s (" << glmSeconds * 1000.0 << " ms), batch 1 thread "
+		<< count / batchSeconds / 1.0e6 << " M objects/s (" << glmSeconds / batchSeconds << "x), batch " << threads << " threads "
+		<< count / parallelSeconds / 1.0e6 << " M objects/s (" << glmSeconds / parallelSeconds << "x)" << endl;
+	cout << "INFO: largest relative difference to glm " << difference << endl;
+	if (difference > 1e-4f)
+	{
+		cerr << "ERROR: the batch kernel doesn't match glm" << endl;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+//BATCH TRANSFORM COMPOSITION ======================================================================================================================
+//
+// --bench-transforms [count]        compose count (default 100000) random transforms with the per-call glm path (translate *
+//                                   rotate * scale as separate matrices) and with the batch kernel on one and on every thread,
+//                                   report matrices/s and the largest difference, and exit
+// --bench-transforms-threads <n>    worker threads for the parallel run (default: one per hardware thread)
+//
+// translation, rotation and scale are stored structure-of-arrays, one float array per component padded to whole 8 lane
+// vectors, so one USimdFloat holds a component of 8 objects (AVX2 when available, otherwise the plain arrays the compiler
+// vectorizes for the target). the kernel builds each rotation straight from the quaternion, scales its columns and
+// writes the world matrix (the last row is always 0 0 0 1, so it is never multiplied) and optionally viewProjection *
+// world, which only needs 3 multiply-adds per element for the same reason. results are glm::mat4 arrays, what the
+// command lists and the storage buffers take. the scene graph composes the local matrices of its dirty nodes with it.
+
+struct UTransformBatch
+{
+	int count = 0;
+	std::vector<float> tx, ty, tz;
+	std::vector<float> qx, qy, qz, qw;
+	std::vector<float> sx, sy, sz;
+};
+
+//keeps the first count transforms, new ones (and the padding) are identity
+void UTransformBatchResize(UTransformBatch& batch, int count);
+void UTransformBatchReserve(UTransformBatch& batch, int count);
+void UTransformBatchSet(UTransformBatch& batch, int index, const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale);
+
+//world[i] = T * R * S for i in [begin, end), and worldViewProjection[i] = viewProjection * world[i] when both are given
+//(the arrays are indexed by object, like the batch)
+void UComposeTransforms(const UTransformBatch& batch, int begin, int end, glm::mat4* world, const glm::mat4* viewProjection = nullptr,
+	glm::mat4* worldViewProjection = nullptr);
+//the same for the whole batch, in chunks on the job system (UJobsInit has to have been called)
+void UComposeTransformsParallel(const UTransformBatch& batch, glm::mat4* world, const glm::mat4* viewProjection = nullptr,
+	glm::mat4* worldViewProjection = nullptr);
+
+struct UTransformBenchConfig
+{
+	bool enabled = false;
+	int count = 100000;
+	int threads = 0;
+};
+
+bool UParseTransformBenchArgs(int argc, char* argv[], UTransformBenchConfig& config);
+//microbenchmark entry point used by main() (returns the process exit code)
+int URunTransformBenchmark(const UTransformBenchConfig& config);
@@ -0,0 +1,267 @@
+#version 440 core
+//permutation flags (injected as #defines by the shader variant system, the values below are the full-featured default)
+#ifndef DIRECTIONAL_LIGHTS
+#define DIRECTIONAL_LIGHTS 2	//0-2: light.direction, light.direction2 (tinted)
+#endif
+#ifndef POINT_LIGHTS
+#define POINT_LIGHTS 0			//0-4: pointLights[]
+#endif
+#ifndef TEXTURED
+#define TEXTURED 1				//otherwise white
+#endif
+#ifndef SPECULAR
+#define SPECULAR 1
+#endif
+#ifndef ALPHA_TEST
+#define ALPHA_TEST 0			//discard texels with alpha < 0.5
+#endif
+#ifndef GPU_DRIVEN
+#define GPU_DRIVEN 0			//the material index comes from the vertex shader (per object storage buffer) instead of materialIndex
+#endif
+#ifndef SHADOWS
+#define SHADOWS 0				//directional lights shadowed by the static atlas and the dynamic cascades (ShadowMaps.h)
+#endif
+#ifndef LIGHTMAP
+#define LIGHTMAP 0				//ambient, directional diffuse and static shadows baked into a lightmap (Lightmap.h)
+#endif
+#ifndef VERTEX_LIGHTING
+#define VERTEX_LIGHTING 0		//the same baked into colorFromVS: lighting in rgb, occlusion in a (Lightmap.h)
+#endif
+#ifndef MULTI_VIEW
+#define MULTI_VIEW 0			//drawn into several views at once, the highlights follow the fragment's view (MultiView.h)
+#endif
+
+struct Material	//material object for lighting properties (std430, UMaterial in Materials.h)
+{
+	vec3 ambient;
+	float shininess;
+	vec3 diffuse;
+	int texture;
+	vec3 specular;
+	uint flags;
+};
+
+struct Light
+{
+	vec3 position;
+	vec3 ambient;
+	vec3 diffuse;
+	vec3 specular;
+	vec3 direction;
+	vec3 direction2;
+};
+
+struct PointLight
+{
+	vec3 position;
+	vec3 color;
+};
+
+in vec4 colorFromVS;	//get color from VS
+in vec2 texCoord;		//get texture coordinates from VS
+in vec3 fragPos;		//get fragment position from VS
+in vec3 normal;
+
+out vec4 FragColor;
+
+//get color for object and light from uniforms
+uniform vec3 objColor;
+uniform vec3 lightColor;
+uniform vec3 lightPos;
+uniform vec3 lightPos2;
+uniform vec3 cameraPos;
+//every material of the scene, the draw picks one
+layout (std430, binding = 6) readonly buffer Materials { Material materials[]; };
+uniform Light light;
+#if POINT_LIGHTS > 0
+uniform PointLight pointLights[POINT_LIGHTS];
+#endif
+//uniform for setting texture
+uniform sampler2D ourTexture;
+
+#if LIGHTMAP
+in vec2 lightmapUV;
+uniform sampler2D lightmap;		//irradiance (direct + bounced) without the albedo
+uniform sampler2D shadowmask;	//fraction of each light's samples that got through
+#endif
+
+#if MULTI_VIEW
+flat in int viewFromVS;
+uniform vec3 viewPositions[4];
+#define EYE_POSITION viewPositions[viewFromVS]
+#else
+#define EYE_POSITION cameraPos
+#endif
+
+#if GPU_DRIVEN
+flat in uint materialFromVS;
+#define MATERIAL_INDEX materialFromVS
+#else
+uniform int materialIndex;
+#define MATERIAL_INDEX materialIndex
+#endif
+
+#if SHADOWS
+//static casters: one tile per light, cached; dynamic casters: one row of cascades per light, every frame
+uniform sampler2DShadow shadowStatic;
+uniform sampler2DShadow shadowCascades;
+uniform mat4 shadowStaticMatrix[2];			//world -> 0-1 inside the light's tile
+uniform mat4 shadowCascadeMatrix[8];		//light * 4 + cascade
+uniform vec2 shadowStaticTexel;				//world size of a texel per light (normal offset)
+uniform vec4 shadowCascadeTexel;			//per cascade
+uniform vec4 shadowSplits;					//view depth each cascade ends at
+uniform int shadowCascadeCount;
+uniform mat4 view;
+
+//3x3 pcf inside one tile of an atlas of tiles.x by tiles.y (lit outside the tile's box)
+float shadowTile(sampler2DShadow atlas, vec3 p, vec2 tile, vec2 tiles)
+{
+	if (any(lessThan(p, vec3(0.0))) || any(greaterThan(p, vec3(1.0))))
+		return 1.0;
+	vec2 texel = tiles / vec2(textureSize(atlas, 0));
+	float lit = 0.0;
+	for (int x = -1; x <= 1; x++)
+	{
+		for (int y = -1; y <= 1; y++)
+		{
+			vec2 uv = clamp(p.xy + vec2(x, y) * texel, 0.5 * texel, 1.0 - 0.5 * texel);
+			lit += texture(atlas, vec3((tile + uv) / tiles, p.z - 0.0005));
+		}
+	}
+	return lit / 9.0;
+}
+
+//dynamic casters only (lit beyond the last cascade), positions pushed off the surface by about a texel
+float shadowCascade(int light, vec3 norm)
+{
+	float depth = -(view * vec4(fragPos, 1.0)).z;
+	int cascade = 0;
+	while (cascade < shadowCascadeCount - 1 && depth > shadowSplits[cascade])
+		cascade++;
+	if (depth > shadowSplits[cascade])
+		return 1.0;
+	vec4 c = shadowCascadeMatrix[light * 4 + cascade] * vec4(fragPos + norm * 1.5 * shadowCascadeTexel[cascade], 1.0);
+	return shadowTile(shadowCascades, c.xyz, vec2(float(cascade), float(light)), vec2(float(shadowCascadeCount), 2.0));
+}
+
+//darker of the static and the dynamic shadow
+float shadow(int light, vec3 norm)
+{
+	vec4 p = shadowStaticMatrix[light] * vec4(fragPos + norm * 1.5 * shadowStaticTexel[light], 1.0);
+	return min(shadowTile(shadowStatic, p.xyz, vec2(float(light), 0.0), vec2(2.0, 1.0)), shadowCascade(light, norm));
+}
+#endif
+
+void main()
+{
+	Material material = materials[MATERIAL_INDEX];
+#if TEXTURED
+	vec4 texel = texture(ourTexture, texCoord);
+#if ALPHA_TEST
+	if (texel.a < 0.5)
+		discard;
+#endif
+	vec3 albedo = texel.rgb;
+#else
+	vec3 albedo = vec3(1.0);
+#endif
+
+#if LIGHTMAP
+	//ambient and directional diffuse come baked (shadowed, with bounced light), the shadowmask shadows the specular
+	vec3 ambient = texture(lightmap, lightmapUV).rgb;
+	vec2 baked = texture(shadowmask, lightmapUV).rg;
+#elif VERTEX_LIGHTING
+	//the same from the interpolated colour, the occlusion stands in for both lights' visibility
+	vec3 ambient = colorFromVS.rgb;
+	vec2 baked = vec2(colorFromVS.a);
+#else
+	//ambient lighting
+	vec3 ambient = light.ambient * material.ambient;
+#endif
+
+	vec3 norm = normalize(normal);
+	vec3 viewDir = normalize(EYE_POSITION - fragPos);
+	vec3 diffuse = vec3(0.0);
+	vec3 specular = vec3(0.0);
+
+#if DIRECTIONAL_LIGHTS >= 1
+	//LIGHT1
+	//directional lighting
+	vec3 lightDir = normalize(-light.direction);
+#if LIGHTMAP || VERTEX_LIGHTING
+	float lit = baked.x;
+#if SHADOWS
+	//moving casters aren't in the bake: take the light they block back out of the lightmap
+	float dynamicLit = min(lit, shadowCascade(0, norm));
+	ambient -= ((lit - dynamicLit) * max(dot(norm, lightDir), 0.0) * material.diffuse) * light.diffuse;
+	lit = dynamicLit;
+#endif
+#elif SHADOWS
+	float lit = shadow(0, norm);
+#else
+	float lit = 1.0;
+#endif
+
+#if !LIGHTMAP && !VERTEX_LIGHTING
+	//diffuse lighting
+	float diff = lit * max(dot(norm, lightDir), 0.0);
+	diffuse += (diff * material.diffuse) * light.diffuse;
+#endif
+
+#if SPECULAR
+	//specular lighting
+	vec3 reflectDir = reflect(-lightDir, norm);
+	float spec = lit * pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
+	specular += (spec * material.specular) * (vec3(0.5, 0.5, 0.5) * light.specular);
+#endif
+#endif
+
+#if DIRECTIONAL_LIGHTS >= 2
+	//LIGHT2
+	//directional lighting
+	vec3 lightDir2 = normalize(-light.direction2);	//opposite the first one
+#if LIGHTMAP || VERTEX_LIGHTING
+	float lit2 = baked.y;
+#if SHADOWS
+	float dynamicLit2 = min(lit2, shadowCascade(1, norm));
+	ambient -= ((lit2 - dynamicLit2) * max(dot(norm, lightDir2), 0.0) * material.diffuse) * (vec3(1.0, 0.5, 0.25) * light.diffuse);
+	lit2 = dynamicLit2;
+#endif
+#elif SHADOWS
+	float lit2 = shadow(1, norm);
+#else
+	float lit2 = 1.0;
+#endif
+
+#if !LIGHTMAP && !VERTEX_LIGHTING
+	//diffuse lighting
+	float diff2 = lit2 * max(dot(norm, lightDir2), 0.0);
+	diffuse += (diff2 * material.diffuse) * (vec3(1.0, 0.5, 0.25) * light.diffuse);
+#endif
+
+#if SPECULAR
+	//specular lighting
+	vec3 reflectDir2 = reflect(-lightDir2, norm);
+	float spec2 = lit2 * pow(max(dot(viewDir, reflectDir2), 0.0), material.shininess);
+	specular += (spec2 * material.specular) * (vec3(1.0, 0.5, 0.25) * light.specular);
+#endif
+#endif
+
+#if POINT_LIGHTS > 0
+	//POINT LIGHTS (distance attenuated)
+	for (int i = 0; i < POINT_LIGHTS; i++)
+	{
+		vec3 toLight = pointLights[i].position - fragPos;
+		float distance = length(toLight);
+		vec3 pointDir = toLight / distance;
+		vec3 radiance = pointLights[i].color / (1.0 + 0.09 * distance + 0.032 * distance * distance);
+		diffuse += (max(dot(norm, pointDir), 0.0) * material.diffuse) * radiance;
+#if SPECULAR
+		specular += (pow(max(dot(viewDir, reflect(-pointDir, norm)), 0.0), material.shininess) * material.specular) * radiance;
+#endif
+	}
+#endif
+
+	vec3 result = (max(ambient, vec3(0.0)) + diffuse + specular) * albedo;
+	FragColor = vec4(result, 1.0);
+}
@@ -0,0 +1,98 @@
+#version 440 core
+#ifndef GPU_DRIVEN
+#define GPU_DRIVEN 0	//model matrix and material per object from storage buffers (GpuCulling.h) instead of uniforms
+#endif
+#ifndef LIGHTMAP
+#define LIGHTMAP 0		//second uv set into the object's square of the baked lightmap (Lightmap.h)
+#endif
+#ifndef MULTI_VIEW
+#define MULTI_VIEW 0	//one draw for every view of MultiView.h, the instance is the view
+#endif
+#ifndef MULTI_VIEW_GEOMETRY
+#define MULTI_VIEW_GEOMETRY 0	//no viewport index in the vertex shader: world space out, multiview.geom projects into each view
+#endif
+#if MULTI_VIEW && !MULTI_VIEW_GEOMETRY
+#extension GL_ARB_shader_viewport_layer_array : enable
+#extension GL_AMD_vertex_shader_viewport_index : enable
+#endif
+#if MULTI_VIEW && MULTI_VIEW_GEOMETRY
+//multiview.geom takes these and passes them on under the names scene.frag reads
+#define colorFromVS vsColor
+#define texCoord vsTexCoord
+#define normal vsNormal
+#define fragPos vsFragPos
+#define lightmapUV vsLightmapUV
+#define materialFromVS vsMaterial
+#endif
+layout (location = 0) in vec3 aPos;				//position coordinates
+layout (location = 1) in vec4 colorFromVBO;		//color values
+layout (location = 2) in vec2 texCoordFromVBO;	//texture coordinate values
+layout (location = 3) in vec3 aNormal;			//normal vector values (for lighting)
+
+out vec4 colorFromVS;	//to pass to FS
+out vec2 texCoord;
+out vec3 normal;
+out vec3 fragPos;
+
+#if LIGHTMAP
+layout (location = 5) in vec2 lightmapUVFromVBO;
+out vec2 lightmapUV;
+#endif
+
+#if GPU_DRIVEN
+layout (location = 4) in uint objectFromVBO;	//instanced attribute, the draw's baseInstance is the object index
+
+struct DrawObject
+{
+	uint node;
+	uint mesh;
+	uint batch;
+	uint command;
+	uint material;		//index into the material table (scene.frag)
+	uint pad0;
+	uint pad1;
+	uint pad2;
+	vec4 lightmap;		//atlas scale/offset
+};
+layout (std430, binding = 0) readonly buffer Objects { DrawObject objects[]; };
+layout (std430, binding = 1) readonly buffer Worlds { mat4 worlds[]; };
+
+flat out uint materialFromVS;
+#else
+uniform mat4 model;
+uniform vec4 lightmapScaleOffset;
+#endif
+uniform mat4 view;
+uniform mat4 projection;
+
+#if MULTI_VIEW && !MULTI_VIEW_GEOMETRY
+uniform mat4 viewProjections[4];
+flat out int viewFromVS;
+#endif
+
+void main()
+{
+#if GPU_DRIVEN
+	mat4 model = worlds[objects[objectFromVBO].node];
+	materialFromVS = objects[objectFromVBO].material;
+#endif
+#if LIGHTMAP
+#if GPU_DRIVEN
+	vec4 lightmapScaleOffset = objects[objectFromVBO].lightmap;
+#endif
+	lightmapUV = lightmapUVFromVBO * lightmapScaleOffset.xy + lightmapScaleOffset.zw;
+#endif
+	normal = mat3(transpose(inverse(model))) * aNormal;
+#if MULTI_VIEW && MULTI_VIEW_GEOMETRY
+	gl_Position = model * vec4(aPos, 1.0f);
+#elif MULTI_VIEW
+	gl_Position = viewProjections[gl_InstanceID] * model * vec4(aPos, 1.0f);
+	gl_ViewportIndex = gl_InstanceID;
+	viewFromVS = gl_InstanceID;
+#else
+	gl_Position = projection * view * model * vec4(aPos, 1.0f);	//transforms vertices to clip coords (creates view)
+#endif
+	colorFromVS = colorFromVBO;
+	texCoord = vec2(texCoordFromVBO.x, texCoordFromVBO.y);
+	fragPos = vec3(model * vec4(aPos, 1.0));
+}